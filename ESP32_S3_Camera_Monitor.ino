@@ -16,8 +16,30 @@
                 11. HTTP Basic Authentication认证 / HTTP Basic Authentication
                 12. OTA升级功能 / OTA upgrade function
                 13. WS2812B LED状态指示 / WS2812B LED status indication
+                14. 旧录像DCT域重量化压缩 / DCT-domain requantization of old recordings
+                15. 事件书签保护录像不被清理 / Event bookmarks protect footage from cleanup
+                16. 按时间段提取录像剪辑 / Clip extraction by time range
+                17. 录制中高分辨率抓拍 / High-resolution snapshots while recording
+                18. 连拍到PSRAM后台写入SD卡 / Burst capture into PSRAM with background SD writes
+                19. SD卡录像/照片索引，清理和列表不再遍历目录 / SD card recording/photo catalog, cleanup and listing no longer walk directories
+                20. 后台SD卡空间清理任务（高低水位线）/ Background SD card janitor task (low/high watermarks)
+                21. SD卡空间增量统计，空间查询不访问SD卡 / Incremental SD space accounting, space queries never touch the card
+                22. SD卡测速接口和启动校准（总线频率、录像写块大小）/ SD card benchmark endpoint and boot calibration (bus frequency, recording write block size)
+                23. 运行时可配置的保留策略（分类配额、最长/最少保留天数）/ Runtime-configurable retention policy (per-category quotas, maximum/minimum kept days)
+                24. 照片按天顺序追加到日包文件，按编号读取 / Photos appended to one pack file per day, served by ID
+                25. SD卡I/O调度（录像写入优先，HTTP读取分块限速，排队时间统计）/ SD card I/O scheduler (recording writes first, HTTP reads chunked and throttled, queue wait metrics)
+                26. SD卡掉卡检测，退避重新挂载后在新分段中继续录像，掉卡期间帧暂存PSRAM / SD card loss detection, remount with backoff and recording resumed in a new segment, frames held in PSRAM meanwhile
+                27. 按天/分类写入统计、写入速率和开始清理时间预测，清理任务按写入速率提前清理 / Per-day/per-category write statistics, write rate and cleanup time forecast, the janitor cleans ahead of demand
+                28. 单一取帧任务按引用计数把同一帧分发给录像、视频流和拍照，观看视频流不再抢录像的帧 / One capture task fans each frame out to recording, streams and photos by reference count, so stream viewers no longer steal the recorder's frames
+                29. 每个视频流观看者由独立发送任务推送，支持4路同时观看，/streams查看每路帧率和发送量 / Each stream viewer is served by its own sender task, 4 concurrent viewers, per-viewer fps and bytes sent on /streams
+                30. 视频流按观看者限速（/stream?fps=&maxkbps=），网络慢时跳到最新帧，分别统计丢帧和限速跳帧 / Per-viewer stream limits (/stream?fps=&maxkbps=), slow networks skip to the newest frame, dropped and rate-capped frames counted separately
+                31. 视频流不分块发送，每帧分段头和图像一次writev()写出，/streams报告每帧发送耗时和写入次数 / Unchunked stream responses, each frame's part header and image go out in one writev(), per-frame send time and write count on /streams
+                32. 网络连接调优（/net）：TCP_NODELAY、发送超时、发送缓冲、保活探测回收掉线观看者、控制连接LRU回收，/streams报告吞吐量和延迟用于对比 / Network connection tuning (/net): TCP_NODELAY, send timeout, send buffer, keepalive probes to reap dead viewers, LRU purge of control connections, throughput and latency on /streams for comparison
+                33. WebSocket视频流（/ws/stream）：每帧一个带序号和时间戳的二进制消息，按确认做流量控制，同一连接传递舵机命令 / WebSocket stream (/ws/stream): one binary message per frame with sequence number and timestamp, acknowledgement-based flow control, servo commands on the same connection
+                34. 文件浏览和下载（/files、/file）：按游标分页列出录像和照片，Range断点续传和拖动播放，下载由独立任务大块读取且让录像优先 / File browsing and download (/files, /file): cursor-paged listing of recordings and photos, Range requests for resuming and seeking, downloads read in large blocks by their own task with recording first
+                35. 录像回放（:81/playback?file=&t=&speed=）：从AVI读取00dc帧按原始时间和倍速推送MJPEG，高倍速按索引跳帧，不解码，播完接着播放下一个分段 / Recording playback (:81/playback?file=&t=&speed=): 00dc frames read from the AVI and pushed as MJPEG at their original timing times the speed, frames skipped through the index at high speed, no decoding, carries on into the next segment
   Auther      : Zhu Wenqian
-  Modification: 2026-02-04
+  Modification: 2026-02-05
   
   代码来源 / Code Source:
   - 基于Freenove ESP32-S3 Camera Example修改 / Modified from Freenove ESP32-S3 Camera Example
@@ -39,6 +61,20 @@
 #include "servo_control.h"
 #include "ota_server.h"
 #include "led_control.h"
+#include "video_aging.h"
+#include "bookmark.h"
+#include "catalog.h"
+#include "hires_snapshot.h"
+#include "photo_burst.h"
+#include "storage_janitor.h"
+#include "sd_bench.h"
+#include "retention.h"
+#include "storage_stats.h"
+#include "sd_io.h"
+#include "sd_recovery.h"
+#include "photo_pack.h"
+#include "frame_broker.h"
+#include "net_tuning.h"
 
 // =================== / ===================
 // Select camera model / 选择摄像头型号 / 选择摄像头型号
@@ -74,6 +110,15 @@ void startCameraServer();
 // 视频录制任务 / Video recording task / Video recording task / Video recording task
 void videoRecordTask(void *pvParameters);
 
+// 视频录制任务运行的核心（旧录像压缩任务在另一个核心）/ Core the recording task runs on (old recording compression runs on the other core)
+#define VIDEO_RECORD_CORE 1
+
+// 录制分辨率（高分辨率抓拍后切回此分辨率）/ Recording resolution (restored after a high-resolution snapshot)
+#define VIDEO_RECORD_FRAMESIZE FRAMESIZE_XGA
+
+// 录制帧率 / Recording frame rate
+#define VIDEO_RECORD_FPS 20
+
 // 获取运行时长（秒）/ Get uptime in seconds/ Get uptime in seconds
 unsigned long getUptimeSeconds() {
   return (millis() - startTime) / 1000;
@@ -141,8 +186,11 @@ void setup() {
   // 如果有PSRAM，使用SVGA分辨率和更高的JPEG质量
   // 以获得更大的预分配帧缓冲区。
   if(psramFound()){
+    // 按抓拍分辨率分配帧缓冲，初始化后再切回录制分辨率 / Size the frame buffers for snapshots, switch back to the recording resolution after init
+    config.frame_size = HIRES_SNAPSHOT_FRAMESIZE;
     config.jpeg_quality = 10;
-    config.fb_count = 2;
+    // 最新帧、录像和其他使用者各持有一帧时仍留一个给驱动填充，更多持有由帧分发器限制 / One buffer is left for the driver while the newest frame, the recorder and one other consumer each hold one; the frame broker refuses anything beyond that
+    config.fb_count = FRAME_BROKER_FB_COUNT;
     config.grab_mode = CAMERA_GRAB_LATEST;
   } else {
     // Limit the frame size when PSRAM is not available / 没有PSRAM时限制帧大小
@@ -169,6 +217,12 @@ void setup() {
   s->set_vflip(s, 1); // flip it back / 翻转回来 / 翻转回来
   s->set_brightness(s, 1); // up the brightness just a bit / 稍微提高亮度 / 稍微提高亮度
   s->set_saturation(s, 0); // lower the saturation / 降低饱和度 / 降低饱和度
+
+  // 切回录制分辨率，启用高分辨率抓拍 / Switch to the recording resolution and enable high-resolution snapshots
+  if(psramFound()){
+    s->set_framesize(s, VIDEO_RECORD_FRAMESIZE);
+    hires_snapshot_init(VIDEO_RECORD_FRAMESIZE);
+  }
   
   WiFi.begin(ssid, password);
   WiFi.setSleep(false);
@@ -205,11 +259,33 @@ void setup() {
     led_set_status(LED_SD_ERROR);
   } else {
     Serial.println("SD card initialized successfully / SD卡初始化成功");
+#if SD_BENCH_CALIBRATE_ON_BOOT
+    // 测速选定SD卡总线频率和录像写块大小（需要重新挂载，必须在打开任何文件之前）/ Benchmark to pick the SD bus frequency and recording write block size (remounts, so it must run before any file is opened)
+    Serial.println("Calibrating SD card... / SD卡测速校准...");
+    sd_bench_calibrate(VIDEO_RECORD_FPS);
+#endif
   }
   
+  // 启用SD卡I/O调度（录像写入优先于照片写入和HTTP读取）/ Enable the SD card I/O scheduler (recording writes go before photo writes and HTTP reads)
+  sd_io_init();
+
   // 初始化照片保存目录 / Initialize photo save directory / Initialize photo save directory
   initPhotoDir();
 
+  // 加载录像/照片索引（缺失或损坏时扫描目录重建）/ Load the recording/photo catalog (rebuilt from a directory scan if missing or corrupt)
+  if(!catalog_init()){
+    Serial.println("Catalog unavailable, falling back to directory scans / 索引不可用，使用目录扫描");
+  }
+
+  // 加载事件书签（清理时保护书签覆盖的分段）/ Load event bookmarks (segments they cover are protected from cleanup)
+  bookmark_init();
+
+  // 加载保留策略（配额、保留天数、清理水位线）/ Load the retention policy (quotas, ages, cleanup watermarks)
+  retention_init();
+
+  // 加载按天写入统计（用于写入速率和清理时间预测）/ Load the per-day write statistics (for the write rate and cleanup forecast)
+  storage_stats_init();
+
   // 清理无效视频文件（大小为0KB的视频）/ Clean up invalid video files (0KB video files) / Clean up invalid video files (0KB video files)
   Serial.println("Cleaning up invalid video files... / 清理无效视频文件...");
   int cleanedFiles = cleanInvalidVideoFiles();
@@ -222,19 +298,52 @@ void setup() {
     Serial.println("Failed to clean up invalid video files / 清理无效视频文件失败");
   }
 
+  // 启动SD卡空间清理任务（录像分段切换时不再清理）/ Start the SD card janitor task (segment rollover no longer cleans up)
+  if(!storage_janitor_init()){
+    Serial.println("Failed to start storage janitor task / SD卡空间清理任务启动失败");
+  }
+
+  // 启动SD卡掉卡恢复任务（连续写入失败后重新挂载并恢复录像）/ Start the SD card recovery task (remounts and resumes recording after repeated write failures)
+  if(!sd_recovery_init()){
+    Serial.println("Failed to start SD recovery task / SD卡掉卡恢复任务启动失败");
+  }
+
+  // 启动取帧任务，录像、视频流和拍照共用同一路帧 / Start the capture task, recording, streams and photos share one frame source
+  if(!frame_broker_init(config.fb_count)){
+    Serial.println("Failed to start frame broker / 取帧任务启动失败");
+  }
+
   // 启动视频录制（启动时自动开始录制）/ Start video recording (auto-start on boot)/ Start video recording (auto-start on boot)
   Serial.println("Starting video recording... / 启动视频录制...");
-  if(startVideoRecording(20, 1024, 768)){
+  if(startVideoRecording(VIDEO_RECORD_FPS, resolution[VIDEO_RECORD_FRAMESIZE].width, resolution[VIDEO_RECORD_FRAMESIZE].height)){
     Serial.println("Video recording started successfully / 视频录制启动成功");
     
     // 创建视频录制任务 / Create video recording task / Create video recording task
     int *fpsParam = (int*)malloc(sizeof(int));
-    *fpsParam = 20;
-    xTaskCreate(videoRecordTask, "video_record", 4096, fpsParam, 5, NULL);
+    *fpsParam = VIDEO_RECORD_FPS;
+    xTaskCreatePinnedToCore(videoRecordTask, "video_record", 4096, fpsParam, 5, NULL, VIDEO_RECORD_CORE);
   } else {
     Serial.println("Failed to start video recording / 视频录制启动失败");
   }
 
+  // 启动旧录像压缩任务（低优先级，录制以外的核心）/ Start old recording compression task (low priority, on the core not used for recording)
+  if(!video_aging_init()){
+    Serial.println("Failed to start video aging task / 旧录像压缩任务启动失败");
+  }
+
+  // 恢复当天的照片包（断电后由记录头重建）/ Recover today's photo pack (rebuilt from record headers after a power loss)
+  if(!photo_pack_init()){
+    Serial.println("Failed to initialise photo packs / 照片包初始化失败");
+  }
+
+  // 启动连拍写入任务 / Start the burst photo flush task
+  if(!photo_burst_init()){
+    Serial.println("Failed to start burst flush task / 连拍写入任务启动失败");
+  }
+
+  // 加载网络调优设置（TCP_NODELAY、保活探测、发送超时等，Web服务启动时使用）/ Load the network tuning settings (TCP_NODELAY, keepalive, send timeout etc., used when the web servers start)
+  net_tuning_init();
+
   startCameraServer();
 
   Serial.print("Camera Ready! Use 'http://");
@@ -249,25 +358,33 @@ void videoRecordTask(void *pvParameters) {
   camera_fb_t *fb = NULL;
   int fps = *((int*)pvParameters);
   int delayMs = 1000 / fps;
+  FrameSubscriber recordSub;
+  frame_broker_subscribe(&recordSub, true);        // 录像使用预留名额 / Recording uses the reserved place
   
   Serial.printf("Video recording task started, FPS: %d / 视频录制任务已启动，帧率: %d\n", fps);
   
   while(isRecordingVideo()) {
-    // 获取摄像头帧 / Get camera frame / Get camera frame
-    fb = esp_camera_fb_get();
+    // 从帧分发器取最新帧（高分辨率抓拍期间没有新帧）/ Take the newest frame from the broker (no new frames during a high-resolution snapshot)
+    fb = frame_broker_acquire(&recordSub, HIRES_SNAPSHOT_LOCK_TIMEOUT_MS);
     if(!fb) {
       Serial.println("Camera capture failed during recording / 录制过程中摄像头捕获失败");
       vTaskDelay(pdMS_TO_TICKS(delayMs));
       continue;
     }
+
+    // 尺寸与录制分辨率不符的帧不写入（仅PSRAM下会切换分辨率）/ Frames not at the recording resolution are never written (resolution only switches with PSRAM)
+    if(psramFound() && (fb->width != resolution[VIDEO_RECORD_FRAMESIZE].width || fb->height != resolution[VIDEO_RECORD_FRAMESIZE].height)) {
+      frame_broker_release(fb);
+      continue;
+    }
     
     // 写入视频帧 / Write video frame / Write video frame
     if(!writeVideoFrame(fb->buf, fb->len)) {
       Serial.println("Failed to write video frame / 写入视频帧失败");
     }
     
-    // 释放帧缓冲区 / Release frame buffer / Release frame buffer
-    esp_camera_fb_return(fb);
+    // 释放帧（最后一个使用者释放后归还帧缓冲）/ Release the frame (the buffer goes back once the last consumer releases it)
+    frame_broker_release(fb);
     
     // 延迟以控制帧率 / Delay to control frame rate / Delay to control frame rate
     vTaskDelay(pdMS_TO_TICKS(delayMs));
@@ -65,6 +65,26 @@
 #include "servo_control.h"
 #include "ota_server.h"
 #include "led_control.h"
+#include "video_aging.h"
+#include "storage_janitor.h"
+#include "bookmark.h"
+#include "video_clip.h"
+#include "hires_snapshot.h"
+#include "photo_burst.h"
+#include "sd_bench.h"
+#include "retention.h"
+#include "sd_space.h"
+#include "photo_pack.h"
+#include "sd_io.h"
+#include "sd_recovery.h"
+#include "storage_stats.h"
+#include "frame_broker.h"
+#include "stream_clients.h"
+#include "net_tuning.h"
+#include "ws_stream.h"
+#include "catalog.h"
+#include "file_download.h"
+#include "video_playback.h"
 
 #if defined(ARDUINO_ARCH_ESP32) && defined(CONFIG_ARDUHAL_ESP_LOG)
 #include "esp32-hal-log.h"
@@ -74,11 +94,6 @@
 static const char *TAG = "camera_httpd";
 #endif
 
-#define PART_BOUNDARY "123456789000000000000987654321"
-static const char *_STREAM_CONTENT_TYPE = "multipart/x-mixed-replace;boundary=" PART_BOUNDARY;
-static const char *_STREAM_BOUNDARY = "\r\n--" PART_BOUNDARY "\r\n";
-static const char *_STREAM_PART = "Content-Type: image/jpeg\r\nContent-Length: %u\r\nX-Timestamp: %d.%06d\r\n\r\n";
-
 httpd_handle_t stream_httpd = NULL;
 httpd_handle_t camera_httpd = NULL;
 
@@ -147,7 +162,9 @@ static esp_err_t bmp_handler(httpd_req_t *req)
 #if ARDUHAL_LOG_LEVEL >= ARDUHAL_LOG_LEVEL_INFO
     uint64_t fr_start = esp_timer_get_time();
 #endif
-    fb = esp_camera_fb_get();
+    FrameSubscriber sub;
+    frame_broker_subscribe(&sub);
+    fb = frame_broker_acquire(&sub, HIRES_SNAPSHOT_LOCK_TIMEOUT_MS);
     if (!fb)
     {
         ESP_LOGE(TAG, "Camera capture failed");
@@ -167,7 +184,7 @@ static esp_err_t bmp_handler(httpd_req_t *req)
     uint8_t * buf = NULL;
     size_t buf_len = 0;
     bool converted = frame2bmp(fb, &buf, &buf_len);
-    esp_camera_fb_return(fb);
+    frame_broker_release(fb);
     if(!converted){
         ESP_LOGE(TAG, "BMP Conversion failed");
         httpd_resp_send_500(req);
@@ -197,6 +214,163 @@ static size_t jpg_encode_stream(void *arg, size_t index, const void *data, size_
     return len;
 }
 
+// ==================== 异步保存照片 / Asynchronous Photo Saving ====================
+
+/**
+ * @brief 返回照片并交给后台任务保存 / Send a photo back and hand it to the background writer
+ * @param req HTTP请求对象 / HTTP request object
+ * @param jpg JPEG数据（ps_malloc分配，本函数负责释放或移交）/ JPEG data (allocated with ps_malloc, freed or handed over here)
+ * @param jpg_len JPEG长度 / JPEG length
+ * @return esp_err_t 处理结果 / Processing result
+ * @details 功能说明 / Function Description:
+ *          1. 预留写入队列，X-Photo-Id响应头返回编号 / Reserve the write queue and return the ID in the X-Photo-Id header
+ *          2. 先发送图片，再把数据交给写入任务，响应不等待SD卡 / Send the photo first, then hand the data to the writer, the response never waits on the SD card
+ *          3. 队列已满时退回同步保存 / Falls back to a synchronous save when the queue is full
+ * @note 调用前可先设置其他响应头 / Callers may set extra headers beforehand
+ */
+static esp_err_t send_and_queue_photo(httpd_req_t *req, uint8_t *jpg, size_t jpg_len)
+{
+    time_t when = time(nullptr);
+    uint32_t id = photo_burst_reserve(jpg_len);
+    char id_str[16];
+    if (id)
+    {
+        snprintf(id_str, sizeof(id_str), "%lu", (unsigned long)id);
+        httpd_resp_set_hdr(req, "X-Photo-Id", id_str);
+    }
+    else if (savePhotoToSDAt(jpg, jpg_len, when))
+    {
+        ESP_LOGW(TAG, "Photo queue full, saved synchronously");
+    }
+    else
+    {
+        ESP_LOGE(TAG, "Failed to save photo to SD card");
+    }
+
+    httpd_resp_set_type(req, "image/jpeg");
+    httpd_resp_set_hdr(req, "Content-Disposition", "inline; filename=capture.jpg");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    httpd_resp_set_hdr(req, "Access-Control-Expose-Headers", "X-Photo-Id");
+    esp_err_t res = httpd_resp_send(req, (const char *)jpg, jpg_len);
+
+    // 发送失败也要保存 / Save even if sending failed
+    if (id)
+    {
+        photo_burst_submit(id, jpg, jpg_len, when);
+    }
+    else
+    {
+        free(jpg);
+    }
+    return res;
+}
+
+/**
+ * @brief 查询照片保存结果（/capture?id=N）/ Look up a photo's save result (/capture?id=N)
+ * @param req HTTP请求对象 / HTTP request object
+ * @param id 照片编号（X-Photo-Id响应头或连拍的first_id）/ Photo ID (X-Photo-Id header or first_id of a burst)
+ * @return esp_err_t 处理结果 / Processing result
+ *
+ * API接口 / API Interface:
+ * GET /capture?id=N
+ * 返回 / Returns: {"id":N,"status":"pending|saved|failed|unknown","path":"/photo?id=..."}
+ * 启用照片日包时path为/photo接口地址，否则为SD卡文件路径 / With daily photo packs path is the /photo URL, otherwise the SD card file path
+ */
+static esp_err_t photo_lookup(httpd_req_t *req, uint32_t id)
+{
+    static const char *state_names[] = {"unknown", "pending", "saved", "failed"};
+    char path[64];
+    PhotoSaveState state = photo_burst_lookup(id, path, sizeof(path));
+
+    char json_response[160];
+    snprintf(json_response, sizeof(json_response), "{\"id\":%lu,\"status\":\"%s\",\"path\":\"%s\"}",
+             (unsigned long)id, state_names[state], path);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    return httpd_resp_send(req, json_response, strlen(json_response));
+}
+
+// ==================== 高分辨率抓拍 / High-Resolution Snapshot ====================
+
+/**
+ * @brief 高分辨率抓拍处理（/capture?hires=1）/ High-resolution snapshot handling (/capture?hires=1)
+ * @param req HTTP请求对象 / HTTP request object
+ * @return esp_err_t 处理结果 / Processing result
+ * @details 功能说明 / Function Description:
+ *          1. 录像暂停，传感器临时切到HIRES_SNAPSHOT_FRAMESIZE抓一帧 / Recording pauses, the sensor briefly switches to HIRES_SNAPSHOT_FRAMESIZE for one frame
+ *          2. 切回录制分辨率后返回图片，由后台任务保存到SD卡 / The photo is returned after switching back and saved to SD by the background writer
+ *          3. X-Resolution和X-Record-Gap-Ms响应头报告分辨率和录像间隙 / The X-Resolution and X-Record-Gap-Ms headers report the resolution and recording gap
+ */
+static esp_err_t hires_capture(httpd_req_t *req)
+{
+    uint8_t *jpg = NULL;
+    size_t jpgLen = 0;
+    uint16_t width = 0;
+    uint16_t height = 0;
+    uint32_t gapMs = 0;
+    if (!hires_snapshot_take(&jpg, &jpgLen, &width, &height, &gapMs))
+    {
+        ESP_LOGE(TAG, "Hi-res snapshot failed");
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+
+    // 触发拍照LED闪烁 / Trigger photo LED flash
+    led_set_status(LED_PHOTO_FLASH);
+
+    char resolutionStr[16];
+    char gapStr[16];
+    snprintf(resolutionStr, sizeof(resolutionStr), "%ux%u", width, height);
+    snprintf(gapStr, sizeof(gapStr), "%lu", (unsigned long)gapMs);
+    httpd_resp_set_hdr(req, "X-Resolution", resolutionStr);
+    httpd_resp_set_hdr(req, "X-Record-Gap-Ms", gapStr);
+    esp_err_t res = send_and_queue_photo(req, jpg, jpgLen);
+    ESP_LOGI(TAG, "Hi-res JPG: %uB %s, %lums outside recording resolution", (uint32_t)jpgLen, resolutionStr, (unsigned long)gapMs);
+    return res;
+}
+
+// ==================== 连拍 / Burst Capture ====================
+
+/**
+ * @brief 连拍处理（/capture?burst=N）/ Burst capture handling (/capture?burst=N)
+ * @param req HTTP请求对象 / HTTP request object
+ * @param count 帧数 / Frame count
+ * @return esp_err_t 处理结果 / Processing result
+ * @details 功能说明 / Function Description:
+ *          1. 以传感器最高帧率连拍N帧到PSRAM / Capture N frames into PSRAM at the sensor's full frame rate
+ *          2. 拍完立即返回JSON，照片由后台任务写入SD卡 / Return JSON as soon as capture finishes, a background task writes the photos to SD
+ *
+ * API接口 / API Interface:
+ * GET /capture?burst=N
+ * 返回 / Returns: {"status":"success","requested":N,"captured":n,"elapsed_ms":ms,"fps":f,"pending":p,"first_id":id}
+ * 照片编号为first_id到first_id+n-1，可用/capture?id=查询保存路径 / Photo IDs run from first_id to first_id+n-1, look up the saved paths with /capture?id=
+ */
+static esp_err_t burst_capture(httpd_req_t *req, int count)
+{
+    PhotoBurstResult result;
+    bool ok = photo_burst_capture(count, &result);
+
+    char json_response[192];
+    if (ok)
+    {
+        led_set_status(LED_PHOTO_FLASH);
+        snprintf(json_response, sizeof(json_response),
+                 "{\"status\":\"success\",\"requested\":%d,\"captured\":%d,\"elapsed_ms\":%lu,\"fps\":%.1f,\"pending\":%lu,\"first_id\":%lu}",
+                 count, result.captured, (unsigned long)result.elapsedMs,
+                 result.elapsedMs ? result.captured * 1000.0f / result.elapsedMs : 0.0f, (unsigned long)result.pendingFrames,
+                 (unsigned long)result.firstId);
+    }
+    else
+    {
+        ESP_LOGE(TAG, "Burst capture failed");
+        snprintf(json_response, sizeof(json_response),
+                 "{\"status\":\"error\",\"message\":\"Burst capture failed\",\"pending\":%lu}", (unsigned long)photo_burst_pending());
+    }
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    return httpd_resp_send(req, json_response, strlen(json_response));
+}
+
 static esp_err_t capture_handler(httpd_req_t *req)
 {
     // 验证认证
@@ -206,6 +380,32 @@ static esp_err_t capture_handler(httpd_req_t *req)
         return auth_send_401(req);
     }
 
+    // hires=1：录制中高分辨率抓拍；burst=N：连拍；id=N：查询保存结果 / hires=1: high-resolution snapshot while recording; burst=N: burst capture; id=N: look up a save result
+    char query[32];
+    char value[12];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK)
+    {
+        if (httpd_query_key_value(query, "id", value, sizeof(value)) == ESP_OK)
+        {
+            return photo_lookup(req, strtoul(value, NULL, 10));
+        }
+        if (httpd_query_key_value(query, "hires", value, sizeof(value)) == ESP_OK && atoi(value) == 1)
+        {
+            return hires_capture(req);
+        }
+        if (httpd_query_key_value(query, "burst", value, sizeof(value)) == ESP_OK)
+        {
+            int count = atoi(value);
+            if (count < 1 || count > PHOTO_BURST_MAX_FRAMES)
+            {
+                char msg[40];
+                snprintf(msg, sizeof(msg), "burst must be 1-%d", PHOTO_BURST_MAX_FRAMES);
+                return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, msg);
+            }
+            return burst_capture(req, count);
+        }
+    }
+
     camera_fb_t *fb = NULL;
     esp_err_t res = ESP_OK;
 #if ARDUHAL_LOG_LEVEL >= ARDUHAL_LOG_LEVEL_INFO
@@ -213,13 +413,17 @@ static esp_err_t capture_handler(httpd_req_t *req)
     size_t fb_len = 0;
 #endif
 
+    // 从帧分发器取一帧更新的帧，不与录像抢帧 / Take a fresh frame from the broker instead of competing with the recorder
+    FrameSubscriber sub;
 #ifdef CONFIG_LED_ILLUMINATOR_ENABLED
     enable_led(true);
-    vTaskDelay(150 / portTICK_PERIOD_MS); // The LED needs to be turned on ~150ms before the call to esp_camera_fb_get()
-    fb = esp_camera_fb_get();             // or it won't be visible in the frame. A better way to do this is needed.
+    vTaskDelay(150 / portTICK_PERIOD_MS); // The LED needs to be turned on ~150ms before the frame is captured
+    frame_broker_subscribe(&sub);         // or it won't be visible in the frame, so only frames from after the wait count.
+    fb = frame_broker_acquire(&sub, HIRES_SNAPSHOT_LOCK_TIMEOUT_MS);
     enable_led(false);
 #else
-    fb = esp_camera_fb_get();
+    frame_broker_subscribe(&sub);
+    fb = frame_broker_acquire(&sub, HIRES_SNAPSHOT_LOCK_TIMEOUT_MS);
 #endif
 
     if (!fb)
@@ -232,7 +436,25 @@ static esp_err_t capture_handler(httpd_req_t *req)
     // 触发拍照LED闪烁 / Trigger photo LED flash
     led_set_status(LED_PHOTO_FLASH);
 
-    // 保存照片到SD卡
+    // 复制到PSRAM后立即归还帧缓冲，保存交给后台任务 / Copy into PSRAM and return the frame buffer at once, the background writer saves it
+    uint8_t *jpg = fb->format == PIXFORMAT_JPEG ? (uint8_t *)ps_malloc(fb->len) : NULL;
+    if (jpg)
+    {
+        size_t jpg_len = fb->len;
+        char ts[32];
+        snprintf(ts, 32, "%ld.%06ld", fb->timestamp.tv_sec, fb->timestamp.tv_usec);
+        memcpy(jpg, fb->buf, jpg_len);
+        frame_broker_release(fb);
+        httpd_resp_set_hdr(req, "X-Timestamp", (const char *)ts);
+        res = send_and_queue_photo(req, jpg, jpg_len);
+#if ARDUHAL_LOG_LEVEL >= ARDUHAL_LOG_LEVEL_INFO
+        int64_t fr_end = esp_timer_get_time();
+#endif
+        ESP_LOGI(TAG, "JPG: %uB %ums", (uint32_t)(jpg_len), (uint32_t)((fr_end - fr_start) / 1000));
+        return res;
+    }
+
+    // PSRAM不足或非JPEG格式时同步保存 / Save synchronously without PSRAM or for non-JPEG formats
     bool saveSuccess = savePhotoToSD(fb->buf, fb->len);
     if(saveSuccess){
         ESP_LOGI(TAG, "Photo saved to SD card successfully");
@@ -264,7 +486,7 @@ static esp_err_t capture_handler(httpd_req_t *req)
         fb_len = jchunk.len;
 #endif
     }
-    esp_camera_fb_return(fb);
+    frame_broker_release(fb);
 #if ARDUHAL_LOG_LEVEL >= ARDUHAL_LOG_LEVEL_INFO
     int64_t fr_end = esp_timer_get_time();
 #endif
@@ -286,107 +508,33 @@ static esp_err_t stream_handler(httpd_req_t *req)
         return httpd_resp_send(req, NULL, 0);
     }
 
-    camera_fb_t *fb = NULL;
-    struct timeval _timestamp;
-    esp_err_t res = ESP_OK;
-    size_t _jpg_buf_len = 0;
-    uint8_t *_jpg_buf = NULL;
-    char *part_buf[128];
-
-    static int64_t last_frame = 0;
-    if (!last_frame)
-    {
-        last_frame = esp_timer_get_time();
-    }
-
-    res = httpd_resp_set_type(req, _STREAM_CONTENT_TYPE);
-    if (res != ESP_OK)
-    {
-        return res;
-    }
-
-    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
-    httpd_resp_set_hdr(req, "X-Framerate", "60");
-
-#ifdef CONFIG_LED_ILLUMINATOR_ENABLED
-    enable_led(true);
-    isStreaming = true;
-#endif
-
-    while (true)
-    {
-        fb = esp_camera_fb_get();
-        if (!fb)
-        {
-            ESP_LOGE(TAG, "Camera capture failed");
-            res = ESP_FAIL;
-        }
-        else
-        {
-            _timestamp.tv_sec = fb->timestamp.tv_sec;
-            _timestamp.tv_usec = fb->timestamp.tv_usec;
-
-            if (fb->format != PIXFORMAT_JPEG)
-            {
-                bool jpeg_converted = frame2jpg(fb, 80, &_jpg_buf, &_jpg_buf_len);
-                esp_camera_fb_return(fb);
-                fb = NULL;
-                if (!jpeg_converted)
-                {
-                    ESP_LOGE(TAG, "JPEG compression failed");
-                    res = ESP_FAIL;
-                }
+    // 限速参数：/stream?fps=10&maxkbps=2000 / Limits: /stream?fps=10&maxkbps=2000
+    StreamClientLimits limits = {0, 0};
+    size_t query_len = httpd_req_get_url_query_len(req) + 1;
+    if (query_len > 1) {
+        char *buf = (char *)malloc(query_len);
+        char value[16];
+        if (buf && httpd_req_get_url_query_str(req, buf, query_len) == ESP_OK) {
+            if (httpd_query_key_value(buf, "fps", value, sizeof(value)) == ESP_OK) {
+                limits.maxFps = strtoul(value, NULL, 10);
             }
-            else
-            {
-                _jpg_buf_len = fb->len;
-                _jpg_buf = fb->buf;
+            if (httpd_query_key_value(buf, "maxkbps", value, sizeof(value)) == ESP_OK) {
+                limits.maxKbps = strtoul(value, NULL, 10);
             }
         }
-        if (res == ESP_OK)
-        {
-            res = httpd_resp_send_chunk(req, _STREAM_BOUNDARY, strlen(_STREAM_BOUNDARY));
-        }
-        if (res == ESP_OK)
-        {
-            size_t hlen = snprintf((char *)part_buf, 128, _STREAM_PART, _jpg_buf_len, _timestamp.tv_sec, _timestamp.tv_usec);
-            res = httpd_resp_send_chunk(req, (const char *)part_buf, hlen);
-        }
-        if (res == ESP_OK)
-        {
-            res = httpd_resp_send_chunk(req, (const char *)_jpg_buf, _jpg_buf_len);
-        }
-        if (fb)
-        {
-            esp_camera_fb_return(fb);
-            fb = NULL;
-            _jpg_buf = NULL;
-        }
-        else if (_jpg_buf)
-        {
-            free(_jpg_buf);
-            _jpg_buf = NULL;
-        }
-        if (res != ESP_OK)
-        {
-            ESP_LOGE(TAG, "send frame failed failed");
-            break;
-        }
-        int64_t fr_end = esp_timer_get_time();
-
-        int64_t frame_time = fr_end - last_frame;
-        frame_time /= 1000;
-        ESP_LOGI(TAG, "MJPG: %uB %ums (%.1ffps)",
-                 (uint32_t)(_jpg_buf_len),
-                 (uint32_t)frame_time, 1000.0 / (uint32_t)frame_time);
+        free(buf);
     }
 
-#ifdef CONFIG_LED_ILLUMINATOR_ENABLED
-    isStreaming = false;
-    enable_led(false);
-#endif
-
-    return res;
+    // 交给独立的发送任务，视频流服务器随即可以接受下一个观看者 / Hand over to a sender task of its own, the stream server can take the next viewer at once
+    esp_err_t res = stream_clients_start(req, &limits);
+    if (res != ESP_OK)
+    {
+        ESP_LOGW(TAG, "Stream handler: no free stream client (%d)", res);
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_hdr(req, "Retry-After", "5");
+        return httpd_resp_send(req, "Too many viewers", HTTPD_RESP_USE_STRLEN);
+    }
+    return ESP_OK;
 }
 
 static esp_err_t parse_get(httpd_req_t *req, char **obuf)
@@ -519,7 +667,7 @@ static esp_err_t status_handler(httpd_req_t *req)
         return auth_send_401(req);
     }
 
-    static char json_response[2048];  // 增大缓冲区以容纳SD卡信息
+    static char json_response[3072];  // 增大缓冲区以容纳SD卡信息
 
     sensor_t *s = esp_camera_sensor_get();
     char *p = json_response;
@@ -602,6 +750,60 @@ static esp_err_t status_handler(httpd_req_t *req)
     p += sprintf(p, ",\"sd_used\":%.2f", usedSpace / 100.0);
     p += sprintf(p, ",\"sd_free\":%.2f", freeSpace / 100.0);
 
+    // 添加SD卡空间清理状态
+    StorageJanitorStats janitorStats;
+    storage_janitor_get_stats(&janitorStats);
+    p += sprintf(p, ",\"janitor_cleaning\":%u", janitorStats.cleaning ? 1 : 0);
+    p += sprintf(p, ",\"janitor_deleted\":%lu", (unsigned long)janitorStats.filesDeleted);
+    p += sprintf(p, ",\"janitor_ahead_mb\":%llu", janitorStats.aheadBytes / (1024ULL * 1024ULL));
+
+    // 添加旧录像压缩统计（节省MB，转码帧率）
+    VideoAgingStats agingStats;
+    video_aging_get_stats(&agingStats);
+    p += sprintf(p, ",\"requant_files\":%lu", (unsigned long)agingStats.filesProcessed);
+    p += sprintf(p, ",\"requant_saved_mb\":%.2f", (agingStats.bytesBefore - agingStats.bytesAfter) / 1048576.0);
+    p += sprintf(p, ",\"requant_fps\":%.1f", video_aging_get_fps());
+
+    // 添加高分辨率抓拍统计（离开录制分辨率的时间）
+    HiresSnapshotStats hiresStats;
+    hires_snapshot_get_stats(&hiresStats);
+    p += sprintf(p, ",\"hires_count\":%lu", (unsigned long)hiresStats.count);
+    p += sprintf(p, ",\"hires_last_gap_ms\":%lu", (unsigned long)hiresStats.lastGapMs);
+    p += sprintf(p, ",\"hires_max_gap_ms\":%lu", (unsigned long)hiresStats.maxGapMs);
+
+    // 添加SD卡I/O调度统计（各类别平均/最长排队时间，录像超出预算次数）
+    static const char *sdio_class_names[SD_IO_NUM_CLASSES] = {"record", "store", "bulk"};
+    SdIoStats sdioStats;
+    sd_io_get_stats(&sdioStats);
+    for(int c = 0; c < SD_IO_NUM_CLASSES; c++) {
+        const SdIoClassStats *cs = &sdioStats.classes[c];
+        p += sprintf(p, ",\"sdio_%s_ops\":%lu", sdio_class_names[c], (unsigned long)cs->ops);
+        p += sprintf(p, ",\"sdio_%s_wait_avg_us\":%lu", sdio_class_names[c],
+                     (unsigned long)(cs->ops ? cs->waitTotalUs / cs->ops : 0));
+        p += sprintf(p, ",\"sdio_%s_wait_max_us\":%lu", sdio_class_names[c], (unsigned long)cs->waitMaxUs);
+        p += sprintf(p, ",\"sdio_%s_kb\":%llu", sdio_class_names[c], (unsigned long long)(cs->bytes / 1024));
+    }
+    p += sprintf(p, ",\"sdio_record_over_budget\":%lu", (unsigned long)sdioStats.recordOverBudget);
+    p += sprintf(p, ",\"sdio_bulk_chunk\":%lu", (unsigned long)sdioStats.bulkChunk);
+
+    // 添加帧分发统计（发布帧数、取帧失败次数、同时未归还帧数峰值、因上限未发出的帧数）
+    FrameBrokerStats brokerStats;
+    frame_broker_get_stats(&brokerStats);
+    p += sprintf(p, ",\"broker_published\":%lu", (unsigned long)brokerStats.published);
+    p += sprintf(p, ",\"broker_capture_failures\":%lu", (unsigned long)brokerStats.captureFailures);
+    p += sprintf(p, ",\"broker_held\":%lu", (unsigned long)brokerStats.held);
+    p += sprintf(p, ",\"broker_held_max\":%lu", (unsigned long)brokerStats.heldMax);
+    p += sprintf(p, ",\"broker_refused\":%lu", (unsigned long)brokerStats.refused);
+
+    // 添加SD卡掉卡恢复状态（0正常，1掉卡，2已重新挂载）和暂存帧统计
+    SdRecoveryStats recoveryStats;
+    sd_recovery_get_stats(&recoveryStats);
+    p += sprintf(p, ",\"sd_card_state\":%d", recoveryStats.state);
+    p += sprintf(p, ",\"sd_card_losses\":%lu", (unsigned long)recoveryStats.cardLosses);
+    p += sprintf(p, ",\"sd_remounts\":%lu", (unsigned long)recoveryStats.remounts);
+    p += sprintf(p, ",\"sd_held_frames\":%lu", (unsigned long)recoveryStats.heldFrames);
+    p += sprintf(p, ",\"sd_dropped_frames\":%lu", (unsigned long)recoveryStats.droppedFrames);
+
     *p++ = '}';
     *p++ = 0;
     httpd_resp_set_type(req, "application/json");
@@ -891,76 +1093,1325 @@ static esp_err_t servo_handler(httpd_req_t *req)
     }
 }
 
-void startCameraServer()
+// =================== / ===================
+// Bookmark Handler / 事件书签处理器
+// =================== / ===================
+
+/**
+ * 就地解码URL编码的标签，并去掉会破坏JSON的字符 / Decode a URL-encoded label in place and drop characters that would break JSON
+ */
+static void decode_label(char *str)
 {
-    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
-    config.max_uri_handlers = 16;
+    char *out = str;
+    for (char *in = str; *in; in++) {
+        char c = *in;
+        if (c == '+') {
+            c = ' ';
+        } else if (c == '%' && isxdigit((unsigned char)in[1]) && isxdigit((unsigned char)in[2])) {
+            char hex[3] = {in[1], in[2], 0};
+            c = (char)strtol(hex, NULL, 16);
+            in += 2;
+        }
+        if (c == '"' || c == '\\' || (unsigned char)c < 0x20) {
+            continue;
+        }
+        *out++ = c;
+    }
+    *out = 0;
+}
 
-    httpd_uri_t index_uri = {
-        .uri = "/",
-        .method = HTTP_GET,
-        .handler = index_handler,
-        .user_ctx = NULL
-    };
+/**
+ * Bookmark handler / 事件书签处理器
+ * 
+ * API接口 / API Interface:
+ * - GET /bookmark?action=add&start=1770000000&end=1770000300&label=door   添加书签 / Add a bookmark
+ * - GET /bookmark?action=list                                             列出书签 / List bookmarks
+ * - GET /bookmark?action=delete&id=3                                      删除书签 / Delete a bookmark
+ * 
+ * 参数说明 / Parameter Description:
+ * - start/end: Unix时间戳（秒），覆盖的视频分段不会被清理 / Unix timestamps (seconds), covered video segments are never cleaned up
+ * - label: 可选标签，最多31字节 / Optional label, up to 31 bytes
+ * - id: 书签ID / Bookmark ID
+ */
+static esp_err_t bookmark_handler(httpd_req_t *req)
+{
+    // 验证认证 / Verify authentication
+    auth_result_t auth_result = auth_verify(req);
+    if(auth_result != AUTH_SUCCESS) {
+        ESP_LOGW(TAG, "Bookmark handler: authentication failed (%d)", auth_result);
+        return auth_send_401(req);
+    }
 
-    httpd_uri_t status_uri = {
-        .uri = "/status",
-        .method = HTTP_GET,
-        .handler = status_handler,
-        .user_ctx = NULL
-    };
+    char *buf = NULL;
+    char action_str[16];
+    char json_response[96];
 
-    httpd_uri_t cmd_uri = {
-        .uri = "/control",
-        .method = HTTP_GET,
-        .handler = cmd_handler,
-        .user_ctx = NULL
-    };
+    if (parse_get(req, &buf) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    if (httpd_query_key_value(buf, "action", action_str, sizeof(action_str)) != ESP_OK) {
+        free(buf);
+        httpd_resp_send_404(req);
+        return ESP_FAIL;
+    }
 
-    httpd_uri_t capture_uri = {
-        .uri = "/capture",
-        .method = HTTP_GET,
-        .handler = capture_handler,
-        .user_ctx = NULL
-    };
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
 
-    httpd_uri_t stream_uri = {
-        .uri = "/stream",
-        .method = HTTP_GET,
-        .handler = stream_handler,
-        .user_ctx = NULL
-    };
+    if (strcmp(action_str, "add") == 0) {
+        char start_str[16];
+        char end_str[16];
+        char label[BOOKMARK_LABEL_LEN * 3];
+        if (httpd_query_key_value(buf, "start", start_str, sizeof(start_str)) != ESP_OK ||
+            httpd_query_key_value(buf, "end", end_str, sizeof(end_str)) != ESP_OK) {
+            free(buf);
+            httpd_resp_send_404(req);
+            return ESP_FAIL;
+        }
+        if (httpd_query_key_value(buf, "label", label, sizeof(label)) != ESP_OK) {
+            label[0] = 0;
+        }
+        free(buf);
+        decode_label(label);
 
-    httpd_uri_t bmp_uri = {
-        .uri = "/bmp",
-        .method = HTTP_GET,
-        .handler = bmp_handler,
-        .user_ctx = NULL
-    };
+        int id = bookmark_add(strtoul(start_str, NULL, 10), strtoul(end_str, NULL, 10), label);
+        if (id < 0) {
+            const char *err = "{\"status\":\"error\",\"message\":\"Invalid range, list full or SD write failed\"}";
+            return httpd_resp_send(req, err, strlen(err));
+        }
+        ESP_LOGI(TAG, "Bookmark %d added: %s - %s", id, start_str, end_str);
+        snprintf(json_response, sizeof(json_response), "{\"status\":\"ok\",\"id\":%d}", id);
+        return httpd_resp_send(req, json_response, strlen(json_response));
+    }
+    else if (strcmp(action_str, "delete") == 0) {
+        char id_str[16];
+        if (httpd_query_key_value(buf, "id", id_str, sizeof(id_str)) != ESP_OK) {
+            free(buf);
+            httpd_resp_send_404(req);
+            return ESP_FAIL;
+        }
+        free(buf);
+        bool ok = bookmark_delete(strtoul(id_str, NULL, 10));
+        snprintf(json_response, sizeof(json_response), "{\"status\":\"%s\"}", ok ? "ok" : "error");
+        return httpd_resp_send(req, json_response, strlen(json_response));
+    }
+    else if (strcmp(action_str, "list") == 0) {
+        free(buf);
+        Bookmark *list = (Bookmark *)malloc(BOOKMARK_MAX_COUNT * sizeof(Bookmark));
+        if (!list) {
+            httpd_resp_send_500(req);
+            return ESP_FAIL;
+        }
+        int count = bookmark_get_list(list, BOOKMARK_MAX_COUNT);
+
+        // 逐条分块发送，避免大缓冲区 / Send entry by entry in chunks to avoid a large buffer
+        char entry[128];
+        httpd_resp_send_chunk(req, "{\"status\":\"ok\",\"bookmarks\":[", HTTPD_RESP_USE_STRLEN);
+        for (int i = 0; i < count; i++) {
+            snprintf(entry, sizeof(entry), "%s{\"id\":%lu,\"start\":%lu,\"end\":%lu,\"label\":\"%s\"}",
+                     i ? "," : "", (unsigned long)list[i].id, (unsigned long)list[i].start,
+                     (unsigned long)list[i].end, list[i].label);
+            httpd_resp_send_chunk(req, entry, HTTPD_RESP_USE_STRLEN);
+        }
+        free(list);
+        httpd_resp_send_chunk(req, "]}", HTTPD_RESP_USE_STRLEN);
+        return httpd_resp_send_chunk(req, NULL, 0);
+    }
 
-    httpd_uri_t xclk_uri = {
-        .uri = "/xclk",
-        .method = HTTP_GET,
-        .handler = xclk_handler,
-        .user_ctx = NULL
-    };
+    free(buf);
+    httpd_resp_send_404(req);
+    return ESP_FAIL;
+}
 
-    httpd_uri_t reg_uri = {
-        .uri = "/reg",
-        .method = HTTP_GET,
-        .handler = reg_handler,
-        .user_ctx = NULL
-    };
+// =================== / ===================
+// Clip Handler / 录像剪辑处理器
+// =================== / ===================
 
-    httpd_uri_t greg_uri = {
-        .uri = "/greg",
-        .method = HTTP_GET,
-        .handler = greg_handler,
-        .user_ctx = NULL
-    };
+/**
+ * 剪辑分块输出回调 / Chunked output callback for clips
+ */
+static bool clip_http_write(const uint8_t *data, size_t len, void *arg)
+{
+    return httpd_resp_send_chunk((httpd_req_t *)arg, (const char *)data, len) == ESP_OK;
+}
 
-    httpd_uri_t pll_uri = {
-        .uri = "/pll",
+/**
+ * Clip handler / 录像剪辑处理器
+ * 
+ * API接口 / API Interface:
+ * - GET /clip?start=1770000000&end=1770000300          下载剪辑AVI / Download the clip AVI
+ * - GET /clip?start=1770000000&end=1770000300&save=1   保存剪辑到SD卡 / Save the clip to the SD card
+ * 
+ * 参数说明 / Parameter Description:
+ * - start/end: Unix时间戳（秒），最长CLIP_MAX_DURATION_S / Unix timestamps (seconds), at most CLIP_MAX_DURATION_S apart
+ * - save: 1=保存到CLIP_DIR并返回JSON / 1 = save into CLIP_DIR and return JSON
+ */
+static esp_err_t clip_handler(httpd_req_t *req)
+{
+    // 验证认证 / Verify authentication
+    auth_result_t auth_result = auth_verify(req);
+    if(auth_result != AUTH_SUCCESS) {
+        ESP_LOGW(TAG, "Clip handler: authentication failed (%d)", auth_result);
+        return auth_send_401(req);
+    }
+
+    char *buf = NULL;
+    char start_str[16];
+    char end_str[16];
+    char save_str[4];
+
+    if (parse_get(req, &buf) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    if (httpd_query_key_value(buf, "start", start_str, sizeof(start_str)) != ESP_OK ||
+        httpd_query_key_value(buf, "end", end_str, sizeof(end_str)) != ESP_OK) {
+        free(buf);
+        httpd_resp_send_404(req);
+        return ESP_FAIL;
+    }
+    bool save = httpd_query_key_value(buf, "save", save_str, sizeof(save_str)) == ESP_OK && atoi(save_str) == 1;
+    free(buf);
+
+    int64_t fr_start = esp_timer_get_time();
+    ClipPlan *plan = clip_prepare(strtoul(start_str, NULL, 10), strtoul(end_str, NULL, 10));
+    if (!plan) {
+        httpd_resp_set_type(req, "application/json");
+        httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+        const char *err = "{\"status\":\"error\",\"message\":\"No recorded frames in range\"}";
+        return httpd_resp_send(req, err, strlen(err));
+    }
+    uint32_t clip_size = clip_file_size(plan);
+
+    esp_err_t res = ESP_OK;
+    if (save) {
+        char path[64];
+        char json_response[160];
+        bool ok = clip_save(plan, path, sizeof(path));
+        if (ok) {
+            snprintf(json_response, sizeof(json_response), "{\"status\":\"ok\",\"path\":\"%s\",\"frames\":%lu,\"size\":%lu}",
+                     path, (unsigned long)plan->frameCount, (unsigned long)clip_size);
+        } else {
+            snprintf(json_response, sizeof(json_response), "{\"status\":\"error\",\"message\":\"SD write failed\"}");
+        }
+        httpd_resp_set_type(req, "application/json");
+        httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+        res = httpd_resp_send(req, json_response, strlen(json_response));
+    } else {
+        char disposition[64];
+        snprintf(disposition, sizeof(disposition), "attachment; filename=clip_%s.avi", start_str);
+        httpd_resp_set_type(req, "video/x-msvideo");
+        httpd_resp_set_hdr(req, "Content-Disposition", disposition);
+        httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+        if (clip_write(plan, clip_http_write, req)) {
+            res = httpd_resp_send_chunk(req, NULL, 0);
+        } else {
+            res = ESP_FAIL;
+        }
+    }
+
+    int64_t fr_end = esp_timer_get_time();
+    ESP_LOGI(TAG, "Clip %s-%s: %u frames, %u segments, %uB in %ums",
+             start_str, end_str, (unsigned)plan->frameCount, (unsigned)plan->segmentCount,
+             (unsigned)clip_size, (unsigned)((fr_end - fr_start) / 1000));
+    clip_free(plan);
+    return res;
+}
+
+static int bench_result_json(char *p, size_t left, const SdBenchResult *r)
+{
+    return snprintf(p, left,
+                    "{\"block\":%lu,\"bytes\":%lu,\"write_kbps\":%lu,\"read_kbps\":%lu,"
+                    "\"write_p50_us\":%lu,\"write_p99_us\":%lu,\"write_max_us\":%lu,"
+                    "\"read_p50_us\":%lu,\"read_p99_us\":%lu,\"read_max_us\":%lu,\"verified\":%s}",
+                    (unsigned long)r->blockSize, (unsigned long)r->bytes, (unsigned long)r->writeKBps, (unsigned long)r->readKBps,
+                    (unsigned long)r->writeP50Us, (unsigned long)r->writeP99Us, (unsigned long)r->writeMaxUs,
+                    (unsigned long)r->readP50Us, (unsigned long)r->readP99Us, (unsigned long)r->readMaxUs,
+                    r->verified ? "true" : "false");
+}
+
+// 正在进行的接口测速 / Endpoint benchmark in progress
+typedef struct {
+    httpd_req_t *req;                   // 异步请求 / Asynchronous request
+    uint32_t block;                     // 块大小，0为全部 / Block size, 0 for all of them
+    uint32_t size;                      // 每项测试的数据量 / Data per test
+} BenchSdJob;
+
+static bool bench_sd_running = false;
+static portMUX_TYPE bench_sd_mux = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief 测速任务：测完后回复并交还连接 / Benchmark task: replies when done and hands the connection back
+ * @param pvParameters 测速请求 / Benchmark job
+ */
+static void bench_sd_task(void *pvParameters)
+{
+    BenchSdJob *job = (BenchSdJob *)pvParameters;
+    httpd_req_t *req = job->req;
+
+    const size_t json_size = 4096;
+    char *json_response = (char *)malloc(json_size);
+    esp_err_t res = ESP_FAIL;
+    if (!json_response) {
+        httpd_resp_send_500(req);
+    } else {
+        char *p = json_response;
+        char *end = json_response + json_size - 4;
+
+        // 当前频率下实测 / Live measurement at the current frequency
+        const uint32_t block_sizes[SD_BENCH_NUM_BLOCK_SIZES] = SD_BENCH_BLOCK_SIZES;
+        int count = job->block ? 1 : SD_BENCH_NUM_BLOCK_SIZES;
+        int64_t fr_start = esp_timer_get_time();
+        p += snprintf(p, end - p, "{\"freq_khz\":%d,\"video_write_block\":%lu,\"results\":[",
+                      sdmmcGetFreqKhz(), (unsigned long)getVideoWriteBlockSize());
+        for (int i = 0; i < count && p < end; i++) {
+            SdBenchResult result;
+            sd_bench_run(job->block ? job->block : block_sizes[i], job->size, &result);
+            p += bench_result_json(p, end - p, &result);
+            if (i < count - 1 && p < end) {
+                *p++ = ',';
+            }
+        }
+
+        // 启动校准结果 / Boot calibration results
+        SdBenchCalibration cal;
+        sd_bench_get_calibration(&cal);
+        if (p < end) {
+            p += snprintf(p, end - p, "],\"calibration\":{\"done\":%s,\"freq_khz\":%d,\"block\":%lu,\"write_kbps\":%lu,"
+                          "\"required_kbps\":%lu,\"sufficient\":%s,\"freqs\":[",
+                          cal.done ? "true" : "false", cal.freqKhz, (unsigned long)cal.blockSize, (unsigned long)cal.writeKBps,
+                          (unsigned long)cal.requiredKBps, cal.sufficient ? "true" : "false");
+        }
+        for (int f = 0; cal.done && f < SD_BENCH_NUM_FREQS && p < end; f++) {
+            p += snprintf(p, end - p, "%s{\"freq_khz\":%d,\"mounted\":%s,\"results\":[",
+                          f ? "," : "", cal.freqs[f], cal.mounted[f] ? "true" : "false");
+            for (int b = 0; cal.mounted[f] && b < SD_BENCH_NUM_BLOCK_SIZES && p < end; b++) {
+                p += bench_result_json(p, end - p, &cal.results[f][b]);
+                if (b < SD_BENCH_NUM_BLOCK_SIZES - 1 && p < end) {
+                    *p++ = ',';
+                }
+            }
+            if (p < end) {
+                p += snprintf(p, end - p, "]}");
+            }
+        }
+        if (p < end) {
+            p += snprintf(p, end - p, "]}}");
+        }
+        if (p > end) {
+            p = end;
+        }
+        *p = 0;
+
+        ESP_LOGI(TAG, "SD bench: %d test(s) of %uB in %ums", count, (unsigned)job->size,
+                 (unsigned)((esp_timer_get_time() - fr_start) / 1000));
+        httpd_resp_set_type(req, "application/json");
+        httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+        res = httpd_resp_send(req, json_response, strlen(json_response));
+        free(json_response);
+    }
+
+    httpd_handle_t server = req->handle;
+    int fd = httpd_req_to_sockfd(req);
+    httpd_req_async_handler_complete(req);
+    if (res != ESP_OK) {
+        httpd_sess_trigger_close(server, fd);
+    }
+    free(job);
+    portENTER_CRITICAL(&bench_sd_mux);
+    bench_sd_running = false;
+    portEXIT_CRITICAL(&bench_sd_mux);
+    vTaskDelete(NULL);
+}
+
+/**
+ * SD card benchmark handler / SD卡测速处理器
+ * 
+ * API接口 / API Interface:
+ * - GET /bench/sd                    当前频率下测所有块大小 / Test every block size at the current frequency
+ * - GET /bench/sd?block=4096&size=2048  只测一种块大小 / Test a single block size
+ * 
+ * 参数说明 / Parameter Description:
+ * - block: 块大小（字节），SD_BENCH_MIN_BLOCK-SD_BENCH_MAX_BLOCK，超出范围返回400；默认SD_BENCH_BLOCK_SIZES全部
+ *          Block size (bytes), SD_BENCH_MIN_BLOCK-SD_BENCH_MAX_BLOCK, 400 outside that range; all of SD_BENCH_BLOCK_SIZES by default
+ * - size: 每项测试的数据量（KB），默认1024，最大8192 / Data per test (KB), 1024 by default, at most 8192
+ * 
+ * 其他频率的结果来自启动校准（换频率需要重新挂载，录像期间不能进行）
+ * Results at other frequencies come from the boot calibration (changing frequency needs a remount, which cannot happen while recording)
+ *
+ * 测速在单独的任务中进行，同时只能有一个，进行中时返回503；录像期间按SD_IO_BULK排队并限速，速度结果不高于SD_IO_BULK_RATE_KBPS
+ * The benchmark runs in its own task, one at a time, 503 while one is running; during recording it queues as SD_IO_BULK under the rate limit, so speeds top out at SD_IO_BULK_RATE_KBPS
+ */
+static esp_err_t bench_sd_handler(httpd_req_t *req)
+{
+    // 验证认证 / Verify authentication
+    auth_result_t auth_result = auth_verify(req);
+    if(auth_result != AUTH_SUCCESS) {
+        ESP_LOGW(TAG, "Bench handler: authentication failed (%d)", auth_result);
+        return auth_send_401(req);
+    }
+
+    uint32_t block = 0;
+    bool block_given = false;
+    uint32_t size = SD_BENCH_DEFAULT_BYTES;
+    size_t query_len = httpd_req_get_url_query_len(req) + 1;
+    if (query_len > 1) {
+        char *buf = (char *)malloc(query_len);
+        char value[16];
+        if (buf && httpd_req_get_url_query_str(req, buf, query_len) == ESP_OK) {
+            if (httpd_query_key_value(buf, "block", value, sizeof(value)) == ESP_OK) {
+                block = strtoul(value, NULL, 10);
+                block_given = true;
+            }
+            if (httpd_query_key_value(buf, "size", value, sizeof(value)) == ESP_OK) {
+                size = strtoul(value, NULL, 10) * 1024;
+            }
+        }
+        free(buf);
+    }
+    // 块太小时每字节一次写入，会占用SD卡很久 / Tiny blocks mean a write per byte or so and would hold the card for ages
+    if (block_given && (block < SD_BENCH_MIN_BLOCK || block > SD_BENCH_MAX_BLOCK)) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "block must be 512-65536");
+    }
+    if (size > SD_BENCH_MAX_BYTES) {
+        size = SD_BENCH_MAX_BYTES;
+    }
+
+    // 同时只测一个 / One benchmark at a time
+    bool busy;
+    portENTER_CRITICAL(&bench_sd_mux);
+    busy = bench_sd_running;
+    bench_sd_running = true;
+    portEXIT_CRITICAL(&bench_sd_mux);
+    if (busy) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_hdr(req, "Retry-After", "10");
+        return httpd_resp_send(req, "Benchmark already running", HTTPD_RESP_USE_STRLEN);
+    }
+
+    BenchSdJob *job = (BenchSdJob *)malloc(sizeof(BenchSdJob));
+    if (job) {
+        job->block = block;
+        job->size = size;
+    }
+    if (!job || httpd_req_async_handler_begin(req, &job->req) != ESP_OK) {
+        free(job);
+        portENTER_CRITICAL(&bench_sd_mux);
+        bench_sd_running = false;
+        portEXIT_CRITICAL(&bench_sd_mux);
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+    if (xTaskCreatePinnedToCore(bench_sd_task, "bench_sd", SD_BENCH_TASK_STACK, job,
+                                SD_BENCH_TASK_PRIORITY, NULL, SD_BENCH_TASK_CORE) != pdPASS) {
+        httpd_req_t *async_req = job->req;
+        free(job);
+        portENTER_CRITICAL(&bench_sd_mux);
+        bench_sd_running = false;
+        portEXIT_CRITICAL(&bench_sd_mux);
+        httpd_resp_send_500(async_req);
+        httpd_req_async_handler_complete(async_req);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+// =================== / ===================
+// Retention Handler / 保留策略处理器
+// =================== / ===================
+
+/**
+ * Retention policy handler / 保留策略处理器
+ * 
+ * API接口 / API Interface:
+ * - GET /retention                                          查看策略和各分类用量 / Show the policy and per-category usage
+ * - GET /retention?video_quota_mb=20480&photo_max_days=30   修改策略并保存到SD卡 / Change the policy and save it to the SD card
+ * 
+ * 参数说明 / Parameter Description:
+ * - video_quota_mb/photo_quota_mb/clip_quota_mb: 各分类配额（MB），0=不限 / Per-category quota (MB), 0 = no limit
+ * - video_max_days/photo_max_days/clip_max_days: 各分类最长保留天数，0=不限，最大36500 / Per-category maximum age (days), 0 = no limit, at most 36500
+ * - min_keep_days: 最少保留天数（含当天），0=不限，最大36500 / Minimum days always kept (including today), 0 = none, at most 36500
+ * - reserve_mb: 剩余空间低于此值开始清理（MB）/ Cleanup starts below this much free space (MB)
+ * - target_mb: 每次清理在保留空间之上再释放的空间（MB）/ Space freed above the reserve by each cleanup (MB)
+ * - priority: 0=只删视频，1=先视频后照片，2=只删照片 / 0 = videos only, 1 = videos then photos, 2 = photos only
+ */
+static esp_err_t retention_handler(httpd_req_t *req)
+{
+    // 验证认证 / Verify authentication
+    auth_result_t auth_result = auth_verify(req);
+    if(auth_result != AUTH_SUCCESS) {
+        ESP_LOGW(TAG, "Retention handler: authentication failed (%d)", auth_result);
+        return auth_send_401(req);
+    }
+
+    static const char *const categories[RETENTION_NUM_CATEGORIES] = {"video", "photo", "clip"};
+    RetentionPolicy policy;
+    retention_get_policy(&policy);
+
+    // 有参数时修改策略 / Change the policy when parameters are given
+    bool changed = false;
+    bool saved = true;
+    size_t query_len = httpd_req_get_url_query_len(req) + 1;
+    if (query_len > 1) {
+        char *buf = (char *)malloc(query_len);
+        char key[24];
+        char value[16];
+        if (buf && httpd_req_get_url_query_str(req, buf, query_len) == ESP_OK) {
+            for (int c = 0; c < RETENTION_NUM_CATEGORIES; c++) {
+                snprintf(key, sizeof(key), "%s_quota_mb", categories[c]);
+                if (httpd_query_key_value(buf, key, value, sizeof(value)) == ESP_OK) {
+                    policy.quotaMB[c] = strtoul(value, NULL, 10);
+                    changed = true;
+                }
+                snprintf(key, sizeof(key), "%s_max_days", categories[c]);
+                if (httpd_query_key_value(buf, key, value, sizeof(value)) == ESP_OK) {
+                    // 超出范围的值不截断，留给校验拒绝 / Out-of-range values are not truncated, validation rejects them
+                    unsigned long days = strtoul(value, NULL, 10);
+                    policy.maxAgeDays[c] = (uint16_t)(days > RETENTION_MAX_DAYS ? RETENTION_MAX_DAYS + 1 : days);
+                    changed = true;
+                }
+            }
+            if (httpd_query_key_value(buf, "min_keep_days", value, sizeof(value)) == ESP_OK) {
+                unsigned long days = strtoul(value, NULL, 10);
+                policy.minKeepDays = (uint16_t)(days > RETENTION_MAX_DAYS ? RETENTION_MAX_DAYS + 1 : days);
+                changed = true;
+            }
+            if (httpd_query_key_value(buf, "reserve_mb", value, sizeof(value)) == ESP_OK) {
+                policy.reserveMB = strtoul(value, NULL, 10);
+                changed = true;
+            }
+            if (httpd_query_key_value(buf, "target_mb", value, sizeof(value)) == ESP_OK) {
+                policy.cleanTargetMB = strtoul(value, NULL, 10);
+                changed = true;
+            }
+            if (httpd_query_key_value(buf, "priority", value, sizeof(value)) == ESP_OK) {
+                policy.priority = (uint8_t)strtoul(value, NULL, 10);
+                changed = true;
+            }
+        }
+        free(buf);
+    }
+    if (changed) {
+        saved = retention_set_policy(&policy);
+        ESP_LOGI(TAG, "Retention policy %s", saved ? "saved" : "rejected");
+        retention_get_policy(&policy);
+    }
+
+    char json_response[640];
+    char *p = json_response;
+    char *end = json_response + sizeof(json_response);
+    p += snprintf(p, end - p, "{\"status\":\"%s\",\"min_keep_days\":%u,\"reserve_mb\":%lu,\"target_mb\":%lu,\"priority\":%u,"
+                  "\"free_mb\":%llu,\"categories\":{",
+                  saved ? "ok" : "error", policy.minKeepDays, (unsigned long)policy.reserveMB,
+                  (unsigned long)policy.cleanTargetMB, policy.priority, sd_space_free_bytes() / (1024ULL * 1024ULL));
+    for (int c = 0; c < RETENTION_NUM_CATEGORIES && p < end; c++) {
+        p += snprintf(p, end - p, "%s\"%s\":{\"quota_mb\":%lu,\"max_days\":%u,\"used_mb\":%llu}",
+                      c ? "," : "", categories[c], (unsigned long)policy.quotaMB[c], policy.maxAgeDays[c],
+                      catalog_type_bytes(c + 1) / (1024ULL * 1024ULL));
+    }
+    if (p < end) {
+        snprintf(p, end - p, "}}");
+    }
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    return httpd_resp_send(req, json_response, strlen(json_response));
+}
+
+// =================== / ===================
+// Storage Statistics Handler / 写入统计处理器
+// =================== / ===================
+
+/**
+ * Storage statistics handler / 写入统计处理器
+ * 
+ * API接口 / API Interface:
+ * - GET /storage              写入速率、开始清理和写满的预测、按天写入量 / Write rate, cleanup and full forecasts, per-day writes
+ * - GET /storage?days=30      另外估算保留30天所需的SD卡空间 / Also estimate the card space needed to keep 30 days
+ * 
+ * 参数说明 / Parameter Description:
+ * - days: 目标保留天数，按最近完整几天的日均写入量加保留空间估算 / Target retention in days, estimated from the average of the recent whole days plus the reserve
+ * 
+ * 返回说明 / Response Description:
+ * - seconds_to_cleanup/seconds_to_full: 按当前写入速率预测，-1表示当前没有写入 / Forecast at the current write rate, -1 while nothing is being written
+ * - days: 最新的在前，单位KB / Newest first, in KB
+ */
+static esp_err_t storage_stats_handler(httpd_req_t *req)
+{
+    // 验证认证 / Verify authentication
+    auth_result_t auth_result = auth_verify(req);
+    if(auth_result != AUTH_SUCCESS) {
+        ESP_LOGW(TAG, "Storage handler: authentication failed (%d)", auth_result);
+        return auth_send_401(req);
+    }
+
+    uint32_t target_days = 0;
+    size_t query_len = httpd_req_get_url_query_len(req) + 1;
+    if (query_len > 1) {
+        char *buf = (char *)malloc(query_len);
+        char value[16];
+        if (buf && httpd_req_get_url_query_str(req, buf, query_len) == ESP_OK &&
+            httpd_query_key_value(buf, "days", value, sizeof(value)) == ESP_OK) {
+            target_days = strtoul(value, NULL, 10);
+        }
+        free(buf);
+    }
+
+    static const char *const categories[RETENTION_NUM_CATEGORIES] = {"video", "photo", "clip"};
+    StorageForecast forecast;
+    storage_stats_forecast(&forecast);
+    StorageDayStats days[STORAGE_STATS_DAYS];
+    int day_count = storage_stats_get_days(days, STORAGE_STATS_DAYS);
+
+    // 日均写入量：有完整的天时不计当天 / Daily average: today is left out once there are whole days
+    int first_whole = day_count > 1 ? 1 : 0;
+    uint64_t daily_bytes[RETENTION_NUM_CATEGORIES] = {0};
+    uint64_t daily_total = 0;
+    for (int c = 0; c < RETENTION_NUM_CATEGORIES; c++) {
+        for (int d = first_whole; d < day_count; d++) {
+            daily_bytes[c] += days[d].bytes[c];
+        }
+        daily_bytes[c] = day_count > first_whole ? daily_bytes[c] / (day_count - first_whole) : 0;
+        daily_total += daily_bytes[c];
+    }
+
+    const size_t json_size = 2048;
+    char *json_response = (char *)malloc(json_size);
+    if (!json_response) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+    char *p = json_response;
+    char *end = json_response + json_size - 4;
+    p += snprintf(p, end - p, "{\"rate_bps\":%lu,\"free_mb\":%llu,\"low_watermark_mb\":%llu,"
+                  "\"seconds_to_cleanup\":%ld,\"seconds_to_full\":%ld,\"avg_daily_mb\":%llu,\"categories\":{",
+                  (unsigned long)forecast.totalRateBps, forecast.freeBytes / (1024ULL * 1024ULL),
+                  forecast.lowWatermarkBytes / (1024ULL * 1024ULL), (long)forecast.secondsToCleanup,
+                  (long)forecast.secondsToFull, daily_total / (1024ULL * 1024ULL));
+    for (int c = 0; c < RETENTION_NUM_CATEGORIES && p < end; c++) {
+        p += snprintf(p, end - p, "%s\"%s\":{\"rate_bps\":%lu,\"boot_kb\":%llu,\"avg_daily_mb\":%llu}",
+                      c ? "," : "", categories[c], (unsigned long)forecast.rateBps[c],
+                      forecast.bootBytes[c] / 1024ULL, daily_bytes[c] / (1024ULL * 1024ULL));
+    }
+    if (p < end) {
+        p += snprintf(p, end - p, "},\"days\":[");
+    }
+    for (int d = 0; d < day_count && p < end; d++) {
+        p += snprintf(p, end - p, "%s{\"date\":%lu,\"video_kb\":%llu,\"photo_kb\":%llu,\"clip_kb\":%llu}",
+                      d ? "," : "", (unsigned long)days[d].date, days[d].bytes[RETENTION_VIDEO] / 1024ULL,
+                      days[d].bytes[RETENTION_PHOTO] / 1024ULL, days[d].bytes[RETENTION_DERIVED] / 1024ULL);
+    }
+    if (p < end) {
+        p += snprintf(p, end - p, "]");
+    }
+    if (target_days > 0 && p < end) {
+        // 所需空间 = 日均写入量 × 天数 + 保留空间 / Space needed = daily average × days + reserve
+        p += snprintf(p, end - p, ",\"target_days\":%lu,\"needed_mb\":%llu", (unsigned long)target_days,
+                      (daily_total * target_days + forecast.lowWatermarkBytes) / (1024ULL * 1024ULL));
+    }
+    if (p < end) {
+        p += snprintf(p, end - p, "}");
+    }
+    if (p > end) {
+        p = end;
+    }
+    *p = 0;
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    esp_err_t res = httpd_resp_send(req, json_response, strlen(json_response));
+    free(json_response);
+    return res;
+}
+
+// =================== / ===================
+// Photo Pack Handler / 照片日包处理器
+// =================== / ===================
+
+/**
+ * Photo pack handler / 照片日包处理器
+ * 
+ * API接口 / API Interface:
+ * - GET /photo?id=2026020200012          按编号返回照片 / Return a photo by ID
+ * - GET /photo?date=20260202&first=0     列出某天的照片 / List a day's photos
+ * 
+ * 参数说明 / Parameter Description:
+ * - id: 照片编号（YYYYMMDD × 100000 + 当天序号），见/capture?id=N的path / Photo ID (YYYYMMDD × 100000 + sequence), see path of /capture?id=N
+ * - date: 日期YYYYMMDD / Date YYYYMMDD
+ * - first: 从第几张开始列出（0开始），默认0 / First photo to list (from 0), 0 by default
+ */
+static esp_err_t photo_pack_handler(httpd_req_t *req)
+{
+    // 验证认证 / Verify authentication
+    auth_result_t auth_result = auth_verify(req);
+    if(auth_result != AUTH_SUCCESS) {
+        ESP_LOGW(TAG, "Photo handler: authentication failed (%d)", auth_result);
+        return auth_send_401(req);
+    }
+
+    char *buf = NULL;
+    char id_str[24];
+    char date_str[16];
+    char first_str[16];
+    if (parse_get(req, &buf) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    bool has_id = httpd_query_key_value(buf, "id", id_str, sizeof(id_str)) == ESP_OK;
+    bool has_date = httpd_query_key_value(buf, "date", date_str, sizeof(date_str)) == ESP_OK;
+    if (httpd_query_key_value(buf, "first", first_str, sizeof(first_str)) != ESP_OK) {
+        first_str[0] = 0;
+    }
+    free(buf);
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+
+    if (has_id) {
+        uint64_t id = strtoull(id_str, NULL, 10);
+        char path[64];
+        PhotoPackIndexEntry entry;
+        if (!photo_pack_locate(id, path, sizeof(path), &entry)) {
+            httpd_resp_send_404(req);
+            return ESP_FAIL;
+        }
+        File file = SD_MMC.open(path, FILE_READ);
+        const size_t chunk_size = 4096;
+        char *chunk = (char *)malloc(chunk_size);
+        if (!file || !chunk || !file.seek(entry.offset)) {
+            if (file) {
+                file.close();
+            }
+            free(chunk);
+            httpd_resp_send_500(req);
+            return ESP_FAIL;
+        }
+
+        // 从包中分块发送，不把整张照片读进内存 / Send from the pack in chunks without reading the whole photo into memory
+        char disposition[48];
+        char time_str[16];
+        snprintf(disposition, sizeof(disposition), "inline; filename=%s.jpg", id_str);
+        snprintf(time_str, sizeof(time_str), "%lu", (unsigned long)entry.time);
+        httpd_resp_set_type(req, "image/jpeg");
+        httpd_resp_set_hdr(req, "Content-Disposition", disposition);
+        httpd_resp_set_hdr(req, "X-Photo-Time", time_str);
+        httpd_resp_set_hdr(req, "Access-Control-Expose-Headers", "X-Photo-Time");
+        esp_err_t res = ESP_OK;
+        uint32_t left = entry.size;
+        while (res == ESP_OK && left > 0) {
+            size_t n = left < chunk_size ? left : chunk_size;
+            if (sd_io_read(file, (uint8_t *)chunk, n, SD_IO_BULK) != n) {
+                res = ESP_FAIL;
+                break;
+            }
+            res = httpd_resp_send_chunk(req, chunk, n);
+            left -= n;
+        }
+        file.close();
+        free(chunk);
+        if (res == ESP_OK) {
+            res = httpd_resp_send_chunk(req, NULL, 0);
+        }
+        return res;
+    }
+
+    if (has_date) {
+        uint32_t date = strtoul(date_str, NULL, 10);
+        uint32_t first = strtoul(first_str, NULL, 10);
+        const int page = 32;
+        PhotoPackIndexEntry *entries = (PhotoPackIndexEntry *)malloc(page * sizeof(PhotoPackIndexEntry));
+        if (!entries) {
+            httpd_resp_send_500(req);
+            return ESP_FAIL;
+        }
+        int num = photo_pack_read_index(date, first, entries, page);
+        if (num < 0) {
+            free(entries);
+            httpd_resp_send_404(req);
+            return ESP_FAIL;
+        }
+
+        // 逐页读索引、逐条分块发送 / Read the index page by page and send entry by entry in chunks
+        char entry_json[96];
+        httpd_resp_set_type(req, "application/json");
+        snprintf(entry_json, sizeof(entry_json), "{\"date\":%lu,\"photos\":[", (unsigned long)date);
+        httpd_resp_send_chunk(req, entry_json, HTTPD_RESP_USE_STRLEN);
+        uint32_t listed = 0;
+        while (num > 0) {
+            for (int i = 0; i < num; i++) {
+                uint64_t id = (uint64_t)date * PHOTO_PACK_ID_DATE_SCALE + first + listed + 1;
+                snprintf(entry_json, sizeof(entry_json), "%s{\"id\":%llu,\"time\":%lu,\"size\":%lu}",
+                         listed ? "," : "", (unsigned long long)id, (unsigned long)entries[i].time, (unsigned long)entries[i].size);
+                httpd_resp_send_chunk(req, entry_json, HTTPD_RESP_USE_STRLEN);
+                listed++;
+            }
+            num = num == page ? photo_pack_read_index(date, first + listed, entries, page) : 0;
+        }
+        free(entries);
+        snprintf(entry_json, sizeof(entry_json), "],\"count\":%lu}", (unsigned long)listed);
+        httpd_resp_send_chunk(req, entry_json, HTTPD_RESP_USE_STRLEN);
+        return httpd_resp_send_chunk(req, NULL, 0);
+    }
+
+    httpd_resp_send_404(req);
+    return ESP_FAIL;
+}
+
+// =================== / ===================
+// Stream Clients Handler / 视频流客户端处理器
+// =================== / ===================
+
+/**
+ * @brief 输出客户端统计数组 / Append a JSON array of client statistics
+ * @return char* 写入后的位置 / Position after the output
+ */
+static char *append_stream_clients(char *p, char *end, const StreamClientStats *clients, int count)
+{
+    uint32_t now = millis();
+    if (p < end) {
+        p += snprintf(p, end - p, "[");
+    }
+    for (int i = 0; i < count && p < end; i++) {
+        p += snprintf(p, end - p, "%s{\"id\":%lu,\"seconds\":%lu,\"frames\":%lu,\"skipped\":%lu,\"dropped\":%lu,"
+                      "\"capped\":%lu,\"fps\":%.1f,\"sent_kb\":%llu,\"send_us\":%lu,\"writes_per_frame\":%.1f,"
+                      "\"kbps\":%lu,\"latency_ms\":%lu,\"max_fps\":%lu,\"max_kbps\":%lu}",
+                      i ? "," : "", (unsigned long)clients[i].id, (unsigned long)((now - clients[i].startMs) / 1000),
+                      (unsigned long)clients[i].frames, (unsigned long)clients[i].skipped,
+                      (unsigned long)clients[i].dropped, (unsigned long)clients[i].capped, clients[i].fps,
+                      clients[i].bytes / 1024ULL,
+                      (unsigned long)(clients[i].frames ? clients[i].sendUs / clients[i].frames : 0),
+                      clients[i].frames ? (float)clients[i].writes / clients[i].frames : 0.0f,
+                      (unsigned long)(now > clients[i].startMs ? clients[i].bytes * 8 / (now - clients[i].startMs) : 0),
+                      (unsigned long)(clients[i].frames ? clients[i].latencyUs / clients[i].frames / 1000 : 0),
+                      (unsigned long)clients[i].limits.maxFps,
+                      (unsigned long)clients[i].limits.maxKbps);
+    }
+    if (p < end) {
+        p += snprintf(p, end - p, "]");
+    }
+    return p;
+}
+
+/**
+ * Stream clients handler / 视频流客户端处理器
+ * 
+ * API接口 / API Interface:
+ * - GET /streams              正在观看的客户端及其帧率、跳帧数和发送量 / Active viewers with their frame rate, skipped frames and bytes sent
+ * 
+ * 返回说明 / Response Description:
+ * - dropped: 上一帧还没发完时到达、被跳过的帧数 / Frames skipped because they arrived while the previous one was still being sent
+ * - capped: 因fps/maxkbps限速跳过的帧数 / Frames skipped to honour the fps/maxkbps limits
+ * - send_us/writes_per_frame: 每帧平均发送耗时（微秒）和socket写入次数 / Average send time (µs) and socket writes per frame
+ * - kbps/latency_ms: 平均吞吐量和取帧到发送完成的平均延迟，用于对比/net的调优设置 / Average throughput and capture-to-sent latency, for comparing the /net tuning settings
+ * - ws_clients: /ws/stream的客户端，capped为等待确认跳过的帧数 / /ws/stream clients, capped counts frames skipped while waiting for acknowledgements
+ * - capture_frames: 取帧任务发布的帧数，客户端增减时其增长速度不变 / Frames published by the capture task, its growth does not change as viewers come and go
+ */
+static esp_err_t streams_handler(httpd_req_t *req)
+{
+    // 验证认证 / Verify authentication
+    auth_result_t auth_result = auth_verify(req);
+    if(auth_result != AUTH_SUCCESS) {
+        ESP_LOGW(TAG, "Streams handler: authentication failed (%d)", auth_result);
+        return auth_send_401(req);
+    }
+
+    FrameBrokerStats broker;
+    frame_broker_get_stats(&broker);
+
+    const size_t json_size = 3072;
+    char *json_response = (char *)malloc(json_size);
+    if (!json_response) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+    char *p = json_response;
+    char *end = json_response + json_size - 4;
+    p += snprintf(p, end - p, "{\"capture_frames\":%lu,\"max_clients\":%d,\"clients\":",
+                  (unsigned long)broker.published, STREAM_MAX_CLIENTS);
+    StreamClientStats clients[STREAM_MAX_CLIENTS];
+    int count = stream_clients_get_stats(clients, STREAM_MAX_CLIENTS);
+    p = append_stream_clients(p, end, clients, count);
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+    if (p < end) {
+        p += snprintf(p, end - p, ",\"ws_clients\":");
+    }
+    count = ws_stream_get_stats(clients, WS_STREAM_MAX_CLIENTS);
+    p = append_stream_clients(p, end, clients, count);
+#endif
+    if (p < end) {
+        p += snprintf(p, end - p, "}");
+    }
+    if (p > end) {
+        p = end;
+    }
+    *p = 0;
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    esp_err_t res = httpd_resp_send(req, json_response, strlen(json_response));
+    free(json_response);
+    return res;
+}
+
+// =================== / ===================
+// Network Tuning Handler / 网络调优处理器
+// =================== / ===================
+
+/**
+ * Network tuning handler / 网络调优处理器
+ * 
+ * API接口 / API Interface:
+ * - GET /net                              查看设置和调优统计 / Show the settings and tuning statistics
+ * - GET /net?nodelay=0                    修改设置并保存到SD卡 / Change settings and save them to the SD card
+ * 
+ * 参数说明 / Parameter Description:
+ * - nodelay: 1关闭Nagle算法 / 1 turns Nagle's algorithm off
+ * - keepalive/keep_idle/keep_interval/keep_count: 视频流连接保活探测 / Keepalive probes on stream connections
+ * - send_timeout_ms: 视频流发送超时 / Stream send timeout
+ * - sndbuf_kb: 视频流发送缓冲，0为系统默认 / Stream send buffer, 0 for the system default
+ * - lru_purge: 控制连接满时回收最久未用的连接（重启后生效）/ Purge the least recently used control connection when they run out (after a restart)
+ * 
+ * 对比方法 / Comparison:
+ * - 修改设置后重新打开视频流，对比/streams的kbps和latency_ms / Reopen the stream after a change and compare kbps and latency_ms on /streams
+ */
+static esp_err_t net_tuning_handler(httpd_req_t *req)
+{
+    // 验证认证 / Verify authentication
+    auth_result_t auth_result = auth_verify(req);
+    if(auth_result != AUTH_SUCCESS) {
+        ESP_LOGW(TAG, "Net handler: authentication failed (%d)", auth_result);
+        return auth_send_401(req);
+    }
+
+    NetTuning tuning;
+    net_tuning_get(&tuning);
+
+    // 有参数时修改设置 / Change the settings when parameters are given
+    bool changed = false;
+    bool saved = true;
+    size_t query_len = httpd_req_get_url_query_len(req) + 1;
+    if (query_len > 1) {
+        char *buf = (char *)malloc(query_len);
+        char value[16];
+        if (buf && httpd_req_get_url_query_str(req, buf, query_len) == ESP_OK) {
+            if (httpd_query_key_value(buf, "nodelay", value, sizeof(value)) == ESP_OK) {
+                tuning.noDelay = (uint8_t)strtoul(value, NULL, 10);
+                changed = true;
+            }
+            if (httpd_query_key_value(buf, "keepalive", value, sizeof(value)) == ESP_OK) {
+                tuning.keepAlive = (uint8_t)strtoul(value, NULL, 10);
+                changed = true;
+            }
+            if (httpd_query_key_value(buf, "keep_idle", value, sizeof(value)) == ESP_OK) {
+                tuning.keepIdleS = (uint16_t)strtoul(value, NULL, 10);
+                changed = true;
+            }
+            if (httpd_query_key_value(buf, "keep_interval", value, sizeof(value)) == ESP_OK) {
+                tuning.keepIntervalS = (uint16_t)strtoul(value, NULL, 10);
+                changed = true;
+            }
+            if (httpd_query_key_value(buf, "keep_count", value, sizeof(value)) == ESP_OK) {
+                tuning.keepCount = (uint8_t)strtoul(value, NULL, 10);
+                changed = true;
+            }
+            if (httpd_query_key_value(buf, "send_timeout_ms", value, sizeof(value)) == ESP_OK) {
+                tuning.sendTimeoutMs = (uint16_t)strtoul(value, NULL, 10);
+                changed = true;
+            }
+            if (httpd_query_key_value(buf, "sndbuf_kb", value, sizeof(value)) == ESP_OK) {
+                tuning.sendBufKB = (uint16_t)strtoul(value, NULL, 10);
+                changed = true;
+            }
+            if (httpd_query_key_value(buf, "lru_purge", value, sizeof(value)) == ESP_OK) {
+                tuning.lruPurge = (uint8_t)strtoul(value, NULL, 10);
+                changed = true;
+            }
+        }
+        free(buf);
+    }
+    if (changed) {
+        saved = net_tuning_set(&tuning);
+        ESP_LOGI(TAG, "Network tuning %s", saved ? "saved" : "rejected");
+        net_tuning_get(&tuning);
+    }
+
+    NetTuningStats stats;
+    net_tuning_get_stats(&stats);
+
+    char json_response[512];
+    snprintf(json_response, sizeof(json_response),
+             "{\"status\":\"%s\",\"nodelay\":%u,\"keepalive\":%u,\"keep_idle\":%u,\"keep_interval\":%u,\"keep_count\":%u,"
+             "\"send_timeout_ms\":%u,\"sndbuf_kb\":%u,\"lru_purge\":%u,\"control_sockets\":%lu,\"stream_sockets\":%lu,"
+             "\"failures\":%lu,\"last_errno\":%d}",
+             saved ? "ok" : "error", tuning.noDelay, tuning.keepAlive, tuning.keepIdleS, tuning.keepIntervalS,
+             tuning.keepCount, tuning.sendTimeoutMs, tuning.sendBufKB, tuning.lruPurge,
+             (unsigned long)stats.controlSockets, (unsigned long)stats.streamSockets,
+             (unsigned long)stats.failures, stats.lastErrno);
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    return httpd_resp_send(req, json_response, strlen(json_response));
+}
+
+// =================== / ===================
+// File Browser Handlers / 文件浏览处理器
+// =================== / ===================
+
+/**
+ * @brief 原地解码URL编码（%XX和+）/ Decode URL encoding (%XX and +) in place
+ */
+static void url_decode(char *s)
+{
+    char *out = s;
+    while (*s) {
+        if (*s == '%' && isxdigit((unsigned char)s[1]) && isxdigit((unsigned char)s[2])) {
+            char hex[3] = {s[1], s[2], 0};
+            *out++ = (char)strtol(hex, NULL, 16);
+            s += 3;
+        } else {
+            *out++ = *s == '+' ? ' ' : *s;
+            s++;
+        }
+    }
+    *out = 0;
+}
+
+/**
+ * @brief 是否允许通过HTTP读取该路径：只允许录像和照片目录下的文件 / Whether a path may be read over HTTP: only files under the recording and photo directories
+ */
+static bool file_path_allowed(const char *path)
+{
+    return (strncmp(path, VIDEO_DIR "/", strlen(VIDEO_DIR "/")) == 0 ||
+            strncmp(path, PHOTO_DIR "/", strlen(PHOTO_DIR "/")) == 0) && !strstr(path, "..");
+}
+
+/**
+ * Files handler / 文件列表处理器
+ * 
+ * API接口 / API Interface:
+ * - GET /files?dir=video&limit=50                     列出录像，最新的在前 / List recordings, newest first
+ * - GET /files?dir=photo&order=oldest&cursor=...      从上一页的next_cursor继续 / Carry on from next_cursor of the previous page
+ * 
+ * 参数说明 / Parameter Description:
+ * - dir: video或photo，默认video / video or photo, video by default
+ * - order: newest（默认）或oldest / newest (default) or oldest
+ * - limit: 每页文件数，1-100，默认50 / Files per page, 1-100, 50 by default
+ * - cursor: 上一页返回的next_cursor（URL编码），没有更多文件时next_cursor为null；过长时返回400
+ *           next_cursor from the previous page (URL-encoded), it is null when there are no more files; 400 when it is too long
+ * 
+ * 返回说明 / Response Description:
+ * - files: path（/file?path=下载）、name、size、time（完成时间）/ path (download with /file?path=), name, size, time (when finalised)
+ * - 正在录制的文件不列出；索引不可用时返回503 / Files still being recorded are left out; 503 when the catalog is unavailable
+ * - PHOTO_PACK_ENABLE为1时dir=photo列出的是每天一个的.pak照片包，单张照片用/photo?date=列出、/photo?id=读取
+ *   With PHOTO_PACK_ENABLE set, dir=photo lists the .pak day files, one per day; list single photos with /photo?date= and read them with /photo?id=
+ */
+static esp_err_t files_handler(httpd_req_t *req)
+{
+    // 验证认证 / Verify authentication
+    auth_result_t auth_result = auth_verify(req);
+    if(auth_result != AUTH_SUCCESS) {
+        ESP_LOGW(TAG, "Files handler: authentication failed (%d)", auth_result);
+        return auth_send_401(req);
+    }
+
+    bool photos = false;
+    bool newest_first = true;
+    int limit = 50;
+    // 游标中的路径可能每个字符都被编码成%XX / Every character of the path in the cursor may be encoded as %XX
+    char cursor[3 * CATALOG_PATH_LEN + 16] = "";
+    bool cursor_too_long = false;
+    size_t query_len = httpd_req_get_url_query_len(req) + 1;
+    if (query_len > 1) {
+        char *buf = (char *)malloc(query_len);
+        char value[16];
+        if (buf && httpd_req_get_url_query_str(req, buf, query_len) == ESP_OK) {
+            if (httpd_query_key_value(buf, "dir", value, sizeof(value)) == ESP_OK && strcmp(value, "photo") == 0) {
+                photos = true;
+            }
+            if (httpd_query_key_value(buf, "order", value, sizeof(value)) == ESP_OK && strcmp(value, "oldest") == 0) {
+                newest_first = false;
+            }
+            if (httpd_query_key_value(buf, "limit", value, sizeof(value)) == ESP_OK) {
+                limit = atoi(value);
+                limit = limit < 1 ? 1 : (limit > 100 ? 100 : limit);
+            }
+            esp_err_t cursor_res = httpd_query_key_value(buf, "cursor", cursor, sizeof(cursor));
+            if (cursor_res == ESP_OK) {
+                url_decode(cursor);
+            } else {
+                cursor_too_long = cursor_res == ESP_ERR_HTTPD_RESULT_TRUNC;
+                cursor[0] = 0;
+            }
+        }
+        free(buf);
+    }
+    // 截断的游标会从错误的位置继续，直接拒绝 / A truncated cursor would resume from the wrong place, so reject it
+    if (cursor_too_long) {
+        httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "cursor too long");
+    }
+
+    // 游标：上一页最后一个文件的"时间:路径" / Cursor: "time:path" of the last file on the previous page
+    uint32_t after_time = 0;
+    const char *after_path = NULL;
+    char *colon = strchr(cursor, ':');
+    if (colon) {
+        *colon = 0;
+        after_time = strtoul(cursor, NULL, 10);
+        after_path = colon + 1;
+    }
+
+    const char *dirname = photos ? PHOTO_DIR : VIDEO_DIR;
+    FileInfo *files = (FileInfo *)(psramFound() ? ps_malloc(limit * sizeof(FileInfo)) : malloc(limit * sizeof(FileInfo)));
+    if (!files) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+    int num = catalog_list(dirname, after_path, after_time, newest_first, CATALOG_FLAG_OPEN, files, limit);
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    if (num < 0) {
+        free(files);
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_hdr(req, "Retry-After", "10");
+        return httpd_resp_send(req, "Catalog unavailable", HTTPD_RESP_USE_STRLEN);
+    }
+
+    // 逐条分块发送 / Send entry by entry in chunks
+    char entry_json[320];
+    httpd_resp_set_type(req, "application/json");
+    snprintf(entry_json, sizeof(entry_json), "{\"dir\":\"%s\",\"order\":\"%s\",\"files\":[",
+             photos ? "photo" : "video", newest_first ? "newest" : "oldest");
+    httpd_resp_send_chunk(req, entry_json, HTTPD_RESP_USE_STRLEN);
+    for (int i = 0; i < num; i++) {
+        snprintf(entry_json, sizeof(entry_json), "%s{\"path\":\"%s\",\"name\":\"%s\",\"size\":%llu,\"time\":%lu}",
+                 i ? "," : "", files[i].path, files[i].name, (unsigned long long)files[i].size, (unsigned long)files[i].mtime);
+        httpd_resp_send_chunk(req, entry_json, HTTPD_RESP_USE_STRLEN);
+    }
+    // 整页时才可能还有下一页 / Only a full page can have a next one
+    if (num == limit) {
+        snprintf(entry_json, sizeof(entry_json), "],\"count\":%d,\"next_cursor\":\"%lu:%s\"}",
+                 num, (unsigned long)files[num - 1].mtime, files[num - 1].path);
+    } else {
+        snprintf(entry_json, sizeof(entry_json), "],\"count\":%d,\"next_cursor\":null}", num);
+    }
+    free(files);
+    httpd_resp_send_chunk(req, entry_json, HTTPD_RESP_USE_STRLEN);
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+/**
+ * File download handler / 文件下载处理器
+ * 
+ * API接口 / API Interface:
+ * - GET /file?path=/camera/videos/20260202/12.avi     下载文件 / Download a file
+ * 
+ * 参数说明 / Parameter Description:
+ * - path: /files返回的路径，只允许录像和照片目录 / A path returned by /files, only the recording and photo directories are allowed
+ * - Range请求头：bytes=a-b、bytes=a-或bytes=-n，返回206；超出文件时返回416
+ *   Range header: bytes=a-b, bytes=a- or bytes=-n gets a 206; past the end of the file gets a 416
+ * 
+ * 返回说明 / Response Description:
+ * - 带Content-Length和Accept-Ranges，支持断点续传和浏览器播放器拖动 / Carries Content-Length and Accept-Ranges, so downloads resume and browser players can seek
+ * - 同时下载数已满时返回503 / 503 when all download slots are taken
+ */
+static esp_err_t file_handler(httpd_req_t *req)
+{
+    // 验证认证 / Verify authentication
+    auth_result_t auth_result = auth_verify(req);
+    if(auth_result != AUTH_SUCCESS) {
+        ESP_LOGW(TAG, "File handler: authentication failed (%d)", auth_result);
+        return auth_send_401(req);
+    }
+
+    char *buf = NULL;
+    char path[128];
+    if (parse_get(req, &buf) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    if (httpd_query_key_value(buf, "path", path, sizeof(path)) != ESP_OK) {
+        free(buf);
+        httpd_resp_send_404(req);
+        return ESP_FAIL;
+    }
+    free(buf);
+    url_decode(path);
+
+    if (!file_path_allowed(path)) {
+        ESP_LOGW(TAG, "File handler: path not allowed: %s", path);
+        httpd_resp_send_err(req, HTTPD_403_FORBIDDEN, "Path not allowed");
+        return ESP_FAIL;
+    }
+
+    // 交给独立的发送任务，控制服务器随即可以处理其他请求 / Hand over to a sender task of its own, the control server can handle other requests at once
+    esp_err_t res = file_download_start(req, path);
+    if (res == ESP_ERR_NO_MEM) {
+        ESP_LOGW(TAG, "File handler: no free download slot");
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_hdr(req, "Retry-After", "5");
+        return httpd_resp_send(req, "Too many downloads", HTTPD_RESP_USE_STRLEN);
+    }
+    return res;
+}
+
+// =================== / ===================
+// Playback Handler / 录像回放处理器
+// =================== / ===================
+
+/**
+ * Playback handler / 录像回放处理器
+ * 
+ * API接口 / API Interface:
+ * - GET :81/playback?file=/camera/videos/20260202/12.avi&t=30&speed=4     从第30秒开始4倍速回放 / Play from second 30 at 4x speed
+ * 
+ * 参数说明 / Parameter Description:
+ * - file: /files?dir=video返回的录像路径 / A recording path returned by /files?dir=video
+ * - t: 开始位置，分段内秒数（可带小数）或Unix时间戳（如书签时间），默认0 / Where to start, seconds into the segment (fractions allowed) or a Unix timestamp (such as a bookmark time), 0 by default
+ * - speed: 倍速0.1-32，默认1；帧率超过20时按索引跳帧 / Speed 0.1-32, 1 by default; frames are skipped through the index beyond 20 fps
+ * 
+ * 返回说明 / Response Description:
+ * - 与/stream相同的multipart MJPEG，可直接用<img>显示；X-Timestamp为帧的录制时间 / The same multipart MJPEG as /stream, an <img> can show it directly; X-Timestamp is when the frame was recorded
+ * - 分段播完后接着播放下一个分段 / Playback carries on with the next segment once one ends
+ */
+static esp_err_t playback_handler(httpd_req_t *req)
+{
+    // 验证认证
+    auth_result_t auth_result = auth_verify(req);
+    if(auth_result != AUTH_SUCCESS) {
+        ESP_LOGW(TAG, "Playback handler: authentication failed (%d)", auth_result);
+        // 视频流认证失败时，返回401并关闭连接
+        httpd_resp_set_status(req, "401 Unauthorized");
+        httpd_resp_set_hdr(req, "WWW-Authenticate", "Basic realm=\"ESP32 Camera\"");
+        httpd_resp_set_hdr(req, "Content-Length", "0");
+        httpd_resp_set_hdr(req, "Connection", "close");
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    char *buf = NULL;
+    char path[128];
+    char value[24];
+    double t = 0;
+    uint32_t speed_pct = 100;
+    if (parse_get(req, &buf) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    if (httpd_query_key_value(buf, "file", path, sizeof(path)) != ESP_OK) {
+        free(buf);
+        httpd_resp_send_404(req);
+        return ESP_FAIL;
+    }
+    if (httpd_query_key_value(buf, "t", value, sizeof(value)) == ESP_OK) {
+        t = atof(value);
+    }
+    if (httpd_query_key_value(buf, "speed", value, sizeof(value)) == ESP_OK && atof(value) > 0) {
+        speed_pct = (uint32_t)(atof(value) * 100 + 0.5);
+    }
+    free(buf);
+    url_decode(path);
+
+    // 只允许录像目录下的AVI / Only AVIs under the recording directory
+    size_t path_len = strlen(path);
+    if (!file_path_allowed(path) || strncmp(path, VIDEO_DIR "/", strlen(VIDEO_DIR "/")) != 0 ||
+        path_len < 4 || strcasecmp(path + path_len - 4, ".avi") != 0) {
+        ESP_LOGW(TAG, "Playback handler: path not allowed: %s", path);
+        httpd_resp_send_err(req, HTTPD_403_FORBIDDEN, "Path not allowed");
+        return ESP_FAIL;
+    }
+
+    // 交给独立的发送任务 / Hand over to a sender task of its own
+    esp_err_t res = video_playback_start(req, path, t, speed_pct);
+    if (res == ESP_ERR_NO_MEM) {
+        ESP_LOGW(TAG, "Playback handler: no free playback slot");
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_hdr(req, "Retry-After", "5");
+        return httpd_resp_send(req, "Too many playbacks", HTTPD_RESP_USE_STRLEN);
+    }
+    return res;
+}
+
+void startCameraServer()
+{
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.max_uri_handlers = 24;
+
+    httpd_uri_t index_uri = {
+        .uri = "/",
+        .method = HTTP_GET,
+        .handler = index_handler,
+        .user_ctx = NULL
+    };
+
+    httpd_uri_t status_uri = {
+        .uri = "/status",
+        .method = HTTP_GET,
+        .handler = status_handler,
+        .user_ctx = NULL
+    };
+
+    httpd_uri_t cmd_uri = {
+        .uri = "/control",
+        .method = HTTP_GET,
+        .handler = cmd_handler,
+        .user_ctx = NULL
+    };
+
+    httpd_uri_t capture_uri = {
+        .uri = "/capture",
+        .method = HTTP_GET,
+        .handler = capture_handler,
+        .user_ctx = NULL
+    };
+
+    httpd_uri_t stream_uri = {
+        .uri = "/stream",
+        .method = HTTP_GET,
+        .handler = stream_handler,
+        .user_ctx = NULL
+    };
+
+    httpd_uri_t playback_uri = {
+        .uri = "/playback",
+        .method = HTTP_GET,
+        .handler = playback_handler,
+        .user_ctx = NULL
+    };
+
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+    httpd_uri_t ws_stream_uri = {
+        .uri = "/ws/stream",
+        .method = HTTP_GET,
+        .handler = ws_stream_handler,
+        .user_ctx = NULL,
+        .is_websocket = true,
+        .handle_ws_control_frames = true
+    };
+#endif
+
+    httpd_uri_t bmp_uri = {
+        .uri = "/bmp",
+        .method = HTTP_GET,
+        .handler = bmp_handler,
+        .user_ctx = NULL
+    };
+
+    httpd_uri_t xclk_uri = {
+        .uri = "/xclk",
+        .method = HTTP_GET,
+        .handler = xclk_handler,
+        .user_ctx = NULL
+    };
+
+    httpd_uri_t reg_uri = {
+        .uri = "/reg",
+        .method = HTTP_GET,
+        .handler = reg_handler,
+        .user_ctx = NULL
+    };
+
+    httpd_uri_t greg_uri = {
+        .uri = "/greg",
+        .method = HTTP_GET,
+        .handler = greg_handler,
+        .user_ctx = NULL
+    };
+
+    httpd_uri_t pll_uri = {
+        .uri = "/pll",
         .method = HTTP_GET,
         .handler = pll_handler,
         .user_ctx = NULL
@@ -980,9 +2431,81 @@ void startCameraServer()
         .user_ctx = NULL
     };
 
+    httpd_uri_t bookmark_uri = {
+        .uri = "/bookmark",
+        .method = HTTP_GET,
+        .handler = bookmark_handler,
+        .user_ctx = NULL
+    };
+
+    httpd_uri_t clip_uri = {
+        .uri = "/clip",
+        .method = HTTP_GET,
+        .handler = clip_handler,
+        .user_ctx = NULL
+    };
+
+    httpd_uri_t bench_sd_uri = {
+        .uri = "/bench/sd",
+        .method = HTTP_GET,
+        .handler = bench_sd_handler,
+        .user_ctx = NULL
+    };
+
+    httpd_uri_t photo_uri = {
+        .uri = "/photo",
+        .method = HTTP_GET,
+        .handler = photo_pack_handler,
+        .user_ctx = NULL
+    };
+
+    httpd_uri_t retention_uri = {
+        .uri = "/retention",
+        .method = HTTP_GET,
+        .handler = retention_handler,
+        .user_ctx = NULL
+    };
+
+    httpd_uri_t storage_uri = {
+        .uri = "/storage",
+        .method = HTTP_GET,
+        .handler = storage_stats_handler,
+        .user_ctx = NULL
+    };
+
+    httpd_uri_t streams_uri = {
+        .uri = "/streams",
+        .method = HTTP_GET,
+        .handler = streams_handler,
+        .user_ctx = NULL
+    };
+
+    httpd_uri_t net_uri = {
+        .uri = "/net",
+        .method = HTTP_GET,
+        .handler = net_tuning_handler,
+        .user_ctx = NULL
+    };
+
+    httpd_uri_t files_uri = {
+        .uri = "/files",
+        .method = HTTP_GET,
+        .handler = files_handler,
+        .user_ctx = NULL
+    };
+
+    httpd_uri_t file_uri = {
+        .uri = "/file",
+        .method = HTTP_GET,
+        .handler = file_handler,
+        .user_ctx = NULL
+    };
+
     ra_filter_init(&ra_filter, 20);
 
 
+    file_download_init();
+    net_tuning_configure(&config, false);
     ESP_LOGI(TAG, "Starting web server on port: '%d'", config.server_port);
     if (httpd_start(&camera_httpd, &config) == ESP_OK)
     {
@@ -998,13 +2521,33 @@ void startCameraServer()
         httpd_register_uri_handler(camera_httpd, &pll_uri);
         httpd_register_uri_handler(camera_httpd, &win_uri);
         httpd_register_uri_handler(camera_httpd, &servo_uri);
+        httpd_register_uri_handler(camera_httpd, &bookmark_uri);
+        httpd_register_uri_handler(camera_httpd, &clip_uri);
+        httpd_register_uri_handler(camera_httpd, &bench_sd_uri);
+        httpd_register_uri_handler(camera_httpd, &retention_uri);
+        httpd_register_uri_handler(camera_httpd, &photo_uri);
+        httpd_register_uri_handler(camera_httpd, &storage_uri);
+        httpd_register_uri_handler(camera_httpd, &streams_uri);
+        httpd_register_uri_handler(camera_httpd, &net_uri);
+        httpd_register_uri_handler(camera_httpd, &files_uri);
+        httpd_register_uri_handler(camera_httpd, &file_uri);
     }
 
     config.server_port += 1;
     config.ctrl_port += 1;
+    stream_clients_init();
+    video_playback_init();
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+    ws_stream_init();
+#endif
+    net_tuning_configure(&config, true);
     ESP_LOGI(TAG, "Starting stream server on port: '%d'", config.server_port);
     if (httpd_start(&stream_httpd, &config) == ESP_OK)
     {
         httpd_register_uri_handler(stream_httpd, &stream_uri);
+        httpd_register_uri_handler(stream_httpd, &playback_uri);
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+        httpd_register_uri_handler(stream_httpd, &ws_stream_uri);
+#endif
     }
 }
@@ -0,0 +1,250 @@
+/**********************************************************************
+  文件名称 / Filename : bookmark.cpp
+  文件用途 / File Purpose : 事件书签实现文件 / Event Bookmark Implementation File
+               本文件实现了录像时间段书签的存储和查询
+               This file implements storage and lookup of recording time range bookmarks
+               主要功能包括 / Main Features:
+               1. 书签文件加载和保存 / Bookmark file loading and saving
+               2. 书签添加、删除、列表 / Bookmark add, delete, list
+               3. 清理时的分段保护检查 / Segment protection check during cleanup
+  作者 / Author : ESP32-S3监控项目 / ESP32-S3 Monitoring Project
+  修改日期 / Modification Date : 2026-02-05
+  硬件平台 / Hardware Platform : ESP32S3-EYE开发板 / ESP32S3-EYE Development Board
+  依赖库 / Dependencies : SD_MMC.h - SD卡文件系统 / SD card file system
+  使用说明 / Usage Instructions : 1. 调用bookmark_init()加载书签 / Call bookmark_init() to load bookmarks
+  注意事项 / Important Notes : 文件格式：头部{magic, count, nextId} + count条44字节记录 / File format: header {magic, count, nextId} + count 44-byte records
+               每次修改整体重写（最多约3KB）/ Every change rewrites the whole file (about 3KB at most)
+               先写BOOKMARK_FILE.tmp再替换；启动时只剩临时文件说明替换被打断，用它补完 / BOOKMARK_FILE.tmp is written first and then swapped in; a temp file left on its own at boot means the swap was cut short and it is used to finish it
+**********************************************************************/
+
+#include "bookmark.h"
+#include "sd_read_write.h"
+#include "SD_MMC.h"
+#include "sd_io.h"
+
+// 保存时的临时文件 / Temp file used while saving
+#define BOOKMARK_TMP_FILE BOOKMARK_FILE ".tmp"
+
+// 书签文件头 / Bookmark file header
+typedef struct {
+    uint32_t magic;                     // 文件标识 / File magic
+    uint32_t count;                     // 书签数量 / Number of bookmarks
+    uint32_t nextId;                    // 下一个书签ID / Next bookmark ID
+} BookmarkFileHeader;
+
+// 内存中的书签 / Bookmarks in RAM
+static Bookmark bookmarks[BOOKMARK_MAX_COUNT];
+static int bookmarkCount = 0;
+static uint32_t bookmarkNextId = 1;
+
+// 互斥锁：Web服务添加/删除，录制任务清理时查询 / Mutex: the web server adds/deletes, the recording task queries during cleanup
+// 写卡的路径先用sd_io_begin()取总线再加锁，与持有总线时查询的任务顺序一致 / Paths that write the card take the bus with sd_io_begin() before the lock, in the same order as tasks querying while holding the bus
+static SemaphoreHandle_t bookmarkMutex = NULL;
+
+/**
+ * @brief 把书签写回SD卡（调用方持有总线和锁）/ Write bookmarks back to the SD card (caller holds the bus and the lock)
+ * @return bool 成功返回true / Returns true on success
+ */
+static bool bookmark_save(void) {
+    File file = SD_MMC.open(BOOKMARK_TMP_FILE, FILE_WRITE);
+    if(!file) {
+        Serial.println("Failed to open bookmark file for writing / 无法写入书签文件");
+        return false;
+    }
+    BookmarkFileHeader header;
+    header.magic = BOOKMARK_MAGIC;
+    header.count = bookmarkCount;
+    header.nextId = bookmarkNextId;
+    size_t dataLen = bookmarkCount * sizeof(Bookmark);
+    bool ok = file.write((uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+              file.write((uint8_t*)bookmarks, dataLen) == dataLen;
+    file.close();
+    if(!ok) {
+        SD_MMC.remove(BOOKMARK_TMP_FILE);
+        return false;
+    }
+    // 与catalog相同：删除旧文件后改名；改名失败时保留临时文件，启动时补完 / Same as the catalog: remove the old file, then rename; the temp file is kept when the rename fails and finished at boot
+    SD_MMC.remove(BOOKMARK_FILE);
+    if(!SD_MMC.rename(BOOKMARK_TMP_FILE, BOOKMARK_FILE)) {
+        Serial.println("Failed to replace bookmark file / 替换书签文件失败");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief 读取书签文件（调用方持有总线）/ Read the bookmark file (caller holds the bus)
+ * @return int 加载的书签数量，文件损坏返回-1 / Number of bookmarks loaded, -1 if the file is corrupt
+ */
+static int load_bookmarks(void) {
+    // 替换被打断：只剩临时文件时它是完整的新文件，否则是写了一半的 / Interrupted swap: a temp file on its own is the complete new file, next to the old one it is half-written
+    if(SD_MMC.exists(BOOKMARK_TMP_FILE)) {
+        if(SD_MMC.exists(BOOKMARK_FILE)) {
+            SD_MMC.remove(BOOKMARK_TMP_FILE);
+        } else if(SD_MMC.rename(BOOKMARK_TMP_FILE, BOOKMARK_FILE)) {
+            Serial.println("Finished an interrupted bookmark save / 补完了被打断的书签保存");
+        }
+    }
+    if(!SD_MMC.exists(BOOKMARK_FILE)) {
+        return 0;
+    }
+    File file = SD_MMC.open(BOOKMARK_FILE, FILE_READ);
+    if(!file) {
+        return -1;
+    }
+    BookmarkFileHeader header;
+    if(file.read((uint8_t*)&header, sizeof(header)) != sizeof(header) ||
+       header.magic != BOOKMARK_MAGIC || header.count > BOOKMARK_MAX_COUNT) {
+        file.close();
+        Serial.println("Bookmark file is corrupt / 书签文件损坏");
+        return -1;
+    }
+    size_t dataLen = header.count * sizeof(Bookmark);
+    if(file.read((uint8_t*)bookmarks, dataLen) != dataLen) {
+        file.close();
+        Serial.println("Bookmark file is truncated / 书签文件不完整");
+        return -1;
+    }
+    file.close();
+
+    bookmarkCount = header.count;
+    bookmarkNextId = header.nextId;
+    for(int i = 0; i < bookmarkCount; i++) {
+        bookmarks[i].label[BOOKMARK_LABEL_LEN - 1] = '\0';
+    }
+    Serial.printf("Loaded %d bookmark(s) / 加载了 %d 个书签\n", bookmarkCount, bookmarkCount);
+    return bookmarkCount;
+}
+
+/**
+ * @brief 加载书签 / Load bookmarks
+ * @return int 加载的书签数量，文件损坏返回-1 / Number of bookmarks loaded, -1 if the file is corrupt
+ */
+int bookmark_init(void) {
+    if(!bookmarkMutex) {
+        bookmarkMutex = xSemaphoreCreateMutex();
+    }
+    bookmarkCount = 0;
+    bookmarkNextId = 1;
+    sd_io_begin(SD_IO_STORE);
+    int loaded = load_bookmarks();
+    sd_io_end(SD_IO_STORE, 0);
+    return loaded;
+}
+
+/**
+ * @brief 添加书签 / Add a bookmark
+ * @return int 新书签ID，失败返回-1 / New bookmark ID, -1 on failure
+ */
+int bookmark_add(uint32_t start, uint32_t end, const char *label) {
+    if(!bookmarkMutex || end < start) {
+        return -1;
+    }
+    sd_io_begin(SD_IO_STORE);
+    xSemaphoreTake(bookmarkMutex, portMAX_DELAY);
+    if(bookmarkCount >= BOOKMARK_MAX_COUNT) {
+        xSemaphoreGive(bookmarkMutex);
+        sd_io_end(SD_IO_STORE, 0);
+        return -1;
+    }
+    Bookmark *b = &bookmarks[bookmarkCount];
+    b->id = bookmarkNextId;
+    b->start = start;
+    b->end = end;
+    memset(b->label, 0, sizeof(b->label));
+    if(label) {
+        strncpy(b->label, label, BOOKMARK_LABEL_LEN - 1);
+    }
+    bookmarkCount++;
+    bookmarkNextId++;
+    bool ok = bookmark_save();
+    if(!ok) {
+        // 写卡失败时撤销，保持内存与SD卡一致 / Roll back on write failure to keep RAM and card consistent
+        bookmarkCount--;
+        bookmarkNextId--;
+    }
+    int id = ok ? (int)b->id : -1;
+    xSemaphoreGive(bookmarkMutex);
+    sd_io_end(SD_IO_STORE, 0);
+    return id;
+}
+
+/**
+ * @brief 删除书签 / Delete a bookmark
+ * @return bool 成功返回true / Returns true on success
+ */
+bool bookmark_delete(uint32_t id) {
+    if(!bookmarkMutex) {
+        return false;
+    }
+    sd_io_begin(SD_IO_STORE);
+    xSemaphoreTake(bookmarkMutex, portMAX_DELAY);
+    int index = -1;
+    for(int i = 0; i < bookmarkCount; i++) {
+        if(bookmarks[i].id == id) {
+            index = i;
+            break;
+        }
+    }
+    bool ok = false;
+    if(index >= 0) {
+        Bookmark removed = bookmarks[index];
+        memmove(&bookmarks[index], &bookmarks[index + 1], (bookmarkCount - index - 1) * sizeof(Bookmark));
+        bookmarkCount--;
+        ok = bookmark_save();
+        if(!ok) {
+            // 写卡失败时撤销，保持内存与SD卡一致 / Roll back on write failure to keep RAM and card consistent
+            memmove(&bookmarks[index + 1], &bookmarks[index], (bookmarkCount - index) * sizeof(Bookmark));
+            bookmarks[index] = removed;
+            bookmarkCount++;
+        }
+    }
+    xSemaphoreGive(bookmarkMutex);
+    sd_io_end(SD_IO_STORE, 0);
+    return ok;
+}
+
+/**
+ * @brief 获取书签列表 / Get the bookmark list
+ * @return int 书签数量 / Number of bookmarks
+ */
+int bookmark_get_list(Bookmark *list, int maxCount) {
+    if(!bookmarkMutex) {
+        return 0;
+    }
+    xSemaphoreTake(bookmarkMutex, portMAX_DELAY);
+    int n = bookmarkCount < maxCount ? bookmarkCount : maxCount;
+    memcpy(list, bookmarks, n * sizeof(Bookmark));
+    xSemaphoreGive(bookmarkMutex);
+    return n;
+}
+
+/**
+ * @brief 检查时间段是否与任一书签重叠 / Check whether a time range overlaps any bookmark
+ * @return bool 重叠返回true / Returns true on overlap
+ */
+bool bookmark_is_protected(uint32_t start, uint32_t end) {
+    if(!bookmarkMutex) {
+        return false;
+    }
+    xSemaphoreTake(bookmarkMutex, portMAX_DELAY);
+    bool hit = false;
+    for(int i = 0; i < bookmarkCount && !hit; i++) {
+        hit = bookmarks[i].start < end && start <= bookmarks[i].end;
+    }
+    xSemaphoreGive(bookmarkMutex);
+    return hit;
+}
+
+/**
+ * @brief 检查视频分段是否受书签保护 / Check whether a video segment is protected by a bookmark
+ * @return bool 受保护返回true / Returns true if protected
+ */
+bool bookmark_is_segment_protected(const char *path) {
+    // 书签数在bookmark_is_protected()内加锁读取 / The bookmark count is read under the lock inside bookmark_is_protected()
+    time_t start = parseTimestampFromPath(path);
+    if(start <= 0) {
+        return false;
+    }
+    return bookmark_is_protected((uint32_t)start, (uint32_t)start + BOOKMARK_SEGMENT_SPAN_S);
+}
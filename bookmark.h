@@ -0,0 +1,100 @@
+/**********************************************************************
+  文件名称 / Filename : bookmark.h
+  文件用途 / File Purpose : 事件书签头文件 / Event Bookmark Header File
+               声明了录像时间段书签相关的函数原型和宏定义
+               Declares function prototypes and macro definitions for recording time range bookmarks
+  作者 / Author : ESP32-S3监控项目 / ESP32-S3 Monitoring Project
+  修改日期 / Modification Date : 2026-02-05
+  硬件平台 / Hardware Platform : ESP32S3-EYE开发板 / ESP32S3-EYE Development Board
+  依赖库 / Dependencies : Arduino.h - Arduino核心库 / Arduino Core Library
+               sd_read_write.h - SD卡操作 / SD card operations
+  使用说明 / Usage Instructions : 1. 包含本头文件 #include "bookmark.h" / Include this header file
+               2. SD卡初始化后调用bookmark_init()加载书签 / Call bookmark_init() after SD card init to load bookmarks
+               3. 调用bookmark_add()/bookmark_delete()管理书签 / Call bookmark_add()/bookmark_delete() to manage bookmarks
+               4. 清理前调用bookmark_is_segment_protected()检查分段 / Call bookmark_is_segment_protected() before cleanup to check a segment
+  参数调整 / Parameter Adjustment : BOOKMARK_MAX_COUNT - 最大书签数量（默认64）/ Maximum number of bookmarks (default 64)
+  注意事项 / Important Notes : 书签保存在SD卡的定长二进制文件中，启动时一次性读入内存 / Bookmarks are stored in a fixed-record binary file on the SD card and read into RAM once at boot
+               清理检查只查内存，不访问SD卡 / Cleanup checks only touch RAM, never the SD card
+               保存时先写临时文件再替换，写到一半断电不会丢失原书签 / Saves write a temp file and then replace, so power loss mid-write never loses the existing bookmarks
+**********************************************************************/
+
+#ifndef __BOOKMARK_H
+#define __BOOKMARK_H
+
+#include "Arduino.h"
+
+// 书签文件路径 / Bookmark file path
+#define BOOKMARK_FILE "/camera/bookmarks.dat"
+
+// 书签文件标识 / Bookmark file magic
+#define BOOKMARK_MAGIC 0x314D4B42  // 'BKM1'
+
+// 最大书签数量 / Maximum number of bookmarks
+#define BOOKMARK_MAX_COUNT 64
+
+// 书签标签最大长度（含结束符）/ Maximum label length (including terminator)
+#define BOOKMARK_LABEL_LEN 32
+
+// 分段覆盖时长（秒）：2分钟分段 + 文件名只精确到分钟的余量 / Segment span (seconds): 2-minute segment + slack for minute-resolution filenames
+#define BOOKMARK_SEGMENT_SPAN_S 180
+
+// 书签记录（定长44字节）/ Bookmark record (fixed 44 bytes)
+typedef struct {
+    uint32_t id;                        // 书签ID / Bookmark ID
+    uint32_t start;                     // 开始时间（Unix时间戳）/ Start time (Unix timestamp)
+    uint32_t end;                       // 结束时间（Unix时间戳）/ End time (Unix timestamp)
+    char label[BOOKMARK_LABEL_LEN];     // 标签 / Label
+} Bookmark;
+
+/**
+ * @brief 加载书签 / Load bookmarks
+ * @return int 加载的书签数量，文件损坏返回-1 / Number of bookmarks loaded, -1 if the file is corrupt
+ * @details 功能说明 / Function Description:
+ *          1. 创建互斥锁 / Create the mutex
+ *          2. 读取书签文件到内存 / Read the bookmark file into RAM
+ * @note 书签文件不存在时返回0 / Returns 0 when the bookmark file does not exist
+ */
+int bookmark_init(void);
+
+/**
+ * @brief 添加书签 / Add a bookmark
+ * @param start 开始时间（Unix时间戳）/ Start time (Unix timestamp)
+ * @param end 结束时间（Unix时间戳）/ End time (Unix timestamp)
+ * @param label 标签，可为NULL / Label, may be NULL
+ * @return int 新书签ID，失败返回-1 / New bookmark ID, -1 on failure
+ * @note 添加后立即写回SD卡 / Written back to the SD card immediately
+ */
+int bookmark_add(uint32_t start, uint32_t end, const char *label);
+
+/**
+ * @brief 删除书签 / Delete a bookmark
+ * @param id 书签ID / Bookmark ID
+ * @return bool 成功返回true，ID不存在或写卡失败返回false（书签不变）/ Returns true on success, false if the ID does not exist or the card write fails (bookmarks unchanged)
+ */
+bool bookmark_delete(uint32_t id);
+
+/**
+ * @brief 获取书签列表 / Get the bookmark list
+ * @param list 输出数组 / Output array
+ * @param maxCount 数组容量 / Array capacity
+ * @return int 书签数量 / Number of bookmarks
+ */
+int bookmark_get_list(Bookmark *list, int maxCount);
+
+/**
+ * @brief 检查时间段是否与任一书签重叠 / Check whether a time range overlaps any bookmark
+ * @param start 开始时间 / Start time
+ * @param end 结束时间 / End time
+ * @return bool 重叠返回true / Returns true on overlap
+ */
+bool bookmark_is_protected(uint32_t start, uint32_t end);
+
+/**
+ * @brief 检查视频分段是否受书签保护 / Check whether a video segment is protected by a bookmark
+ * @param path 分段文件路径（YYYYMMDDHHMM.avi）/ Segment file path (YYYYMMDDHHMM.avi)
+ * @return bool 受保护返回true / Returns true if protected
+ * @note 分段时间从文件名解析，覆盖[开始, 开始+BOOKMARK_SEGMENT_SPAN_S) / Segment time is parsed from the filename and covers [start, start+BOOKMARK_SEGMENT_SPAN_S)
+ */
+bool bookmark_is_segment_protected(const char *path);
+
+#endif // __BOOKMARK_H
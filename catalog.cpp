@@ -0,0 +1,966 @@
+/**********************************************************************
+  文件名称 / Filename : catalog.cpp
+  文件用途 / File Purpose : 录像目录索引实现文件 / Recording Catalog Implementation File
+               本文件实现了SD卡上只追加的录像/照片目录索引
+               This file implements the append-only recording/photo catalog on the SD card
+               主要功能包括 / Main Features:
+               1. 启动时校验并重放索引文件 / Verify and replay the catalog file at boot
+               2. 索引缺失或损坏时从目录扫描重建 / Rebuild from a directory scan when missing or corrupt
+               3. 文件完成、更新、删除时追加一条记录 / Append one record when a file is finalised, updated or deleted
+               4. 删除记录过多时压缩重写 / Compact by rewriting once deleted records pile up
+               5. 代替目录扫描的查询接口 / Query interface replacing directory scans
+               6. 按配额、保留天数和剩余空间一次遍历计算清理集合 / Single-pass cleanup planning by quota, retention age and free space
+  作者 / Author : ESP32-S3监控项目 / ESP32-S3 Monitoring Project
+  修改日期 / Modification Date : 2026-02-05
+  硬件平台 / Hardware Platform : ESP32S3-EYE开发板 / ESP32S3-EYE Development Board
+  依赖库 / Dependencies : SD_MMC.h - SD卡文件系统 / SD card file system
+               unistd.h - truncate()截断残缺的尾部记录 / truncate() for cutting torn tail records
+  使用说明 / Usage Instructions : 1. 调用catalog_init()加载索引 / Call catalog_init() to load the catalog
+  注意事项 / Important Notes : 文件格式：头部{magic, version, recordSize, reserved} + 80字节记录 / File format: header {magic, version, recordSize, reserved} + 80-byte records
+               内存中的有效文件列表放在PSRAM，按路径哈希表查找，重放和每次添加、删除都不扫描整个列表
+                  The in-memory live file list lives in PSRAM and is looked up through a path hash table, so replay and every add or delete avoid scanning the whole list
+               追加失败时删除索引文件，下次启动重建，避免索引与SD卡不一致 / A failed append deletes the catalog file so it is rebuilt next boot and never disagrees with the card
+               断电留下的残缺尾部记录在启动时截断，不必重建 / A torn tail record left by a power loss is truncated at boot instead of forcing a rebuild
+**********************************************************************/
+
+#include "catalog.h"
+#include "SD_MMC.h"
+#include "sd_space.h"
+#include "bookmark.h"
+#include "video_clip.h"
+#include "photo_pack.h"
+#include "sd_io.h"
+#include <unistd.h>
+
+// 重写索引时的临时文件 / Temp file used while rewriting the catalog
+#define CATALOG_TMP_FILE CATALOG_FILE ".tmp"
+
+// 索引文件头 / Catalog file header
+typedef struct {
+    uint32_t magic;                     // 文件标识 / File magic
+    uint32_t version;                   // 格式版本 / Format version
+    uint32_t recordSize;                // 记录大小 / Record size
+    uint32_t reserved;                  // 保留 / Reserved
+} CatalogFileHeader;
+
+// 内存中的文件条目 / In-memory file entry
+typedef struct {
+    char path[CATALOG_PATH_LEN];        // 文件路径 / File path
+    uint32_t start;                     // 开始时间 / Start time
+    uint32_t end;                       // 结束时间 / End time
+    uint32_t size;                      // 文件大小 / File size
+    uint8_t type;                       // 文件类型 / File type
+    uint8_t dead;                       // 已删除 / Deleted
+    uint16_t flags;                     // 文件标志 / File flags
+    uint32_t hash;                      // 路径哈希 / Path hash
+} CatalogEntry;
+
+// 文件条目（PSRAM，按时间先后）/ File entries (PSRAM, in time order)
+static CatalogEntry *catalogEntries = NULL;
+static uint32_t catalogEntryCount = 0;      // 含已删除 / Including deleted
+static uint32_t catalogEntryCap = 0;
+static uint32_t catalogDeadCount = 0;
+static uint32_t catalogFirstLive = 0;       // 第一个有效条目（清理从最旧的删起）/ First live entry (cleanup deletes oldest first)
+
+// 路径哈希表（PSRAM，开放寻址，槽位存条目下标+1，0为空）/ Path hash table (PSRAM, open addressing, slots hold entry index + 1, 0 is empty)
+// 已删除条目留在表中直到压缩，分配失败时退回顺序查找 / Deleted entries stay in the table until compaction, lookups fall back to a linear scan if it cannot be allocated
+static uint32_t *catalogHashSlots = NULL;
+static uint32_t catalogHashCap = 0;
+
+// 索引文件大小（用于空间统计）/ Catalog file size (for the space accounting)
+static uint32_t catalogFileBytes = 0;
+
+// 各类型文件总字节数（下标为类型-1）/ Total bytes per file type (indexed by type - 1)
+static uint64_t catalogTypeBytes[CATALOG_NUM_TYPES] = {0};
+
+// 索引是否可用 / Whether the catalog is usable
+static bool catalogReady = false;
+
+// 互斥锁：录像任务、Web服务、后台任务都会访问 / Mutex: used by the recorder, the web server and background tasks
+static SemaphoreHandle_t catalogMutex = NULL;
+
+// 压缩进行中，以及压缩开始后追加到旧文件的记录数 / Compaction in progress, and records appended to the old file since it started
+static bool catalogCompacting = false;
+static uint32_t catalogTailRecords = 0;
+
+// 加载次数，压缩期间重新加载（重新挂载后）时放弃压缩 / Load count, compaction gives up if the catalog is reloaded meanwhile (after a remount)
+static uint32_t catalogLoads = 0;
+
+/**
+ * @brief 计算CRC32 / Compute CRC32
+ * @return uint32_t CRC32（IEEE 802.3）/ CRC32 (IEEE 802.3)
+ */
+static uint32_t catalog_crc32(const uint8_t *data, size_t len) {
+    uint32_t crc = 0xFFFFFFFF;
+    for(size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for(int k = 0; k < 8; k++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+/**
+ * @brief 目录是否在索引范围内 / Whether the catalog covers a directory
+ */
+static bool catalog_covers(const char *dirname) {
+    return strncmp(dirname, VIDEO_DIR, strlen(VIDEO_DIR)) == 0 || strncmp(dirname, PHOTO_DIR, strlen(PHOTO_DIR)) == 0 ||
+           strncmp(dirname, CLIP_DIR, strlen(CLIP_DIR)) == 0;
+}
+
+/**
+ * @brief 把条目计入或移出类型统计 / Count an entry into or out of the per-type totals
+ * @param add true计入，false移出 / true counts in, false counts out
+ */
+static void count_entry(const CatalogEntry *e, bool add) {
+    if(e->type < 1 || e->type > CATALOG_NUM_TYPES) {
+        return;
+    }
+    uint64_t *total = &catalogTypeBytes[e->type - 1];
+    if(add) {
+        *total += e->size;
+    } else {
+        *total -= *total < e->size ? *total : e->size;
+    }
+}
+
+/**
+ * @brief 重新统计各类型总字节数（调用方持有锁）/ Recount the per-type totals (caller holds the lock)
+ */
+static void recount_type_bytes(void) {
+    memset(catalogTypeBytes, 0, sizeof(catalogTypeBytes));
+    for(uint32_t i = catalogFirstLive; i < catalogEntryCount; i++) {
+        if(!catalogEntries[i].dead) {
+            count_entry(&catalogEntries[i], true);
+        }
+    }
+}
+
+/**
+ * @brief 计算路径哈希 / Compute a path hash
+ * @return uint32_t FNV-1a
+ */
+static uint32_t path_hash(const char *path) {
+    uint32_t h = 2166136261u;
+    while(*path) {
+        h = (h ^ (uint8_t)*path++) * 16777619u;
+    }
+    return h;
+}
+
+/**
+ * @brief 把条目放入哈希表（调用方持有锁，表中有空位）/ Put an entry into the hash table (caller holds the lock, the table has room)
+ */
+static void hash_insert(uint32_t index) {
+    uint32_t mask = catalogHashCap - 1;
+    uint32_t slot = catalogEntries[index].hash & mask;
+    while(catalogHashSlots[slot]) {
+        slot = (slot + 1) & mask;
+    }
+    catalogHashSlots[slot] = index + 1;
+}
+
+/**
+ * @brief 按当前条目重建哈希表（调用方持有锁）/ Rebuild the hash table from the current entries (caller holds the lock)
+ * @details 表容量保持在条目数（含已删除）的两倍以上 / The table is kept at more than twice the entry count (deleted ones included)
+ */
+static void hash_rebuild(void) {
+    uint32_t cap = CATALOG_GROW_STEP * 2;
+    while(cap < catalogEntryCount * 2 + 2) {
+        cap *= 2;
+    }
+    if(cap != catalogHashCap) {
+        free(catalogHashSlots);
+        catalogHashSlots = (uint32_t*)ps_malloc(cap * sizeof(uint32_t));
+        catalogHashCap = catalogHashSlots ? cap : 0;
+    }
+    if(!catalogHashSlots) {
+        return;
+    }
+    memset(catalogHashSlots, 0, catalogHashCap * sizeof(uint32_t));
+    for(uint32_t i = catalogFirstLive; i < catalogEntryCount; i++) {
+        if(!catalogEntries[i].dead) {
+            hash_insert(i);
+        }
+    }
+}
+
+/**
+ * @brief 清空全部条目（调用方持有锁）/ Drop every entry (caller holds the lock)
+ */
+static void reset_entries(void) {
+    catalogEntryCount = 0;
+    catalogDeadCount = 0;
+    catalogFirstLive = 0;
+    hash_rebuild();
+}
+
+/**
+ * @brief 按路径查找有效条目 / Find a live entry by path
+ * @param path 文件路径 / File path
+ * @return CatalogEntry* 条目，未找到返回NULL / Entry, NULL if not found
+ * @note 同一路径最多只有一个有效条目 / A path has at most one live entry
+ */
+static CatalogEntry* find_entry(const char *path) {
+    uint32_t h = path_hash(path);
+    if(!catalogHashSlots) {
+        for(uint32_t i = catalogEntryCount; i-- > catalogFirstLive; ) {
+            CatalogEntry *e = &catalogEntries[i];
+            if(!e->dead && e->hash == h && strcmp(e->path, path) == 0) {
+                return e;
+            }
+        }
+        return NULL;
+    }
+    uint32_t mask = catalogHashCap - 1;
+    for(uint32_t slot = h & mask; catalogHashSlots[slot]; slot = (slot + 1) & mask) {
+        CatalogEntry *e = &catalogEntries[catalogHashSlots[slot] - 1];
+        if(e->hash == h && !e->dead && strcmp(e->path, path) == 0) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief 标记条目已删除 / Mark an entry deleted
+ */
+static void kill_entry(CatalogEntry *e) {
+    e->dead = 1;
+    catalogDeadCount++;
+    while(catalogFirstLive < catalogEntryCount && catalogEntries[catalogFirstLive].dead) {
+        catalogFirstLive++;
+    }
+}
+
+/**
+ * @brief 追加内存条目 / Append an in-memory entry
+ * @param path 文件路径（短于CATALOG_PATH_LEN）/ File path (shorter than CATALOG_PATH_LEN)
+ * @return CatalogEntry* 新条目，内存不足返回NULL / New entry, NULL when out of memory
+ */
+static CatalogEntry* push_entry(const char *path) {
+    if(catalogEntryCount == catalogEntryCap) {
+        CatalogEntry *grown = (CatalogEntry*)ps_realloc(catalogEntries, (catalogEntryCap + CATALOG_GROW_STEP) * sizeof(CatalogEntry));
+        if(!grown) {
+            return NULL;
+        }
+        catalogEntries = grown;
+        catalogEntryCap += CATALOG_GROW_STEP;
+    }
+    CatalogEntry *e = &catalogEntries[catalogEntryCount++];
+    memset(e, 0, sizeof(CatalogEntry));
+    snprintf(e->path, sizeof(e->path), "%s", path);
+    e->hash = path_hash(e->path);
+    if(catalogEntryCount * 2 + 2 > catalogHashCap) {
+        hash_rebuild();
+    } else {
+        hash_insert(catalogEntryCount - 1);
+    }
+    return e;
+}
+
+/**
+ * @brief 用条目填充记录并计算CRC / Fill a record from an entry and compute its CRC
+ */
+static void fill_record(CatalogRecord *rec, uint8_t op, const CatalogEntry *e) {
+    memset(rec, 0, sizeof(CatalogRecord));
+    rec->magic = CATALOG_MAGIC;
+    rec->op = op;
+    rec->type = e->type;
+    rec->flags = e->flags;
+    rec->start = e->start;
+    rec->end = e->end;
+    rec->size = e->size;
+    memcpy(rec->path, e->path, CATALOG_PATH_LEN);
+    rec->crc = catalog_crc32((const uint8_t*)rec, offsetof(CatalogRecord, crc));
+}
+
+/**
+ * @brief 排队取SD卡总线后加锁 / Queue for the SD card bus, then take the lock
+ * @note 录像任务持有总线时会更新索引，写索引文件的路径都先取总线再加锁，顺序一致不会死锁
+ *       The recorder updates the catalog while holding the bus, so every path that writes the catalog file takes the bus before the lock and the order never deadlocks
+ */
+static void catalog_lock_io(void) {
+    sd_io_begin(SD_IO_STORE);
+    xSemaphoreTake(catalogMutex, portMAX_DELAY);
+}
+
+/**
+ * @brief 解锁并释放SD卡总线 / Give the lock back, then release the SD card bus
+ */
+static void catalog_unlock_io(void) {
+    xSemaphoreGive(catalogMutex);
+    sd_io_end(SD_IO_STORE, 0);
+}
+
+/**
+ * @brief 压缩内存中的已删除条目（调用方持有锁）/ Compact deleted in-memory entries (caller holds the lock)
+ */
+static void compact_entries(void) {
+    uint32_t live = 0;
+    for(uint32_t i = 0; i < catalogEntryCount; i++) {
+        if(!catalogEntries[i].dead) {
+            catalogEntries[live++] = catalogEntries[i];
+        }
+    }
+    catalogEntryCount = live;
+    catalogDeadCount = 0;
+    catalogFirstLive = 0;
+    hash_rebuild();
+}
+
+/**
+ * @brief 用临时文件替换索引文件（调用方持有总线和锁）/ Replace the catalog file with the temp file (caller holds the bus and the lock)
+ * @param newBytes 临时文件大小 / Temp file size
+ * @return bool 成功返回true / Returns true on success
+ */
+static bool swap_in_catalog_file(uint32_t newBytes) {
+    SD_MMC.remove(CATALOG_FILE);
+    bool ok = SD_MMC.rename(CATALOG_TMP_FILE, CATALOG_FILE);
+    if(!ok) {
+        SD_MMC.remove(CATALOG_TMP_FILE);
+        newBytes = 0;
+    }
+    sd_space_file_resized(catalogFileBytes, newBytes);
+    catalogFileBytes = newBytes;
+    return ok;
+}
+
+/**
+ * @brief 把全部有效条目写成新的索引文件（调用方持有总线和锁）/ Write all live entries as a fresh catalog file (caller holds the bus and the lock)
+ * @details 重建时使用：先写临时文件再替换，同时压缩内存中的已删除条目 / Used by rebuilds: writes a temp file and then replaces, also compacting deleted in-memory entries
+ * @return bool 成功返回true / Returns true on success
+ */
+static bool write_catalog_file(void) {
+    compact_entries();
+    File file = SD_MMC.open(CATALOG_TMP_FILE, FILE_WRITE);
+    if(!file) {
+        return false;
+    }
+    CatalogFileHeader header = {CATALOG_MAGIC, CATALOG_VERSION, sizeof(CatalogRecord), 0};
+    bool ok = sd_io_write(file, (uint8_t*)&header, sizeof(header), SD_IO_STORE) == sizeof(header);
+
+    // 每次攒16条再写，减少SD卡写入次数 / Write 16 records at a time to cut SD card writes
+    CatalogRecord batch[16];
+    uint32_t n = 0;
+    for(uint32_t i = 0; ok && i < catalogEntryCount; i++) {
+        fill_record(&batch[n++], CATALOG_OP_ADD, &catalogEntries[i]);
+        if(n == 16 || i == catalogEntryCount - 1) {
+            ok = sd_io_write(file, (uint8_t*)batch, n * sizeof(CatalogRecord), SD_IO_STORE) == n * sizeof(CatalogRecord);
+            n = 0;
+        }
+    }
+    file.close();
+    if(!ok) {
+        SD_MMC.remove(CATALOG_TMP_FILE);
+        return false;
+    }
+    return swap_in_catalog_file(sizeof(header) + catalogEntryCount * sizeof(CatalogRecord));
+}
+
+/**
+ * @brief 删除索引文件 / Remove the catalog file
+ */
+static void remove_catalog_file(void) {
+    SD_MMC.remove(CATALOG_FILE);
+    sd_space_file_removed(catalogFileBytes);
+    catalogFileBytes = 0;
+}
+
+/**
+ * @brief 把条目填入文件信息 / Fill a file info from an entry
+ */
+static void entry_to_file_info(const CatalogEntry *e, FileInfo *info) {
+    const char *name = strrchr(e->path, '/');
+    snprintf(info->path, sizeof(info->path), "%s", e->path);
+    snprintf(info->name, sizeof(info->name), "%s", name ? name + 1 : e->path);
+    info->size = e->size;
+    info->mtime = e->end;
+}
+
+/**
+ * @brief 追加一条记录（调用方持有总线和锁）/ Append one record (caller holds the bus and the lock)
+ * @details 失败时删除索引文件并停用索引，下次启动重建 / On failure deletes the catalog file and disables the catalog until it is rebuilt next boot
+ */
+static void append_record(uint8_t op, const CatalogEntry *e) {
+    CatalogRecord rec;
+    fill_record(&rec, op, e);
+    File file = SD_MMC.open(CATALOG_FILE, FILE_APPEND);
+    bool ok = file && file.write((uint8_t*)&rec, sizeof(rec)) == sizeof(rec);
+    if(file) {
+        file.close();
+    }
+    if(ok) {
+        sd_space_file_resized(catalogFileBytes, catalogFileBytes + sizeof(rec));
+        catalogFileBytes += sizeof(rec);
+        if(catalogCompacting) {
+            catalogTailRecords++;
+        }
+    } else {
+        Serial.println("Catalog append failed, rebuilding on next boot / 索引写入失败，下次启动重建");
+        remove_catalog_file();
+        catalogReady = false;
+    }
+}
+
+/**
+ * @brief 压缩索引文件 / Compact the catalog file
+ * @details 功能说明 / Function Description:
+ *          1. 加锁压缩内存条目，记下要写的条目数 / Under the lock, compact the in-memory entries and note how many to write
+ *          2. 不持有锁，每16条加锁取一次记录，按批量类别写入临时文件 / Without holding the lock, take 16 records at a time under it and write them to the temp file as bulk I/O
+ *          3. 取总线和锁，把期间追加到旧文件的记录接到临时文件后再替换 / Take the bus and the lock, copy the records appended to the old file meanwhile onto the temp file, then swap
+ * @note 写临时文件期间添加、更新、删除照常进行；条目只会追加或标记删除，下标不变
+ *       Adds, updates and deletes carry on while the temp file is written; entries are only appended or marked dead, so indices stay put
+ */
+static void compact_catalog(void) {
+    xSemaphoreTake(catalogMutex, portMAX_DELAY);
+    if(!catalogReady || catalogCompacting) {
+        xSemaphoreGive(catalogMutex);
+        return;
+    }
+    uint32_t t0 = millis();
+    compact_entries();
+    uint32_t count = catalogEntryCount;
+    uint32_t loads = catalogLoads;
+    catalogCompacting = true;
+    catalogTailRecords = 0;
+    xSemaphoreGive(catalogMutex);
+
+    File file = SD_MMC.open(CATALOG_TMP_FILE, FILE_WRITE);
+    CatalogFileHeader header = {CATALOG_MAGIC, CATALOG_VERSION, sizeof(CatalogRecord), 0};
+    bool ok = file && sd_io_write(file, (uint8_t*)&header, sizeof(header), SD_IO_BULK) == sizeof(header);
+    uint32_t written = 0;
+    CatalogRecord batch[16];
+    for(uint32_t i = 0; ok && i < count; ) {
+        uint32_t n = 0;
+        xSemaphoreTake(catalogMutex, portMAX_DELAY);
+        if(catalogLoads != loads) {
+            xSemaphoreGive(catalogMutex);
+            ok = false;
+            break;
+        }
+        for(; i < count && n < 16; i++) {
+            // 期间删除的条目不写，旧文件尾部的删除记录会被复制过来 / Entries deleted meanwhile are left out, their delete records come over with the old file's tail
+            if(!catalogEntries[i].dead) {
+                fill_record(&batch[n++], CATALOG_OP_ADD, &catalogEntries[i]);
+            }
+        }
+        xSemaphoreGive(catalogMutex);
+        ok = sd_io_write(file, (uint8_t*)batch, n * sizeof(CatalogRecord), SD_IO_BULK) == n * sizeof(CatalogRecord);
+        written += n;
+    }
+
+    catalog_lock_io();
+    // 索引在此期间停用（追加失败）或重新加载时放弃 / Give up if the catalog was disabled (a failed append) or reloaded meanwhile
+    ok = ok && catalogReady && catalogLoads == loads;
+    uint32_t tail = catalogTailRecords;
+    if(ok && tail > 0) {
+        File old = SD_MMC.open(CATALOG_FILE, FILE_READ);
+        ok = old && old.seek(catalogFileBytes - tail * sizeof(CatalogRecord));
+        for(uint32_t k = 0; ok && k < tail; ) {
+            uint32_t n = tail - k < 16 ? tail - k : 16;
+            ok = old.read((uint8_t*)batch, n * sizeof(CatalogRecord)) == n * sizeof(CatalogRecord) &&
+                 file.write((uint8_t*)batch, n * sizeof(CatalogRecord)) == n * sizeof(CatalogRecord);
+            k += n;
+        }
+        if(old) {
+            old.close();
+        }
+    }
+    if(file) {
+        file.close();
+    }
+    if(ok) {
+        if(!swap_in_catalog_file(sizeof(header) + (written + tail) * sizeof(CatalogRecord))) {
+            Serial.println("Catalog compaction failed, rebuilding on next boot / 索引压缩失败，下次启动重建");
+            catalogReady = false;
+        } else {
+            Serial.printf("Catalog compacted: %lu record(s) in %lu ms / 索引已压缩\n",
+                          (unsigned long)(written + tail), (unsigned long)(millis() - t0));
+        }
+    } else {
+        // 旧文件仍然完整，下次删除时再试 / The old file is still whole, try again on a later delete
+        SD_MMC.remove(CATALOG_TMP_FILE);
+        Serial.println("Catalog compaction failed, keeping the old file / 索引压缩失败，保留原文件");
+    }
+    catalogCompacting = false;
+    catalog_unlock_io();
+}
+
+/**
+ * @brief 扫描一级目录加入内存条目 / Scan one directory level into in-memory entries
+ * @return bool 成功返回true / Returns true on success
+ */
+static bool scan_files_in(const char *dirname, uint8_t type, const char *extension) {
+    File root = SD_MMC.open(dirname);
+    if(!root || !root.isDirectory()) {
+        return true; // 目录不存在视为空 / A missing directory counts as empty
+    }
+    size_t extLen = strlen(extension);
+    File file = root.openNextFile();
+    while(file) {
+        const char *name = file.name();
+        size_t nameLen = strlen(name);
+        if(!file.isDirectory() && nameLen > extLen && strcmp(name + nameLen - extLen, extension) == 0) {
+            char path[CATALOG_PATH_LEN];
+            snprintf(path, sizeof(path), "%s/%s", dirname, name);
+            CatalogEntry *e = push_entry(path);
+            if(!e) {
+                return false;
+            }
+            time_t mtime = file.getLastWrite();
+            time_t start = parseTimestampFromPath(name);
+            e->start = (uint32_t)(start > 0 ? start : mtime);
+            e->end = (uint32_t)(mtime > start ? mtime : start);
+            e->size = file.size();
+            e->type = type;
+        }
+        file = root.openNextFile();
+    }
+    return true;
+}
+
+/**
+ * @brief 扫描目录及其日期子目录加入内存条目 / Scan a directory and its date directories into in-memory entries
+ * @return bool 成功返回true / Returns true on success
+ */
+static bool scan_dir(const char *dirname, uint8_t type, const char *extension) {
+    // 根目录中是旧版平铺存放的文件 / The root holds legacy flat files
+    if(!scan_files_in(dirname, type, extension)) {
+        return false;
+    }
+    uint32_t date = 0;
+    while((date = findDateDir(dirname, date, false)) != 0) {
+        char dateDir[48];
+        dateDirPath(dirname, date, dateDir, sizeof(dateDir));
+        if(!scan_files_in(dateDir, type, extension)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief 按开始时间排序的比较函数 / Comparison by start time
+ */
+static int compare_entries(const void *a, const void *b) {
+    const CatalogEntry *ea = (const CatalogEntry*)a;
+    const CatalogEntry *eb = (const CatalogEntry*)b;
+    if(ea->start != eb->start) {
+        return ea->start < eb->start ? -1 : 1;
+    }
+    return strcmp(ea->path, eb->path);
+}
+
+/**
+ * @brief 从目录扫描重建索引（调用方持有锁）/ Rebuild the catalog from a directory scan (caller holds the lock)
+ * @return bool 成功返回true / Returns true on success
+ */
+static bool rebuild_catalog(void) {
+    uint32_t t0 = millis();
+    reset_entries();
+    if(!scan_dir(VIDEO_DIR, CATALOG_TYPE_VIDEO, ".avi") || !scan_dir(PHOTO_DIR, CATALOG_TYPE_PHOTO, ".jpg") ||
+       !scan_dir(PHOTO_DIR, CATALOG_TYPE_PHOTO, PHOTO_PACK_EXT) ||
+       !scan_files_in(CLIP_DIR, CATALOG_TYPE_CLIP, ".avi")) {
+        return false;
+    }
+    qsort(catalogEntries, catalogEntryCount, sizeof(CatalogEntry), compare_entries);
+    bool ok = write_catalog_file();
+    Serial.printf("Catalog rebuilt: %lu file(s) in %lu ms / 索引已重建\n", (unsigned long)catalogEntryCount, (unsigned long)(millis() - t0));
+    return ok;
+}
+
+/**
+ * @brief 读取并重放索引文件（调用方持有锁）/ Read and replay the catalog file (caller holds the lock)
+ * @details 追加时断电只会损坏最后一条记录：尾部不足一条的字节和从第一条CRC错误记录起的尾部被截断，索引照常使用
+ *          A power loss while appending only damages the last record: a partial tail and everything from the first bad-CRC record on are cut off and the catalog is used as usual
+ * @return bool 文件有效返回true，文件头无效或中间有损坏记录返回false / Returns true if the file is valid, false for a bad header or damage in the middle
+ */
+static bool load_catalog(void) {
+    if(!SD_MMC.exists(CATALOG_FILE)) {
+        return false;
+    }
+    File file = SD_MMC.open(CATALOG_FILE, FILE_READ);
+    if(!file) {
+        return false;
+    }
+    CatalogFileHeader header;
+    size_t fileSize = file.size();
+    catalogFileBytes = fileSize;
+    if(fileSize < sizeof(header) || file.read((uint8_t*)&header, sizeof(header)) != sizeof(header) ||
+       header.magic != CATALOG_MAGIC || header.version != CATALOG_VERSION || header.recordSize != sizeof(CatalogRecord)) {
+        file.close();
+        return false;
+    }
+
+    reset_entries();
+    CatalogRecord batch[16];
+    bool ok = true;
+    size_t records = (fileSize - sizeof(header)) / sizeof(CatalogRecord);
+    size_t goodRecords = records;       // 第一条损坏记录之前的记录数 / Records before the first damaged one
+    bool damaged = false;
+    for(size_t done = 0; ok && done < records; ) {
+        size_t n = records - done < 16 ? records - done : 16;
+        if(file.read((uint8_t*)batch, n * sizeof(CatalogRecord)) != n * sizeof(CatalogRecord)) {
+            ok = false;
+            break;
+        }
+        for(size_t i = 0; ok && i < n; i++) {
+            CatalogRecord *rec = &batch[i];
+            if(rec->magic != CATALOG_MAGIC || rec->crc != catalog_crc32((const uint8_t*)rec, offsetof(CatalogRecord, crc))) {
+                if(!damaged) {
+                    damaged = true;
+                    goodRecords = done + i;
+                }
+                continue;
+            }
+            if(damaged) {
+                // 损坏记录之后还有有效记录：不是断电留下的尾部，重建 / Valid records after a damaged one: not a torn tail, rebuild
+                ok = false;
+                break;
+            }
+            rec->path[CATALOG_PATH_LEN - 1] = '\0';
+            if(rec->op == CATALOG_OP_DELETE) {
+                CatalogEntry *e = find_entry(rec->path);
+                if(e) {
+                    kill_entry(e);
+                }
+                continue;
+            }
+            // 与catalog_add()相同按哈希表查整个索引，重复添加的路径只保留一条 / Look up the whole catalog through the hash table as catalog_add() does, so a path added twice keeps one entry
+            CatalogEntry *e = find_entry(rec->path);
+            if(!e) {
+                if(rec->op != CATALOG_OP_ADD || !(e = push_entry(rec->path))) {
+                    ok = false;
+                    break;
+                }
+            }
+            e->type = rec->type;
+            e->flags = rec->flags;
+            e->start = rec->start;
+            e->end = rec->end;
+            e->size = rec->size;
+        }
+        done += n;
+    }
+    file.close();
+    if(!ok) {
+        return false;
+    }
+
+    // 截断残缺的尾部，之后的追加接在最后一条有效记录后 / Cut off the torn tail so later appends follow the last good record
+    size_t goodBytes = sizeof(header) + goodRecords * sizeof(CatalogRecord);
+    if(goodBytes != fileSize) {
+        char fullPath[64];
+        snprintf(fullPath, sizeof(fullPath), "%s%s", SD_MOUNT_POINT, CATALOG_FILE);
+        if(truncate(fullPath, goodBytes) != 0) {
+            Serial.println("Failed to truncate catalog tail / 无法截断索引尾部");
+            return false;
+        }
+        Serial.printf("Catalog: dropped %lu torn byte(s) at the tail / 截断了索引尾部残缺的 %lu 字节\n",
+                      (unsigned long)(fileSize - goodBytes), (unsigned long)(fileSize - goodBytes));
+        sd_space_file_resized(fileSize, goodBytes);
+        catalogFileBytes = goodBytes;
+    }
+    return true;
+}
+
+/**
+ * @brief 加载或重建索引 / Load or rebuild the catalog
+ * @return bool 索引可用返回true / Returns true if the catalog is usable
+ */
+bool catalog_init(void) {
+    if(!catalogMutex) {
+        catalogMutex = xSemaphoreCreateMutex();
+    }
+    if(!catalogMutex) {
+        return false;
+    }
+    // 加载时截断尾部、重建时写文件，先取总线 / Loading may truncate the tail and rebuilding writes the file, so take the bus first
+    catalog_lock_io();
+    catalogLoads++;
+    uint32_t t0 = millis();
+    catalogReady = load_catalog();
+    if(catalogReady) {
+        Serial.printf("Catalog loaded: %lu file(s) in %lu ms / 索引已加载\n",
+                      (unsigned long)(catalogEntryCount - catalogDeadCount), (unsigned long)(millis() - t0));
+    } else {
+        Serial.println("Catalog missing or corrupt, rebuilding from directory scan / 索引缺失或损坏，扫描目录重建");
+        catalogReady = rebuild_catalog();
+    }
+    if(catalogReady) {
+        recount_type_bytes();
+    }
+    catalog_unlock_io();
+    return catalogReady;
+}
+
+/**
+ * @brief 添加文件 / Add a file
+ */
+void catalog_add(const char *path, uint8_t type, uint32_t start, uint32_t end, uint32_t size, uint16_t flags) {
+    if(!catalogMutex || strlen(path) >= CATALOG_PATH_LEN) {
+        return;
+    }
+    catalog_lock_io();
+    if(catalogReady) {
+        CatalogEntry *e = find_entry(path);
+        if(!e) {
+            e = push_entry(path);
+        }
+        if(e) {
+            count_entry(e, false);
+            e->type = type;
+            e->start = start;
+            e->end = end;
+            e->size = size;
+            e->flags = flags;
+            count_entry(e, true);
+            append_record(CATALOG_OP_ADD, e);
+        } else {
+            catalogReady = false;
+            remove_catalog_file();
+        }
+    }
+    catalog_unlock_io();
+}
+
+/**
+ * @brief 更新文件 / Update a file
+ */
+void catalog_update(const char *path, uint32_t end, uint32_t size, uint16_t flags) {
+    if(!catalogMutex) {
+        return;
+    }
+    catalog_lock_io();
+    CatalogEntry *e = catalogReady ? find_entry(path) : NULL;
+    if(e) {
+        count_entry(e, false);
+        if(end) {
+            e->end = end;
+        }
+        e->size = size;
+        e->flags = flags;
+        count_entry(e, true);
+        append_record(CATALOG_OP_UPDATE, e);
+    }
+    catalog_unlock_io();
+}
+
+/**
+ * @brief 删除文件记录 / Remove a file record
+ */
+void catalog_remove(const char *path) {
+    if(!catalogMutex) {
+        return;
+    }
+    catalog_lock_io();
+    CatalogEntry *e = catalogReady ? find_entry(path) : NULL;
+    bool compact = false;
+    if(e) {
+        append_record(CATALOG_OP_DELETE, e);
+        count_entry(e, false);
+        kill_entry(e);
+        // 删除记录过多时压缩 / Compact once deleted records pile up
+        compact = catalogReady && !catalogCompacting && catalogDeadCount >= CATALOG_COMPACT_MIN_DEAD &&
+                  catalogDeadCount * 2 > catalogEntryCount;
+    }
+    catalog_unlock_io();
+
+    // 压缩在锁外写临时文件，不阻塞录像任务和查询 / Compaction writes the temp file outside the lock and blocks neither the recorder nor queries
+    if(compact) {
+        compact_catalog();
+    }
+}
+
+/**
+ * @brief 查询目录下与时间段重叠的文件 / Query files in a directory overlapping a time range
+ * @return int 文件数量，索引不可用返回-1 / Number of files, -1 if the catalog is unusable
+ */
+int catalog_query(const char *dirname, uint32_t start, uint32_t end, uint16_t excludeFlags, FileInfo *files, int maxFiles) {
+    if(!catalogMutex || !catalog_covers(dirname)) {
+        return -1;
+    }
+    size_t dirLen = strlen(dirname);
+    xSemaphoreTake(catalogMutex, portMAX_DELAY);
+    if(!catalogReady) {
+        xSemaphoreGive(catalogMutex);
+        return -1;
+    }
+    int num = 0;
+    for(uint32_t i = catalogFirstLive; i < catalogEntryCount && num < maxFiles; i++) {
+        const CatalogEntry *e = &catalogEntries[i];
+        if(e->dead || strncmp(e->path, dirname, dirLen) != 0 || e->path[dirLen] != '/') {
+            continue;
+        }
+        if(e->end < start || e->start > end || (e->flags & excludeFlags)) {
+            continue;
+        }
+        entry_to_file_info(e, &files[num++]);
+    }
+    xSemaphoreGive(catalogMutex);
+    return num;
+}
+
+/**
+ * @brief 分页列出目录下的文件 / List the files in a directory page by page
+ * @return int 文件数量，索引不可用返回-1 / Number of files, -1 if the catalog is unusable
+ */
+int catalog_list(const char *dirname, const char *afterPath, uint32_t afterTime, bool newestFirst, uint16_t excludeFlags,
+                 FileInfo *files, int maxFiles) {
+    if(!catalogMutex || !catalog_covers(dirname)) {
+        return -1;
+    }
+    size_t dirLen = strlen(dirname);
+    xSemaphoreTake(catalogMutex, portMAX_DELAY);
+    if(!catalogReady) {
+        xSemaphoreGive(catalogMutex);
+        return -1;
+    }
+    uint32_t count = catalogEntryCount - catalogFirstLive;
+    uint32_t k = 0;
+    bool byTime = false;
+    if(afterPath && afterPath[0]) {
+        // 从游标文件的下一个开始；游标文件已删除时跳过时间不晚于（或不早于）它的文件
+        // Start after the cursor file; once it is gone, skip files whose time is not past it
+        CatalogEntry *cursor = find_entry(afterPath);
+        if(cursor) {
+            uint32_t pos = cursor - catalogEntries;
+            k = newestFirst ? catalogEntryCount - pos : pos - catalogFirstLive + 1;
+        } else {
+            byTime = true;
+        }
+    }
+    int num = 0;
+    for(; k < count && num < maxFiles; k++) {
+        uint32_t i = newestFirst ? catalogEntryCount - 1 - k : catalogFirstLive + k;
+        const CatalogEntry *e = &catalogEntries[i];
+        if(e->dead || strncmp(e->path, dirname, dirLen) != 0 || e->path[dirLen] != '/' || (e->flags & excludeFlags)) {
+            continue;
+        }
+        if(byTime && (newestFirst ? e->end >= afterTime : e->end <= afterTime)) {
+            continue;
+        }
+        entry_to_file_info(e, &files[num++]);
+    }
+    xSemaphoreGive(catalogMutex);
+    return num;
+}
+
+/**
+ * @brief 统计目录下的文件数 / Count the files in a directory
+ * @return int 文件数量，索引不可用返回-1 / Number of files, -1 if the catalog is unusable
+ */
+int catalog_count(const char *dirname) {
+    if(!catalogMutex || !catalog_covers(dirname)) {
+        return -1;
+    }
+    size_t dirLen = strlen(dirname);
+    xSemaphoreTake(catalogMutex, portMAX_DELAY);
+    int num = -1;
+    if(catalogReady) {
+        num = 0;
+        for(uint32_t i = catalogFirstLive; i < catalogEntryCount; i++) {
+            const CatalogEntry *e = &catalogEntries[i];
+            if(!e->dead && strncmp(e->path, dirname, dirLen) == 0 && e->path[dirLen] == '/') {
+                num++;
+            }
+        }
+    }
+    xSemaphoreGive(catalogMutex);
+    return num;
+}
+
+/**
+ * @brief 计算一批要删除的文件 / Plan one batch of files to delete
+ * @return int 文件数量，索引不可用返回-1 / Number of files, -1 if the catalog is unusable
+ */
+int catalog_plan_cleanup(const CatalogCleanupRules *rules, FileInfo *files, int maxFiles) {
+    if(!catalogMutex || maxFiles < 1) {
+        return -1;
+    }
+    // 为剩余空间删除的候选（索引下标），每种类型最多maxFiles个 / Candidates for free space (entry indexes), at most maxFiles per type
+    uint32_t *candidates = (uint32_t*)malloc(CATALOG_NUM_TYPES * maxFiles * sizeof(uint32_t));
+    if(!candidates) {
+        return -1;
+    }
+    int candidateCount[CATALOG_NUM_TYPES] = {0};
+    uint64_t candidateBytes[CATALOG_NUM_TYPES] = {0};
+    bool needType[CATALOG_NUM_TYPES] = {false};
+    for(int k = 0; k < CATALOG_NUM_TYPES && rules->needOrder[k]; k++) {
+        if(rules->needOrder[k] <= CATALOG_NUM_TYPES) {
+            needType[rules->needOrder[k] - 1] = true;
+        }
+    }
+
+    xSemaphoreTake(catalogMutex, portMAX_DELAY);
+    if(!catalogReady) {
+        xSemaphoreGive(catalogMutex);
+        free(candidates);
+        return -1;
+    }
+    uint64_t excess[CATALOG_NUM_TYPES];
+    for(int t = 0; t < CATALOG_NUM_TYPES; t++) {
+        excess[t] = rules->quotaBytes[t] && catalogTypeBytes[t] > rules->quotaBytes[t] ? catalogTypeBytes[t] - rules->quotaBytes[t] : 0;
+    }
+    uint64_t need = rules->needBytes;
+    int num = 0;
+
+    // 从最旧的开始遍历一次 / One walk, oldest first
+    for(uint32_t i = catalogFirstLive; i < catalogEntryCount && num < maxFiles; i++) {
+        const CatalogEntry *e = &catalogEntries[i];
+        if(e->dead || (e->flags & CATALOG_FLAG_OPEN) || e->type < 1 || e->type > CATALOG_NUM_TYPES) {
+            continue;
+        }
+        if(rules->keepAfter && e->end >= rules->keepAfter) {
+            continue;
+        }
+        int t = e->type - 1;
+        bool expired = rules->expireBefore[t] && e->end < rules->expireBefore[t];
+        if(!expired && excess[t] == 0 && !(need > 0 && needType[t] && candidateBytes[t] < need && candidateCount[t] < maxFiles)) {
+            continue;
+        }
+        if(e->type == CATALOG_TYPE_VIDEO && bookmark_is_segment_protected(e->path)) {
+            continue;
+        }
+        if(expired || excess[t] > 0) {
+            entry_to_file_info(e, &files[num++]);
+            excess[t] -= excess[t] < e->size ? excess[t] : e->size;
+            need -= need < e->size ? need : e->size;
+        } else {
+            candidates[t * maxFiles + candidateCount[t]++] = i;
+            candidateBytes[t] += e->size;
+        }
+    }
+
+    // 剩余空间仍不足时按类型先后补足 / Fill the remaining free space need in type order
+    for(int k = 0; k < CATALOG_NUM_TYPES && rules->needOrder[k] && need > 0; k++) {
+        int t = rules->needOrder[k] - 1;
+        if(t < 0 || t >= CATALOG_NUM_TYPES) {
+            continue;
+        }
+        for(int c = 0; c < candidateCount[t] && need > 0 && num < maxFiles; c++) {
+            const CatalogEntry *e = &catalogEntries[candidates[t * maxFiles + c]];
+            entry_to_file_info(e, &files[num++]);
+            need -= need < e->size ? need : e->size;
+        }
+    }
+    xSemaphoreGive(catalogMutex);
+    free(candidates);
+    return num;
+}
+
+/**
+ * @brief 获取某类型文件的总字节数 / Get the total bytes of one file type
+ * @return uint64_t 字节数，索引不可用返回0 / Bytes, 0 if the catalog is unusable
+ */
+uint64_t catalog_type_bytes(uint8_t type) {
+    if(!catalogMutex || type < 1 || type > CATALOG_NUM_TYPES) {
+        return 0;
+    }
+    xSemaphoreTake(catalogMutex, portMAX_DELAY);
+    uint64_t bytes = catalogReady ? catalogTypeBytes[type - 1] : 0;
+    xSemaphoreGive(catalogMutex);
+    return bytes;
+}
@@ -0,0 +1,174 @@
+/**********************************************************************
+  文件名称 / Filename : catalog.h
+  文件用途 / File Purpose : 录像目录索引头文件 / Recording Catalog Header File
+               声明了SD卡上只追加的录像/照片目录索引相关的函数原型和宏定义
+               Declares function prototypes and macro definitions for the append-only recording/photo catalog on the SD card
+  作者 / Author : ESP32-S3监控项目 / ESP32-S3 Monitoring Project
+  修改日期 / Modification Date : 2026-02-05
+  硬件平台 / Hardware Platform : ESP32S3-EYE开发板 / ESP32S3-EYE Development Board
+  依赖库 / Dependencies : Arduino.h - Arduino核心库 / Arduino Core Library
+               sd_read_write.h - FileInfo结构与目录定义 / FileInfo structure and directory definitions
+  使用说明 / Usage Instructions : 1. 包含本头文件 #include "catalog.h" / Include this header file
+               2. SD卡初始化后调用catalog_init()加载或重建索引 / Call catalog_init() after SD card init to load or rebuild the catalog
+               3. 文件完成/删除时调用catalog_add()/catalog_update()/catalog_remove() / Call catalog_add()/catalog_update()/catalog_remove() when files are finalised/deleted
+               4. 调用catalog_query()代替目录扫描，catalog_list()分页列出 / Call catalog_query() instead of scanning directories, catalog_list() to list page by page
+               5. 调用catalog_plan_cleanup()计算清理集合 / Call catalog_plan_cleanup() to plan cleanup
+  参数调整 / Parameter Adjustment : CATALOG_COMPACT_MIN_DEAD - 触发压缩的最少删除记录数（默认256）/ Minimum deleted records before compaction (default 256)
+  注意事项 / Important Notes : 每条记录80字节，带CRC32；尾部残缺或校验失败的记录在加载时截断，文件缺失、文件头无效或中间记录损坏时从目录扫描重建
+                  Each record is 80 bytes with a CRC32; a partial or failing tail is truncated at load, the catalog is rebuilt from a directory scan if the file is missing, its header is bad or a record in the middle is damaged
+               只覆盖VIDEO_DIR、PHOTO_DIR和CLIP_DIR，其他目录仍按目录扫描 / Only VIDEO_DIR, PHOTO_DIR and CLIP_DIR are covered, other directories are still scanned
+               记录在文件中按时间先后排列，查询结果最旧的在前 / Records are in time order, query results come oldest first
+**********************************************************************/
+
+#ifndef __CATALOG_H
+#define __CATALOG_H
+
+#include "Arduino.h"
+#include "sd_read_write.h"
+
+// 索引文件路径 / Catalog file path
+#define CATALOG_FILE "/camera/catalog.dat"
+
+// 文件头和记录标识 / File header and record magic
+#define CATALOG_MAGIC 0x314C5443  // 'CTL1'
+#define CATALOG_VERSION 1
+
+// 记录中路径的最大长度（含结束符）/ Maximum path length in a record (including terminator)
+#define CATALOG_PATH_LEN 56
+
+// 删除记录超过此数量且多于有效记录时压缩文件 / Compact once deleted records exceed this and outnumber live ones
+#define CATALOG_COMPACT_MIN_DEAD 256
+
+// 内存索引增长步长 / In-memory index growth step
+#define CATALOG_GROW_STEP 1024
+
+// 文件类型 / File types
+#define CATALOG_TYPE_VIDEO 1
+#define CATALOG_TYPE_PHOTO 2
+#define CATALOG_TYPE_CLIP 3
+#define CATALOG_NUM_TYPES 3
+
+// 文件标志 / File flags
+#define CATALOG_FLAG_OPEN 0x0001      // 正在录制，尚未完成 / Being recorded, not finalised yet
+#define CATALOG_FLAG_REQUANT 0x0002   // 已重量化压缩 / Requantized
+
+// 记录操作 / Record operations
+#define CATALOG_OP_ADD 1
+#define CATALOG_OP_UPDATE 2
+#define CATALOG_OP_DELETE 3
+
+// 索引记录（定长80字节）/ Catalog record (fixed 80 bytes)
+typedef struct {
+    uint32_t magic;                     // 记录标识 / Record magic
+    uint8_t op;                         // 操作 / Operation
+    uint8_t type;                       // 文件类型 / File type
+    uint16_t flags;                     // 文件标志 / File flags
+    uint32_t start;                     // 开始时间（Unix时间戳）/ Start time (Unix timestamp)
+    uint32_t end;                       // 结束时间（Unix时间戳）/ End time (Unix timestamp)
+    uint32_t size;                      // 文件大小（字节）/ File size (bytes)
+    char path[CATALOG_PATH_LEN];        // 文件路径 / File path
+    uint32_t crc;                       // 前面所有字节的CRC32 / CRC32 of all preceding bytes
+} CatalogRecord;
+
+// 清理规则（数组下标为文件类型-1）/ Cleanup rules (arrays are indexed by file type - 1)
+typedef struct {
+    uint64_t quotaBytes[CATALOG_NUM_TYPES];     // 各类型配额，0表示不限 / Per-type quota, 0 for no limit
+    uint32_t expireBefore[CATALOG_NUM_TYPES];   // 结束时间早于此值的文件过期，0表示不过期 / Files ending before this expire, 0 for never
+    uint32_t keepAfter;                         // 结束时间不早于此值的文件总是保留，0表示不限 / Files ending at or after this are always kept, 0 for no limit
+    uint64_t needBytes;                         // 为剩余空间还需释放的字节数 / Bytes still to free for free space
+    uint8_t needOrder[CATALOG_NUM_TYPES];       // 可为剩余空间删除的类型，按先后顺序，0结束 / Types that may be deleted for free space, in order, 0 terminated
+} CatalogCleanupRules;
+
+/**
+ * @brief 加载或重建索引 / Load or rebuild the catalog
+ * @return bool 索引可用返回true / Returns true if the catalog is usable
+ * @details 功能说明 / Function Description:
+ *          1. 读取索引文件，逐条校验CRC并重放 / Read the catalog file, check every CRC and replay the records
+ *          2. 文件缺失或损坏时扫描VIDEO_DIR、PHOTO_DIR（含日期目录）和CLIP_DIR重建 / Rebuild from VIDEO_DIR, PHOTO_DIR (including the date directories) and CLIP_DIR if it is missing or corrupt
+ * @note 索引不可用时catalog_query()返回-1，调用方回退到目录扫描 / When unusable catalog_query() returns -1 and callers fall back to directory scans
+ */
+bool catalog_init(void);
+
+/**
+ * @brief 添加文件 / Add a file
+ * @param path 文件路径 / File path
+ * @param type 文件类型 / File type
+ * @param start 开始时间 / Start time
+ * @param end 结束时间 / End time
+ * @param size 文件大小 / File size
+ * @param flags 文件标志 / File flags
+ */
+void catalog_add(const char *path, uint8_t type, uint32_t start, uint32_t end, uint32_t size, uint16_t flags);
+
+/**
+ * @brief 更新文件 / Update a file
+ * @param path 文件路径 / File path
+ * @param end 结束时间，0表示不变 / End time, 0 keeps the current one
+ * @param size 文件大小 / File size
+ * @param flags 文件标志 / File flags
+ */
+void catalog_update(const char *path, uint32_t end, uint32_t size, uint16_t flags);
+
+/**
+ * @brief 删除文件记录 / Remove a file record
+ * @param path 文件路径 / File path
+ */
+void catalog_remove(const char *path);
+
+/**
+ * @brief 查询目录下与时间段重叠的文件 / Query files in a directory overlapping a time range
+ * @param dirname 目录路径 / Directory path
+ * @param start 开始时间（0表示不限）/ Start time (0 for no limit)
+ * @param end 结束时间（UINT32_MAX表示不限）/ End time (UINT32_MAX for no limit)
+ * @param excludeFlags 带有任一这些标志的文件不返回 / Files carrying any of these flags are left out
+ * @param files 输出数组 / Output array
+ * @param maxFiles 数组容量 / Array capacity
+ * @return int 文件数量（最旧的在前），索引不可用或目录不在索引范围内返回-1 / Number of files (oldest first), -1 if the catalog is unusable or does not cover the directory
+ * @note FileInfo.mtime填入结束时间 / FileInfo.mtime carries the end time
+ */
+int catalog_query(const char *dirname, uint32_t start, uint32_t end, uint16_t excludeFlags, FileInfo *files, int maxFiles);
+
+/**
+ * @brief 分页列出目录下的文件 / List the files in a directory page by page
+ * @param dirname 目录路径 / Directory path
+ * @param afterPath 上一页最后一个文件的路径，NULL或空串从头开始 / Path of the last file on the previous page, NULL or empty to start from the beginning
+ * @param afterTime 上一页最后一个文件的mtime，该文件已被删除时按时间续接 / mtime of the last file on the previous page, used to carry on by time once that file is gone
+ * @param newestFirst true最新的在前，false最旧的在前 / true for newest first, false for oldest first
+ * @param excludeFlags 带有任一这些标志的文件不返回 / Files carrying any of these flags are left out
+ * @param files 输出数组 / Output array
+ * @param maxFiles 数组容量 / Array capacity
+ * @return int 文件数量，索引不可用或目录不在索引范围内返回-1 / Number of files, -1 if the catalog is unusable or does not cover the directory
+ * @note 游标是文件路径而不是序号，压缩或删除不会让分页跳过或重复文件 / The cursor is a path rather than a position, so compaction and deletes never make pages skip or repeat files
+ */
+int catalog_list(const char *dirname, const char *afterPath, uint32_t afterTime, bool newestFirst, uint16_t excludeFlags,
+                 FileInfo *files, int maxFiles);
+
+/**
+ * @brief 统计目录下的文件数 / Count the files in a directory
+ * @param dirname 目录路径 / Directory path
+ * @return int 文件数量，索引不可用或目录不在索引范围内返回-1 / Number of files, -1 if the catalog is unusable or does not cover the directory
+ */
+int catalog_count(const char *dirname);
+
+/**
+ * @brief 计算一批要删除的文件 / Plan one batch of files to delete
+ * @param rules 清理规则 / Cleanup rules
+ * @param files 输出数组 / Output array
+ * @param maxFiles 数组容量 / Array capacity
+ * @return int 文件数量，索引不可用返回-1 / Number of files, -1 if the catalog is unusable
+ * @details 功能说明 / Function Description:
+ *          1. 从最旧的开始遍历一次索引 / Walk the catalog once, oldest first
+ *          2. 过期或所属类型超出配额的文件直接选中 / Files that expired or whose type is over quota are selected right away
+ *          3. 其余文件按类型记为候选，遍历结束后按needOrder补足needBytes / The rest are noted as candidates per type and fill needBytes in needOrder once the walk ends
+ * @note 正在录制、keepAfter之后和书签保护的文件不会选中 / Files being recorded, after keepAfter or protected by a bookmark are never selected
+ */
+int catalog_plan_cleanup(const CatalogCleanupRules *rules, FileInfo *files, int maxFiles);
+
+/**
+ * @brief 获取某类型文件的总字节数 / Get the total bytes of one file type
+ * @param type 文件类型 / File type
+ * @return uint64_t 字节数，索引不可用返回0 / Bytes, 0 if the catalog is unusable
+ */
+uint64_t catalog_type_bytes(uint8_t type);
+
+#endif // __CATALOG_H
@@ -0,0 +1,301 @@
+/**********************************************************************
+  文件名称 / Filename : file_download.cpp
+  文件用途 / File Purpose : 文件下载实现文件 / File Download Implementation File
+               本文件实现了每个下载一个发送任务的文件下载
+               This file implements file downloads with one sender task per download
+               主要功能包括 / Main Features:
+               1. Range请求头解析和206/416响应 / Range header parsing and 206/416 responses
+               2. 大块批量读取，录像写入优先 / Large bulk reads with recording writes first
+               3. 响应头和第一块数据一次writev()发出 / Response head and the first block go out in one writev()
+  作者 / Author : ESP32-S3监控项目 / ESP32-S3 Monitoring Project
+  修改日期 / Modification Date : 2026-02-05
+  硬件平台 / Hardware Platform : ESP32S3-EYE开发板 / ESP32S3-EYE Development Board
+  依赖库 / Dependencies : SD_MMC.h - SD卡文件系统 / SD card file system
+               sd_io.h - 批量读取 / Bulk reads
+               stream_clients.h - stream_send_iov()
+  使用说明 / Usage Instructions : 1. 调用file_download_init()初始化 / Call file_download_init() to initialise
+  注意事项 / Important Notes : 发送任务结束时调用httpd_req_async_handler_complete()把连接交还服务器，发送失败时关闭连接
+                  The sender task hands the connection back with httpd_req_async_handler_complete() when it ends, and closes it when sending failed
+**********************************************************************/
+
+#include "file_download.h"
+#include "SD_MMC.h"
+#include "sd_io.h"
+#include "stream_clients.h"
+
+// 下载位置 / Download slot
+typedef struct {
+    bool used;                          // 是否占用 / Whether taken
+    httpd_req_t *req;                   // 异步请求 / Asynchronous request
+    File file;                          // 已定位到范围开头的文件 / File positioned at the start of the range
+    uint8_t *buf;                       // 读缓冲 / Read buffer
+    uint64_t length;                    // 要发送的字节数 / Bytes to send
+    char head[320];                     // 响应头 / Response head
+    size_t headLen;                     // 响应头长度 / Response head length
+} FileDownload;
+
+static FileDownload downloads[FILE_DOWNLOAD_MAX_CLIENTS];
+static FileDownloadStats downloadStats;
+static portMUX_TYPE downloadsMux = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief 释放下载位置 / Free a download slot
+ */
+static void release_slot(FileDownload *dl) {
+    if(dl->file) {
+        dl->file.close();
+    }
+    free(dl->buf);
+    dl->buf = NULL;
+    portENTER_CRITICAL(&downloadsMux);
+    dl->used = false;
+    portEXIT_CRITICAL(&downloadsMux);
+}
+
+/**
+ * @brief 解析Range请求头 / Parse a Range header
+ * @param value 请求头的值 / Header value
+ * @param size 文件大小 / File size
+ * @param first 输出范围第一个字节 / Output first byte of the range
+ * @param last 输出范围最后一个字节 / Output last byte of the range
+ * @return int 1为有效范围，0为忽略（返回整个文件），-1为无法满足（416）/ 1 for a valid range, 0 to ignore it (whole file), -1 when it cannot be satisfied (416)
+ */
+static int parse_range(const char *value, uint64_t size, uint64_t *first, uint64_t *last) {
+    if(strncmp(value, "bytes=", 6) != 0 || strchr(value, ',')) {
+        return 0;
+    }
+    const char *p = value + 6;
+    char *q;
+    if(*p == '-') {
+        // 最后n个字节 / The last n bytes
+        if(!isdigit((unsigned char)p[1])) {
+            return 0;
+        }
+        uint64_t n = strtoull(p + 1, &q, 10);
+        if(*q) {
+            return 0;
+        }
+        if(n == 0 || size == 0) {
+            return -1;
+        }
+        *first = n >= size ? 0 : size - n;
+        *last = size - 1;
+        return 1;
+    }
+    if(!isdigit((unsigned char)*p)) {
+        return 0;
+    }
+    uint64_t a = strtoull(p, &q, 10);
+    if(*q != '-') {
+        return 0;
+    }
+    uint64_t b = UINT64_MAX;
+    if(q[1]) {
+        if(!isdigit((unsigned char)q[1])) {
+            return 0;
+        }
+        b = strtoull(q + 1, &q, 10);
+        if(*q || b < a) {
+            return 0;
+        }
+    }
+    if(a >= size) {
+        return -1;
+    }
+    *first = a;
+    *last = b < size ? b : size - 1;
+    return 1;
+}
+
+/**
+ * @brief 按扩展名取内容类型 / Content type from the file extension
+ */
+static const char *content_type(const char *path) {
+    const char *ext = strrchr(path, '.');
+    if(ext && strcasecmp(ext, ".avi") == 0) {
+        return "video/x-msvideo";
+    }
+    if(ext && (strcasecmp(ext, ".jpg") == 0 || strcasecmp(ext, ".jpeg") == 0)) {
+        return "image/jpeg";
+    }
+    return "application/octet-stream";
+}
+
+/**
+ * @brief 发送任务 / Sender task
+ * @param pvParameters 下载位置 / Download slot
+ */
+static void file_download_task(void *pvParameters) {
+    FileDownload *dl = (FileDownload*)pvParameters;
+    httpd_req_t *req = dl->req;
+    int fd = httpd_req_to_sockfd(req);
+    uint64_t left = dl->length;
+    uint64_t sent = 0;
+    uint32_t startMs = millis();
+    bool headSent = false;
+    esp_err_t res = ESP_OK;
+
+    // 读一块发一块，响应头随第一块一起发出 / Read a block, send a block; the head goes out with the first one
+    while(res == ESP_OK && (left > 0 || !headSent)) {
+        size_t want = left < FILE_DOWNLOAD_BUF_SIZE ? (size_t)left : FILE_DOWNLOAD_BUF_SIZE;
+        if(want && sd_io_read(dl->file, dl->buf, want, SD_IO_BULK) != want) {
+            Serial.printf("Download read failed at byte %llu / 下载读取失败\n", (unsigned long long)sent);
+            res = ESP_FAIL;
+            break;
+        }
+        struct iovec iov[2];
+        int count = 0;
+        if(!headSent) {
+            iov[count].iov_base = dl->head;
+            iov[count].iov_len = dl->headLen;
+            count++;
+        }
+        if(want) {
+            iov[count].iov_base = dl->buf;
+            iov[count].iov_len = want;
+            count++;
+        }
+        uint32_t writes = 0;
+        res = stream_send_iov(fd, iov, count, &writes);
+        if(res == ESP_OK) {
+            headSent = true;
+            left -= want;
+            sent += want;
+        }
+    }
+
+    uint32_t elapsedMs = millis() - startMs;
+    portENTER_CRITICAL(&downloadsMux);
+    downloadStats.bytes += sent;
+    if(res == ESP_OK) {
+        downloadStats.completed++;
+        downloadStats.lastKBps = elapsedMs ? (uint32_t)(sent * 1000 / elapsedMs / 1024) : 0;
+    } else {
+        downloadStats.failed++;
+    }
+    portEXIT_CRITICAL(&downloadsMux);
+    if(res == ESP_OK) {
+        Serial.printf("Download done: %llu KB in %lu ms / 下载完成\n", (unsigned long long)(sent / 1024), (unsigned long)elapsedMs);
+    }
+
+    // 响应完整时连接可以继续使用，否则关闭 / The connection can be reused after a complete response, otherwise it is closed
+    httpd_handle_t server = req->handle;
+    httpd_req_async_handler_complete(req);
+    if(res != ESP_OK) {
+        httpd_sess_trigger_close(server, fd);
+    }
+    release_slot(dl);
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief 初始化文件下载 / Initialise file downloads
+ * @return bool 成功返回true / Returns true on success
+ */
+bool file_download_init(void) {
+    for(int i = 0; i < FILE_DOWNLOAD_MAX_CLIENTS; i++) {
+        downloads[i].used = false;
+        downloads[i].req = NULL;
+        downloads[i].buf = NULL;
+    }
+    memset(&downloadStats, 0, sizeof(downloadStats));
+    return true;
+}
+
+/**
+ * @brief 开始下载文件 / Start downloading a file
+ * @return esp_err_t 成功返回ESP_OK，下载数已满返回ESP_ERR_NO_MEM / ESP_OK on success, ESP_ERR_NO_MEM when all download slots are taken
+ */
+esp_err_t file_download_start(httpd_req_t *req, const char *path) {
+    // 占用下载位置 / Take a download slot
+    FileDownload *dl = NULL;
+    portENTER_CRITICAL(&downloadsMux);
+    for(int i = 0; i < FILE_DOWNLOAD_MAX_CLIENTS; i++) {
+        if(!downloads[i].used) {
+            dl = &downloads[i];
+            dl->used = true;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&downloadsMux);
+    if(!dl) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    dl->file = SD_MMC.open(path, FILE_READ);
+    if(!dl->file || dl->file.isDirectory()) {
+        release_slot(dl);
+        return httpd_resp_send_404(req);
+    }
+    uint64_t size = dl->file.size();
+
+    // 单个范围 / Single range
+    uint64_t first = 0;
+    uint64_t last = size ? size - 1 : 0;
+    int ranged = 0;
+    char range[64];
+    if(httpd_req_get_hdr_value_str(req, "Range", range, sizeof(range)) == ESP_OK) {
+        ranged = parse_range(range, size, &first, &last);
+    }
+    if(ranged < 0) {
+        char contentRange[40];
+        snprintf(contentRange, sizeof(contentRange), "bytes */%llu", (unsigned long long)size);
+        release_slot(dl);
+        httpd_resp_set_status(req, "416 Range Not Satisfiable");
+        httpd_resp_set_hdr(req, "Content-Range", contentRange);
+        httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+        return httpd_resp_send(req, NULL, 0);
+    }
+    dl->length = size ? last - first + 1 : 0;
+
+    dl->buf = (uint8_t*)(psramFound() ? ps_malloc(FILE_DOWNLOAD_BUF_SIZE) : malloc(FILE_DOWNLOAD_BUF_SIZE));
+    if(!dl->buf || (first && !dl->file.seek(first))) {
+        release_slot(dl);
+        return httpd_resp_send_500(req);
+    }
+
+    const char *name = strrchr(path, '/');
+    char contentRange[64] = "";
+    if(ranged) {
+        snprintf(contentRange, sizeof(contentRange), "Content-Range: bytes %llu-%llu/%llu\r\n",
+                 (unsigned long long)first, (unsigned long long)last, (unsigned long long)size);
+    }
+    dl->headLen = snprintf(dl->head, sizeof(dl->head),
+                           "HTTP/1.1 %s\r\nContent-Type: %s\r\nContent-Length: %llu\r\nAccept-Ranges: bytes\r\n%s"
+                           "Content-Disposition: inline; filename=\"%s\"\r\nAccess-Control-Allow-Origin: *\r\n"
+                           "Access-Control-Expose-Headers: Content-Range, Content-Length\r\n\r\n",
+                           ranged ? "206 Partial Content" : "200 OK", content_type(path), (unsigned long long)dl->length,
+                           contentRange, name ? name + 1 : path);
+
+    if(httpd_req_async_handler_begin(req, &dl->req) != ESP_OK) {
+        release_slot(dl);
+        return ESP_FAIL;
+    }
+    if(xTaskCreatePinnedToCore(file_download_task, "file_download", FILE_DOWNLOAD_TASK_STACK, dl,
+                               FILE_DOWNLOAD_TASK_PRIORITY, NULL, FILE_DOWNLOAD_TASK_CORE) != pdPASS) {
+        httpd_req_async_handler_complete(dl->req);
+        release_slot(dl);
+        return ESP_ERR_NO_MEM;
+    }
+    if(ranged) {
+        portENTER_CRITICAL(&downloadsMux);
+        downloadStats.ranges++;
+        portEXIT_CRITICAL(&downloadsMux);
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief 获取下载统计 / Get the download statistics
+ */
+void file_download_get_stats(FileDownloadStats *stats) {
+    portENTER_CRITICAL(&downloadsMux);
+    *stats = downloadStats;
+    stats->active = 0;
+    for(int i = 0; i < FILE_DOWNLOAD_MAX_CLIENTS; i++) {
+        if(downloads[i].used) {
+            stats->active++;
+        }
+    }
+    portEXIT_CRITICAL(&downloadsMux);
+}
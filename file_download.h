@@ -0,0 +1,75 @@
+/**********************************************************************
+  文件名称 / Filename : file_download.h
+  文件用途 / File Purpose : 文件下载头文件 / File Download Header File
+               声明了通过HTTP下载录像和照片（支持Range断点续传和拖动播放）相关的函数原型和宏定义
+               Declares function prototypes and macro definitions for downloading recordings and photos over HTTP, with Range support for resuming and seeking
+  作者 / Author : ESP32-S3监控项目 / ESP32-S3 Monitoring Project
+  修改日期 / Modification Date : 2026-02-05
+  硬件平台 / Hardware Platform : ESP32S3-EYE开发板 / ESP32S3-EYE Development Board
+  依赖库 / Dependencies : esp_http_server.h - 异步请求 / Asynchronous requests
+               sd_io.h - 批量读取 / Bulk reads
+               stream_clients.h - 一次写出 / Single-write sending
+  使用说明 / Usage Instructions : 1. 包含本头文件 #include "file_download.h" / Include this header file
+               2. 处理函数验证认证和路径后调用file_download_start()并立即返回 / The handler checks authentication and the path, then calls file_download_start() and returns at once
+  参数调整 / Parameter Adjustment : FILE_DOWNLOAD_MAX_CLIENTS - 同时下载数上限（默认2）/ Maximum concurrent downloads (default 2)
+               FILE_DOWNLOAD_BUF_SIZE - 每个下载的读缓冲（默认32KB，优先放在PSRAM）/ Read buffer per download (default 32KB, PSRAM when present)
+  注意事项 / Important Notes : 只支持单个范围（bytes=a-b、bytes=a-、bytes=-n），多个范围时返回整个文件
+                  Only single ranges are supported (bytes=a-b, bytes=a-, bytes=-n), multiple ranges get the whole file
+               响应头自己写出并带Content-Length，不分块；发送完成后连接交还服务器，可以保持连接
+                  The response head is written here with Content-Length and no chunking; the connection goes back to the server afterwards and may be kept alive
+               读取按SD_IO_BULK类别排队，录像写入优先，录像期间下载速度受SD_IO_BULK_RATE_KBPS限制
+                  Reads queue as SD_IO_BULK so recording writes come first, downloads are held to SD_IO_BULK_RATE_KBPS while recording
+**********************************************************************/
+
+#ifndef __FILE_DOWNLOAD_H
+#define __FILE_DOWNLOAD_H
+
+#include "Arduino.h"
+#include "esp_http_server.h"
+
+// 同时下载数上限 / Maximum concurrent downloads
+#define FILE_DOWNLOAD_MAX_CLIENTS 2
+
+// 每个下载的读缓冲大小（字节）/ Read buffer size per download (bytes)
+#define FILE_DOWNLOAD_BUF_SIZE (32 * 1024)
+
+// 发送任务配置（低于视频流，高于后台整理）/ Sender task configuration (below streaming, above background housekeeping)
+#define FILE_DOWNLOAD_TASK_STACK 4096
+#define FILE_DOWNLOAD_TASK_PRIORITY 2
+#define FILE_DOWNLOAD_TASK_CORE 0
+
+// 下载统计 / Download statistics
+typedef struct {
+    uint32_t active;                    // 正在下载数 / Downloads in progress
+    uint32_t completed;                 // 完成数 / Downloads completed
+    uint32_t failed;                    // 中断数（多为客户端取消或拖动）/ Downloads cut short (mostly clients cancelling or seeking)
+    uint32_t ranges;                    // 带Range的请求数 / Requests carrying a Range
+    uint64_t bytes;                     // 发送字节数 / Bytes sent
+    uint32_t lastKBps;                  // 最近一次完成的下载速度（KB/s）/ Speed of the last completed download (KB/s)
+} FileDownloadStats;
+
+/**
+ * @brief 初始化文件下载 / Initialise file downloads
+ * @return bool 成功返回true / Returns true on success
+ */
+bool file_download_init(void);
+
+/**
+ * @brief 开始下载文件 / Start downloading a file
+ * @param req 请求 / Request
+ * @param path 文件路径（调用方已检查）/ File path (already checked by the caller)
+ * @return esp_err_t ESP_OK表示已开始发送或已回复404/416，ESP_ERR_NO_MEM表示下载数已满，由调用方回复503
+ *                   ESP_OK once sending has started or a 404/416 has been sent, ESP_ERR_NO_MEM when all download slots are taken and the caller answers 503
+ * @details 功能说明 / Function Description:
+ *          1. 打开文件，按Range请求头计算范围 / Open the file and work out the range from the Range header
+ *          2. 把请求交给发送任务，服务器随即可以处理其他请求 / Hand the request to a sender task, the server can handle other requests at once
+ */
+esp_err_t file_download_start(httpd_req_t *req, const char *path);
+
+/**
+ * @brief 获取下载统计 / Get the download statistics
+ * @param stats 输出统计 / Output statistics
+ */
+void file_download_get_stats(FileDownloadStats *stats);
+
+#endif // __FILE_DOWNLOAD_H
@@ -0,0 +1,243 @@
+/**********************************************************************
+  文件名称 / Filename : frame_broker.cpp
+  文件用途 / File Purpose : 帧分发实现文件 / Frame Broker Implementation File
+               本文件实现了单一取帧任务和按引用计数的帧分发
+               This file implements the single capture task and reference-counted frame fan-out
+               主要功能包括 / Main Features:
+               1. 唯一调用esp_camera_fb_get()的取帧任务 / The one capture task that calls esp_camera_fb_get()
+               2. 帧引用计数，最后一个使用者释放时归还 / Frame reference counts, returned when the last consumer releases
+               3. 最新帧优先，慢的使用者跳帧 / Newest frame wins, slow consumers skip frames
+  作者 / Author : ESP32-S3监控项目 / ESP32-S3 Monitoring Project
+  修改日期 / Modification Date : 2026-02-05
+  硬件平台 / Hardware Platform : ESP32S3-EYE开发板 / ESP32S3-EYE Development Board
+  依赖库 / Dependencies : esp_camera.h - ESP32摄像头驱动 / ESP32 camera driver
+  使用说明 / Usage Instructions : 1. 调用frame_broker_init()启动取帧任务 / Call frame_broker_init() to start the capture task
+  注意事项 / Important Notes : 最新帧由分发器自己持有一个引用，被新帧替换时放开 / The broker holds one reference on the newest frame and drops it when a newer one replaces it
+               新帧通过事件组广播给所有等待的使用者 / New frames are broadcast to every waiting consumer through an event group
+               持有帧数达到上限时被拒绝的使用者按节拍轮询，释放后即可取得 / Consumers refused at the held-frame limit poll every tick so a release lets them in at once
+**********************************************************************/
+
+#include "frame_broker.h"
+#include "hires_snapshot.h"
+#include "freertos/event_groups.h"
+
+// 新帧事件位 / New frame event bit
+#define NEW_FRAME_BIT BIT0
+
+// 在用的帧 / Frame in use
+typedef struct {
+    camera_fb_t *fb;                    // 帧缓冲，NULL表示空位 / Frame buffer, NULL for a free slot
+    uint32_t seq;                       // 帧序号 / Sequence number
+    uint32_t refs;                      // 引用数 / Reference count
+} BrokerFrame;
+
+static BrokerFrame brokerFrames[FRAME_BROKER_MAX_FRAMES];
+static int latestSlot = -1;
+static uint32_t latestSeq = 0;
+static FrameBrokerStats brokerStats;
+static portMUX_TYPE brokerMux = portMUX_INITIALIZER_UNLOCKED;
+static EventGroupHandle_t brokerEvents = NULL;
+
+/**
+ * @brief 放开一个引用，归零时返回要归还的帧 / Drop one reference, returning the frame to give back when it reaches zero
+ * @note 在brokerMux内调用 / Called inside brokerMux
+ */
+static camera_fb_t* unref_locked(int slot) {
+    BrokerFrame *frame = &brokerFrames[slot];
+    if(--frame->refs > 0) {
+        return NULL;
+    }
+    camera_fb_t *fb = frame->fb;
+    frame->fb = NULL;
+    brokerStats.held--;
+    return fb;
+}
+
+/**
+ * @brief 能否发出未被共享的最新帧 / Whether an unshared newest frame may be handed out
+ * @note 在brokerMux内调用；发出后最新帧被替换时会多占一个缓冲 / Called inside brokerMux; once handed out it takes one more buffer when a newer frame replaces it
+ */
+static bool may_pin_locked(const FrameSubscriber *sub) {
+    uint32_t limit = brokerStats.heldLimit;
+    if(limit == 0) {
+        return true;
+    }
+    // 普通使用者给预留使用者留一个名额 / Ordinary consumers leave one place for reserved ones
+    return sub->reserved ? brokerStats.held < limit : brokerStats.held + 1 < limit;
+}
+
+/**
+ * @brief 发布新帧 / Publish a new frame
+ */
+static void publish(camera_fb_t *fb) {
+    camera_fb_t *done = NULL;
+    portENTER_CRITICAL(&brokerMux);
+    int slot = -1;
+    for(int i = 0; i < FRAME_BROKER_MAX_FRAMES; i++) {
+        if(!brokerFrames[i].fb) {
+            slot = i;
+            break;
+        }
+    }
+    if(slot >= 0) {
+        brokerFrames[slot].fb = fb;
+        brokerFrames[slot].seq = ++latestSeq;
+        brokerFrames[slot].refs = 1;
+        if(latestSlot >= 0) {
+            done = unref_locked(latestSlot);
+        }
+        latestSlot = slot;
+        brokerStats.published++;
+        brokerStats.held++;
+        if(brokerStats.held > brokerStats.heldMax) {
+            brokerStats.heldMax = brokerStats.held;
+        }
+    } else {
+        // 帧缓冲数不超过空位数，这里只做保护 / There are never more frame buffers than slots, this is only a safeguard
+        done = fb;
+    }
+    portEXIT_CRITICAL(&brokerMux);
+    if(done) {
+        esp_camera_fb_return(done);
+    }
+    xEventGroupSetBits(brokerEvents, NEW_FRAME_BIT);
+}
+
+/**
+ * @brief 取帧任务 / Capture task
+ * @param pvParameters 未使用 / Unused
+ */
+static void frame_broker_task(void *pvParameters) {
+    while(true) {
+        // 先清除事件位，之后到达的等待者等下一帧 / Clear the event bit first, waiters arriving after this wait for the next frame
+        xEventGroupClearBits(brokerEvents, NEW_FRAME_BIT);
+
+        // 高分辨率抓拍期间在这里等待 / Waits here during a high-resolution snapshot
+        camera_fb_t *fb = NULL;
+        if(hires_snapshot_lock(HIRES_SNAPSHOT_LOCK_TIMEOUT_MS)) {
+            fb = esp_camera_fb_get();
+            hires_snapshot_unlock();
+        }
+        if(!fb) {
+            portENTER_CRITICAL(&brokerMux);
+            brokerStats.captureFailures++;
+            portEXIT_CRITICAL(&brokerMux);
+            vTaskDelay(pdMS_TO_TICKS(10));
+            continue;
+        }
+        publish(fb);
+    }
+}
+
+/**
+ * @brief 启动取帧任务 / Start the capture task
+ * @param fbCount 摄像头帧缓冲数 / Camera frame buffer count
+ * @return bool 成功返回true / Returns true on success
+ */
+bool frame_broker_init(size_t fbCount) {
+    if(brokerEvents) {
+        return true;
+    }
+    // 留一个缓冲给驱动填充 / Leave one buffer for the driver to fill
+    brokerStats.heldLimit = fbCount >= 3 ? fbCount - 1 : 0;
+    brokerEvents = xEventGroupCreate();
+    if(!brokerEvents) {
+        return false;
+    }
+    return xTaskCreatePinnedToCore(frame_broker_task, "frame_broker", FRAME_BROKER_TASK_STACK, NULL,
+                                   FRAME_BROKER_TASK_PRIORITY, NULL, FRAME_BROKER_TASK_CORE) == pdPASS;
+}
+
+/**
+ * @brief 初始化使用者 / Set up a consumer
+ */
+void frame_broker_subscribe(FrameSubscriber *sub, bool reserved) {
+    portENTER_CRITICAL(&brokerMux);
+    sub->lastSeq = latestSeq;
+    portEXIT_CRITICAL(&brokerMux);
+    sub->frames = 0;
+    sub->skipped = 0;
+    sub->reserved = reserved;
+}
+
+/**
+ * @brief 取最新帧 / Acquire the newest frame
+ * @return camera_fb_t* 只读帧，超时返回NULL / Read-only frame, NULL on timeout
+ */
+camera_fb_t* frame_broker_acquire(FrameSubscriber *sub, uint32_t timeoutMs) {
+    if(!brokerEvents) {
+        return NULL;
+    }
+    TickType_t start = xTaskGetTickCount();
+    TickType_t timeout = pdMS_TO_TICKS(timeoutMs);
+    uint32_t refusedSeq = sub->lastSeq;
+    while(true) {
+        camera_fb_t *fb = NULL;
+        bool refused = false;
+        portENTER_CRITICAL(&brokerMux);
+        if(latestSlot >= 0 && brokerFrames[latestSlot].seq != sub->lastSeq) {
+            BrokerFrame *frame = &brokerFrames[latestSlot];
+            // 已被共享的最新帧不多占缓冲，总可以发出 / A newest frame already shared takes no extra buffer and can always go out
+            if(frame->refs == 1 && !may_pin_locked(sub)) {
+                refused = true;
+                if(refusedSeq != frame->seq) {
+                    refusedSeq = frame->seq;
+                    brokerStats.refused++;
+                }
+            } else {
+                frame->refs++;
+                fb = frame->fb;
+                // 首次取帧不计跳帧 / The first frame does not count skips
+                if(sub->frames > 0) {
+                    sub->skipped += frame->seq - sub->lastSeq - 1;
+                }
+                sub->lastSeq = frame->seq;
+            }
+        }
+        portEXIT_CRITICAL(&brokerMux);
+        if(fb) {
+            sub->frames++;
+            return fb;
+        }
+        TickType_t waited = xTaskGetTickCount() - start;
+        if(waited >= timeout) {
+            return NULL;
+        }
+        if(refused) {
+            // 等其他使用者释放或下一帧 / Wait for another consumer to release or for the next frame
+            vTaskDelay(1);
+            continue;
+        }
+        xEventGroupWaitBits(brokerEvents, NEW_FRAME_BIT, pdFALSE, pdFALSE, timeout - waited);
+    }
+}
+
+/**
+ * @brief 释放帧 / Release a frame
+ */
+void frame_broker_release(camera_fb_t *fb) {
+    if(!fb) {
+        return;
+    }
+    camera_fb_t *done = NULL;
+    portENTER_CRITICAL(&brokerMux);
+    for(int i = 0; i < FRAME_BROKER_MAX_FRAMES; i++) {
+        if(brokerFrames[i].fb == fb) {
+            done = unref_locked(i);
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&brokerMux);
+    if(done) {
+        esp_camera_fb_return(done);
+    }
+}
+
+/**
+ * @brief 获取分发统计 / Get broker statistics
+ */
+void frame_broker_get_stats(FrameBrokerStats *stats) {
+    portENTER_CRITICAL(&brokerMux);
+    *stats = brokerStats;
+    portEXIT_CRITICAL(&brokerMux);
+}
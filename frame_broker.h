@@ -0,0 +1,104 @@
+/**********************************************************************
+  文件名称 / Filename : frame_broker.h
+  文件用途 / File Purpose : 帧分发头文件 / Frame Broker Header File
+               声明了单一取帧任务、按引用计数把同一帧分发给录像、视频流和拍照相关的函数原型和宏定义
+               Declares function prototypes and macro definitions for one capture task that fans each frame out to recording, streams and snapshots by reference count
+  作者 / Author : ESP32-S3监控项目 / ESP32-S3 Monitoring Project
+  修改日期 / Modification Date : 2026-02-05
+  硬件平台 / Hardware Platform : ESP32S3-EYE开发板 / ESP32S3-EYE Development Board
+  依赖库 / Dependencies : esp_camera.h - ESP32摄像头驱动 / ESP32 camera driver
+               hires_snapshot.h - 高分辨率抓拍期间暂停取帧 / Capture pauses during high-resolution snapshots
+  使用说明 / Usage Instructions : 1. 包含本头文件 #include "frame_broker.h" / Include this header file
+               2. 摄像头初始化后调用frame_broker_init()启动取帧任务 / Call frame_broker_init() after camera init to start the capture task
+               3. 每个使用者持有一个FrameSubscriber，调用frame_broker_subscribe()初始化 / Each consumer keeps a FrameSubscriber set up with frame_broker_subscribe()
+               4. frame_broker_acquire()取最新帧，用完调用frame_broker_release() / frame_broker_acquire() takes the newest frame, frame_broker_release() gives it back
+  参数调整 / Parameter Adjustment : FRAME_BROKER_TASK_PRIORITY - 取帧任务优先级（高于录像任务）/ Capture task priority (above the recording task)
+               FRAME_BROKER_FB_COUNT - 有PSRAM时的帧缓冲数（默认4）/ Frame buffer count with PSRAM (default 4)
+  注意事项 / Important Notes : 取得的帧只读，最后一个使用者释放后才归还给摄像头驱动 / Acquired frames are read-only and go back to the camera driver once the last consumer releases them
+               使用者总是拿到最新帧，处理慢时跳过中间的帧而不是排队，不会拖慢取帧 / Consumers always get the newest frame, a slow one skips frames rather than queuing and never holds capture back
+               每个使用者同一时间只持有一帧；多个使用者持有同一最新帧只占一个缓冲，被新帧替换后仍被持有的旧帧才多占缓冲
+                  Each consumer holds one frame at a time; any number of consumers holding the newest frame share one buffer, only older frames still held after a newer one arrives take more
+               未归还帧数达到 帧缓冲数 - 1 时不再发出未被共享的最新帧，总留一个缓冲给驱动填充；最后一个名额留给预留使用者（录像）
+                  Once the frames out of the driver reach the buffer count - 1, an unshared newest frame is no longer handed out so one buffer is always left for the driver to fill; the last place is kept for reserved consumers (recording)
+               被拒绝的使用者等下一帧，计入refused / A refused consumer waits for the next frame and counts in refused
+               独占摄像头的操作（高分辨率抓拍、连拍）仍在hires_snapshot_lock()内直接取帧 / Operations that need the camera exclusively (hi-res snapshots, bursts) still grab frames directly under hires_snapshot_lock()
+**********************************************************************/
+
+#ifndef __FRAME_BROKER_H
+#define __FRAME_BROKER_H
+
+#include "Arduino.h"
+#include "esp_camera.h"
+
+// 同时在用的帧数上限（大于帧缓冲数即可）/ Maximum frames in use at once (anything above the frame buffer count)
+#define FRAME_BROKER_MAX_FRAMES 8
+
+// 有PSRAM时的帧缓冲数：最新帧、录像持有的旧帧、其他使用者持有的一个旧帧，再留一个给驱动
+// Frame buffer count with PSRAM: the newest frame, an older one held by recording, one older frame for everyone else, and one left for the driver
+#define FRAME_BROKER_FB_COUNT 4
+
+// 取帧任务配置 / Capture task configuration
+#define FRAME_BROKER_TASK_STACK 3072
+#define FRAME_BROKER_TASK_PRIORITY 6
+#define FRAME_BROKER_TASK_CORE 1
+
+// 使用者状态 / Consumer state
+typedef struct {
+    uint32_t lastSeq;                   // 上次取得的帧序号 / Sequence number of the last frame acquired
+    uint32_t frames;                    // 取得的帧数 / Frames acquired
+    uint32_t skipped;                   // 跳过的帧数 / Frames skipped
+    bool reserved;                      // 可以用最后一个名额（录像）/ May use the last place (recording)
+} FrameSubscriber;
+
+// 分发统计 / Broker statistics
+typedef struct {
+    uint32_t published;                 // 发布的帧数 / Frames published
+    uint32_t captureFailures;           // 取帧失败次数 / Failed captures
+    uint32_t held;                      // 当前未归还的帧数（含最新帧）/ Frames currently out of the driver (including the newest)
+    uint32_t heldMax;                   // 未归还帧数峰值 / Peak frames out of the driver
+    uint32_t heldLimit;                 // 未归还帧数上限，0表示不限 / Limit on frames out of the driver, 0 for none
+    uint32_t refused;                   // 因上限没有发出的帧数 / Frames not handed out because of the limit
+} FrameBrokerStats;
+
+/**
+ * @brief 启动取帧任务 / Start the capture task
+ * @param fbCount 摄像头帧缓冲数（config.fb_count），少于3时不限制持有帧数 / Camera frame buffer count (config.fb_count), held frames are not limited below 3
+ * @return bool 成功返回true / Returns true on success
+ * @details 功能说明 / Function Description:
+ *          1. 在hires_snapshot_lock()内调用esp_camera_fb_get()取帧 / Grab frames with esp_camera_fb_get() under hires_snapshot_lock()
+ *          2. 替换最新帧并唤醒等待的使用者 / Replace the newest frame and wake waiting consumers
+ *          3. 没有使用者引用的旧帧立即归还 / Return older frames at once when no consumer references them
+ */
+bool frame_broker_init(size_t fbCount);
+
+/**
+ * @brief 初始化使用者 / Set up a consumer
+ * @param sub 使用者状态 / Consumer state
+ * @param reserved 是否可以用最后一个名额，只给不能丢帧的录像 / Whether it may use the last place, only for recording which must not drop frames
+ * @note 之后只会取到比现在更新的帧 / It only gets frames newer than the current one from now on
+ */
+void frame_broker_subscribe(FrameSubscriber *sub, bool reserved = false);
+
+/**
+ * @brief 取最新帧 / Acquire the newest frame
+ * @param sub 使用者状态 / Consumer state
+ * @param timeoutMs 等待新帧的超时（毫秒）/ Timeout waiting for a new frame (ms)
+ * @return camera_fb_t* 只读帧，超时或未启动返回NULL / Read-only frame, NULL on timeout or when not started
+ * @note 只返回比上次取得的更新的帧，中间错过的帧计入skipped / Only returns a frame newer than the last one acquired, frames missed in between count as skipped
+ *       未归还帧数达到上限时等下一帧 / Waits for the next frame while the frames out of the driver are at the limit
+ */
+camera_fb_t* frame_broker_acquire(FrameSubscriber *sub, uint32_t timeoutMs);
+
+/**
+ * @brief 释放帧 / Release a frame
+ * @param fb frame_broker_acquire()取得的帧 / Frame from frame_broker_acquire()
+ */
+void frame_broker_release(camera_fb_t *fb);
+
+/**
+ * @brief 获取分发统计 / Get broker statistics
+ * @param stats 输出统计 / Output statistics
+ */
+void frame_broker_get_stats(FrameBrokerStats *stats);
+
+#endif // __FRAME_BROKER_H
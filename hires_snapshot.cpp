@@ -0,0 +1,164 @@
+/**********************************************************************
+  文件名称 / Filename : hires_snapshot.cpp
+  文件用途 / File Purpose : 录制中高分辨率抓拍实现文件 / High-Resolution Snapshot While Recording Implementation File
+               本文件实现了录制期间临时切换传感器分辨率抓拍一帧
+               This file implements briefly switching the sensor resolution to grab one frame while recording
+               主要功能包括 / Main Features:
+               1. 摄像头独占锁（录像任务、视频流和抓拍共用）/ Exclusive camera lock (shared by the recorder, the stream and snapshots)
+               2. 切换分辨率并丢弃尺寸不符的帧 / Switch resolution and discard frames of the wrong size
+               3. 统计离开录制分辨率的时间 / Track the time spent outside the recording resolution
+  作者 / Author : ESP32-S3监控项目 / ESP32-S3 Monitoring Project
+  修改日期 / Modification Date : 2026-02-05
+  硬件平台 / Hardware Platform : ESP32S3-EYE开发板 / ESP32S3-EYE Development Board
+  依赖库 / Dependencies : esp_camera.h - ESP32摄像头驱动 / ESP32 camera driver
+  使用说明 / Usage Instructions : 1. 调用hires_snapshot_init()初始化 / Call hires_snapshot_init() to initialize
+  注意事项 / Important Notes : 离开时间从切到高分辨率开始，到第一张录制分辨率的帧到达为止
+                  The time outside starts at the switch to high resolution and ends when the first recording-size frame arrives
+**********************************************************************/
+
+#include "hires_snapshot.h"
+#include "sd_read_write.h"
+
+// 录制分辨率 / Recording resolution
+static framesize_t recordFramesize = FRAMESIZE_INVALID;
+
+// 摄像头独占锁 / Exclusive camera lock
+static SemaphoreHandle_t cameraMutex = NULL;
+
+// 抓拍统计 / Snapshot statistics
+static HiresSnapshotStats snapshotStats = {0};
+static portMUX_TYPE snapshotStatsMux = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief 初始化高分辨率抓拍 / Initialize high-resolution snapshots
+ * @return bool 成功返回true / Returns true on success
+ */
+bool hires_snapshot_init(framesize_t recordSize) {
+    if(!cameraMutex) {
+        cameraMutex = xSemaphoreCreateMutex();
+    }
+    if(!cameraMutex) {
+        return false;
+    }
+    recordFramesize = recordSize;
+    return true;
+}
+
+/**
+ * @brief 独占摄像头 / Hold the camera exclusively
+ * @return bool 获得返回true / Returns true when acquired
+ */
+bool hires_snapshot_lock(uint32_t timeoutMs) {
+    if(!cameraMutex) {
+        return true;
+    }
+    return xSemaphoreTake(cameraMutex, pdMS_TO_TICKS(timeoutMs)) == pdTRUE;
+}
+
+/**
+ * @brief 释放摄像头 / Release the camera
+ */
+void hires_snapshot_unlock(void) {
+    if(cameraMutex) {
+        xSemaphoreGive(cameraMutex);
+    }
+}
+
+/**
+ * @brief 取一帧指定尺寸的图像，丢弃切换过程中的旧尺寸帧 / Grab one frame of the given size, discarding old-size frames from the switch
+ * @param size 目标分辨率 / Target resolution
+ * @return camera_fb_t* 帧缓冲，超过丢弃次数返回NULL / Frame buffer, NULL once the discard limit is exceeded
+ */
+static camera_fb_t* grab_frame_of_size(framesize_t size) {
+    for(int i = 0; i <= HIRES_SNAPSHOT_MAX_DISCARD; i++) {
+        camera_fb_t *fb = esp_camera_fb_get();
+        if(!fb) {
+            continue;
+        }
+        if(fb->width == resolution[size].width && fb->height == resolution[size].height && fb->len > 0) {
+            return fb;
+        }
+        esp_camera_fb_return(fb);
+    }
+    return NULL;
+}
+
+/**
+ * @brief 记录一次抓拍结果 / Record the outcome of one snapshot
+ */
+static void add_stats(bool ok, uint32_t gapMs) {
+    portENTER_CRITICAL(&snapshotStatsMux);
+    if(ok) {
+        snapshotStats.count++;
+    } else {
+        snapshotStats.failures++;
+    }
+    snapshotStats.lastGapMs = gapMs;
+    snapshotStats.totalGapMs += gapMs;
+    if(gapMs > snapshotStats.maxGapMs) {
+        snapshotStats.maxGapMs = gapMs;
+    }
+    portEXIT_CRITICAL(&snapshotStatsMux);
+}
+
+/**
+ * @brief 抓拍一张高分辨率照片 / Take one high-resolution snapshot
+ * @return bool 成功返回true / Returns true on success
+ */
+bool hires_snapshot_take(uint8_t **buf, size_t *len, uint16_t *width, uint16_t *height, uint32_t *gapMs) {
+    *buf = NULL;
+    *len = 0;
+    *gapMs = 0;
+    sensor_t *s = esp_camera_sensor_get();
+    if(!cameraMutex || !s || recordFramesize == FRAMESIZE_INVALID) {
+        return false;
+    }
+    if(!hires_snapshot_lock(HIRES_SNAPSHOT_LOCK_TIMEOUT_MS)) {
+        add_stats(false, 0);
+        return false;
+    }
+
+    // 切到高分辨率，只复制帧数据，不在这里写SD卡 / Switch to high resolution, only copy the frame here and never write the SD card
+    uint32_t switchStart = millis();
+    bool ok = s->set_framesize(s, HIRES_SNAPSHOT_FRAMESIZE) == 0;
+    camera_fb_t *fb = ok ? grab_frame_of_size(HIRES_SNAPSHOT_FRAMESIZE) : NULL;
+    if(fb) {
+        *buf = (uint8_t*)ps_malloc(fb->len);
+        if(*buf) {
+            memcpy(*buf, fb->buf, fb->len);
+            *len = fb->len;
+            *width = fb->width;
+            *height = fb->height;
+        }
+        esp_camera_fb_return(fb);
+    }
+
+    // 切回录制分辨率，等到第一张录制尺寸的帧再放开摄像头 / Switch back and only release the camera once a recording-size frame arrives
+    s->set_framesize(s, recordFramesize);
+    camera_fb_t *restored = grab_frame_of_size(recordFramesize);
+    if(restored) {
+        esp_camera_fb_return(restored);
+    } else {
+        Serial.println("Recording resolution not restored in time / 录制分辨率未及时恢复");
+    }
+    *gapMs = millis() - switchStart;
+    hires_snapshot_unlock();
+
+    // 录像中标记这段间隙 / Mark the gap in the recording
+    markVideoGap(*gapMs);
+
+    ok = *buf != NULL;
+    add_stats(ok, *gapMs);
+    Serial.printf("Hi-res snapshot %s, %lu ms outside recording resolution / 高分辨率抓拍%s，离开录制分辨率 %lu 毫秒\n",
+                  ok ? "taken" : "failed", (unsigned long)*gapMs, ok ? "完成" : "失败", (unsigned long)*gapMs);
+    return ok;
+}
+
+/**
+ * @brief 获取抓拍统计 / Get snapshot statistics
+ */
+void hires_snapshot_get_stats(HiresSnapshotStats *stats) {
+    portENTER_CRITICAL(&snapshotStatsMux);
+    *stats = snapshotStats;
+    portEXIT_CRITICAL(&snapshotStatsMux);
+}
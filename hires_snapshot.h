@@ -0,0 +1,92 @@
+/**********************************************************************
+  文件名称 / Filename : hires_snapshot.h
+  文件用途 / File Purpose : 录制中高分辨率抓拍头文件 / High-Resolution Snapshot While Recording Header File
+               声明了录制期间临时切换传感器分辨率抓拍一帧的函数原型和宏定义
+               Declares function prototypes and macro definitions for briefly switching the sensor resolution to grab one frame while recording
+  作者 / Author : ESP32-S3监控项目 / ESP32-S3 Monitoring Project
+  修改日期 / Modification Date : 2026-02-05
+  硬件平台 / Hardware Platform : ESP32S3-EYE开发板 / ESP32S3-EYE Development Board
+  依赖库 / Dependencies : esp_camera.h - ESP32摄像头驱动 / ESP32 camera driver
+               sd_read_write.h - 录像间隙标记 / Recording gap marking
+  使用说明 / Usage Instructions : 1. 包含本头文件 #include "hires_snapshot.h" / Include this header file
+               2. 摄像头以HIRES_SNAPSHOT_FRAMESIZE初始化（按最大分辨率分配帧缓冲），再切回录制分辨率
+                  Initialize the camera with HIRES_SNAPSHOT_FRAMESIZE (frame buffers sized for the largest resolution), then switch back to the recording resolution
+               3. 调用hires_snapshot_init()传入录制分辨率 / Call hires_snapshot_init() with the recording resolution
+               4. 其他取帧的地方用hires_snapshot_lock()/hires_snapshot_unlock()包住esp_camera_fb_get()
+                  Wrap esp_camera_fb_get() elsewhere with hires_snapshot_lock()/hires_snapshot_unlock()
+               5. 调用hires_snapshot_take()抓拍 / Call hires_snapshot_take() to take a snapshot
+  参数调整 / Parameter Adjustment : HIRES_SNAPSHOT_FRAMESIZE - 抓拍分辨率（默认UXGA，OV2640最大）/ Snapshot resolution (default UXGA, the OV2640 maximum)
+               HIRES_SNAPSHOT_MAX_DISCARD - 切换后最多丢弃的帧数 / Maximum frames discarded after a switch
+  注意事项 / Important Notes : 抓拍期间录像暂停，录像中以空帧标记间隙，不会写入尺寸不一致的帧
+                  Recording pauses during the snapshot and the gap is marked with empty frames, never with mixed-size frames
+               高分辨率帧先复制到PSRAM并立即切回，SD卡写入在切回之后进行
+                  The high-resolution frame is copied to PSRAM and the sensor switched back at once, the SD card write happens afterwards
+**********************************************************************/
+
+#ifndef __HIRES_SNAPSHOT_H
+#define __HIRES_SNAPSHOT_H
+
+#include "Arduino.h"
+#include "esp_camera.h"
+
+// 抓拍分辨率（帧缓冲按此分辨率分配）/ Snapshot resolution (frame buffers are sized for it)
+#define HIRES_SNAPSHOT_FRAMESIZE FRAMESIZE_UXGA
+
+// 切换分辨率后最多丢弃的帧数 / Maximum frames discarded after switching resolution
+#define HIRES_SNAPSHOT_MAX_DISCARD 6
+
+// 等待其他取帧任务让出摄像头的超时（毫秒）/ Timeout waiting for other frame grabbers to release the camera (ms)
+#define HIRES_SNAPSHOT_LOCK_TIMEOUT_MS 3000
+
+// 抓拍统计 / Snapshot statistics
+typedef struct {
+    uint32_t count;             // 成功次数 / Successful snapshots
+    uint32_t failures;          // 失败次数 / Failed snapshots
+    uint32_t lastGapMs;         // 最近一次离开录制分辨率的时间（毫秒）/ Time spent outside the recording resolution last time (ms)
+    uint32_t maxGapMs;          // 最长离开时间（毫秒）/ Longest time outside the recording resolution (ms)
+    uint32_t totalGapMs;        // 累计离开时间（毫秒）/ Total time outside the recording resolution (ms)
+} HiresSnapshotStats;
+
+/**
+ * @brief 初始化高分辨率抓拍 / Initialize high-resolution snapshots
+ * @param recordSize 录制分辨率 / Recording resolution
+ * @return bool 成功返回true / Returns true on success
+ * @note 没有PSRAM时帧缓冲按录制分辨率分配，应传入false跳过 / Without PSRAM the frame buffers only fit the recording resolution, do not enable it
+ */
+bool hires_snapshot_init(framesize_t recordSize);
+
+/**
+ * @brief 抓拍期间独占摄像头 / Hold the camera exclusively around a frame grab
+ * @param timeoutMs 超时（毫秒）/ Timeout (ms)
+ * @return bool 获得返回true，未初始化时直接返回true / Returns true when acquired, or straight away when not initialized
+ */
+bool hires_snapshot_lock(uint32_t timeoutMs);
+
+/**
+ * @brief 释放摄像头 / Release the camera
+ */
+void hires_snapshot_unlock(void);
+
+/**
+ * @brief 抓拍一张高分辨率照片 / Take one high-resolution snapshot
+ * @param buf 输出：JPEG数据（PSRAM，调用方free）/ Output: JPEG data (PSRAM, freed by the caller)
+ * @param len 输出：JPEG长度 / Output: JPEG length
+ * @param width 输出：宽度 / Output: width
+ * @param height 输出：高度 / Output: height
+ * @param gapMs 输出：离开录制分辨率的时间（毫秒）/ Output: time spent outside the recording resolution (ms)
+ * @return bool 成功返回true / Returns true on success
+ * @details 功能说明 / Function Description:
+ *          1. 独占摄像头，切换到HIRES_SNAPSHOT_FRAMESIZE / Take the camera, switch to HIRES_SNAPSHOT_FRAMESIZE
+ *          2. 丢弃尺寸不符的帧，复制第一张高分辨率帧 / Discard frames of the wrong size, copy the first high-resolution one
+ *          3. 切回录制分辨率，等到尺寸恢复后释放摄像头 / Switch back and release the camera once the size is restored
+ *          4. 在录像中标记间隙 / Mark the gap in the recording
+ */
+bool hires_snapshot_take(uint8_t **buf, size_t *len, uint16_t *width, uint16_t *height, uint32_t *gapMs);
+
+/**
+ * @brief 获取抓拍统计 / Get snapshot statistics
+ * @param stats 输出统计 / Output statistics
+ */
+void hires_snapshot_get_stats(HiresSnapshotStats *stats);
+
+#endif // __HIRES_SNAPSHOT_H
@@ -0,0 +1,839 @@
+/**********************************************************************
+  文件名称 / Filename : jpeg_requant.cpp
+  文件用途 / File Purpose : JPEG DCT域重量化实现 / JPEG DCT-Domain Requantization Implementation
+               本文件实现了基线JPEG的熵解码、系数重量化和Huffman重编码
+               This file implements entropy decoding, coefficient requantization and Huffman re-encoding of baseline JPEG
+               主要功能包括 / Main Features:
+               1. JPEG段解析（DQT、SOF0/1、DHT、DRI、SOS）/ JPEG segment parsing (DQT, SOF0/1, DHT, DRI, SOS)
+               2. 9位查表加速的Huffman解码 / Huffman decoding accelerated by a 9-bit lookup table
+               3. 量化系数四舍五入重量化 / Rounded requantization of quantized coefficients
+               4. 标准Huffman表重编码，支持重启标记 / Re-encoding with standard Huffman tables, restart markers supported
+  作者 / Author : ESP32-S3监控项目 / ESP32-S3 Monitoring Project
+  修改日期 / Modification Date : 2026-02-05
+  硬件平台 / Hardware Platform : ESP32S3-EYE开发板 / ESP32S3-EYE Development Board
+  依赖库 / Dependencies : string.h - 内存操作 / Memory operations
+  使用说明 / Usage Instructions : 1. 调用jpeg_requantize()处理一帧 / Call jpeg_requantize() for one frame
+  注意事项 / Important Notes : 新系数 = round(旧系数 × 旧步长 / 新步长)，不经过像素域 / New coefficient = round(old coefficient × old step / new step), never goes through the pixel domain
+               所有输出写入都做边界检查，溢出时返回false / Every output write is bounds-checked, returns false on overflow
+**********************************************************************/
+
+#include "jpeg_requant.h"
+#include <string.h>
+
+// JPEG标记 / JPEG markers
+#define M_SOI  0xD8
+#define M_EOI  0xD9
+#define M_SOF0 0xC0
+#define M_SOF1 0xC1
+#define M_DHT  0xC4
+#define M_DQT  0xDB
+#define M_DRI  0xDD
+#define M_SOS  0xDA
+#define M_RST0 0xD0
+
+// Huffman查找表位数 / Huffman lookup table bits
+#define HUFF_LOOKAHEAD 9
+
+// 单个MCU最多块数（JPEG规范上限10）/ Maximum blocks per MCU (JPEG limit is 10)
+#define MAX_BLOCKS_IN_MCU 10
+
+// Huffman解码表 / Huffman decoding table
+typedef struct {
+    bool defined;                        // 是否已定义 / Whether defined
+    uint8_t vals[256];                   // 符号值 / Symbol values
+    int32_t maxcode[18];                 // 每个码长的最大码字 / Maximum code per length
+    int32_t mincode[17];                 // 每个码长的最小码字 / Minimum code per length
+    int32_t valptr[17];                  // 每个码长第一个符号下标 / Index of first symbol per length
+    uint16_t lookup[1 << HUFF_LOOKAHEAD]; // (码长<<8)|符号，0表示需要慢速路径 / (length<<8)|symbol, 0 means slow path
+} huff_dec_t;
+
+// Huffman编码表 / Huffman encoding table
+typedef struct {
+    uint16_t code[256];                  // 码字 / Code word
+    uint8_t size[256];                   // 码长，0表示符号不存在 / Code length, 0 means symbol missing
+} huff_enc_t;
+
+// 分量信息 / Component information
+typedef struct {
+    uint8_t id;                          // 分量ID / Component ID
+    uint8_t h;                           // 水平采样因子 / Horizontal sampling factor
+    uint8_t v;                           // 垂直采样因子 / Vertical sampling factor
+    uint8_t tq;                          // 量化表编号 / Quantization table index
+    uint8_t td;                          // DC表编号 / DC table index
+    uint8_t ta;                          // AC表编号 / AC table index
+    int32_t oldPred;                     // 源DC预测值 / Source DC predictor
+    int32_t newPred;                     // 输出DC预测值 / Output DC predictor
+} component_t;
+
+// 重量化上下文（模块级静态，约9KB）/ Requantization context (module-level static, about 9KB)
+typedef struct {
+    huff_dec_t dc[4];                    // DC解码表 / DC decoding tables
+    huff_dec_t ac[4];                    // AC解码表 / AC decoding tables
+    huff_enc_t encDc[2];                 // DC编码表（亮度/色度）/ DC encoding tables (luma/chroma)
+    huff_enc_t encAc[2];                 // AC编码表（亮度/色度）/ AC encoding tables (luma/chroma)
+    bool encReady;                       // 编码表是否已生成 / Whether encoding tables are built
+    uint16_t oldQ[4][64];                // 源量化表（之字形顺序）/ Source quantization tables (zigzag order)
+    uint16_t newQ[4][64];                // 新量化表（之字形顺序）/ New quantization tables (zigzag order)
+    bool qDefined[4];                    // 量化表是否已定义 / Whether quantization table is defined
+    component_t comp[4];                 // 帧分量 / Frame components
+    int compCount;                       // 帧分量数 / Frame component count
+    uint16_t width;                      // 图像宽度 / Image width
+    uint16_t height;                     // 图像高度 / Image height
+    uint16_t restartInterval;            // 重启间隔（MCU数）/ Restart interval (MCUs)
+    bool sofSeen;                        // 是否已解析SOF / Whether SOF was parsed
+
+    // 位读取器 / Bit reader
+    const uint8_t *in;
+    const uint8_t *inEnd;
+    uint32_t bitBuf;
+    int bitCnt;
+    bool hitMarker;
+
+    // 位写入器 / Bit writer
+    uint8_t *out;
+    uint8_t *outEnd;
+    uint32_t acc;
+    int accBits;
+    bool overflow;
+} requant_ctx_t;
+
+static requant_ctx_t ctx;
+
+// 标准Huffman表（JPEG规范Annex K.3）/ Standard Huffman tables (JPEG spec Annex K.3)
+static const uint8_t STD_DC_LUM_BITS[16] = {0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0};
+static const uint8_t STD_DC_CHR_BITS[16] = {0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0};
+static const uint8_t STD_DC_VALS[12] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+static const uint8_t STD_AC_LUM_BITS[16] = {0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d};
+static const uint8_t STD_AC_LUM_VALS[162] = {
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+    0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+    0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+    0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+    0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+    0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+    0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+    0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa
+};
+static const uint8_t STD_AC_CHR_BITS[16] = {0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77};
+static const uint8_t STD_AC_CHR_VALS[162] = {
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+    0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+    0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+    0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+    0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+    0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+    0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+    0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+    0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+    0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa
+};
+
+/**
+ * @brief 由BITS/HUFFVAL生成解码表 / Build a decoding table from BITS/HUFFVAL
+ * @return bool 表合法返回true / Returns true if the table is valid
+ */
+static bool build_decoder(huff_dec_t *t, const uint8_t bits[16], const uint8_t *vals) {
+    int total = 0;
+    for(int i = 0; i < 16; i++) {
+        total += bits[i];
+    }
+    if(total > 256) {
+        return false;
+    }
+    memcpy(t->vals, vals, total);
+    memset(t->lookup, 0, sizeof(t->lookup));
+
+    int32_t code = 0;
+    int k = 0;
+    for(int len = 1; len <= 16; len++) {
+        t->valptr[len] = k;
+        t->mincode[len] = code;
+        for(int i = 0; i < bits[len - 1]; i++) {
+            // 短码字填充查找表 / Fill lookup table for short codes
+            if(len <= HUFF_LOOKAHEAD) {
+                int shift = HUFF_LOOKAHEAD - len;
+                int base = code << shift;
+                for(int j = 0; j < (1 << shift); j++) {
+                    t->lookup[base + j] = (uint16_t)((len << 8) | t->vals[k]);
+                }
+            }
+            code++;
+            k++;
+        }
+        t->maxcode[len] = bits[len - 1] ? code - 1 : -1;
+        // 码字不能溢出当前码长 / Code must not overflow the current length
+        if(code > (1 << len)) {
+            return false;
+        }
+        code <<= 1;
+    }
+    t->maxcode[17] = 0x7fffffff;
+    t->defined = true;
+    return true;
+}
+
+/**
+ * @brief 由BITS/HUFFVAL生成编码表 / Build an encoding table from BITS/HUFFVAL
+ */
+static void build_encoder(huff_enc_t *t, const uint8_t bits[16], const uint8_t *vals) {
+    memset(t->size, 0, sizeof(t->size));
+    uint16_t code = 0;
+    int k = 0;
+    for(int len = 1; len <= 16; len++) {
+        for(int i = 0; i < bits[len - 1]; i++) {
+            t->code[vals[k]] = code;
+            t->size[vals[k]] = (uint8_t)len;
+            code++;
+            k++;
+        }
+        code <<= 1;
+    }
+}
+
+/**
+ * @brief 位读取器填充到至少25位 / Refill the bit reader to at least 25 bits
+ * @note 遇到非0x00填充的0xFF即视为标记，停止消费并补0 / A 0xFF not followed by 0x00 is a marker: stop consuming and pad with zeros
+ */
+static inline void fill_bits(void) {
+    while(ctx.bitCnt <= 24) {
+        uint32_t b = 0;
+        if(!ctx.hitMarker && ctx.in < ctx.inEnd) {
+            b = *ctx.in;
+            if(b == 0xFF) {
+                uint8_t next = (ctx.in + 1 < ctx.inEnd) ? ctx.in[1] : M_EOI;
+                if(next == 0x00) {
+                    ctx.in += 2;
+                } else {
+                    ctx.hitMarker = true;
+                    b = 0;
+                }
+            } else {
+                ctx.in++;
+            }
+        }
+        ctx.bitBuf |= b << (24 - ctx.bitCnt);
+        ctx.bitCnt += 8;
+    }
+}
+
+static inline uint32_t peek_bits(int n) {
+    return ctx.bitBuf >> (32 - n);
+}
+
+static inline void skip_bits(int n) {
+    ctx.bitBuf <<= n;
+    ctx.bitCnt -= n;
+}
+
+/**
+ * @brief 解码一个Huffman符号 / Decode one Huffman symbol
+ * @return int 符号值，码字非法返回-1 / Symbol value, -1 on an invalid code
+ */
+static inline int decode_symbol(const huff_dec_t *t) {
+    fill_bits();
+    uint16_t e = t->lookup[peek_bits(HUFF_LOOKAHEAD)];
+    if(e) {
+        skip_bits(e >> 8);
+        return e & 0xFF;
+    }
+    // 慢速路径：逐码长比较 / Slow path: compare length by length
+    for(int len = HUFF_LOOKAHEAD + 1; len <= 16; len++) {
+        int32_t code = (int32_t)peek_bits(len);
+        if(t->maxcode[len] >= 0 && code <= t->maxcode[len]) {
+            skip_bits(len);
+            return t->vals[t->valptr[len] + code - t->mincode[len]];
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief 读取s位附加值并做符号扩展 / Receive s extra bits and sign-extend
+ */
+static inline int32_t receive_extend(int s) {
+    if(s == 0) {
+        return 0;
+    }
+    fill_bits();
+    int32_t v = (int32_t)peek_bits(s);
+    skip_bits(s);
+    if(v < (1 << (s - 1))) {
+        v -= (1 << s) - 1;
+    }
+    return v;
+}
+
+/**
+ * @brief 写出一个字节（输出边界检查）/ Emit one byte (bounds-checked)
+ */
+static inline void emit_byte(uint8_t b) {
+    if(ctx.out >= ctx.outEnd) {
+        ctx.overflow = true;
+        return;
+    }
+    *ctx.out++ = b;
+}
+
+/**
+ * @brief 写入n位（自动插入0xFF后的0x00）/ Write n bits (0x00 stuffed after 0xFF automatically)
+ */
+static inline void put_bits(uint32_t code, int n) {
+    if(n == 0) {
+        return;
+    }
+    ctx.acc = (ctx.acc << n) | (code & ((1u << n) - 1));
+    ctx.accBits += n;
+    while(ctx.accBits >= 8) {
+        uint8_t b = (uint8_t)(ctx.acc >> (ctx.accBits - 8));
+        emit_byte(b);
+        if(b == 0xFF) {
+            emit_byte(0x00);
+        }
+        ctx.accBits -= 8;
+    }
+}
+
+/**
+ * @brief 用1填充到字节边界 / Pad to a byte boundary with 1 bits
+ */
+static void flush_bits(void) {
+    if(ctx.accBits > 0) {
+        put_bits(0x7F, 8 - ctx.accBits);
+    }
+    ctx.acc = 0;
+    ctx.accBits = 0;
+}
+
+/**
+ * @brief 计算幅值类别（位数）/ Compute magnitude category (bit count)
+ */
+static inline int magnitude_bits(int32_t v) {
+    uint32_t a = (uint32_t)(v < 0 ? -v : v);
+    int n = 0;
+    while(a) {
+        n++;
+        a >>= 1;
+    }
+    return n;
+}
+
+/**
+ * @brief 四舍五入重量化一个系数 / Requantize one coefficient with rounding
+ */
+static inline int32_t requant(int32_t v, uint16_t oldQ, uint16_t newQ) {
+    int32_t num = v * oldQ;
+    if(num >= 0) {
+        return (num + newQ / 2) / newQ;
+    }
+    return -((-num + newQ / 2) / newQ);
+}
+
+/**
+ * @brief 写出Huffman码字，符号不在表中时标记溢出 / Write a Huffman code, flag failure if the symbol is missing
+ */
+static inline void put_symbol(const huff_enc_t *t, uint8_t sym) {
+    if(t->size[sym] == 0) {
+        ctx.overflow = true;
+        return;
+    }
+    put_bits(t->code[sym], t->size[sym]);
+}
+
+/**
+ * @brief 解码、重量化并重编码一个8x8块 / Decode, requantize and re-encode one 8x8 block
+ * @return bool 成功返回true / Returns true on success
+ */
+static bool transcode_block(component_t *c, int encIdx) {
+    int32_t zz[64];
+    memset(zz, 0, sizeof(zz));
+
+    // DC系数 / DC coefficient
+    int s = decode_symbol(&ctx.dc[c->td]);
+    if(s < 0 || s > 11) {
+        return false;
+    }
+    c->oldPred += receive_extend(s);
+    zz[0] = c->oldPred;
+
+    // AC系数 / AC coefficients
+    for(int k = 1; k < 64; k++) {
+        int rs = decode_symbol(&ctx.ac[c->ta]);
+        if(rs < 0) {
+            return false;
+        }
+        int r = rs >> 4;
+        s = rs & 15;
+        if(s == 0) {
+            if(r != 15) {
+                break;          // EOB
+            }
+            k += 15;            // ZRL
+            continue;
+        }
+        k += r;
+        if(k > 63) {
+            return false;
+        }
+        zz[k] = receive_extend(s);
+    }
+
+    // 重量化 / Requantize
+    const uint16_t *oq = ctx.oldQ[c->tq];
+    const uint16_t *nq = ctx.newQ[c->tq];
+    for(int k = 0; k < 64; k++) {
+        if(zz[k]) {
+            zz[k] = requant(zz[k], oq[k], nq[k]);
+        }
+    }
+
+    // DC差分编码 / DC differential encoding
+    const huff_enc_t *dcT = &ctx.encDc[encIdx];
+    const huff_enc_t *acT = &ctx.encAc[encIdx];
+    int32_t diff = zz[0] - c->newPred;
+    c->newPred = zz[0];
+    int nbits = magnitude_bits(diff);
+    if(nbits > 11) {
+        return false;
+    }
+    put_symbol(dcT, (uint8_t)nbits);
+    put_bits(diff < 0 ? (uint32_t)(diff - 1) : (uint32_t)diff, nbits);
+
+    // AC游程编码 / AC run-length encoding
+    int run = 0;
+    for(int k = 1; k < 64; k++) {
+        int32_t v = zz[k];
+        if(v == 0) {
+            run++;
+            continue;
+        }
+        while(run > 15) {
+            put_symbol(acT, 0xF0);
+            run -= 16;
+        }
+        nbits = magnitude_bits(v);
+        if(nbits > 10) {
+            return false;
+        }
+        put_symbol(acT, (uint8_t)((run << 4) | nbits));
+        put_bits(v < 0 ? (uint32_t)(v - 1) : (uint32_t)v, nbits);
+        run = 0;
+    }
+    if(run > 0) {
+        put_symbol(acT, 0x00);
+    }
+    return !ctx.overflow;
+}
+
+/**
+ * @brief 处理重启标记：丢弃剩余位并越过RSTn / Handle a restart marker: drop remaining bits and step over RSTn
+ * @return bool 找到RST标记返回true / Returns true if an RST marker was found
+ */
+static bool process_restart(void) {
+    ctx.bitBuf = 0;
+    ctx.bitCnt = 0;
+    ctx.hitMarker = false;
+    while(ctx.in + 1 < ctx.inEnd && !(ctx.in[0] == 0xFF && (ctx.in[1] & 0xF8) == M_RST0)) {
+        ctx.in++;
+    }
+    if(ctx.in + 1 >= ctx.inEnd) {
+        return false;
+    }
+    ctx.in += 2;
+    return true;
+}
+
+/**
+ * @brief 写入一个段（标记+长度+内容）/ Write one segment (marker + length + payload)
+ */
+static void write_segment(uint8_t marker, const uint8_t *payload, uint16_t len) {
+    emit_byte(0xFF);
+    emit_byte(marker);
+    emit_byte((uint8_t)((len + 2) >> 8));
+    emit_byte((uint8_t)((len + 2) & 0xFF));
+    for(uint16_t i = 0; i < len && !ctx.overflow; i++) {
+        emit_byte(payload[i]);
+    }
+}
+
+/**
+ * @brief 写入一张Huffman表到DHT / Write one Huffman table into DHT
+ */
+static void write_dht_table(uint8_t tcth, const uint8_t bits[16], const uint8_t *vals, int count) {
+    emit_byte(tcth);
+    for(int i = 0; i < 16; i++) {
+        emit_byte(bits[i]);
+    }
+    for(int i = 0; i < count; i++) {
+        emit_byte(vals[i]);
+    }
+}
+
+/**
+ * @brief 写入标准Huffman表DHT段 / Write the DHT segment with the standard Huffman tables
+ */
+static void write_standard_dht(void) {
+    uint16_t len = 2 + 4 * 17 + 12 + 12 + 162 + 162;
+    emit_byte(0xFF);
+    emit_byte(M_DHT);
+    emit_byte((uint8_t)(len >> 8));
+    emit_byte((uint8_t)(len & 0xFF));
+    write_dht_table(0x00, STD_DC_LUM_BITS, STD_DC_VALS, 12);
+    write_dht_table(0x10, STD_AC_LUM_BITS, STD_AC_LUM_VALS, 162);
+    write_dht_table(0x01, STD_DC_CHR_BITS, STD_DC_VALS, 12);
+    write_dht_table(0x11, STD_AC_CHR_BITS, STD_AC_CHR_VALS, 162);
+}
+
+/**
+ * @brief 解析DQT段并写出放大后的量化表 / Parse a DQT segment and write the scaled tables
+ */
+static bool handle_dqt(const uint8_t *p, uint16_t len, uint16_t scalePercent) {
+    uint8_t seg[4 * 65];
+    uint16_t segLen = 0;
+    uint16_t pos = 0;
+    while(pos < len) {
+        uint8_t pq = p[pos] >> 4;
+        uint8_t tq = p[pos] & 0x0F;
+        // 只支持8位精度量化表 / Only 8-bit precision tables are supported
+        if(pq != 0 || tq > 3 || pos + 65 > len || segLen + 65u > sizeof(seg)) {
+            return false;
+        }
+        seg[segLen++] = p[pos];
+        for(int k = 0; k < 64; k++) {
+            uint16_t oq = p[pos + 1 + k];
+            if(oq == 0) {
+                return false;
+            }
+            uint32_t nq = ((uint32_t)oq * scalePercent + 50) / 100;
+            if(nq < 1) {
+                nq = 1;
+            }
+            if(nq > 255) {
+                nq = 255;
+            }
+            ctx.oldQ[tq][k] = oq;
+            ctx.newQ[tq][k] = (uint16_t)nq;
+            seg[segLen++] = (uint8_t)nq;
+        }
+        ctx.qDefined[tq] = true;
+        pos += 65;
+    }
+    write_segment(M_DQT, seg, segLen);
+    return true;
+}
+
+/**
+ * @brief 解析DHT段到解码表 / Parse a DHT segment into decoding tables
+ */
+static bool handle_dht(const uint8_t *p, uint16_t len) {
+    uint16_t pos = 0;
+    while(pos + 17 <= len) {
+        uint8_t tc = p[pos] >> 4;
+        uint8_t th = p[pos] & 0x0F;
+        if(tc > 1 || th > 3) {
+            return false;
+        }
+        const uint8_t *bits = p + pos + 1;
+        int total = 0;
+        for(int i = 0; i < 16; i++) {
+            total += bits[i];
+        }
+        if(pos + 17 + total > len) {
+            return false;
+        }
+        huff_dec_t *t = tc ? &ctx.ac[th] : &ctx.dc[th];
+        if(!build_decoder(t, bits, p + pos + 17)) {
+            return false;
+        }
+        pos += 17 + total;
+    }
+    return true;
+}
+
+/**
+ * @brief 解析SOF0/SOF1段 / Parse a SOF0/SOF1 segment
+ */
+static bool handle_sof(const uint8_t *p, uint16_t len) {
+    if(len < 6 || p[0] != 8) {
+        return false;
+    }
+    ctx.height = (p[1] << 8) | p[2];
+    ctx.width = (p[3] << 8) | p[4];
+    ctx.compCount = p[5];
+    if(ctx.compCount < 1 || ctx.compCount > 4 || len < 6 + 3 * ctx.compCount || ctx.width == 0 || ctx.height == 0) {
+        return false;
+    }
+    for(int i = 0; i < ctx.compCount; i++) {
+        component_t *c = &ctx.comp[i];
+        c->id = p[6 + 3 * i];
+        c->h = p[7 + 3 * i] >> 4;
+        c->v = p[7 + 3 * i] & 0x0F;
+        c->tq = p[8 + 3 * i];
+        if(c->h < 1 || c->h > 4 || c->v < 1 || c->v > 4 || c->tq > 3) {
+            return false;
+        }
+    }
+    ctx.sofSeen = true;
+    return true;
+}
+
+/**
+ * @brief 熵解码/重编码扫描数据 / Entropy-decode and re-encode the scan data
+ * @param order 扫描中的分量下标 / Component indices in the scan
+ * @param ns 扫描分量数 / Number of components in the scan
+ */
+static bool transcode_scan(const int *order, int ns) {
+    int hmax = 1, vmax = 1;
+    for(int i = 0; i < ctx.compCount; i++) {
+        if(ctx.comp[i].h > hmax) hmax = ctx.comp[i].h;
+        if(ctx.comp[i].v > vmax) vmax = ctx.comp[i].v;
+    }
+
+    // 单分量扫描每个MCU只有1个块 / A single-component scan has one block per MCU
+    int blocksPerMcu = 0;
+    uint32_t mcusX, mcusY;
+    if(ns == 1) {
+        component_t *c = &ctx.comp[order[0]];
+        uint32_t cw = (ctx.width * c->h + hmax - 1) / hmax;
+        uint32_t ch = (ctx.height * c->v + vmax - 1) / vmax;
+        mcusX = (cw + 7) / 8;
+        mcusY = (ch + 7) / 8;
+        blocksPerMcu = 1;
+    } else {
+        mcusX = (ctx.width + 8 * hmax - 1) / (8 * hmax);
+        mcusY = (ctx.height + 8 * vmax - 1) / (8 * vmax);
+        for(int i = 0; i < ns; i++) {
+            blocksPerMcu += ctx.comp[order[i]].h * ctx.comp[order[i]].v;
+        }
+    }
+    if(blocksPerMcu > MAX_BLOCKS_IN_MCU) {
+        return false;
+    }
+
+    for(int i = 0; i < ctx.compCount; i++) {
+        ctx.comp[i].oldPred = 0;
+        ctx.comp[i].newPred = 0;
+    }
+
+    uint32_t totalMcus = mcusX * mcusY;
+    uint16_t restartsLeft = ctx.restartInterval;
+    uint8_t nextRst = 0;
+    for(uint32_t m = 0; m < totalMcus; m++) {
+        // 重启间隔处理 / Restart interval handling
+        if(ctx.restartInterval) {
+            if(restartsLeft == 0) {
+                if(!process_restart()) {
+                    return false;
+                }
+                flush_bits();
+                emit_byte(0xFF);
+                emit_byte(M_RST0 + nextRst);
+                nextRst = (nextRst + 1) & 7;
+                for(int i = 0; i < ctx.compCount; i++) {
+                    ctx.comp[i].oldPred = 0;
+                    ctx.comp[i].newPred = 0;
+                }
+                restartsLeft = ctx.restartInterval;
+            }
+            restartsLeft--;
+        }
+
+        for(int i = 0; i < ns; i++) {
+            component_t *c = &ctx.comp[order[i]];
+            int encIdx = (order[i] == 0) ? 0 : 1;
+            int blocks = (ns == 1) ? 1 : c->h * c->v;
+            for(int b = 0; b < blocks; b++) {
+                if(!transcode_block(c, encIdx)) {
+                    return false;
+                }
+            }
+        }
+    }
+    flush_bits();
+    return !ctx.overflow;
+}
+
+/**
+ * @brief 解析SOS段并转码扫描数据 / Parse the SOS segment and transcode the scan data
+ */
+static bool handle_sos(const uint8_t *p, uint16_t len, const uint8_t *scanStart, const uint8_t *srcEnd) {
+    if(!ctx.sofSeen || len < 1) {
+        return false;
+    }
+    int ns = p[0];
+    if(ns < 1 || ns > 4 || len < 1 + 2 * ns + 3) {
+        return false;
+    }
+    // 只支持一次扫描包含全部分量（基线摄像头JPEG）/ Only a single scan with all components (baseline camera JPEG)
+    if(ns != ctx.compCount) {
+        return false;
+    }
+
+    int order[4];
+    uint8_t sos[1 + 2 * 4 + 3];
+    uint16_t sosLen = 0;
+    sos[sosLen++] = (uint8_t)ns;
+    for(int i = 0; i < ns; i++) {
+        uint8_t cid = p[1 + 2 * i];
+        uint8_t tables = p[2 + 2 * i];
+        int idx = -1;
+        for(int j = 0; j < ctx.compCount; j++) {
+            if(ctx.comp[j].id == cid) {
+                idx = j;
+                break;
+            }
+        }
+        if(idx < 0) {
+            return false;
+        }
+        component_t *c = &ctx.comp[idx];
+        c->td = tables >> 4;
+        c->ta = tables & 0x0F;
+        if(c->td > 3 || c->ta > 3 || !ctx.qDefined[c->tq]) {
+            return false;
+        }
+        // 流中没有DHT时回退到标准表（MJPEG常见）/ Fall back to standard tables when the stream has no DHT (common in MJPEG)
+        if(!ctx.dc[c->td].defined) {
+            build_decoder(&ctx.dc[c->td], idx == 0 ? STD_DC_LUM_BITS : STD_DC_CHR_BITS, STD_DC_VALS);
+        }
+        if(!ctx.ac[c->ta].defined) {
+            build_decoder(&ctx.ac[c->ta], idx == 0 ? STD_AC_LUM_BITS : STD_AC_CHR_BITS,
+                          idx == 0 ? STD_AC_LUM_VALS : STD_AC_CHR_VALS);
+        }
+        order[i] = idx;
+        sos[sosLen++] = cid;
+        sos[sosLen++] = (idx == 0) ? 0x00 : 0x11;
+    }
+    // Ss/Se/Ah/Al原样保留 / Keep Ss/Se/Ah/Al as is
+    sos[sosLen++] = p[1 + 2 * ns];
+    sos[sosLen++] = p[2 + 2 * ns];
+    sos[sosLen++] = p[3 + 2 * ns];
+
+    write_standard_dht();
+    write_segment(M_SOS, sos, sosLen);
+
+    ctx.in = scanStart;
+    ctx.inEnd = srcEnd;
+    ctx.bitBuf = 0;
+    ctx.bitCnt = 0;
+    ctx.hitMarker = false;
+    ctx.acc = 0;
+    ctx.accBits = 0;
+    return transcode_scan(order, ns);
+}
+
+/**
+ * @brief 在DCT域重量化一帧JPEG / Requantize one JPEG frame in the DCT domain
+ * @param src 源JPEG数据 / Source JPEG data
+ * @param srcLen 源JPEG长度 / Source JPEG length
+ * @param dst 输出缓冲区 / Output buffer
+ * @param dstCap 输出缓冲区容量 / Output buffer capacity
+ * @param dstLen 输出长度 / Output length
+ * @param scalePercent 量化步长放大百分比 / Quantization step scale in percent
+ * @return bool 成功返回true / Returns true on success
+ * @details 功能说明 / Function Description:
+ *          1. 逐段解析，APPn/COM/SOF/DRI原样复制 / Walk segments, copy APPn/COM/SOF/DRI as is
+ *          2. DQT按比例放大后写出，DHT只读入不复制 / Write DQT scaled, read DHT without copying it
+ *          3. SOS前写入标准DHT，然后转码扫描数据并写EOI / Write the standard DHT before SOS, transcode the scan and write EOI
+ * @note 源文件中第一个扫描之后的数据被忽略（基线JPEG只有一个扫描）/ Data after the first scan is ignored (baseline JPEG has a single scan)
+ */
+bool jpeg_requantize(const uint8_t *src, size_t srcLen, uint8_t *dst, size_t dstCap, size_t *dstLen, uint16_t scalePercent) {
+    if(!src || !dst || !dstLen || srcLen < 4 || scalePercent < JPEG_REQUANT_MIN_SCALE || scalePercent > JPEG_REQUANT_MAX_SCALE) {
+        return false;
+    }
+    if(src[0] != 0xFF || src[1] != M_SOI) {
+        return false;
+    }
+
+    // 编码表只需生成一次 / Encoding tables only need to be built once
+    if(!ctx.encReady) {
+        build_encoder(&ctx.encDc[0], STD_DC_LUM_BITS, STD_DC_VALS);
+        build_encoder(&ctx.encDc[1], STD_DC_CHR_BITS, STD_DC_VALS);
+        build_encoder(&ctx.encAc[0], STD_AC_LUM_BITS, STD_AC_LUM_VALS);
+        build_encoder(&ctx.encAc[1], STD_AC_CHR_BITS, STD_AC_CHR_VALS);
+        ctx.encReady = true;
+    }
+    for(int i = 0; i < 4; i++) {
+        ctx.dc[i].defined = false;
+        ctx.ac[i].defined = false;
+        ctx.qDefined[i] = false;
+    }
+    ctx.sofSeen = false;
+    ctx.restartInterval = 0;
+    ctx.out = dst;
+    ctx.outEnd = dst + dstCap;
+    ctx.overflow = false;
+
+    emit_byte(0xFF);
+    emit_byte(M_SOI);
+
+    const uint8_t *end = src + srcLen;
+    const uint8_t *p = src + 2;
+    while(p + 4 <= end) {
+        if(p[0] != 0xFF) {
+            return false;
+        }
+        // 跳过填充的0xFF / Skip fill 0xFF bytes
+        while(p + 1 < end && p[1] == 0xFF) {
+            p++;
+        }
+        uint8_t marker = p[1];
+        if(marker == M_EOI || marker == M_SOI || (marker & 0xF8) == M_RST0) {
+            return false;
+        }
+        uint16_t segLen = (p[2] << 8) | p[3];
+        if(segLen < 2 || p + 2 + segLen > end) {
+            return false;
+        }
+        const uint8_t *payload = p + 4;
+        uint16_t payloadLen = segLen - 2;
+
+        bool ok = true;
+        switch(marker) {
+            case M_DQT:
+                ok = handle_dqt(payload, payloadLen, scalePercent);
+                break;
+            case M_DHT:
+                ok = handle_dht(payload, payloadLen);
+                break;
+            case M_SOF0:
+            case M_SOF1:
+                ok = handle_sof(payload, payloadLen);
+                write_segment(marker, payload, payloadLen);
+                break;
+            case M_DRI:
+                ok = payloadLen >= 2;
+                if(ok) {
+                    ctx.restartInterval = (payload[0] << 8) | payload[1];
+                    write_segment(marker, payload, payloadLen);
+                }
+                break;
+            case M_SOS:
+                if(!handle_sos(payload, payloadLen, payload + payloadLen, end)) {
+                    return false;
+                }
+                emit_byte(0xFF);
+                emit_byte(M_EOI);
+                if(ctx.overflow) {
+                    return false;
+                }
+                *dstLen = ctx.out - dst;
+                return true;
+            default:
+                // 其他SOFn（渐进、无损、算术编码）不支持 / Other SOFn (progressive, lossless, arithmetic) are unsupported
+                if((marker >= 0xC2 && marker <= 0xCF) && marker != M_DHT && marker != 0xC8 && marker != 0xCC) {
+                    return false;
+                }
+                write_segment(marker, payload, payloadLen);
+                break;
+        }
+        if(!ok || ctx.overflow) {
+            return false;
+        }
+        p += 2 + segLen;
+    }
+    return false;
+}
@@ -0,0 +1,48 @@
+/**********************************************************************
+  文件名称 / Filename : jpeg_requant.h
+  文件用途 / File Purpose : JPEG DCT域重量化头文件 / JPEG DCT-Domain Requantization Header File
+               声明了在DCT系数域对基线JPEG进行粗量化重编码的函数原型
+               Declares function prototypes for re-encoding baseline JPEG at a coarser quantization in the DCT coefficient domain
+  作者 / Author : ESP32-S3监控项目 / ESP32-S3 Monitoring Project
+  修改日期 / Modification Date : 2026-02-05
+  硬件平台 / Hardware Platform : ESP32S3-EYE开发板 / ESP32S3-EYE Development Board
+  依赖库 / Dependencies : stdint.h / stddef.h - 标准类型 / Standard types
+  使用说明 / Usage Instructions : 1. 包含本头文件 #include "jpeg_requant.h" / Include this header file
+               2. 调用jpeg_requantize()将一帧JPEG重量化到输出缓冲区 / Call jpeg_requantize() to requantize one JPEG frame into an output buffer
+  参数调整 / Parameter Adjustment : scalePercent - 量化步长放大百分比（如200表示步长翻倍）/ Quantization step scale in percent (e.g. 200 doubles every step)
+  注意事项 / Important Notes : 只做熵解码→系数重量化→Huffman重编码，不做IDCT和像素重编码 / Only entropy-decode → requantize coefficients → re-Huffman-encode, no IDCT and no pixel re-encode
+               仅支持8位精度基线/扩展顺序Huffman JPEG（摄像头输出格式）/ Only 8-bit baseline/extended sequential Huffman JPEG is supported (the camera output format)
+               输出统一使用JPEG标准（Annex K）Huffman表 / Output always uses the standard (Annex K) Huffman tables
+               内部使用模块级静态上下文，同一时间只能由一个任务调用 / Uses a module-level static context, must be called from one task at a time
+**********************************************************************/
+
+#ifndef __JPEG_REQUANT_H
+#define __JPEG_REQUANT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// 最小/最大量化放大百分比 / Minimum/maximum quantization scale percent
+#define JPEG_REQUANT_MIN_SCALE 101
+#define JPEG_REQUANT_MAX_SCALE 800
+
+/**
+ * @brief 在DCT域重量化一帧JPEG / Requantize one JPEG frame in the DCT domain
+ * @param src 源JPEG数据 / Source JPEG data
+ * @param srcLen 源JPEG长度（字节）/ Source JPEG length (bytes)
+ * @param dst 输出缓冲区 / Output buffer
+ * @param dstCap 输出缓冲区容量（字节）/ Output buffer capacity (bytes)
+ * @param dstLen 输出JPEG长度（字节）/ Output JPEG length (bytes)
+ * @param scalePercent 量化步长放大百分比（101-800）/ Quantization step scale in percent (101-800)
+ * @return bool 成功返回true；格式不支持、数据损坏或输出缓冲区不足返回false
+ *         Returns true on success; false if the format is unsupported, the data is corrupt or the output buffer is too small
+ * @details 功能说明 / Function Description:
+ *          1. 解析DQT/SOF/DHT/DRI/SOS段 / Parse DQT/SOF/DHT/DRI/SOS segments
+ *          2. Huffman熵解码每个8x8块的量化系数 / Huffman entropy-decode the quantized coefficients of every 8x8 block
+ *          3. 系数按 旧步长/新步长 四舍五入重量化 / Requantize coefficients by old step / new step with rounding
+ *          4. 写入新DQT和标准Huffman表，重新熵编码 / Write the new DQT and standard Huffman tables, then re-entropy-encode
+ * @note 失败时调用方应保留原始帧 / On failure the caller should keep the original frame
+ */
+bool jpeg_requantize(const uint8_t *src, size_t srcLen, uint8_t *dst, size_t dstCap, size_t *dstLen, uint16_t scalePercent);
+
+#endif // __JPEG_REQUANT_H
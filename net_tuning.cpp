@@ -0,0 +1,214 @@
+/**********************************************************************
+  文件名称 / Filename : net_tuning.cpp
+  文件用途 / File Purpose : 网络连接调优实现文件 / Network Connection Tuning Implementation File
+               本文件实现了网络调优设置的加载保存，以及连接建立时的套接字选项设置
+               This file implements loading and saving the network tuning settings, and setting socket options when a connection opens
+               主要功能包括 / Main Features:
+               1. TCP_NODELAY（两个服务器）/ TCP_NODELAY (both servers)
+               2. 视频流连接的发送超时、发送缓冲和保活探测 / Send timeout, send buffer and keepalive probes on stream connections
+               3. 控制服务器的空闲连接回收 / Idle connection purging on the control server
+  作者 / Author : ESP32-S3监控项目 / ESP32-S3 Monitoring Project
+  修改日期 / Modification Date : 2026-02-05
+  硬件平台 / Hardware Platform : ESP32S3-EYE开发板 / ESP32S3-EYE Development Board
+  依赖库 / Dependencies : SD_MMC.h - SD卡文件系统 / SD card file system
+               lwip/sockets.h - 套接字选项 / Socket options
+  使用说明 / Usage Instructions : 1. 调用net_tuning_init()加载设置 / Call net_tuning_init() to load the settings
+  注意事项 / Important Notes : open_fn在服务器任务中调用，只做setsockopt()，不访问SD卡 / open_fn runs in the server task and only calls setsockopt(), it never touches the SD card
+**********************************************************************/
+
+#include "net_tuning.h"
+#include "SD_MMC.h"
+#include "sd_io.h"
+#include <lwip/sockets.h>
+
+// 设置文件内容 / Settings file contents
+typedef struct {
+    uint32_t magic;                     // 文件标识 / File magic
+    NetTuning tuning;                   // 设置 / Settings
+} NetTuningFile;
+
+// 当前设置（初始化前即为默认值）/ Current settings (defaults until initialised)
+static NetTuning netTuning = {
+    1, 1, 1, NET_TUNING_DEFAULT_KEEP_COUNT,
+    NET_TUNING_DEFAULT_KEEP_IDLE_S, NET_TUNING_DEFAULT_KEEP_INTERVAL_S,
+    NET_TUNING_DEFAULT_SEND_TIMEOUT_MS, 0, {0, 0, 0, 0}
+};
+
+// 互斥锁：Web服务修改，open_fn读取 / Mutex: the web server changes it, open_fn reads it
+static SemaphoreHandle_t netTuningMutex = NULL;
+
+static NetTuningStats netStats;
+static portMUX_TYPE netStatsMux = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief 检查设置是否有效 / Check whether the settings are valid
+ */
+static bool tuning_valid(const NetTuning *tuning) {
+    if(tuning->noDelay > 1 || tuning->keepAlive > 1 || tuning->lruPurge > 1 || tuning->sendTimeoutMs < 100) {
+        return false;
+    }
+    return !tuning->keepAlive || (tuning->keepIdleS > 0 && tuning->keepIntervalS > 0 && tuning->keepCount > 0);
+}
+
+/**
+ * @brief 设置一个整数选项，失败时计数 / Set one integer option, counting failures
+ */
+static void set_option(int sockfd, int level, int name, int value) {
+    if(setsockopt(sockfd, level, name, &value, sizeof(value)) != 0) {
+        portENTER_CRITICAL(&netStatsMux);
+        netStats.failures++;
+        netStats.lastErrno = errno;
+        portEXIT_CRITICAL(&netStatsMux);
+    }
+}
+
+/**
+ * @brief 控制连接建立 / A control connection opened
+ * @return esp_err_t 总是返回ESP_OK，选项设置失败不拒绝连接 / Always ESP_OK, a failed option does not refuse the connection
+ */
+static esp_err_t open_control(httpd_handle_t hd, int sockfd) {
+    NetTuning tuning;
+    net_tuning_get(&tuning);
+    set_option(sockfd, IPPROTO_TCP, TCP_NODELAY, tuning.noDelay);
+    portENTER_CRITICAL(&netStatsMux);
+    netStats.controlSockets++;
+    portEXIT_CRITICAL(&netStatsMux);
+    return ESP_OK;
+}
+
+/**
+ * @brief 视频流连接建立 / A stream connection opened
+ * @return esp_err_t 总是返回ESP_OK，选项设置失败不拒绝连接 / Always ESP_OK, a failed option does not refuse the connection
+ * @note 服务器在调用open_fn前已按send_wait_timeout设置了SO_SNDTIMEO，这里覆盖 / The server sets SO_SNDTIMEO from send_wait_timeout before open_fn, this overrides it
+ */
+static esp_err_t open_stream(httpd_handle_t hd, int sockfd) {
+    NetTuning tuning;
+    net_tuning_get(&tuning);
+    set_option(sockfd, IPPROTO_TCP, TCP_NODELAY, tuning.noDelay);
+
+    struct timeval timeout;
+    timeout.tv_sec = tuning.sendTimeoutMs / 1000;
+    timeout.tv_usec = (tuning.sendTimeoutMs % 1000) * 1000;
+    if(setsockopt(sockfd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)) != 0) {
+        portENTER_CRITICAL(&netStatsMux);
+        netStats.failures++;
+        netStats.lastErrno = errno;
+        portEXIT_CRITICAL(&netStatsMux);
+    }
+    if(tuning.sendBufKB) {
+        set_option(sockfd, SOL_SOCKET, SO_SNDBUF, tuning.sendBufKB * 1024);
+    }
+
+    // 保活探测：观看者掉线后不再回应，探测失败即断开 / Keepalive: a vanished viewer stops answering and is dropped once the probes fail
+    set_option(sockfd, SOL_SOCKET, SO_KEEPALIVE, tuning.keepAlive);
+    if(tuning.keepAlive) {
+        set_option(sockfd, IPPROTO_TCP, TCP_KEEPIDLE, tuning.keepIdleS);
+        set_option(sockfd, IPPROTO_TCP, TCP_KEEPINTVL, tuning.keepIntervalS);
+        set_option(sockfd, IPPROTO_TCP, TCP_KEEPCNT, tuning.keepCount);
+    }
+    portENTER_CRITICAL(&netStatsMux);
+    netStats.streamSockets++;
+    portEXIT_CRITICAL(&netStatsMux);
+    return ESP_OK;
+}
+
+/**
+ * @brief 加载网络调优设置 / Load the network tuning settings
+ * @return bool 从SD卡加载返回true，使用默认值返回false / Returns true if loaded from the SD card, false if defaults apply
+ */
+bool net_tuning_init(void) {
+    if(!netTuningMutex) {
+        netTuningMutex = xSemaphoreCreateMutex();
+    }
+    NetTuningFile contents;
+    sd_io_begin(SD_IO_STORE);
+    File file = SD_MMC.exists(NET_TUNING_FILE) ? SD_MMC.open(NET_TUNING_FILE, FILE_READ) : File();
+    if(!file) {
+        sd_io_end(SD_IO_STORE, 0);
+        return false;
+    }
+    bool ok = file.read((uint8_t*)&contents, sizeof(contents)) == sizeof(contents) &&
+              contents.magic == NET_TUNING_MAGIC && tuning_valid(&contents.tuning);
+    file.close();
+    sd_io_end(SD_IO_STORE, sizeof(contents));
+    if(!ok) {
+        Serial.println("Network tuning file is corrupt, using defaults / 网络调优文件损坏，使用默认值");
+        return false;
+    }
+    xSemaphoreTake(netTuningMutex, portMAX_DELAY);
+    netTuning = contents.tuning;
+    xSemaphoreGive(netTuningMutex);
+    Serial.printf("Network tuning loaded: nodelay %u, keepalive %u (%u/%u/%u), send timeout %u ms, send buffer %u KB / 已加载网络调优设置\n",
+                  contents.tuning.noDelay, contents.tuning.keepAlive, contents.tuning.keepIdleS, contents.tuning.keepIntervalS,
+                  contents.tuning.keepCount, contents.tuning.sendTimeoutMs, contents.tuning.sendBufKB);
+    return true;
+}
+
+/**
+ * @brief 获取网络调优设置 / Get the network tuning settings
+ */
+void net_tuning_get(NetTuning *tuning) {
+    if(netTuningMutex) {
+        xSemaphoreTake(netTuningMutex, portMAX_DELAY);
+    }
+    *tuning = netTuning;
+    if(netTuningMutex) {
+        xSemaphoreGive(netTuningMutex);
+    }
+}
+
+/**
+ * @brief 设置并保存网络调优设置 / Set and save the network tuning settings
+ * @return bool 成功返回true / Returns true on success
+ */
+bool net_tuning_set(const NetTuning *tuning) {
+    if(!netTuningMutex || !tuning_valid(tuning)) {
+        return false;
+    }
+    NetTuningFile contents;
+    memset(&contents, 0, sizeof(contents));
+    contents.magic = NET_TUNING_MAGIC;
+    contents.tuning = *tuning;
+    memset(contents.tuning.reserved, 0, sizeof(contents.tuning.reserved));
+
+    // 先取总线再加锁，与其他模块一致 / Take the bus before the lock, like the other modules
+    sd_io_begin(SD_IO_STORE);
+    xSemaphoreTake(netTuningMutex, portMAX_DELAY);
+    File file = SD_MMC.open(NET_TUNING_FILE, FILE_WRITE);
+    bool ok = file && file.write((uint8_t*)&contents, sizeof(contents)) == sizeof(contents);
+    if(file) {
+        file.close();
+    }
+    if(ok) {
+        netTuning = contents.tuning;
+    } else {
+        Serial.println("Failed to write network tuning file / 无法写入网络调优文件");
+    }
+    xSemaphoreGive(netTuningMutex);
+    sd_io_end(SD_IO_STORE, sizeof(contents));
+    return ok;
+}
+
+/**
+ * @brief 填写服务器配置 / Fill in a server configuration
+ */
+void net_tuning_configure(httpd_config_t *config, bool stream) {
+    NetTuning tuning;
+    net_tuning_get(&tuning);
+    if(stream) {
+        config->open_fn = open_stream;
+        config->lru_purge_enable = false;
+    } else {
+        config->open_fn = open_control;
+        config->lru_purge_enable = tuning.lruPurge;
+    }
+}
+
+/**
+ * @brief 获取调优统计 / Get the tuning statistics
+ */
+void net_tuning_get_stats(NetTuningStats *stats) {
+    portENTER_CRITICAL(&netStatsMux);
+    *stats = netStats;
+    portEXIT_CRITICAL(&netStatsMux);
+}
@@ -0,0 +1,98 @@
+/**********************************************************************
+  文件名称 / Filename : net_tuning.h
+  文件用途 / File Purpose : 网络连接调优头文件 / Network Connection Tuning Header File
+               声明了运行时可配置的TCP_NODELAY、发送缓冲、发送超时、保活探测和空闲控制连接回收相关的函数原型和宏定义
+               Declares function prototypes and macro definitions for runtime-configurable TCP_NODELAY, send buffer, send timeout, keepalive probes and idle control socket purging
+  作者 / Author : ESP32-S3监控项目 / ESP32-S3 Monitoring Project
+  修改日期 / Modification Date : 2026-02-05
+  硬件平台 / Hardware Platform : ESP32S3-EYE开发板 / ESP32S3-EYE Development Board
+  依赖库 / Dependencies : esp_http_server.h - open_fn回调 / open_fn callback
+               lwip/sockets.h - 套接字选项 / Socket options
+  使用说明 / Usage Instructions : 1. 包含本头文件 #include "net_tuning.h" / Include this header file
+               2. SD卡初始化后、启动Web服务前调用net_tuning_init()加载设置 / Call net_tuning_init() after SD card init and before starting the web servers to load the settings
+               3. httpd_start()前调用net_tuning_configure()填入open_fn和回收设置 / Call net_tuning_configure() before httpd_start() to fill in open_fn and the purge setting
+  参数调整 / Parameter Adjustment : NET_TUNING_DEFAULT_* - 设置文件缺失时的默认值 / Defaults when the settings file is missing
+  注意事项 / Important Notes : 设置保存在SD卡的定长二进制文件中，文件缺失或损坏时使用默认值 / Settings are stored in a fixed-size binary file on the SD card, defaults apply when it is missing or corrupt
+               套接字选项在连接建立时设置，修改后对新连接生效；lruPurge在重启后生效 / Socket options are set when a connection opens, changes apply to new connections; lruPurge applies after a restart
+               视频流服务器不做LRU回收（会断开正在观看的连接），失效的观看者由保活探测和发送超时回收
+                  The stream server never purges by LRU (that would cut off active viewers), dead viewers are reaped by keepalive probes and the send timeout
+               lwIP的TCP发送缓冲在编译时确定（CONFIG_LWIP_TCP_SND_BUF_DEFAULT），不支持SO_SNDBUF时计入失败次数
+                  lwIP's TCP send buffer is fixed at build time (CONFIG_LWIP_TCP_SND_BUF_DEFAULT), a rejected SO_SNDBUF counts as a failure
+**********************************************************************/
+
+#ifndef __NET_TUNING_H
+#define __NET_TUNING_H
+
+#include "Arduino.h"
+#include "esp_http_server.h"
+
+// 设置文件路径 / Settings file path
+#define NET_TUNING_FILE "/camera/net_tuning.dat"
+
+// 设置文件标识 / Settings file magic
+#define NET_TUNING_MAGIC 0x3154454E  // 'NET1'
+
+// 默认值 / Defaults
+#define NET_TUNING_DEFAULT_SEND_TIMEOUT_MS 5000     // 与HTTPD_DEFAULT_CONFIG()的send_wait_timeout相同 / Same as send_wait_timeout of HTTPD_DEFAULT_CONFIG()
+#define NET_TUNING_DEFAULT_KEEP_IDLE_S 5            // 空闲5秒后开始探测 / Probing starts after 5 idle seconds
+#define NET_TUNING_DEFAULT_KEEP_INTERVAL_S 2        // 探测间隔 / Probe interval
+#define NET_TUNING_DEFAULT_KEEP_COUNT 3             // 探测3次无应答即断开 / Dropped after 3 unanswered probes
+
+// 网络调优设置（定长16字节）/ Network tuning settings (fixed 16 bytes)
+typedef struct {
+    uint8_t noDelay;                    // TCP_NODELAY，1为关闭Nagle算法 / TCP_NODELAY, 1 turns Nagle's algorithm off
+    uint8_t keepAlive;                  // 视频流连接保活探测 / Keepalive probes on stream connections
+    uint8_t lruPurge;                   // 控制服务器连接满时回收最久未用的连接 / Purge the least recently used control connection when they run out
+    uint8_t keepCount;                  // 保活探测次数 / Keepalive probe count
+    uint16_t keepIdleS;                 // 开始探测前的空闲时间（秒）/ Idle time before probing (s)
+    uint16_t keepIntervalS;             // 探测间隔（秒）/ Probe interval (s)
+    uint16_t sendTimeoutMs;             // 视频流发送超时（毫秒）/ Stream send timeout (ms)
+    uint16_t sendBufKB;                 // 视频流发送缓冲（KB），0为系统默认 / Stream send buffer (KB), 0 for the system default
+    uint8_t reserved[4];                // 保留 / Reserved
+} NetTuning;
+
+// 调优统计 / Tuning statistics
+typedef struct {
+    uint32_t controlSockets;            // 已调优的控制连接数 / Control connections tuned
+    uint32_t streamSockets;             // 已调优的视频流连接数 / Stream connections tuned
+    uint32_t failures;                  // 设置失败的选项数 / Options that failed to apply
+    int lastErrno;                      // 最近一次失败的errno / errno of the last failure
+} NetTuningStats;
+
+/**
+ * @brief 加载网络调优设置 / Load the network tuning settings
+ * @return bool 从SD卡加载返回true，使用默认值返回false / Returns true if loaded from the SD card, false if defaults apply
+ */
+bool net_tuning_init(void);
+
+/**
+ * @brief 获取网络调优设置 / Get the network tuning settings
+ * @param tuning 输出设置 / Output settings
+ */
+void net_tuning_get(NetTuning *tuning);
+
+/**
+ * @brief 设置并保存网络调优设置 / Set and save the network tuning settings
+ * @param tuning 新设置 / New settings
+ * @return bool 成功返回true，参数无效或写卡失败返回false / Returns true on success, false if invalid or the SD write failed
+ * @note 写卡失败时内存中的设置保持不变 / The in-memory settings are unchanged when the SD write fails
+ */
+bool net_tuning_set(const NetTuning *tuning);
+
+/**
+ * @brief 填写服务器配置 / Fill in a server configuration
+ * @param config 服务器配置 / Server configuration
+ * @param stream true为视频流服务器，false为控制服务器 / true for the stream server, false for the control server
+ * @details 功能说明 / Function Description:
+ *          1. 设置open_fn，连接建立时设置套接字选项 / Set open_fn so socket options are set when a connection opens
+ *          2. 控制服务器按lruPurge回收空闲连接，视频流服务器不回收 / The control server purges idle connections per lruPurge, the stream server never does
+ */
+void net_tuning_configure(httpd_config_t *config, bool stream);
+
+/**
+ * @brief 获取调优统计 / Get the tuning statistics
+ * @param stats 输出统计 / Output statistics
+ */
+void net_tuning_get_stats(NetTuningStats *stats);
+
+#endif // __NET_TUNING_H
@@ -0,0 +1,274 @@
+/**********************************************************************
+  文件名称 / Filename : photo_burst.cpp
+  文件用途 / File Purpose : 连拍实现文件 / Burst Photo Capture Implementation File
+               本文件实现了连拍到PSRAM和后台写入SD卡
+               This file implements burst capture into PSRAM and background flushing to the SD card
+               主要功能包括 / Main Features:
+               1. 以传感器最高帧率连续取帧 / Grab frames back to back at the sensor's full frame rate
+               2. PSRAM占用上限控制 / PSRAM usage limit
+               3. 后台任务按拍摄时间写入照片 / Background task writes photos under their capture time
+               4. 按编号记录保存结果 / Save results recorded by photo ID
+  作者 / Author : ESP32-S3监控项目 / ESP32-S3 Monitoring Project
+  修改日期 / Modification Date : 2026-02-05
+  硬件平台 / Hardware Platform : ESP32S3-EYE开发板 / ESP32S3-EYE Development Board
+  依赖库 / Dependencies : esp_camera.h - ESP32摄像头驱动 / ESP32 camera driver
+  使用说明 / Usage Instructions : 1. 调用photo_burst_init()启动写入任务 / Call photo_burst_init() to start the flush task
+  注意事项 / Important Notes : 队列中只传指针，照片数据由写入任务写完后释放 / Only pointers go through the queue, the flush task frees the photo data once written
+**********************************************************************/
+
+#include "photo_burst.h"
+#include "sd_read_write.h"
+#include "hires_snapshot.h"
+#include "photo_pack.h"
+#include "esp_camera.h"
+
+// 等待写入的照片 / Photo waiting to be written
+typedef struct {
+    uint8_t *buf;               // JPEG数据（PSRAM）/ JPEG data (PSRAM)
+    size_t len;                 // JPEG长度 / JPEG length
+    time_t when;                // 拍摄时间 / Capture time
+    uint32_t id;                // 照片编号 / Photo ID
+} BurstPhoto;
+
+// 保存结果 / Save result
+typedef struct {
+    uint32_t id;                // 照片编号 / Photo ID
+    PhotoSaveState state;       // 保存状态 / Save state
+    char path[64];              // 保存路径 / Saved path
+} PhotoSaveResult;
+
+// 写入队列 / Flush queue
+static QueueHandle_t burstQueue = NULL;
+
+// 等待写入的照片数和字节数 / Photos and bytes waiting to be written
+static uint32_t burstPendingFrames = 0;
+static uint32_t burstPendingBytes = 0;
+static portMUX_TYPE burstPendingMux = portMUX_INITIALIZER_UNLOCKED;
+
+// 最近的保存结果（按编号取模存放，与额度共用锁）/ Recent save results (stored by ID modulo, sharing the budget lock)
+static PhotoSaveResult saveResults[PHOTO_BURST_RESULT_SLOTS];
+static uint32_t nextPhotoId = 1;
+
+/**
+ * @brief 预留PSRAM额度并分配编号 / Reserve PSRAM budget and assign an ID
+ * @return uint32_t 照片编号，额度不足返回0 / Photo ID, 0 if the budget does not allow it
+ */
+static uint32_t reserve_pending(size_t len) {
+    uint32_t id = 0;
+    portENTER_CRITICAL(&burstPendingMux);
+    if(burstPendingFrames < PHOTO_BURST_QUEUE_LEN && burstPendingBytes + len <= PHOTO_BURST_MAX_PENDING_BYTES) {
+        burstPendingFrames++;
+        burstPendingBytes += len;
+        id = nextPhotoId++;
+        if(nextPhotoId == 0) {
+            nextPhotoId = 1;
+        }
+        PhotoSaveResult *slot = &saveResults[id % PHOTO_BURST_RESULT_SLOTS];
+        slot->id = id;
+        slot->state = PHOTO_SAVE_PENDING;
+        slot->path[0] = '\0';
+    }
+    portEXIT_CRITICAL(&burstPendingMux);
+    return id;
+}
+
+/**
+ * @brief 记录保存结果 / Record a save result
+ */
+static void set_result(uint32_t id, PhotoSaveState state, const char *path) {
+    portENTER_CRITICAL(&burstPendingMux);
+    PhotoSaveResult *slot = &saveResults[id % PHOTO_BURST_RESULT_SLOTS];
+    if(slot->id == id) {
+        slot->state = state;
+        strncpy(slot->path, path ? path : "", sizeof(slot->path) - 1);
+        slot->path[sizeof(slot->path) - 1] = '\0';
+    }
+    portEXIT_CRITICAL(&burstPendingMux);
+}
+
+/**
+ * @brief 归还PSRAM额度 / Release PSRAM budget
+ */
+static void release_pending(size_t len) {
+    portENTER_CRITICAL(&burstPendingMux);
+    burstPendingFrames--;
+    burstPendingBytes -= len;
+    portEXIT_CRITICAL(&burstPendingMux);
+}
+
+/**
+ * @brief 保存一张照片 / Save one photo
+ * @param path 输出保存位置 / Output saved location
+ * @return bool 成功返回true / Returns true on success
+ * @note 启用日包时保存位置为读取照片的接口地址 / With daily packs enabled the saved location is the URL that serves the photo
+ */
+static bool save_photo(const BurstPhoto *photo, char *path, size_t pathSize) {
+#if PHOTO_PACK_ENABLE
+    uint64_t packId = photo_pack_append(photo->buf, photo->len, photo->when);
+    if(packId) {
+        snprintf(path, pathSize, "/photo?id=%llu", (unsigned long long)packId);
+    }
+    return packId != 0;
+#else
+    return savePhotoToSDAt(photo->buf, photo->len, photo->when, path, pathSize);
+#endif
+}
+
+/**
+ * @brief 连拍写入任务 / Burst flush task
+ * @param pvParameters 未使用 / Unused
+ */
+static void photo_burst_task(void *pvParameters) {
+    BurstPhoto photo;
+    char path[64];
+    while(true) {
+        if(xQueueReceive(burstQueue, &photo, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        if(save_photo(&photo, path, sizeof(path))) {
+            set_result(photo.id, PHOTO_SAVE_DONE, path);
+        } else {
+            Serial.println("Failed to save queued photo / 照片保存失败");
+            set_result(photo.id, PHOTO_SAVE_FAILED, NULL);
+        }
+        free(photo.buf);
+        release_pending(photo.len);
+    }
+}
+
+/**
+ * @brief 启动连拍写入任务 / Start the burst flush task
+ * @return bool 成功返回true / Returns true on success
+ */
+bool photo_burst_init(void) {
+    if(burstQueue) {
+        return true;
+    }
+    burstQueue = xQueueCreate(PHOTO_BURST_QUEUE_LEN, sizeof(BurstPhoto));
+    if(!burstQueue) {
+        return false;
+    }
+    return xTaskCreatePinnedToCore(photo_burst_task, "photo_burst", PHOTO_BURST_TASK_STACK, NULL,
+                                   PHOTO_BURST_TASK_PRIORITY, NULL, PHOTO_BURST_TASK_CORE) == pdPASS;
+}
+
+/**
+ * @brief 连拍 / Take a burst
+ * @return bool 至少拍到一帧返回true / Returns true if at least one frame was captured
+ */
+bool photo_burst_capture(int count, PhotoBurstResult *result) {
+    memset(result, 0, sizeof(PhotoBurstResult));
+    if(!burstQueue || count < 1) {
+        return false;
+    }
+    if(count > PHOTO_BURST_MAX_FRAMES) {
+        count = PHOTO_BURST_MAX_FRAMES;
+    }
+    if(!hires_snapshot_lock(HIRES_SNAPSHOT_LOCK_TIMEOUT_MS)) {
+        return false;
+    }
+
+    // 独占摄像头连续取帧，只做内存复制 / Grab frames back to back while holding the camera, memory copies only
+    BurstPhoto photos[PHOTO_BURST_MAX_FRAMES];
+    int captured = 0;
+    uint32_t start = millis();
+    while(captured < count) {
+        camera_fb_t *fb = esp_camera_fb_get();
+        if(!fb) {
+            break;
+        }
+        BurstPhoto *photo = &photos[captured];
+        photo->id = reserve_pending(fb->len);
+        if(!photo->id) {
+            esp_camera_fb_return(fb);
+            break;
+        }
+        photo->buf = (uint8_t*)ps_malloc(fb->len);
+        if(!photo->buf) {
+            set_result(photo->id, PHOTO_SAVE_FAILED, NULL);
+            release_pending(fb->len);
+            esp_camera_fb_return(fb);
+            break;
+        }
+        memcpy(photo->buf, fb->buf, fb->len);
+        photo->len = fb->len;
+        photo->when = time(nullptr);
+        esp_camera_fb_return(fb);
+        captured++;
+    }
+    result->elapsedMs = millis() - start;
+    hires_snapshot_unlock();
+
+    // 录像中标记这段间隙 / Mark the gap in the recording
+    markVideoGap(result->elapsedMs);
+
+    for(int i = 0; i < captured; i++) {
+        if(xQueueSend(burstQueue, &photos[i], 0) != pdTRUE) {
+            // 额度已保证队列有空位，这里只做保护 / The budget guarantees a free slot, this is only a safeguard
+            free(photos[i].buf);
+            set_result(photos[i].id, PHOTO_SAVE_FAILED, NULL);
+            release_pending(photos[i].len);
+        }
+    }
+    result->captured = captured;
+    result->firstId = captured > 0 ? photos[0].id : 0;
+    result->pendingFrames = photo_burst_pending();
+    return captured > 0;
+}
+
+/**
+ * @brief 预留一张待写入照片 / Reserve one photo for writing
+ * @return uint32_t 照片编号，额度或队列已满返回0 / Photo ID, 0 when the budget or the queue is full
+ */
+uint32_t photo_burst_reserve(size_t len) {
+    if(!burstQueue) {
+        return 0;
+    }
+    return reserve_pending(len);
+}
+
+/**
+ * @brief 提交预留的照片 / Submit a reserved photo
+ */
+void photo_burst_submit(uint32_t id, uint8_t *buf, size_t len, time_t when) {
+    BurstPhoto photo = {buf, len, when, id};
+    if(xQueueSend(burstQueue, &photo, 0) != pdTRUE) {
+        // 额度已保证队列有空位，这里只做保护 / The budget guarantees a free slot, this is only a safeguard
+        free(buf);
+        set_result(id, PHOTO_SAVE_FAILED, NULL);
+        release_pending(len);
+    }
+}
+
+/**
+ * @brief 查询照片保存结果 / Look up a photo's save result
+ * @return PhotoSaveState 保存状态 / Save state
+ */
+PhotoSaveState photo_burst_lookup(uint32_t id, char *path, size_t pathSize) {
+    PhotoSaveState state = PHOTO_SAVE_UNKNOWN;
+    if(pathSize > 0) {
+        path[0] = '\0';
+    }
+    portENTER_CRITICAL(&burstPendingMux);
+    PhotoSaveResult *slot = &saveResults[id % PHOTO_BURST_RESULT_SLOTS];
+    if(id != 0 && slot->id == id) {
+        state = slot->state;
+        if(pathSize > 0) {
+            strncpy(path, slot->path, pathSize - 1);
+            path[pathSize - 1] = '\0';
+        }
+    }
+    portEXIT_CRITICAL(&burstPendingMux);
+    return state;
+}
+
+/**
+ * @brief 获取等待写入的照片数 / Get the number of photos waiting to be written
+ * @return uint32_t 照片数 / Photo count
+ */
+uint32_t photo_burst_pending(void) {
+    portENTER_CRITICAL(&burstPendingMux);
+    uint32_t pending = burstPendingFrames;
+    portEXIT_CRITICAL(&burstPendingMux);
+    return pending;
+}
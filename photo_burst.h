@@ -0,0 +1,115 @@
+/**********************************************************************
+  文件名称 / Filename : photo_burst.h
+  文件用途 / File Purpose : 连拍头文件 / Burst Photo Capture Header File
+               声明了连拍到PSRAM、后台写入SD卡相关的函数原型和宏定义
+               Declares function prototypes and macro definitions for burst capture into PSRAM with background flushing to the SD card
+               /capture的单张照片也通过同一队列异步写入 / Single /capture photos go through the same queue and are written asynchronously
+  作者 / Author : ESP32-S3监控项目 / ESP32-S3 Monitoring Project
+  修改日期 / Modification Date : 2026-02-05
+  硬件平台 / Hardware Platform : ESP32S3-EYE开发板 / ESP32S3-EYE Development Board
+  依赖库 / Dependencies : esp_camera.h - ESP32摄像头驱动 / ESP32 camera driver
+               sd_read_write.h - 照片保存 / Photo saving
+               photo_pack.h - 照片日包 / Daily photo packs
+               hires_snapshot.h - 摄像头独占锁 / Exclusive camera lock
+  使用说明 / Usage Instructions : 1. 包含本头文件 #include "photo_burst.h" / Include this header file
+               2. SD卡初始化后调用photo_burst_init()启动写入任务 / Call photo_burst_init() after SD card init to start the flush task
+               3. 调用photo_burst_capture()连拍 / Call photo_burst_capture() to take a burst
+               4. 单张照片先photo_burst_reserve()取编号，再photo_burst_submit()交给写入任务 / For a single photo, take an ID with photo_burst_reserve() and hand it over with photo_burst_submit()
+               5. 调用photo_burst_lookup()按编号查询保存路径 / Call photo_burst_lookup() to look up the saved path by ID
+  参数调整 / Parameter Adjustment : PHOTO_BURST_MAX_FRAMES - 单次连拍最多帧数（默认10）/ Maximum frames per burst (default 10)
+               PHOTO_BURST_MAX_PENDING_BYTES - 等待写入的PSRAM上限（默认4MB）/ PSRAM limit for frames waiting to be written (default 4MB)
+  注意事项 / Important Notes : 连拍期间独占摄像头，录像以空帧标记间隙 / The camera is held for the burst, the recording marks the gap with empty frames
+               照片按拍摄时间命名，写入时间晚于拍摄时间不影响文件名 / Photos are named by capture time, a later write does not change the name
+               只保留最近PHOTO_BURST_RESULT_SLOTS个编号的保存结果 / Only the results of the latest PHOTO_BURST_RESULT_SLOTS IDs are kept
+**********************************************************************/
+
+#ifndef __PHOTO_BURST_H
+#define __PHOTO_BURST_H
+
+#include "Arduino.h"
+
+// 单次连拍最多帧数 / Maximum frames per burst
+#define PHOTO_BURST_MAX_FRAMES 10
+
+// 等待写入的照片最多占用的PSRAM（字节）/ Maximum PSRAM held by photos waiting to be written (bytes)
+#define PHOTO_BURST_MAX_PENDING_BYTES (4 * 1024 * 1024)
+
+// 写入队列长度 / Flush queue length
+#define PHOTO_BURST_QUEUE_LEN 32
+
+// 写入任务参数 / Flush task parameters
+#define PHOTO_BURST_TASK_CORE 0
+#define PHOTO_BURST_TASK_PRIORITY 2
+#define PHOTO_BURST_TASK_STACK 4096
+
+// 保留的保存结果数 / Save results kept
+#define PHOTO_BURST_RESULT_SLOTS 32
+
+// 照片保存状态 / Photo save state
+typedef enum {
+    PHOTO_SAVE_UNKNOWN = 0,     // 编号不存在或结果已被覆盖 / No such ID, or its result was overwritten
+    PHOTO_SAVE_PENDING,         // 等待写入 / Waiting to be written
+    PHOTO_SAVE_DONE,            // 已保存 / Saved
+    PHOTO_SAVE_FAILED           // 写入失败 / Write failed
+} PhotoSaveState;
+
+// 连拍结果 / Burst result
+typedef struct {
+    int captured;               // 实际拍到的帧数 / Frames actually captured
+    uint32_t elapsedMs;         // 拍摄耗时（毫秒）/ Capture time (ms)
+    uint32_t pendingFrames;     // 等待写入的照片数（含本次）/ Photos waiting to be written (including this burst)
+    uint32_t firstId;           // 第一张照片的编号，后续照片编号依次加1 / ID of the first photo, the following photos count up from it
+} PhotoBurstResult;
+
+/**
+ * @brief 启动连拍写入任务 / Start the burst flush task
+ * @return bool 成功返回true / Returns true on success
+ */
+bool photo_burst_init(void);
+
+/**
+ * @brief 连拍 / Take a burst
+ * @param count 帧数（1~PHOTO_BURST_MAX_FRAMES）/ Frame count (1~PHOTO_BURST_MAX_FRAMES)
+ * @param result 输出结果 / Output result
+ * @return bool 至少拍到一帧返回true / Returns true if at least one frame was captured
+ * @details 功能说明 / Function Description:
+ *          1. 独占摄像头，连续取帧并复制到PSRAM / Hold the camera, grab frames back to back and copy them to PSRAM
+ *          2. 放开摄像头后把照片放入写入队列立即返回 / Release the camera, queue the photos and return at once
+ *          3. 后台任务写入当天的照片包（PHOTO_PACK_ENABLE为0时通过savePhotoToSDAt()写入）/ The background task appends them to the day's photo pack (through savePhotoToSDAt() when PHOTO_PACK_ENABLE is 0)
+ * @note PSRAM或队列不足时提前停止，captured小于count / Stops early when PSRAM or the queue runs out, captured is then less than count
+ */
+bool photo_burst_capture(int count, PhotoBurstResult *result);
+
+/**
+ * @brief 预留一张待写入照片 / Reserve one photo for writing
+ * @param len JPEG长度 / JPEG length
+ * @return uint32_t 照片编号，PSRAM额度或队列已满返回0 / Photo ID, 0 when the PSRAM budget or the queue is full
+ * @note 预留后必须调用photo_burst_submit() / Must be followed by photo_burst_submit()
+ */
+uint32_t photo_burst_reserve(size_t len);
+
+/**
+ * @brief 提交预留的照片 / Submit a reserved photo
+ * @param id photo_burst_reserve()返回的编号 / ID returned by photo_burst_reserve()
+ * @param buf JPEG数据（ps_malloc分配，提交后由写入任务释放）/ JPEG data (allocated with ps_malloc, freed by the flush task once submitted)
+ * @param len JPEG长度，与预留时相同 / JPEG length, the same as reserved
+ * @param when 拍摄时间 / Capture time
+ */
+void photo_burst_submit(uint32_t id, uint8_t *buf, size_t len, time_t when);
+
+/**
+ * @brief 查询照片保存结果 / Look up a photo's save result
+ * @param id 照片编号 / Photo ID
+ * @param path 输出保存路径（已保存时）/ Receives the saved path (when saved)
+ * @param pathSize path缓冲区大小 / Size of the path buffer
+ * @return PhotoSaveState 保存状态 / Save state
+ */
+PhotoSaveState photo_burst_lookup(uint32_t id, char *path, size_t pathSize);
+
+/**
+ * @brief 获取等待写入的照片数 / Get the number of photos waiting to be written
+ * @return uint32_t 照片数 / Photo count
+ */
+uint32_t photo_burst_pending(void);
+
+#endif // __PHOTO_BURST_H
@@ -0,0 +1,482 @@
+/**********************************************************************
+  文件名称 / Filename : photo_pack.cpp
+  文件用途 / File Purpose : 照片日包实现文件 / Daily Photo Pack Implementation File
+               本文件实现了照片按天顺序追加到包文件和按编号读取
+               This file implements appending photos to one pack file per day and reading them back by ID
+               主要功能包括 / Main Features:
+               1. 顺序追加照片，不再每张照片新建FAT文件 / Sequential appends instead of one FAT file per photo
+               2. 封包时写入末尾索引 / Trailing index written when a pack is sealed
+               3. 断电后由记录头重建索引并截掉残缺数据 / Index rebuilt from record headers after a power loss, with any torn tail cut off
+               4. 按编号定位照片 / Photo lookup by ID
+  作者 / Author : ESP32-S3监控项目 / ESP32-S3 Monitoring Project
+  修改日期 / Modification Date : 2026-02-05
+  硬件平台 / Hardware Platform : ESP32S3-EYE开发板 / ESP32S3-EYE Development Board
+  依赖库 / Dependencies : SD_MMC.h - SD卡文件系统 / SD card file system
+               unistd.h - truncate()截断包文件 / truncate() for cutting pack files
+  使用说明 / Usage Instructions : 1. 调用photo_pack_init()恢复当天的包 / Call photo_pack_init() to recover today's pack
+  注意事项 / Important Notes : 打开的包在每张照片后flush，索引条目在flush之后才加入，读取方只会看到完整的照片
+                  The open pack is flushed after every photo and the index entry is only added afterwards, so readers only ever see complete photos
+**********************************************************************/
+
+#include "photo_pack.h"
+#include "catalog.h"
+#include "sd_space.h"
+#include "sd_io.h"
+#include "storage_stats.h"
+#include <unistd.h>
+#include <time.h>
+
+// 正在写入的包 / Pack being written
+static File packFile;
+static bool packOpen = false;
+static uint32_t packDate = 0;
+static char packPath[64];
+static uint32_t packBytes = 0;              // 已写入的数据长度（不含索引）/ Data written so far (excluding the index)
+static uint32_t packLastTime = 0;           // 最后一张照片的拍摄时间 / Capture time of the last photo
+static uint32_t packResealDate = 0;         // 封存失败、等待重新封存的包的日期 / Date of a pack whose sealing failed and is waiting to be sealed again
+
+// 内存索引（PSRAM）/ In-memory index (PSRAM)
+static PhotoPackIndexEntry *packIndex = NULL;
+static uint32_t packCount = 0;
+static uint32_t packIndexCap = 0;
+
+// 互斥锁：写入任务追加，Web服务读取 / Mutex: the flush task appends, the web server reads
+static SemaphoreHandle_t packMutex = NULL;
+
+/**
+ * @brief 时间对应的日期 / Date of a time
+ * @return uint32_t 日期（YYYYMMDD）/ Date (YYYYMMDD)
+ */
+static uint32_t date_of(time_t when) {
+    struct tm timeinfo;
+    localtime_r(&when, &timeinfo);
+    return (timeinfo.tm_year + 1900) * 10000 + (timeinfo.tm_mon + 1) * 100 + timeinfo.tm_mday;
+}
+
+/**
+ * @brief 日期当天零点 / Local midnight of a date
+ */
+static time_t midnight_of(uint32_t date) {
+    struct tm timeinfo;
+    memset(&timeinfo, 0, sizeof(timeinfo));
+    timeinfo.tm_year = date / 10000 - 1900;
+    timeinfo.tm_mon = date / 100 % 100 - 1;
+    timeinfo.tm_mday = date % 100;
+    timeinfo.tm_isdst = -1;
+    return mktime(&timeinfo);
+}
+
+/**
+ * @brief 生成包文件路径 / Build a pack file path
+ */
+static void pack_path(uint32_t date, char *path, size_t pathSize) {
+    char dateDir[48];
+    dateDirPath(PHOTO_DIR, date, dateDir, sizeof(dateDir));
+    snprintf(path, pathSize, "%s/%08lu0000%s", dateDir, (unsigned long)date, PHOTO_PACK_EXT);
+}
+
+/**
+ * @brief 截断包文件 / Truncate a pack file
+ * @return bool 成功返回true / Returns true on success
+ */
+static bool truncate_pack(const char *path, uint32_t size) {
+    char fullPath[80];
+    snprintf(fullPath, sizeof(fullPath), "%s%s", SD_MOUNT_POINT, path);
+    return truncate(fullPath, size) == 0;
+}
+
+/**
+ * @brief 扩充内存索引 / Grow the in-memory index
+ * @return bool 成功返回true / Returns true on success
+ */
+static bool index_reserve(uint32_t count) {
+    if(count <= packIndexCap) {
+        return true;
+    }
+    uint32_t cap = (count + PHOTO_PACK_INDEX_GROW_STEP - 1) / PHOTO_PACK_INDEX_GROW_STEP * PHOTO_PACK_INDEX_GROW_STEP;
+    PhotoPackIndexEntry *grown = (PhotoPackIndexEntry*)(psramFound() ? ps_realloc(packIndex, cap * sizeof(PhotoPackIndexEntry))
+                                                                     : realloc(packIndex, cap * sizeof(PhotoPackIndexEntry)));
+    if(!grown) {
+        return false;
+    }
+    packIndex = grown;
+    packIndexCap = cap;
+    return true;
+}
+
+/**
+ * @brief 读取并校验索引尾部 / Read and check the index footer
+ * @return bool 包已封存且尾部有效返回true / Returns true if the pack is sealed with a valid footer
+ */
+static bool read_footer(File &file, uint32_t fileSize, PhotoPackFooter *footer) {
+    if(fileSize < sizeof(PhotoPackFooter) || !file.seek(fileSize - sizeof(PhotoPackFooter)) ||
+       file.read((uint8_t*)footer, sizeof(PhotoPackFooter)) != sizeof(PhotoPackFooter)) {
+        return false;
+    }
+    return footer->magic == PHOTO_PACK_FOOTER_MAGIC &&
+           (uint64_t)footer->indexOffset + (uint64_t)footer->count * sizeof(PhotoPackIndexEntry) + sizeof(PhotoPackFooter) == fileSize;
+}
+
+/**
+ * @brief 读取下一条照片记录 / Read the next photo record
+ * @param pos 记录头偏移，成功后移到下一条 / Record header offset, moved to the next record on success
+ * @param seq 期望的序号 / Expected sequence
+ * @return bool 记录完整有效返回true / Returns true if the record is complete and valid
+ */
+static bool next_record(File &file, uint32_t fileSize, uint32_t *pos, uint32_t seq, PhotoPackIndexEntry *entry) {
+    PhotoPackRecordHeader header;
+    if((uint64_t)*pos + sizeof(header) > fileSize || !file.seek(*pos) ||
+       file.read((uint8_t*)&header, sizeof(header)) != sizeof(header)) {
+        return false;
+    }
+    if(header.magic != PHOTO_PACK_RECORD_MAGIC || header.seq != seq ||
+       (uint64_t)*pos + sizeof(header) + header.size > fileSize) {
+        return false;
+    }
+    entry->offset = *pos + sizeof(header);
+    entry->size = header.size;
+    entry->time = header.time;
+    *pos = entry->offset + header.size;
+    return true;
+}
+
+/**
+ * @brief 打开某天的包用于追加（调用方持有锁和SD总线）/ Open a day's pack for appending (caller holds the lock and the SD bus)
+ * @details 已有的包读入索引并截掉尾部索引或残缺数据 / An existing pack has its index read in and its trailing index or torn data cut off
+ * @return bool 成功返回true / Returns true on success
+ */
+static bool open_pack_locked(uint32_t date) {
+    if(date == packResealDate) {
+        packResealDate = 0;
+    }
+    packCount = 0;
+    packBytes = 0;
+    packLastTime = 0;
+    pack_path(date, packPath, sizeof(packPath));
+
+    if(SD_MMC.exists(packPath)) {
+        File file = SD_MMC.open(packPath, FILE_READ);
+        if(!file) {
+            return false;
+        }
+        uint32_t fileSize = file.size();
+        PhotoPackFooter footer;
+        if(read_footer(file, fileSize, &footer)) {
+            // 已封存：读入索引，数据在索引之前结束 / Sealed: read the index, the data ends where it starts
+            bool ok = index_reserve(footer.count) && file.seek(footer.indexOffset);
+            size_t indexLen = footer.count * sizeof(PhotoPackIndexEntry);
+            if(!ok || (indexLen && file.read((uint8_t*)packIndex, indexLen) != indexLen)) {
+                file.close();
+                return false;
+            }
+            packCount = footer.count;
+            packBytes = footer.indexOffset;
+        } else {
+            // 未封存：逐条读记录头，在第一条残缺记录处结束 / Not sealed: walk the record headers up to the first torn record
+            PhotoPackIndexEntry entry;
+            while(next_record(file, fileSize, &packBytes, packCount + 1, &entry)) {
+                if(!index_reserve(packCount + 1)) {
+                    file.close();
+                    return false;
+                }
+                packIndex[packCount++] = entry;
+            }
+        }
+        file.close();
+        if(packCount > 0) {
+            packLastTime = packIndex[packCount - 1].time;
+        }
+        if(fileSize != packBytes) {
+            if(!truncate_pack(packPath, packBytes)) {
+                Serial.printf("Failed to truncate photo pack: %s / 无法截断照片包\n", packPath);
+                return false;
+            }
+            sd_space_file_resized(fileSize, packBytes);
+        }
+        catalog_add(packPath, CATALOG_TYPE_PHOTO, (uint32_t)midnight_of(date), packCount ? packLastTime : (uint32_t)midnight_of(date),
+                    packBytes, CATALOG_FLAG_OPEN);
+    } else {
+        // 新包：借用文件名生成函数创建日期目录 / New pack: the filename generator creates the date directory
+        char path[64];
+        generateTimestampFilenameAt(midnight_of(date), PHOTO_DIR, PHOTO_PACK_EXT, path, sizeof(path));
+        catalog_add(packPath, CATALOG_TYPE_PHOTO, (uint32_t)midnight_of(date), (uint32_t)midnight_of(date), 0, CATALOG_FLAG_OPEN);
+    }
+
+    packFile = SD_MMC.open(packPath, FILE_APPEND);
+    if(!packFile) {
+        Serial.printf("Failed to open photo pack: %s / 无法打开照片包\n", packPath);
+        return false;
+    }
+    packFile.setBufferSize(PHOTO_PACK_WRITE_BUFFER);
+    packDate = date;
+    packOpen = true;
+    Serial.printf("Photo pack open: %s, %lu photo(s) / 照片包已打开\n", packPath, (unsigned long)packCount);
+    return true;
+}
+
+/**
+ * @brief 打开某天的包用于追加（调用方持有锁）/ Open a day's pack for appending (caller holds the lock)
+ * @note 读索引、截断和建目录都是元数据操作，整体按STORE排队 / Reading the index, truncating and creating the directory are metadata work queued as STORE as a whole
+ */
+static bool open_pack(uint32_t date) {
+    sd_io_begin(SD_IO_STORE);
+    bool ok = open_pack_locked(date);
+    sd_io_end(SD_IO_STORE, 0);
+    return ok;
+}
+
+/**
+ * @brief 封存当前的包（调用方持有锁）/ Seal the current pack (caller holds the lock)
+ * @details 索引或尾部写入失败时截回数据末尾，索引条目保持OPEN标志，之后重新打开时由记录头重建再封存
+ *          If the index or footer write fails the file is cut back to the end of the data and its catalog entry stays OPEN, so it is rebuilt from the record headers and sealed again later
+ */
+static void seal_pack(void) {
+    if(!packOpen) {
+        return;
+    }
+    PhotoPackFooter footer = {PHOTO_PACK_FOOTER_MAGIC, packCount, packBytes, 0};
+    size_t indexLen = packCount * sizeof(PhotoPackIndexEntry);
+    bool ok = (indexLen == 0 || sd_io_write(packFile, (uint8_t*)packIndex, indexLen, SD_IO_STORE) == indexLen) &&
+              sd_io_write(packFile, (uint8_t*)&footer, sizeof(footer), SD_IO_STORE) == sizeof(footer);
+    sd_io_begin(SD_IO_STORE);
+    packFile.close();
+    sd_io_end(SD_IO_STORE, 0);
+    packOpen = false;
+
+    if(ok) {
+        uint32_t fileSize = packBytes + indexLen + sizeof(footer);
+        sd_space_file_resized(packBytes, fileSize);
+        catalog_update(packPath, packLastTime, fileSize, 0);
+        Serial.printf("Photo pack sealed: %s, %lu photo(s) / 照片包已封存\n", packPath, (unsigned long)packCount);
+        return;
+    }
+    sd_io_begin(SD_IO_STORE);
+    bool cut = truncate_pack(packPath, packBytes);
+    sd_io_end(SD_IO_STORE, 0);
+    packResealDate = packDate;
+    Serial.printf("Photo pack index write failed: %s%s / 照片包索引写入失败\n", packPath, cut ? "" : ", truncate failed");
+}
+
+/**
+ * @brief 初始化照片日包 / Initialise the daily photo packs
+ * @return bool 成功返回true / Returns true on success
+ */
+bool photo_pack_init(void) {
+    if(!packMutex) {
+        packMutex = xSemaphoreCreateMutex();
+    }
+    if(!packMutex) {
+        return false;
+    }
+    uint32_t date = findDateDir(PHOTO_DIR, 0, true);
+    if(date == 0) {
+        return true;
+    }
+    char path[64];
+    pack_path(date, path, sizeof(path));
+    sd_io_begin(SD_IO_STORE);
+    bool exists = SD_MMC.exists(path);
+    sd_io_end(SD_IO_STORE, 0);
+    if(!exists) {
+        return true;
+    }
+
+    xSemaphoreTake(packMutex, portMAX_DELAY);
+    bool ok = true;
+    if(date == date_of(time(nullptr))) {
+        // 当天的包继续追加 / Keep appending to today's pack
+        ok = open_pack(date);
+    } else {
+        // 之前断电留下的未封存包 / An unsealed pack left by an earlier power loss
+        sd_io_begin(SD_IO_STORE);
+        File file = SD_MMC.open(path, FILE_READ);
+        PhotoPackFooter footer;
+        bool sealed = file && read_footer(file, file.size(), &footer);
+        if(file) {
+            file.close();
+        }
+        sd_io_end(SD_IO_STORE, 0);
+        if(!sealed) {
+            ok = open_pack(date);
+            seal_pack();
+        }
+    }
+    xSemaphoreGive(packMutex);
+    return ok;
+}
+
+/**
+ * @brief 追加一张照片 / Append a photo
+ * @return uint64_t 照片编号，失败返回0 / Photo ID, 0 on failure
+ */
+uint64_t photo_pack_append(const uint8_t *buf, size_t len, time_t when) {
+    if(!packMutex || len == 0) {
+        return 0;
+    }
+    uint32_t date = date_of(when);
+    xSemaphoreTake(packMutex, portMAX_DELAY);
+    if(packOpen && packDate != date) {
+        seal_pack();
+    }
+    // 之前封存失败的包重新打开再封存一次 / Reopen and seal again a pack whose sealing failed earlier
+    if(!packOpen && packResealDate && packResealDate != date && open_pack(packResealDate)) {
+        seal_pack();
+    }
+    if(!packOpen && !open_pack(date)) {
+        xSemaphoreGive(packMutex);
+        return 0;
+    }
+    if(packCount + 1 >= PHOTO_PACK_ID_DATE_SCALE || (uint64_t)packBytes + sizeof(PhotoPackRecordHeader) + len > UINT32_MAX ||
+       !index_reserve(packCount + 1)) {
+        xSemaphoreGive(packMutex);
+        return 0;
+    }
+
+    // 记录头和JPEG数据一起写入并刷新 / Write the record header and JPEG data, then flush
+    PhotoPackRecordHeader header = {PHOTO_PACK_RECORD_MAGIC, packCount + 1, (uint32_t)when, (uint32_t)len};
+    bool ok = sd_io_write(packFile, (uint8_t*)&header, sizeof(header), SD_IO_STORE) == sizeof(header) &&
+              sd_io_write(packFile, buf, len, SD_IO_STORE) == len;
+    sd_io_begin(SD_IO_STORE);
+    packFile.flush();
+    sd_io_end(SD_IO_STORE, 0);
+    if(!ok) {
+        // 关闭后重新打开时由记录头重建并截掉残缺数据 / Reopening rebuilds from the record headers and cuts the torn data off
+        Serial.printf("Photo pack write failed: %s / 照片包写入失败\n", packPath);
+        sd_io_begin(SD_IO_STORE);
+        packFile.close();
+        sd_io_end(SD_IO_STORE, 0);
+        packOpen = false;
+        xSemaphoreGive(packMutex);
+        return 0;
+    }
+    uint32_t oldBytes = packBytes;
+    packIndex[packCount].offset = packBytes + sizeof(header);
+    packIndex[packCount].size = len;
+    packIndex[packCount].time = (uint32_t)when;
+    packCount++;
+    packBytes += sizeof(header) + len;
+    packLastTime = (uint32_t)when;
+    sd_space_file_resized(oldBytes, packBytes);
+    storage_stats_add(RETENTION_PHOTO, sizeof(header) + len);
+    uint64_t id = (uint64_t)date * PHOTO_PACK_ID_DATE_SCALE + packCount;
+    xSemaphoreGive(packMutex);
+    return id;
+}
+
+/**
+ * @brief 封存当前打开的包 / Seal the pack that is currently open
+ */
+void photo_pack_seal(void) {
+    if(!packMutex) {
+        return;
+    }
+    xSemaphoreTake(packMutex, portMAX_DELAY);
+    seal_pack();
+    xSemaphoreGive(packMutex);
+}
+
+/**
+ * @brief 放弃当前打开的包 / Drop the pack that is currently open
+ */
+void photo_pack_detach(void) {
+    if(!packMutex) {
+        return;
+    }
+    xSemaphoreTake(packMutex, portMAX_DELAY);
+    if(packOpen) {
+        sd_io_begin(SD_IO_STORE);
+        packFile.close();
+        sd_io_end(SD_IO_STORE, 0);
+        packOpen = false;
+    }
+    xSemaphoreGive(packMutex);
+}
+
+/**
+ * @brief 读取已关闭包的索引条目 / Read index entries of a closed pack
+ * @return int 读到的条目数，没有包返回-1 / Entries read, -1 if there is no pack
+ * @note 已封存的包直接读索引，未封存的逐条读记录头 / Sealed packs read the index directly, unsealed ones walk the record headers
+ */
+static int read_closed_index(const char *path, uint32_t first, PhotoPackIndexEntry *entries, int maxEntries) {
+    sd_io_begin(SD_IO_STORE);
+    File file = SD_MMC.open(path, FILE_READ);
+    if(!file) {
+        sd_io_end(SD_IO_STORE, 0);
+        return -1;
+    }
+    uint32_t fileSize = file.size();
+    int num = 0;
+    PhotoPackFooter footer;
+    if(read_footer(file, fileSize, &footer)) {
+        if(first < footer.count) {
+            num = footer.count - first < (uint32_t)maxEntries ? footer.count - first : maxEntries;
+            size_t len = num * sizeof(PhotoPackIndexEntry);
+            if(!file.seek(footer.indexOffset + first * sizeof(PhotoPackIndexEntry)) || file.read((uint8_t*)entries, len) != len) {
+                num = 0;
+            }
+        }
+    } else {
+        uint32_t pos = 0;
+        PhotoPackIndexEntry entry;
+        for(uint32_t seq = 1; num < maxEntries && next_record(file, fileSize, &pos, seq, &entry); seq++) {
+            if(seq > first) {
+                entries[num++] = entry;
+            }
+        }
+    }
+    file.close();
+    sd_io_end(SD_IO_STORE, num * sizeof(PhotoPackIndexEntry));
+    return num;
+}
+
+/**
+ * @brief 读取某天的索引 / Read one day's index
+ * @return int 读到的条目数，没有这天的包返回-1 / Entries read, -1 if there is no pack for that day
+ */
+int photo_pack_read_index(uint32_t date, uint32_t first, PhotoPackIndexEntry *entries, int maxEntries) {
+    if(!packMutex || maxEntries < 1) {
+        return -1;
+    }
+    xSemaphoreTake(packMutex, portMAX_DELAY);
+    if(packOpen && packDate == date) {
+        // 正在写入的包读内存索引 / The pack being written uses the in-memory index
+        int num = 0;
+        for(uint32_t i = first; i < packCount && num < maxEntries; i++) {
+            entries[num++] = packIndex[i];
+        }
+        xSemaphoreGive(packMutex);
+        return num;
+    }
+    xSemaphoreGive(packMutex);
+
+    char path[64];
+    pack_path(date, path, sizeof(path));
+    return read_closed_index(path, first, entries, maxEntries);
+}
+
+/**
+ * @brief 按编号查找照片 / Locate a photo by ID
+ * @return bool 找到返回true / Returns true if found
+ */
+bool photo_pack_locate(uint64_t id, char *path, size_t pathSize, PhotoPackIndexEntry *entry) {
+    uint32_t date = (uint32_t)(id / PHOTO_PACK_ID_DATE_SCALE);
+    uint32_t seq = (uint32_t)(id % PHOTO_PACK_ID_DATE_SCALE);
+    if(seq == 0 || photo_pack_read_index(date, seq - 1, entry, 1) != 1) {
+        return false;
+    }
+    pack_path(date, path, pathSize);
+    return true;
+}
+
+/**
+ * @brief 是否为正在写入的包 / Whether a path is the pack being written
+ */
+bool photo_pack_is_open(const char *path) {
+    if(!packMutex) {
+        return false;
+    }
+    xSemaphoreTake(packMutex, portMAX_DELAY);
+    bool open = packOpen && strcmp(path, packPath) == 0;
+    xSemaphoreGive(packMutex);
+    return open;
+}
@@ -0,0 +1,131 @@
+/**********************************************************************
+  文件名称 / Filename : photo_pack.h
+  文件用途 / File Purpose : 照片日包头文件 / Daily Photo Pack Header File
+               声明了把照片顺序追加到每日一个包文件、按编号读取照片相关的函数原型和宏定义
+               Declares function prototypes and macro definitions for appending photos to one pack file per day and reading them back by ID
+  作者 / Author : ESP32-S3监控项目 / ESP32-S3 Monitoring Project
+  修改日期 / Modification Date : 2026-02-05
+  硬件平台 / Hardware Platform : ESP32S3-EYE开发板 / ESP32S3-EYE Development Board
+  依赖库 / Dependencies : sd_read_write.h - 日期目录和SD卡操作 / Date directories and SD card operations
+               catalog.h - 包文件计入目录索引 / Pack files are tracked in the catalog
+  使用说明 / Usage Instructions : 1. 包含本头文件 #include "photo_pack.h" / Include this header file
+               2. SD卡和索引初始化后调用photo_pack_init()恢复当天的包 / Call photo_pack_init() after SD card and catalog init to recover today's pack
+               3. 调用photo_pack_append()追加照片，返回照片编号 / Call photo_pack_append() to append a photo, it returns the photo ID
+               4. 调用photo_pack_locate()按编号找到照片数据 / Call photo_pack_locate() to find a photo's data by ID
+  参数调整 / Parameter Adjustment : PHOTO_PACK_ENABLE - 连拍和/capture照片是否写入日包（默认1）/ Whether burst and /capture photos go into daily packs (default 1)
+  注意事项 / Important Notes : 包文件：PHOTO_DIR/YYYY/MM/DD/YYYYMMDD0000.pak，每张照片为16字节记录头 + JPEG数据
+                  Pack file: PHOTO_DIR/YYYY/MM/DD/YYYYMMDD0000.pak, each photo is a 16-byte record header + JPEG data
+               封包时在末尾追加索引（每张照片12字节：偏移、大小、时间）和16字节尾部 / Sealing appends the index (12 bytes per photo: offset, size, time) and a 16-byte footer
+               当天的包保持打开，索引在PSRAM中；断电后由记录头重建 / Today's pack stays open with its index in PSRAM; after a power loss it is rebuilt from the record headers
+               照片编号 = 日期YYYYMMDD × 100000 + 当天序号（从1开始）/ Photo ID = date YYYYMMDD × 100000 + sequence within the day (from 1)
+**********************************************************************/
+
+#ifndef __PHOTO_PACK_H
+#define __PHOTO_PACK_H
+
+#include "Arduino.h"
+#include "sd_read_write.h"
+
+// 连拍和/capture照片是否写入日包 / Whether burst and /capture photos go into daily packs
+#define PHOTO_PACK_ENABLE 1
+
+// 包文件扩展名 / Pack file extension
+#define PHOTO_PACK_EXT ".pak"
+
+// 记录头和索引尾部标识 / Record header and index footer magic
+#define PHOTO_PACK_RECORD_MAGIC 0x31525050  // 'PPR1'
+#define PHOTO_PACK_FOOTER_MAGIC 0x31495050  // 'PPI1'
+
+// 照片编号中日期的倍数，也是每天最多的照片数 / Date multiplier in photo IDs, also the per-day photo limit
+#define PHOTO_PACK_ID_DATE_SCALE 100000ULL
+
+// 内存索引增长步长 / In-memory index growth step
+#define PHOTO_PACK_INDEX_GROW_STEP 256
+
+// 写缓冲大小（字节），一张照片尽量一次写入 / Write buffer size (bytes), a photo is written in as few calls as possible
+#define PHOTO_PACK_WRITE_BUFFER (16 * 1024)
+
+// 照片记录头（定长16字节，紧跟JPEG数据）/ Photo record header (fixed 16 bytes, followed by the JPEG data)
+typedef struct {
+    uint32_t magic;                     // 记录标识 / Record magic
+    uint32_t seq;                       // 当天序号（从1开始）/ Sequence within the day (from 1)
+    uint32_t time;                      // 拍摄时间（Unix时间戳）/ Capture time (Unix timestamp)
+    uint32_t size;                      // JPEG长度 / JPEG length
+} PhotoPackRecordHeader;
+
+// 索引条目（定长12字节，第i条对应序号i+1）/ Index entry (fixed 12 bytes, entry i is sequence i+1)
+typedef struct {
+    uint32_t offset;                    // JPEG数据在包中的偏移 / Offset of the JPEG data in the pack
+    uint32_t size;                      // JPEG长度 / JPEG length
+    uint32_t time;                      // 拍摄时间（Unix时间戳）/ Capture time (Unix timestamp)
+} PhotoPackIndexEntry;
+
+// 索引尾部（定长16字节，位于文件末尾）/ Index footer (fixed 16 bytes, at the end of the file)
+typedef struct {
+    uint32_t magic;                     // 尾部标识 / Footer magic
+    uint32_t count;                     // 照片数 / Photo count
+    uint32_t indexOffset;               // 索引在包中的偏移 / Offset of the index in the pack
+    uint32_t reserved;                  // 保留，写0 / Reserved, written as 0
+} PhotoPackFooter;
+
+/**
+ * @brief 初始化照片日包 / Initialise the daily photo packs
+ * @return bool 成功返回true / Returns true on success
+ * @details 功能说明 / Function Description:
+ *          1. 找到最新一天的包 / Find the newest day's pack
+ *          2. 是当天的包则重新打开继续追加，否则补写索引封包 / Reopen it for appending if it is today's, otherwise seal it with its index
+ */
+bool photo_pack_init(void);
+
+/**
+ * @brief 追加一张照片 / Append a photo
+ * @param buf JPEG数据 / JPEG data
+ * @param len JPEG长度 / JPEG length
+ * @param when 拍摄时间 / Capture time
+ * @return uint64_t 照片编号，失败返回0 / Photo ID, 0 on failure
+ * @note 拍摄日期与打开的包不同时先封包，再打开该日期的包 / When the capture date differs from the open pack, that pack is sealed and the date's pack opened
+ *       每张照片写完即刷新到SD卡，之后才对读取可见 / Each photo is flushed to the card before it becomes visible to readers
+ */
+uint64_t photo_pack_append(const uint8_t *buf, size_t len, time_t when);
+
+/**
+ * @brief 封存当前打开的包 / Seal the pack that is currently open
+ * @note 写入索引和尾部后关闭文件 / Writes the index and footer, then closes the file
+ */
+void photo_pack_seal(void);
+
+/**
+ * @brief 放弃当前打开的包（SD卡掉卡时）/ Drop the pack that is currently open (when the SD card is lost)
+ * @note 只关闭文件不写索引；重新挂载后photo_pack_init()由记录头重建 / Only closes the file without writing the index; after remounting photo_pack_init() rebuilds it from the record headers
+ */
+void photo_pack_detach(void);
+
+/**
+ * @brief 按编号查找照片 / Locate a photo by ID
+ * @param id 照片编号 / Photo ID
+ * @param path 输出包文件路径 / Output pack file path
+ * @param pathSize 路径缓冲区大小 / Path buffer size
+ * @param entry 输出索引条目 / Output index entry
+ * @return bool 找到返回true / Returns true if found
+ */
+bool photo_pack_locate(uint64_t id, char *path, size_t pathSize, PhotoPackIndexEntry *entry);
+
+/**
+ * @brief 读取某天的索引 / Read one day's index
+ * @param date 日期（YYYYMMDD）/ Date (YYYYMMDD)
+ * @param first 起始条目（0开始）/ First entry (from 0)
+ * @param entries 输出数组 / Output array
+ * @param maxEntries 数组容量 / Array capacity
+ * @return int 读到的条目数，没有这天的包返回-1 / Entries read, -1 if there is no pack for that day
+ * @note 条目first+i对应编号 date × PHOTO_PACK_ID_DATE_SCALE + first + i + 1 / Entry first+i has ID date × PHOTO_PACK_ID_DATE_SCALE + first + i + 1
+ */
+int photo_pack_read_index(uint32_t date, uint32_t first, PhotoPackIndexEntry *entries, int maxEntries);
+
+/**
+ * @brief 是否为正在写入的包 / Whether a path is the pack being written
+ * @param path 文件路径 / File path
+ * @return bool 是返回true / Returns true if it is
+ */
+bool photo_pack_is_open(const char *path);
+
+#endif // __PHOTO_PACK_H
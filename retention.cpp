@@ -0,0 +1,210 @@
+/**********************************************************************
+  文件名称 / Filename : retention.cpp
+  文件用途 / File Purpose : 存储保留策略实现文件 / Storage Retention Policy Implementation File
+               本文件实现了运行时可配置的保留策略及其与目录索引清理计划的衔接
+               This file implements the runtime-configurable retention policy and its link to the catalog cleanup planner
+               主要功能包括 / Main Features:
+               1. 策略文件加载和保存 / Policy file loading and saving
+               2. 分类配额、最长保留天数、最少保留天数 / Per-category quotas, maximum ages and minimum kept days
+               3. 运行时清理优先级和水位线 / Runtime cleanup priority and watermarks
+  作者 / Author : ESP32-S3监控项目 / ESP32-S3 Monitoring Project
+  修改日期 / Modification Date : 2026-02-05
+  硬件平台 / Hardware Platform : ESP32S3-EYE开发板 / ESP32S3-EYE Development Board
+  依赖库 / Dependencies : SD_MMC.h - SD卡文件系统 / SD card file system
+  使用说明 / Usage Instructions : 1. 调用retention_init()加载策略 / Call retention_init() to load the policy
+  注意事项 / Important Notes : 文件格式：magic + 32字节策略 / File format: magic + 32-byte policy
+               每次修改整体重写 / Every change rewrites the whole file
+**********************************************************************/
+
+#include "retention.h"
+#include "SD_MMC.h"
+#include "sd_io.h"
+#include <time.h>
+
+// 策略文件内容 / Policy file contents
+typedef struct {
+    uint32_t magic;                     // 文件标识 / File magic
+    RetentionPolicy policy;             // 策略 / Policy
+} RetentionFile;
+
+// 当前策略（初始化前即为默认值）/ Current policy (defaults until initialised)
+static RetentionPolicy retentionPolicy = {
+    {0, 0, 0}, {0, 0, 0}, 0,
+    SD_SPACE_RESERVE_GB * 1024, SD_CLEAN_TARGET_GB * 1024, SD_CLEANUP_PRIORITY, {0, 0, 0}
+};
+
+// 互斥锁：Web服务修改，清理任务读取 / Mutex: the web server changes it, the janitor reads it
+static SemaphoreHandle_t retentionMutex = NULL;
+
+/**
+ * @brief 检查策略是否有效 / Check whether a policy is valid
+ */
+static bool policy_valid(const RetentionPolicy *policy) {
+    for(int c = 0; c < RETENTION_NUM_CATEGORIES; c++) {
+        if(policy->maxAgeDays[c] > RETENTION_MAX_DAYS) {
+            return false;
+        }
+    }
+    return policy->priority <= 2 && policy->reserveMB > 0 && policy->minKeepDays <= RETENTION_MAX_DAYS;
+}
+
+/**
+ * @brief 加载保留策略 / Load the retention policy
+ * @return bool 从SD卡加载返回true，使用默认值返回false / Returns true if loaded from the SD card, false if defaults apply
+ */
+bool retention_init(void) {
+    if(!retentionMutex) {
+        retentionMutex = xSemaphoreCreateMutex();
+    }
+    RetentionFile contents;
+    sd_io_begin(SD_IO_STORE);
+    File file = SD_MMC.exists(RETENTION_FILE) ? SD_MMC.open(RETENTION_FILE, FILE_READ) : File();
+    if(!file) {
+        sd_io_end(SD_IO_STORE, 0);
+        return false;
+    }
+    bool ok = file.read((uint8_t*)&contents, sizeof(contents)) == sizeof(contents) &&
+              contents.magic == RETENTION_MAGIC && policy_valid(&contents.policy);
+    file.close();
+    sd_io_end(SD_IO_STORE, sizeof(contents));
+    if(!ok) {
+        Serial.println("Retention policy file is corrupt, using defaults / 保留策略文件损坏，使用默认值");
+        return false;
+    }
+    xSemaphoreTake(retentionMutex, portMAX_DELAY);
+    retentionPolicy = contents.policy;
+    xSemaphoreGive(retentionMutex);
+    Serial.printf("Retention policy loaded: quotas %lu/%lu/%lu MB, max age %u/%u/%u days, keep %u days / 已加载保留策略\n",
+                  (unsigned long)contents.policy.quotaMB[RETENTION_VIDEO], (unsigned long)contents.policy.quotaMB[RETENTION_PHOTO],
+                  (unsigned long)contents.policy.quotaMB[RETENTION_DERIVED], contents.policy.maxAgeDays[RETENTION_VIDEO],
+                  contents.policy.maxAgeDays[RETENTION_PHOTO], contents.policy.maxAgeDays[RETENTION_DERIVED], contents.policy.minKeepDays);
+    return true;
+}
+
+/**
+ * @brief 获取保留策略 / Get the retention policy
+ */
+void retention_get_policy(RetentionPolicy *policy) {
+    if(retentionMutex) {
+        xSemaphoreTake(retentionMutex, portMAX_DELAY);
+    }
+    *policy = retentionPolicy;
+    if(retentionMutex) {
+        xSemaphoreGive(retentionMutex);
+    }
+}
+
+/**
+ * @brief 设置并保存保留策略 / Set and save the retention policy
+ * @return bool 成功返回true / Returns true on success
+ */
+bool retention_set_policy(const RetentionPolicy *policy) {
+    if(!retentionMutex || !policy_valid(policy)) {
+        return false;
+    }
+    RetentionFile contents;
+    memset(&contents, 0, sizeof(contents));
+    contents.magic = RETENTION_MAGIC;
+    contents.policy = *policy;
+    memset(contents.policy.reserved, 0, sizeof(contents.policy.reserved));
+
+    // 先取总线再加锁，与持有总线时读取策略的任务顺序一致 / Take the bus before the lock, in the same order as tasks reading the policy while holding the bus
+    sd_io_begin(SD_IO_STORE);
+    xSemaphoreTake(retentionMutex, portMAX_DELAY);
+    File file = SD_MMC.open(RETENTION_FILE, FILE_WRITE);
+    bool ok = file && file.write((uint8_t*)&contents, sizeof(contents)) == sizeof(contents);
+    if(file) {
+        file.close();
+    }
+    if(ok) {
+        retentionPolicy = contents.policy;
+    } else {
+        Serial.println("Failed to write retention policy file / 无法写入保留策略文件");
+    }
+    xSemaphoreGive(retentionMutex);
+    sd_io_end(SD_IO_STORE, sizeof(contents));
+    return ok;
+}
+
+/**
+ * @brief 获取清理优先级 / Get the cleanup priority
+ */
+int retention_priority(void) {
+    RetentionPolicy policy;
+    retention_get_policy(&policy);
+    return policy.priority;
+}
+
+/**
+ * @brief 获取低水位线 / Get the low watermark
+ */
+uint64_t retention_low_watermark_bytes(void) {
+    RetentionPolicy policy;
+    retention_get_policy(&policy);
+    return policy.reserveMB * 1024ULL * 1024ULL;
+}
+
+/**
+ * @brief 获取高水位线 / Get the high watermark
+ */
+uint64_t retention_high_watermark_bytes(void) {
+    RetentionPolicy policy;
+    retention_get_policy(&policy);
+    return ((uint64_t)policy.reserveMB + policy.cleanTargetMB) * 1024ULL * 1024ULL;
+}
+
+/**
+ * @brief 计算N天前当地零点 / Local midnight N days ago
+ */
+static uint32_t local_midnight_days_ago(time_t now, int days) {
+    struct tm timeinfo;
+    localtime_r(&now, &timeinfo);
+    timeinfo.tm_hour = 0;
+    timeinfo.tm_min = 0;
+    timeinfo.tm_sec = 0;
+    timeinfo.tm_mday -= days;
+    timeinfo.tm_isdst = -1;
+    time_t t = mktime(&timeinfo);
+    return t > 0 ? (uint32_t)t : 0;
+}
+
+/**
+ * @brief 计算一批要删除的文件 / Plan one batch of files to delete
+ * @return int 文件数量，索引不可用返回-1 / Number of files, -1 if the catalog is unusable
+ */
+int retention_plan_cleanup(uint64_t needBytes, FileInfo *files, int maxFiles) {
+    RetentionPolicy policy;
+    retention_get_policy(&policy);
+
+    CatalogCleanupRules rules;
+    memset(&rules, 0, sizeof(rules));
+    for(int c = 0; c < RETENTION_NUM_CATEGORIES; c++) {
+        rules.quotaBytes[c] = policy.quotaMB[c] * 1024ULL * 1024ULL;
+    }
+
+    // 时间未同步时不按天数判断，避免误删或误保留 / Day-based rules are skipped until the clock is synced
+    time_t now = time(nullptr);
+    if(now >= RETENTION_MIN_VALID_TIME) {
+        for(int c = 0; c < RETENTION_NUM_CATEGORIES; c++) {
+            if(policy.maxAgeDays[c]) {
+                // 64位计算，天数超过当前时间时不过期（0）/ Computed in 64 bits, an age reaching past the epoch never expires (0)
+                uint64_t age = (uint64_t)policy.maxAgeDays[c] * 86400ULL;
+                rules.expireBefore[c] = age < (uint64_t)now ? (uint32_t)((uint64_t)now - age) : 0;
+            }
+        }
+        if(policy.minKeepDays) {
+            rules.keepAfter = local_midnight_days_ago(now, policy.minKeepDays - 1);
+        }
+    }
+
+    // 剩余空间按优先级删除，剪辑只受配额和天数约束 / Free space follows the priority, clips only obey quotas and ages
+    rules.needBytes = needBytes;
+    int k = 0;
+    if(policy.priority != 2) {
+        rules.needOrder[k++] = CATALOG_TYPE_VIDEO;
+    }
+    if(policy.priority != 0) {
+        rules.needOrder[k++] = CATALOG_TYPE_PHOTO;
+    }
+    return catalog_plan_cleanup(&rules, files, maxFiles);
+}
@@ -0,0 +1,105 @@
+/**********************************************************************
+  文件名称 / Filename : retention.h
+  文件用途 / File Purpose : 存储保留策略头文件 / Storage Retention Policy Header File
+               声明了运行时可配置的分类配额、保留天数和清理水位线相关的函数原型和宏定义
+               Declares function prototypes and macro definitions for runtime-configurable per-category quotas, retention ages and cleanup watermarks
+  作者 / Author : ESP32-S3监控项目 / ESP32-S3 Monitoring Project
+  修改日期 / Modification Date : 2026-02-05
+  硬件平台 / Hardware Platform : ESP32S3-EYE开发板 / ESP32S3-EYE Development Board
+  依赖库 / Dependencies : catalog.h - 单次遍历计算清理集合 / Single-pass cleanup planning
+  使用说明 / Usage Instructions : 1. 包含本头文件 #include "retention.h" / Include this header file
+               2. SD卡初始化后调用retention_init()加载策略 / Call retention_init() after SD card init to load the policy
+               3. 调用retention_plan_cleanup()计算一批要删除的文件 / Call retention_plan_cleanup() to plan one batch of files to delete
+  参数调整 / Parameter Adjustment : 默认值来自SD_SPACE_RESERVE_GB、SD_CLEAN_TARGET_GB、SD_CLEANUP_PRIORITY，配额和保留天数默认不限
+                  Defaults come from SD_SPACE_RESERVE_GB, SD_CLEAN_TARGET_GB and SD_CLEANUP_PRIORITY, quotas and ages are unlimited by default
+  注意事项 / Important Notes : 策略保存在SD卡的定长二进制文件中，文件缺失或损坏时使用默认值 / The policy is stored in a fixed-size binary file on the SD card, defaults apply when it is missing or corrupt
+               分类：视频=VIDEO_DIR，照片=PHOTO_DIR，派生数据=CLIP_DIR中的剪辑 / Categories: video = VIDEO_DIR, photo = PHOTO_DIR, derived = clips in CLIP_DIR
+               最少保留天数内的文件即使空间不足也不删除 / Files within the minimum kept days are not deleted even when space runs low
+**********************************************************************/
+
+#ifndef __RETENTION_H
+#define __RETENTION_H
+
+#include "Arduino.h"
+#include "catalog.h"
+
+// 策略文件路径 / Policy file path
+#define RETENTION_FILE "/camera/retention.dat"
+
+// 策略文件标识 / Policy file magic
+#define RETENTION_MAGIC 0x31544552  // 'RET1'
+
+// 分类（与目录索引的文件类型一一对应）/ Categories (one per catalog file type)
+#define RETENTION_VIDEO (CATALOG_TYPE_VIDEO - 1)
+#define RETENTION_PHOTO (CATALOG_TYPE_PHOTO - 1)
+#define RETENTION_DERIVED (CATALOG_TYPE_CLIP - 1)
+#define RETENTION_NUM_CATEGORIES CATALOG_NUM_TYPES
+
+// 系统时间早于此值时不按保留天数删除（未完成NTP同步）/ Age rules are skipped while the clock is before this (NTP not synced yet)
+#define RETENTION_MIN_VALID_TIME 1700000000
+
+// 天数设置上限（约100年）/ Upper bound of the day settings (about 100 years)
+#define RETENTION_MAX_DAYS 36500
+
+// 保留策略（定长32字节）/ Retention policy (fixed 32 bytes)
+typedef struct {
+    uint32_t quotaMB[RETENTION_NUM_CATEGORIES];         // 各分类配额（MB），0表示不限 / Per-category quota (MB), 0 for no limit
+    uint16_t maxAgeDays[RETENTION_NUM_CATEGORIES];      // 各分类最长保留天数，0表示不限 / Per-category maximum age (days), 0 for no limit
+    uint16_t minKeepDays;                               // 最少保留天数（含当天），0表示不限 / Minimum days always kept (including today), 0 for none
+    uint32_t reserveMB;                                 // 剩余空间低于此值开始清理（MB）/ Cleanup starts below this much free space (MB)
+    uint32_t cleanTargetMB;                             // 每次清理在保留空间之上再释放的空间（MB）/ Space freed above the reserve by each cleanup (MB)
+    uint8_t priority;                                   // 清理优先级，含义同SD_CLEANUP_PRIORITY / Cleanup priority, same meaning as SD_CLEANUP_PRIORITY
+    uint8_t reserved[3];                                // 保留 / Reserved
+} RetentionPolicy;
+
+/**
+ * @brief 加载保留策略 / Load the retention policy
+ * @return bool 从SD卡加载返回true，使用默认值返回false / Returns true if loaded from the SD card, false if defaults apply
+ */
+bool retention_init(void);
+
+/**
+ * @brief 获取保留策略 / Get the retention policy
+ * @param policy 输出策略 / Output policy
+ */
+void retention_get_policy(RetentionPolicy *policy);
+
+/**
+ * @brief 设置并保存保留策略 / Set and save the retention policy
+ * @param policy 新策略 / New policy
+ * @return bool 成功返回true，参数无效或写卡失败返回false / Returns true on success, false if invalid or the SD write failed
+ * @note 写卡失败时内存中的策略保持不变 / The in-memory policy is unchanged when the SD write fails
+ */
+bool retention_set_policy(const RetentionPolicy *policy);
+
+/**
+ * @brief 获取清理优先级 / Get the cleanup priority
+ * @return int 0=只删视频，1=先视频后照片，2=只删照片 / 0 = videos only, 1 = videos then photos, 2 = photos only
+ */
+int retention_priority(void);
+
+/**
+ * @brief 获取开始清理的剩余空间（低水位线）/ Get the free space at which cleanup starts (low watermark)
+ * @return uint64_t 字节数 / Bytes
+ */
+uint64_t retention_low_watermark_bytes(void);
+
+/**
+ * @brief 获取停止清理的剩余空间（高水位线）/ Get the free space at which cleanup stops (high watermark)
+ * @return uint64_t 字节数 / Bytes
+ */
+uint64_t retention_high_watermark_bytes(void);
+
+/**
+ * @brief 计算一批要删除的文件 / Plan one batch of files to delete
+ * @param needBytes 为剩余空间还需释放的字节数，0表示只按配额和保留天数 / Bytes still to free for free space, 0 for quotas and ages only
+ * @param files 输出数组 / Output array
+ * @param maxFiles 数组容量 / Array capacity
+ * @return int 文件数量，索引不可用返回-1 / Number of files, -1 if the catalog is unusable
+ * @details 功能说明 / Function Description:
+ *          1. 按当前策略和时间生成清理规则 / Build cleanup rules from the current policy and time
+ *          2. 由catalog_plan_cleanup()一次遍历索引选出文件 / Let catalog_plan_cleanup() select the files in one walk of the catalog
+ */
+int retention_plan_cleanup(uint64_t needBytes, FileInfo *files, int maxFiles);
+
+#endif // __RETENTION_H
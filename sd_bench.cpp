@@ -0,0 +1,256 @@
+/**********************************************************************
+  文件名称 / Filename : sd_bench.cpp
+  文件用途 / File Purpose : SD卡性能测试实现文件 / SD Card Benchmark Implementation File
+               本文件实现了SD卡顺序读写测速和启动时的总线频率、录像写块大小校准
+               This file implements SD card sequential read/write benchmarks and the boot calibration of bus frequency and recording write block size
+               主要功能包括 / Main Features:
+               1. 按块测速并统计延迟分位数 / Per-block timing with latency percentiles
+               2. 读回校验 / Read-back verification
+               3. 启动校准并检查录像码率余量 / Boot calibration with a recording bitrate headroom check
+  作者 / Author : ESP32-S3监控项目 / ESP32-S3 Monitoring Project
+  修改日期 / Modification Date : 2026-02-05
+  硬件平台 / Hardware Platform : ESP32S3-EYE开发板 / ESP32S3-EYE Development Board
+  依赖库 / Dependencies : sd_read_write.h - SD卡挂载与录像写缓冲 / SD card mounting and the recording write buffer
+               esp_camera.h - 估算录像码率 / Estimating the recording bitrate
+  使用说明 / Usage Instructions : 1. 调用sd_bench_calibrate()进行启动校准 / Call sd_bench_calibrate() for the boot calibration
+  注意事项 / Important Notes : 写测试文件时把文件写缓冲设为块大小，每次写入都直接落到SD卡
+                  The test file's write buffer is set to the block size so every write goes straight to the card
+               每块按SD_IO_BULK排队，延迟只计块读写本身，吞吐量按总时间计（含排队）
+                  Every block queues as SD_IO_BULK; latencies time the block transfer alone, throughput uses the total time (queuing included)
+**********************************************************************/
+
+#include "sd_bench.h"
+#include "esp_camera.h"
+#include "esp_timer.h"
+#include "sd_io.h"
+
+// 启动校准结果 / Boot calibration result
+static SdBenchCalibration calibration = {0};
+
+/**
+ * @brief 比较两个延迟值（qsort用）/ Compare two latencies (for qsort)
+ */
+static int compare_latency(const void *a, const void *b) {
+    uint32_t la = *(const uint32_t*)a;
+    uint32_t lb = *(const uint32_t*)b;
+    return la < lb ? -1 : (la > lb ? 1 : 0);
+}
+
+/**
+ * @brief 计算延迟分位数 / Compute latency percentiles
+ * @param latency 各块延迟（会被排序）/ Per-block latencies (sorted in place)
+ * @param count 块数 / Block count
+ */
+static void latency_percentiles(uint32_t *latency, uint32_t count, uint32_t *p50, uint32_t *p99, uint32_t *maxUs) {
+    qsort(latency, count, sizeof(uint32_t), compare_latency);
+    *p50 = latency[count / 2];
+    *p99 = latency[(uint64_t)count * 99 / 100];
+    *maxUs = latency[count - 1];
+}
+
+/**
+ * @brief 计算速度 / Compute throughput
+ * @return uint32_t KB/s
+ */
+static uint32_t throughput_kbps(uint32_t bytes, int64_t elapsedUs) {
+    if(elapsedUs <= 0) {
+        elapsedUs = 1;
+    }
+    return (uint32_t)((uint64_t)bytes * 1000000ULL / 1024ULL / (uint64_t)elapsedUs);
+}
+
+/**
+ * @brief 测一种块大小的顺序读写 / Benchmark sequential read/write with one block size
+ * @return bool 测试完成返回true / Returns true if the test completed
+ */
+bool sd_bench_run(uint32_t blockSize, uint32_t totalBytes, SdBenchResult *result) {
+    memset(result, 0, sizeof(SdBenchResult));
+    result->blockSize = blockSize;
+    if(blockSize == 0 || totalBytes < blockSize) {
+        return false;
+    }
+    uint32_t blocks = totalBytes / blockSize;
+    result->bytes = blocks * blockSize;
+
+    uint8_t *buf = (uint8_t*)(psramFound() ? ps_malloc(blockSize) : malloc(blockSize));
+    uint32_t *latency = (uint32_t*)(psramFound() ? ps_malloc(blocks * sizeof(uint32_t)) : malloc(blocks * sizeof(uint32_t)));
+    if(!buf || !latency) {
+        free(buf);
+        free(latency);
+        return false;
+    }
+    for(uint32_t i = 0; i < blockSize; i++) {
+        buf[i] = (uint8_t)(i * 31 + 7);
+    }
+
+    // 顺序写，每块开头写入块序号用于读回校验 / Sequential write, each block starts with its number for the read-back check
+    bool ok = false;
+    sd_io_begin(SD_IO_BULK);
+    File file = SD_MMC.open(SD_BENCH_FILE, FILE_WRITE);
+    sd_io_end(SD_IO_BULK, 0);
+    if(file) {
+        file.setBufferSize(blockSize);
+        ok = true;
+        int64_t start = esp_timer_get_time();
+        for(uint32_t i = 0; ok && i < blocks; i++) {
+            memcpy(buf, &i, sizeof(i));
+            sd_io_begin(SD_IO_BULK);
+            int64_t t0 = esp_timer_get_time();
+            ok = file.write(buf, blockSize) == blockSize;
+            latency[i] = (uint32_t)(esp_timer_get_time() - t0);
+            sd_io_end(SD_IO_BULK, blockSize);
+        }
+        sd_io_begin(SD_IO_BULK);
+        file.close();
+        sd_io_end(SD_IO_BULK, 0);
+        result->writeKBps = throughput_kbps(result->bytes, esp_timer_get_time() - start);
+        if(ok) {
+            latency_percentiles(latency, blocks, &result->writeP50Us, &result->writeP99Us, &result->writeMaxUs);
+        }
+    }
+
+    // 顺序读并校验 / Sequential read with verification
+    if(ok) {
+        sd_io_begin(SD_IO_BULK);
+        file = SD_MMC.open(SD_BENCH_FILE, FILE_READ);
+        sd_io_end(SD_IO_BULK, 0);
+        ok = (bool)file;
+    }
+    if(ok) {
+        file.setBufferSize(blockSize);
+        bool verified = true;
+        int64_t start = esp_timer_get_time();
+        for(uint32_t i = 0; ok && i < blocks; i++) {
+            sd_io_begin(SD_IO_BULK);
+            int64_t t0 = esp_timer_get_time();
+            ok = file.read(buf, blockSize) == blockSize;
+            latency[i] = (uint32_t)(esp_timer_get_time() - t0);
+            sd_io_end(SD_IO_BULK, blockSize);
+            uint32_t seq;
+            memcpy(&seq, buf, sizeof(seq));
+            if(seq != i || buf[blockSize - 1] != (uint8_t)((blockSize - 1) * 31 + 7)) {
+                verified = false;
+            }
+        }
+        result->readKBps = throughput_kbps(result->bytes, esp_timer_get_time() - start);
+        sd_io_begin(SD_IO_BULK);
+        file.close();
+        sd_io_end(SD_IO_BULK, 0);
+        if(ok) {
+            latency_percentiles(latency, blocks, &result->readP50Us, &result->readP99Us, &result->readMaxUs);
+            result->verified = verified;
+        }
+    }
+
+    sd_io_begin(SD_IO_BULK);
+    SD_MMC.remove(SD_BENCH_FILE);
+    sd_io_end(SD_IO_BULK, 0);
+    free(buf);
+    free(latency);
+    return ok;
+}
+
+/**
+ * @brief 估算录像码率 / Estimate the recording bitrate
+ * @param fps 录像帧率 / Recording frame rate
+ * @return uint32_t KB/s，取不到帧返回0 / KB/s, 0 if no frame could be grabbed
+ * @note 丢弃前几帧，帧缓冲里可能还有切换分辨率前的帧 / The first frames are dropped, the buffers may still hold frames from before the resolution switch
+ */
+static uint32_t estimate_recording_kbps(int fps) {
+    size_t frameLen = 0;
+    for(int i = 0; i < 3; i++) {
+        camera_fb_t *fb = esp_camera_fb_get();
+        if(fb) {
+            frameLen = fb->len;
+            esp_camera_fb_return(fb);
+        }
+    }
+    if(frameLen == 0) {
+        return 0;
+    }
+    // 每帧还有8字节块头 / Every frame also carries an 8-byte chunk header
+    return (uint32_t)((uint64_t)(frameLen + 8) * fps / 1024);
+}
+
+/**
+ * @brief 启动校准 / Boot calibration
+ * @return bool 完成校准返回true / Returns true if the calibration ran
+ */
+bool sd_bench_calibrate(int fps) {
+    memset(&calibration, 0, sizeof(calibration));
+    if(SD_MMC.cardType() == CARD_NONE) {
+        return false;
+    }
+
+    const int freqs[SD_BENCH_NUM_FREQS] = SD_BENCH_FREQS;
+    const uint32_t blockSizes[SD_BENCH_NUM_BLOCK_SIZES] = SD_BENCH_BLOCK_SIZES;
+    int startFreq = sdmmcGetFreqKhz();
+    int bestFreq = startFreq;
+    uint32_t bestBlockSize = 0;
+    uint32_t bestKBps = 0;
+    bool mounted = true;
+
+    for(int f = 0; f < SD_BENCH_NUM_FREQS; f++) {
+        calibration.freqs[f] = freqs[f];
+        if(!mounted || freqs[f] != sdmmcGetFreqKhz()) {
+            mounted = sdmmcRemount(freqs[f]);
+            if(!mounted) {
+                continue;
+            }
+        }
+        calibration.mounted[f] = true;
+        for(int b = 0; b < SD_BENCH_NUM_BLOCK_SIZES; b++) {
+            SdBenchResult *r = &calibration.results[f][b];
+            bool ok = sd_bench_run(blockSizes[b], SD_BENCH_CALIBRATION_BYTES, r);
+            Serial.printf("SD bench %d kHz, %lu B blocks: write %lu KB/s (p99 %lu us), read %lu KB/s%s / SD卡测速\n",
+                          freqs[f], (unsigned long)blockSizes[b], (unsigned long)r->writeKBps, (unsigned long)r->writeP99Us,
+                          (unsigned long)r->readKBps, ok && r->verified ? "" : ", FAILED");
+            if(ok && r->verified && r->writeKBps > bestKBps) {
+                bestKBps = r->writeKBps;
+                bestFreq = freqs[f];
+                bestBlockSize = blockSizes[b];
+            }
+        }
+    }
+
+    // 以选定频率重新挂载，失败时退回原频率 / Remount at the chosen frequency, falling back to the original one
+    if(!mounted || sdmmcGetFreqKhz() != bestFreq) {
+        if(!sdmmcRemount(bestFreq)) {
+            bestFreq = startFreq;
+            bestBlockSize = 0;
+            bestKBps = 0;
+            if(!sdmmcRemount(startFreq)) {
+                Serial.println("SD card lost during calibration / 校准过程中SD卡挂载失败");
+                return false;
+            }
+        }
+    }
+    setVideoWriteBlockSize(bestBlockSize);
+
+    calibration.freqKhz = bestFreq;
+    calibration.blockSize = bestBlockSize;
+    calibration.writeKBps = bestKBps;
+    calibration.requiredKBps = estimate_recording_kbps(fps);
+    calibration.sufficient = (uint64_t)bestKBps * 100 >= (uint64_t)calibration.requiredKBps * SD_BENCH_HEADROOM_PERCENT;
+    calibration.done = true;
+
+    if(bestKBps == 0) {
+        Serial.println("SD benchmark failed, keeping default frequency and write buffer / SD卡测速失败，保持默认设置");
+    } else {
+        Serial.printf("SD calibration: %d kHz, %lu B write blocks, %lu KB/s / SD卡校准完成\n",
+                      bestFreq, (unsigned long)bestBlockSize, (unsigned long)bestKBps);
+    }
+    if(!calibration.sufficient) {
+        Serial.printf("WARNING: SD card writes %lu KB/s, recording needs about %lu KB/s at %d fps; lower the resolution, quality or fps / "
+                      "警告：SD卡写入速度不足以支撑当前录像分辨率和帧率\n",
+                      (unsigned long)bestKBps, (unsigned long)calibration.requiredKBps, fps);
+    }
+    return true;
+}
+
+/**
+ * @brief 获取启动校准结果 / Get the boot calibration result
+ */
+void sd_bench_get_calibration(SdBenchCalibration *cal) {
+    *cal = calibration;
+}
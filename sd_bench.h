@@ -0,0 +1,121 @@
+/**********************************************************************
+  文件名称 / Filename : sd_bench.h
+  文件用途 / File Purpose : SD卡性能测试头文件 / SD Card Benchmark Header File
+               声明了SD卡顺序读写测速、启动校准相关的函数原型和宏定义
+               Declares function prototypes and macro definitions for SD card sequential read/write benchmarks and the boot calibration
+  作者 / Author : ESP32-S3监控项目 / ESP32-S3 Monitoring Project
+  修改日期 / Modification Date : 2026-02-05
+  硬件平台 / Hardware Platform : ESP32S3-EYE开发板 / ESP32S3-EYE Development Board
+  依赖库 / Dependencies : sd_read_write.h - SD卡挂载与录像写缓冲 / SD card mounting and the recording write buffer
+               esp_camera.h - 估算录像码率 / Estimating the recording bitrate
+  使用说明 / Usage Instructions : 1. 包含本头文件 #include "sd_bench.h" / Include this header file
+               2. SD卡初始化后、开始录像前调用sd_bench_calibrate() / Call sd_bench_calibrate() after SD card init and before recording starts
+               3. 调用sd_bench_run()测一种块大小（/bench/sd接口）/ Call sd_bench_run() to measure one block size (/bench/sd endpoint)
+  参数调整 / Parameter Adjustment : SD_BENCH_CALIBRATE_ON_BOOT - 启动时是否校准（默认1）/ Whether to calibrate at boot (default 1)
+               SD_BENCH_CALIBRATION_BYTES - 校准时每项测试的数据量（默认512KB）/ Data per calibration test (default 512KB)
+               SD_BENCH_HEADROOM_PERCENT - 写入速度相对录像码率的最低余量（默认200%）/ Minimum write speed relative to the recording bitrate (default 200%)
+  注意事项 / Important Notes : 测试文件写在CAMERA_DIR下，测完删除 / The test file lives under CAMERA_DIR and is deleted afterwards
+               校准需要重新挂载SD卡，只能在没有打开文件时进行 / Calibration remounts the SD card, so it only runs while no files are open
+               /bench/sd在单独的任务中测速；录像期间按SD_IO_BULK排队并限速，录像写入优先
+                  /bench/sd runs in its own task; while recording it queues as SD_IO_BULK under the rate limit so recording writes come first
+**********************************************************************/
+
+#ifndef __SD_BENCH_H
+#define __SD_BENCH_H
+
+#include "Arduino.h"
+#include "sd_read_write.h"
+
+// 测试文件 / Test file
+#define SD_BENCH_FILE CAMERA_DIR "/bench.tmp"
+
+// 测试的块大小（字节）/ Block sizes tested (bytes)
+#define SD_BENCH_BLOCK_SIZES {512, 4096, 16384, 32768}
+#define SD_BENCH_NUM_BLOCK_SIZES 4
+
+// 校准尝试的总线频率（kHz）/ Bus frequencies tried by the calibration (kHz)
+#define SD_BENCH_FREQS {SDMMC_FREQ_DEFAULT, SDMMC_FREQ_HIGHSPEED}
+#define SD_BENCH_NUM_FREQS 2
+
+// 启动时是否校准 / Whether to calibrate at boot
+#define SD_BENCH_CALIBRATE_ON_BOOT 1
+
+// 校准时每项测试的数据量（字节）/ Data per calibration test (bytes)
+#define SD_BENCH_CALIBRATION_BYTES (512 * 1024)
+
+// 接口测试的块大小范围（字节）/ Block size range for endpoint tests (bytes)
+#define SD_BENCH_MIN_BLOCK 512
+#define SD_BENCH_MAX_BLOCK 65536
+
+// 接口测速任务配置（与下载相同，低于视频流）/ Endpoint benchmark task configuration (same as downloads, below streaming)
+#define SD_BENCH_TASK_STACK 4096
+#define SD_BENCH_TASK_PRIORITY 2
+#define SD_BENCH_TASK_CORE 0
+
+// 接口测试的默认和最大数据量（字节）/ Default and maximum data per endpoint test (bytes)
+#define SD_BENCH_DEFAULT_BYTES (1024 * 1024)
+#define SD_BENCH_MAX_BYTES (8 * 1024 * 1024)
+
+// 写入速度相对录像码率的最低余量（百分比）/ Minimum write speed relative to the recording bitrate (percent)
+#define SD_BENCH_HEADROOM_PERCENT 200
+
+// 单项测试结果 / Result of one test
+typedef struct {
+    uint32_t blockSize;         // 块大小（字节）/ Block size (bytes)
+    uint32_t bytes;             // 数据量（字节）/ Data size (bytes)
+    uint32_t writeKBps;         // 顺序写速度（KB/s，含关闭文件）/ Sequential write speed (KB/s, including close)
+    uint32_t readKBps;          // 顺序读速度（KB/s）/ Sequential read speed (KB/s)
+    uint32_t writeP50Us;        // 单块写延迟P50（微秒）/ Per-block write latency P50 (us)
+    uint32_t writeP99Us;        // 单块写延迟P99（微秒）/ Per-block write latency P99 (us)
+    uint32_t writeMaxUs;        // 单块写延迟最大值（微秒）/ Per-block write latency max (us)
+    uint32_t readP50Us;         // 单块读延迟P50（微秒）/ Per-block read latency P50 (us)
+    uint32_t readP99Us;         // 单块读延迟P99（微秒）/ Per-block read latency P99 (us)
+    uint32_t readMaxUs;         // 单块读延迟最大值（微秒）/ Per-block read latency max (us)
+    bool verified;              // 读回数据校验通过 / Read-back data verified
+} SdBenchResult;
+
+// 启动校准结果 / Boot calibration result
+typedef struct {
+    bool done;                                                          // 已完成校准 / Calibration finished
+    int freqKhz;                                                        // 选定的总线频率 / Chosen bus frequency
+    uint32_t blockSize;                                                 // 选定的录像写块大小 / Chosen recording write block size
+    uint32_t writeKBps;                                                 // 选定配置的写速度 / Write speed of the chosen setup
+    uint32_t requiredKBps;                                              // 估算的录像码率（KB/s）/ Estimated recording bitrate (KB/s)
+    bool sufficient;                                                    // 写速度满足余量要求 / Write speed meets the headroom requirement
+    int freqs[SD_BENCH_NUM_FREQS];                                      // 尝试的频率 / Frequencies tried
+    bool mounted[SD_BENCH_NUM_FREQS];                                   // 该频率是否挂载成功 / Whether the card mounted at that frequency
+    SdBenchResult results[SD_BENCH_NUM_FREQS][SD_BENCH_NUM_BLOCK_SIZES]; // 各频率各块大小的结果 / Results per frequency and block size
+} SdBenchCalibration;
+
+/**
+ * @brief 测一种块大小的顺序读写 / Benchmark sequential read/write with one block size
+ * @param blockSize 块大小（字节）/ Block size (bytes)
+ * @param totalBytes 数据量（字节）/ Data size (bytes)
+ * @param result 输出结果 / Output result
+ * @return bool 测试完成返回true / Returns true if the test completed
+ * @details 功能说明 / Function Description:
+ *          1. 按块写入测试文件，记录每块耗时 / Write the test file block by block, timing each block
+ *          2. 按块读回并校验块序号 / Read it back block by block and check the block numbers
+ *          3. 计算速度和延迟分位数后删除测试文件 / Compute speeds and latency percentiles, then delete the test file
+ */
+bool sd_bench_run(uint32_t blockSize, uint32_t totalBytes, SdBenchResult *result);
+
+/**
+ * @brief 启动校准 / Boot calibration
+ * @param fps 录像帧率 / Recording frame rate
+ * @return bool 完成校准返回true / Returns true if the calibration ran
+ * @details 功能说明 / Function Description:
+ *          1. 依次以SD_BENCH_FREQS中的频率挂载，测所有块大小 / Mount at each frequency in SD_BENCH_FREQS and test every block size
+ *          2. 选写入最快且校验通过的频率和块大小，以该频率重新挂载并设为录像写块 / Pick the fastest verified frequency and block size, remount at it and use it as the recording write block
+ *          3. 取一帧估算录像码率，写速度余量不足时警告 / Grab one frame to estimate the recording bitrate and warn if the write speed lacks headroom
+ * @note 必须在开始录像和启动其他SD卡任务之前调用 / Must be called before recording and other SD card tasks start
+ */
+bool sd_bench_calibrate(int fps);
+
+/**
+ * @brief 获取启动校准结果 / Get the boot calibration result
+ * @param cal 输出结果 / Output result
+ */
+void sd_bench_get_calibration(SdBenchCalibration *cal);
+
+#endif // __SD_BENCH_H
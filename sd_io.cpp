@@ -0,0 +1,205 @@
+/**********************************************************************
+  文件名称 / Filename : sd_io.cpp
+  文件用途 / File Purpose : SD卡I/O调度实现文件 / SD Card I/O Scheduler Implementation File
+               本文件实现了SD卡总线的分类排队：录像写入严格优先，批量读写分块并在录像期间限速
+               This file implements class-based queuing on the SD card bus: recording writes get strict priority, bulk I/O is chunked and throttled while recording
+               主要功能包括 / Main Features:
+               1. 严格优先级排队 / Strict priority queuing
+               2. 按录像时延预算自适应批量块大小 / Bulk chunk size adapted to the recording latency budget
+               3. 录像期间批量限速 / Bulk rate limit while recording
+               4. 各类别排队时间统计 / Per-class queue wait statistics
+  作者 / Author : ESP32-S3监控项目 / ESP32-S3 Monitoring Project
+  修改日期 / Modification Date : 2026-02-05
+  硬件平台 / Hardware Platform : ESP32S3-EYE开发板 / ESP32S3-EYE Development Board
+  依赖库 / Dependencies : FreeRTOS - 递归互斥锁 / Recursive mutex
+  使用说明 / Usage Instructions : 1. 调用sd_io_init()启用调度 / Call sd_io_init() to enable scheduling
+  注意事项 / Important Notes : 总线由一个递归互斥锁表示，优先级由等待计数实现：取得锁后发现更高类别在等待就让出
+                  The bus is one recursive mutex, priority comes from waiter counts: a task that takes it while a higher class waits gives it back
+**********************************************************************/
+
+#include "sd_io.h"
+#include "esp_timer.h"
+
+// SD卡总线 / SD card bus
+static SemaphoreHandle_t sdIoMutex = NULL;
+
+// 各类别等待者数量、统计和批量限速状态 / Per-class waiters, statistics and bulk throttle state
+static uint32_t sdIoWaiting[SD_IO_NUM_CLASSES] = {0};
+static SdIoStats sdIoStats;
+static uint32_t sdIoBulkChunk = SD_IO_BULK_CHUNK_MAX;
+static uint32_t sdIoLastRecordMs = 0;
+static bool sdIoRecordSeen = false;
+static int64_t sdIoBulkReadyUs = 0;
+static portMUX_TYPE sdIoMux = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief 初始化I/O调度 / Initialise the I/O scheduler
+ * @return bool 成功返回true / Returns true on success
+ */
+bool sd_io_init(void) {
+    if(!sdIoMutex) {
+        memset(&sdIoStats, 0, sizeof(sdIoStats));
+        sdIoMutex = xSemaphoreCreateRecursiveMutex();
+    }
+    return sdIoMutex != NULL;
+}
+
+/**
+ * @brief 是否有更高类别在等待 / Whether a higher class is waiting
+ */
+static bool higher_class_waiting(int ioClass) {
+    bool waiting = false;
+    portENTER_CRITICAL(&sdIoMux);
+    for(int c = 0; c < ioClass; c++) {
+        if(sdIoWaiting[c]) {
+            waiting = true;
+        }
+    }
+    portEXIT_CRITICAL(&sdIoMux);
+    return waiting;
+}
+
+/**
+ * @brief 排队获取SD卡总线 / Queue for the SD card bus
+ */
+void sd_io_begin(int ioClass) {
+    if(!sdIoMutex) {
+        return;
+    }
+    // 嵌套调用只加深递归层数 / Nested calls only deepen the recursion
+    if(xSemaphoreGetMutexHolder(sdIoMutex) == xTaskGetCurrentTaskHandle()) {
+        xSemaphoreTakeRecursive(sdIoMutex, portMAX_DELAY);
+        return;
+    }
+
+    int64_t t0 = esp_timer_get_time();
+    portENTER_CRITICAL(&sdIoMux);
+    sdIoWaiting[ioClass]++;
+    portEXIT_CRITICAL(&sdIoMux);
+    while(true) {
+        xSemaphoreTakeRecursive(sdIoMutex, portMAX_DELAY);
+        if(!higher_class_waiting(ioClass)) {
+            break;
+        }
+        xSemaphoreGiveRecursive(sdIoMutex);
+        vTaskDelay(1);
+    }
+    uint32_t waitUs = (uint32_t)(esp_timer_get_time() - t0);
+
+    portENTER_CRITICAL(&sdIoMux);
+    sdIoWaiting[ioClass]--;
+    SdIoClassStats *stats = &sdIoStats.classes[ioClass];
+    stats->ops++;
+    stats->waitTotalUs += waitUs;
+    if(waitUs > stats->waitMaxUs) {
+        stats->waitMaxUs = waitUs;
+    }
+    if(ioClass == SD_IO_RECORD) {
+        sdIoLastRecordMs = millis();
+        sdIoRecordSeen = true;
+        // 超出预算时批量块减半，远低于预算时逐步恢复 / Halve the bulk chunk when over budget, grow it back while well under
+        if(waitUs > SD_IO_RECORD_BUDGET_MS * 1000UL) {
+            sdIoStats.recordOverBudget++;
+            sdIoBulkChunk = sdIoBulkChunk / 2 > SD_IO_BULK_CHUNK_MIN ? sdIoBulkChunk / 2 : SD_IO_BULK_CHUNK_MIN;
+        } else if(waitUs < SD_IO_RECORD_BUDGET_MS * 1000UL / 4 && sdIoBulkChunk < SD_IO_BULK_CHUNK_MAX) {
+            sdIoBulkChunk += SD_IO_BULK_CHUNK_MIN;
+        }
+    }
+    portEXIT_CRITICAL(&sdIoMux);
+}
+
+/**
+ * @brief 释放SD卡总线 / Release the SD card bus
+ */
+void sd_io_end(int ioClass, size_t bytes) {
+    if(!sdIoMutex) {
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    int64_t delayUs = 0;
+    portENTER_CRITICAL(&sdIoMux);
+    sdIoStats.classes[ioClass].bytes += bytes;
+    if(ioClass == SD_IO_BULK) {
+        // 录像期间所有批量读写共用一条限速时间线 / While recording, all bulk I/O shares one rate-limited timeline
+        if(sdIoRecordSeen && millis() - sdIoLastRecordMs < SD_IO_RECORD_ACTIVE_MS) {
+            if(sdIoBulkReadyUs < now) {
+                sdIoBulkReadyUs = now;
+            }
+            sdIoBulkReadyUs += (int64_t)bytes * 1000000 / (SD_IO_BULK_RATE_KBPS * 1024LL);
+            delayUs = sdIoBulkReadyUs - now;
+        } else {
+            sdIoBulkReadyUs = now;
+        }
+    }
+    portEXIT_CRITICAL(&sdIoMux);
+    xSemaphoreGiveRecursive(sdIoMutex);
+
+    // 只在完全释放总线后延时，不足一个节拍的累计到下次 / Only delay once the bus is fully released, less than a tick carries over to the next call
+    TickType_t ticks = pdMS_TO_TICKS(delayUs / 1000);
+    if(ticks > 0 && xSemaphoreGetMutexHolder(sdIoMutex) != xTaskGetCurrentTaskHandle()) {
+        vTaskDelay(ticks);
+    }
+}
+
+/**
+ * @brief 类别的单次读写块大小 / Single transfer size for a class
+ */
+static size_t chunk_size(int ioClass, size_t len) {
+    size_t chunk = len;
+    if(ioClass == SD_IO_BULK) {
+        portENTER_CRITICAL(&sdIoMux);
+        chunk = sdIoBulkChunk;
+        portEXIT_CRITICAL(&sdIoMux);
+    } else if(ioClass == SD_IO_STORE) {
+        chunk = SD_IO_BULK_CHUNK_MAX;
+    }
+    return chunk < len ? chunk : len;
+}
+
+/**
+ * @brief 按类别分块读取 / Read in class-sized chunks
+ * @return size_t 实际读取字节数 / Bytes actually read
+ */
+size_t sd_io_read(File &file, uint8_t *buf, size_t len, int ioClass) {
+    size_t done = 0;
+    while(done < len) {
+        size_t n = chunk_size(ioClass, len - done);
+        sd_io_begin(ioClass);
+        size_t got = file.read(buf + done, n);
+        sd_io_end(ioClass, got);
+        done += got;
+        if(got != n) {
+            break;
+        }
+    }
+    return done;
+}
+
+/**
+ * @brief 按类别分块写入 / Write in class-sized chunks
+ * @return size_t 实际写入字节数 / Bytes actually written
+ */
+size_t sd_io_write(File &file, const uint8_t *buf, size_t len, int ioClass) {
+    size_t done = 0;
+    while(done < len) {
+        size_t n = chunk_size(ioClass, len - done);
+        sd_io_begin(ioClass);
+        size_t put = file.write(buf + done, n);
+        sd_io_end(ioClass, put);
+        done += put;
+        if(put != n) {
+            break;
+        }
+    }
+    return done;
+}
+
+/**
+ * @brief 获取调度统计 / Get scheduler statistics
+ */
+void sd_io_get_stats(SdIoStats *stats) {
+    portENTER_CRITICAL(&sdIoMux);
+    *stats = sdIoStats;
+    stats->bulkChunk = sdIoBulkChunk;
+    portEXIT_CRITICAL(&sdIoMux);
+}
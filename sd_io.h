@@ -0,0 +1,118 @@
+/**********************************************************************
+  文件名称 / Filename : sd_io.h
+  文件用途 / File Purpose : SD卡I/O调度头文件 / SD Card I/O Scheduler Header File
+               声明了按类别排队访问SD卡总线（录像优先、批量读取分块限速）相关的函数原型和宏定义
+               Declares function prototypes and macro definitions for class-based queuing on the SD card bus (recording first, bulk reads chunked and throttled)
+  作者 / Author : ESP32-S3监控项目 / ESP32-S3 Monitoring Project
+  修改日期 / Modification Date : 2026-02-05
+  硬件平台 / Hardware Platform : ESP32S3-EYE开发板 / ESP32S3-EYE Development Board
+  依赖库 / Dependencies : FS.h - 文件读写 / File reads and writes
+  使用说明 / Usage Instructions : 1. 包含本头文件 #include "sd_io.h" / Include this header file
+               2. SD卡挂载后调用sd_io_init() / Call sd_io_init() after the SD card is mounted
+               3. 数据读写用sd_io_read()/sd_io_write()，或用sd_io_begin()/sd_io_end()包住一组操作 / Use sd_io_read()/sd_io_write() for data I/O, or wrap a group of operations in sd_io_begin()/sd_io_end()
+  参数调整 / Parameter Adjustment : SD_IO_RECORD_BUDGET_MS - 录像写入的排队时延预算（默认20毫秒）/ Queue latency budget for recording writes (default 20 ms)
+                  SD_IO_BULK_CHUNK_MAX - 批量读写单次最大块（默认16KB）/ Largest single bulk transfer (default 16KB)
+                  SD_IO_BULK_RATE_KBPS - 录像期间批量读写限速（默认1024KB/s）/ Bulk rate limit while recording (default 1024KB/s)
+  注意事项 / Important Notes : 类别：录像写入 > 照片写入和删除 > 批量读写（HTTP读取、旧录像压缩），高类别在等待时低类别让出总线
+                  Classes: recording writes > photo writes and deletes > bulk I/O (HTTP reads, old recording compression); lower classes yield while a higher one waits
+               录像等待超过预算时批量块减半，之后逐步恢复 / When recording waits longer than its budget the bulk chunk is halved, then grows back gradually
+               同一任务可嵌套调用，只有最外层排队 / Calls nest within one task, only the outermost one queues
+               索引、书签、策略、统计等小文件、照片包打开和剪辑建文件按SD_IO_STORE排队，索引压缩、剪辑复制、旧录像压缩和SD卡测速按SD_IO_BULK排队
+                  Small metadata files (catalog, bookmarks, policies, statistics), photo pack opens and clip file creation queue as SD_IO_STORE; catalog compaction, clip copies, old recording compression and SD benchmarks as SD_IO_BULK
+               同时持有模块锁时先调用sd_io_begin()再加锁：录像任务持有总线时会更新索引，顺序相反会死锁
+                  When a module lock is also needed, call sd_io_begin() before taking it: the recorder updates the catalog while holding the bus, the opposite order deadlocks
+**********************************************************************/
+
+#ifndef __SD_IO_H
+#define __SD_IO_H
+
+#include "Arduino.h"
+#include "FS.h"
+
+// 调度类别（数值越小优先级越高）/ Scheduling classes (lower value, higher priority)
+#define SD_IO_RECORD 0                      // 录像写入 / Recording writes
+#define SD_IO_STORE 1                       // 照片写入、文件删除 / Photo writes, file deletes
+#define SD_IO_BULK 2                        // HTTP读取、旧录像压缩 / HTTP reads, old recording compression
+#define SD_IO_NUM_CLASSES 3
+
+// 录像写入的排队时延预算（毫秒）/ Queue latency budget for recording writes (ms)
+#define SD_IO_RECORD_BUDGET_MS 20
+
+// 批量读写块大小范围（字节）/ Bulk transfer chunk range (bytes)
+#define SD_IO_BULK_CHUNK_MAX (16 * 1024)
+#define SD_IO_BULK_CHUNK_MIN (2 * 1024)
+
+// 录像期间批量读写限速（KB/s）/ Bulk rate limit while recording (KB/s)
+#define SD_IO_BULK_RATE_KBPS 1024
+
+// 距上次录像写入在此时间内视为正在录像（毫秒）/ Recording counts as active within this long of the last recording write (ms)
+#define SD_IO_RECORD_ACTIVE_MS 500
+
+// 单个类别的统计 / Per-class statistics
+typedef struct {
+    uint32_t ops;                       // 排队次数 / Times queued
+    uint64_t bytes;                     // 读写字节数 / Bytes transferred
+    uint64_t waitTotalUs;               // 累计排队时间（微秒）/ Total queue wait (us)
+    uint32_t waitMaxUs;                 // 最长排队时间（微秒）/ Longest queue wait (us)
+} SdIoClassStats;
+
+// 调度统计 / Scheduler statistics
+typedef struct {
+    SdIoClassStats classes[SD_IO_NUM_CLASSES];  // 各类别统计 / Per-class statistics
+    uint32_t recordOverBudget;                  // 录像排队超出预算次数 / Recording waits over budget
+    uint32_t bulkChunk;                         // 当前批量块大小（字节）/ Current bulk chunk size (bytes)
+} SdIoStats;
+
+/**
+ * @brief 初始化I/O调度 / Initialise the I/O scheduler
+ * @return bool 成功返回true / Returns true on success
+ * @note 初始化前的调用直接访问SD卡，不排队 / Calls made before init go straight to the card without queuing
+ */
+bool sd_io_init(void);
+
+/**
+ * @brief 排队获取SD卡总线 / Queue for the SD card bus
+ * @param ioClass 调度类别 / Scheduling class
+ * @details 功能说明 / Function Description:
+ *          1. 登记为该类别的等待者 / Register as a waiter of the class
+ *          2. 取得总线后若有更高类别在等待则让出，稍后重试 / After taking the bus, give it back and retry if a higher class is waiting
+ *          3. 记录排队时间 / Record the queue wait
+ */
+void sd_io_begin(int ioClass);
+
+/**
+ * @brief 释放SD卡总线 / Release the SD card bus
+ * @param ioClass 调度类别（与sd_io_begin()相同）/ Scheduling class (same as sd_io_begin())
+ * @param bytes 本次读写字节数 / Bytes transferred
+ * @note 录像期间批量类别在释放后按SD_IO_BULK_RATE_KBPS延时 / While recording, the bulk class is delayed after release to stay within SD_IO_BULK_RATE_KBPS
+ */
+void sd_io_end(int ioClass, size_t bytes);
+
+/**
+ * @brief 按类别分块读取 / Read in class-sized chunks
+ * @param file 文件 / File
+ * @param buf 输出缓冲区 / Output buffer
+ * @param len 读取长度 / Length to read
+ * @param ioClass 调度类别 / Scheduling class
+ * @return size_t 实际读取字节数 / Bytes actually read
+ * @note 录像类别一次读完，其他类别每块单独排队 / The recording class reads in one go, other classes queue per chunk
+ */
+size_t sd_io_read(File &file, uint8_t *buf, size_t len, int ioClass);
+
+/**
+ * @brief 按类别分块写入 / Write in class-sized chunks
+ * @param file 文件 / File
+ * @param buf 数据 / Data
+ * @param len 写入长度 / Length to write
+ * @param ioClass 调度类别 / Scheduling class
+ * @return size_t 实际写入字节数 / Bytes actually written
+ */
+size_t sd_io_write(File &file, const uint8_t *buf, size_t len, int ioClass);
+
+/**
+ * @brief 获取调度统计 / Get scheduler statistics
+ * @param stats 输出统计 / Output statistics
+ */
+void sd_io_get_stats(SdIoStats *stats);
+
+#endif // __SD_IO_H
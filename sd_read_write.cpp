@@ -48,6 +48,14 @@
 **********************************************************************/
 
 #include "sd_read_write.h"
+#include "bookmark.h"
+#include "catalog.h"
+#include "sd_space.h"
+#include "retention.h"
+#include "photo_pack.h"
+#include "sd_io.h"
+#include "sd_recovery.h"
+#include "storage_stats.h"
 #include "time.h"
 
 // 视频录制相关变量 / Video recording related variables
@@ -69,6 +77,24 @@ static const uint32_t VIDEO_SEGMENT_DURATION = 120; // 视频分段时长（秒
 static AVI_MAIN_HEADER aviMainHeader;     // AVI主头 / AVI main header
 static AVI_STREAM_HEADER aviStreamHeader; // AVI流头 / AVI stream header
 static AVI_BITMAP_INFO aviBitmapInfo;     // AVI位图信息 / AVI bitmap info
+static uint32_t *videoFrameSizes = NULL;  // 每帧大小（PSRAM，用于写idx1）/ Per-frame size (PSRAM, used to write idx1)
+static uint32_t videoFrameSizesCap = 0;   // 帧大小数组容量 / Frame size array capacity
+
+// 已确认存在的日期目录（照片、视频各一条），避免每次生成文件名都访问SD卡 / Date directories known to exist (one each for photos and videos), so generating a filename does not touch the SD card
+static char knownDateDirs[2][48] = {"", ""};
+static portMUX_TYPE knownDateDirsMux = portMUX_INITIALIZER_UNLOCKED;
+static bool videoIndexComplete = true;    // 帧大小是否全部记录 / Whether every frame size was recorded
+static time_t videoSegmentStartEpoch = 0; // 当前分段开始时间（Unix时间戳）/ Current segment start time (Unix timestamp)
+static volatile uint32_t videoPendingGapMs = 0; // 待补的录像间隙（毫秒）/ Pending recording gap to fill (ms)
+static portMUX_TYPE videoGapMux = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t videoAccountedBytes = 0;  // 已计入空间统计的文件大小 / File size already counted in the space accounting
+static uint32_t videoWriteBlockSize = 0;  // 录像文件写缓冲大小，0为默认 / Recording file write buffer size, 0 keeps the default
+static uint32_t videoWriteFailures = 0;   // 连续写帧失败次数 / Consecutive frame write failures
+static char lostVideoFilename[64] = "";   // 掉卡时收尾的分段，重新挂载后补记索引 / Segment closed out on card loss, its catalog entry is fixed after remount
+static uint32_t lostVideoEndTime = 0;     // 该分段的结束时间（Unix时间戳）/ That segment's end time (Unix timestamp)
+
+// SD卡总线频率（kHz），由启动校准调整 / SD card bus frequency (kHz), adjusted by the boot calibration
+static int sdmmcFreqKhz = SDMMC_FREQ_DEFAULT;
 
 /**
  * @brief SD_MMC存储卡初始化函数
@@ -92,9 +118,9 @@ bool sdmmcInit(void){
   // - "/sdcard": 挂载点路径
   // - true: 使用1位数据线模式（false为4位模式）
   // - true: 格式化卡（如果需要）
-  // - SDMMC_FREQ_DEFAULT: 使用默认频率
-  // - 5: 最大频率分频值
-  if (!SD_MMC.begin(SD_MOUNT_POINT, true, true, SDMMC_FREQ_DEFAULT, 5)) {
+  // - sdmmcFreqKhz: 总线频率（默认SDMMC_FREQ_DEFAULT，启动校准后可能提高）
+  // - 5: 最大同时打开文件数
+  if (!SD_MMC.begin(SD_MOUNT_POINT, true, true, sdmmcFreqKhz, 5)) {
     // SD卡挂载失败，输出错误信息
     Serial.println("Card Mount Failed");
     return false;
@@ -125,15 +151,48 @@ bool sdmmcInit(void){
   uint64_t cardSize = SD_MMC.cardSize() / (1024 * 1024);
   Serial.printf("SD_MMC Card Size: %lluMB\n", cardSize);
   
+  // 挂载时读取一次准确的空间信息，之后由文件操作增量维护
+  if(!sd_space_init()){
+      Serial.println("SD space reading failed / SD卡空间读取失败");
+  }
+  
   // 输出SD卡总空间（单位：MB）
-  Serial.printf("Total space: %lluMB\r\n", SD_MMC.totalBytes() / (1024 * 1024));
+  Serial.printf("Total space: %lluMB\r\n", sd_space_total_bytes() / (1024 * 1024));
   
   // 输出SD卡已用空间（单位：MB）
-  Serial.printf("Used space: %lluMB\r\n", SD_MMC.usedBytes() / (1024 * 1024));
+  Serial.printf("Used space: %lluMB\r\n", sd_space_used_bytes() / (1024 * 1024));
   
   return true;
 }
 
+static void forgetDateDirs(void);
+
+/**
+ * @brief 以指定总线频率重新挂载SD卡
+ * @param freqKhz 总线频率（kHz）
+ * @return bool 挂载成功返回true
+ * @note 只在没有打开文件时调用（启动校准、掉卡恢复）；挂载失败不格式化，调用方应退回原频率或稍后重试
+ *       重新挂载后可能是另一张卡，清空已知日期目录
+ */
+bool sdmmcRemount(int freqKhz){
+  SD_MMC.end();
+  forgetDateDirs();
+  if(!SD_MMC.begin(SD_MOUNT_POINT, true, false, freqKhz, 5) || SD_MMC.cardType() == CARD_NONE){
+    Serial.printf("SD card remount at %d kHz failed\n", freqKhz);
+    return false;
+  }
+  sdmmcFreqKhz = freqKhz;
+  return true;
+}
+
+/**
+ * @brief 获取当前SD卡总线频率
+ * @return int 总线频率（kHz）
+ */
+int sdmmcGetFreqKhz(void){
+  return sdmmcFreqKhz;
+}
+
 /**
  * @brief 列出目录内容函数
  * @param fs 文件系统对象引用
@@ -426,22 +485,29 @@ void testFileIO(fs::FS &fs, const char * path){
  *          1. 打开文件进行写入（覆盖模式）
  *          2. 将JPEG二进制数据写入文件
  *          3. 输出保存结果
+ * @return bool 全部写入返回true
  * @note 这是本项目的核心函数，用于保存摄像头拍摄的照片
  *       buf指向摄像头帧缓冲区，size为图像数据长度
  */
-void writejpg(fs::FS &fs, const char * path, const uint8_t *buf, size_t size){
+bool writejpg(fs::FS &fs, const char * path, const uint8_t *buf, size_t size){
     // 打开文件进行写入（覆盖模式）
     File file = fs.open(path, FILE_WRITE);
     if(!file){
       Serial.println("Failed to open file for writing");
-      return;
+      return false;
     }
     
     // 写入JPEG二进制数据
-    file.write(buf, size);
+    bool ok = sd_io_write(file, buf, size, SD_IO_STORE) == size;
+    file.close();
+    if(!ok){
+      Serial.printf("Failed to write file: %s\r\n", path);
+      return false;
+    }
     
     // 输出保存成功信息
     Serial.printf("Saved file to path: %s\r\n", path);
+    return true;
 }
 
 /**
@@ -457,6 +523,14 @@ void writejpg(fs::FS &fs, const char * path, const uint8_t *buf, size_t size){
  *       例如：/camera/0.jpg, /camera/1.jpg, /camera/2.jpg, ...
  */
 int readFileNum(fs::FS &fs, const char * dirname){
+    // 索引覆盖的目录直接从索引统计，不遍历目录
+    if(&fs == &SD_MMC){
+        int cataloged = catalog_count(dirname);
+        if(cataloged >= 0){
+            return cataloged;
+        }
+    }
+    
     // 打开目录
     File root = fs.open(dirname);
     if(!root){
@@ -531,9 +605,165 @@ void initPhotoDir(void){
     }
 }
 
+/**
+ * @brief 解析定长数字目录名
+ * @param name 目录名
+ * @param digits 位数
+ * @return int 数值，不是定长数字返回-1
+ */
+static int parseDateDirName(const char *name, int digits){
+    int value = 0;
+    for(int i = 0; i < digits; i++){
+        if(name[i] < '0' || name[i] > '9'){
+            return -1;
+        }
+        value = value * 10 + (name[i] - '0');
+    }
+    return name[digits] == '\0' ? value : -1;
+}
+
+/**
+ * @brief 列出目录下的日期子目录名（升序）
+ * @param dir 目录路径
+ * @param digits 目录名位数（年4位，月日2位）
+ * @param values 输出数组
+ * @param maxValues 数组容量
+ * @return int 子目录数量
+ * @note 先列出名字再关闭目录，逐级查找时同一时间只打开一个目录
+ */
+static int listDateDirNames(const char *dir, int digits, int *values, int maxValues){
+    File root = SD_MMC.open(dir);
+    if(!root || !root.isDirectory()){
+        return 0;
+    }
+    int num = 0;
+    File entry = root.openNextFile();
+    while(entry && num < maxValues){
+        int value = entry.isDirectory() ? parseDateDirName(entry.name(), digits) : -1;
+        entry.close();
+        if(value >= 0){
+            // 插入排序，保持升序
+            int i = num++;
+            while(i > 0 && values[i - 1] > value){
+                values[i] = values[i - 1];
+                i--;
+            }
+            values[i] = value;
+        }
+        entry = root.openNextFile();
+    }
+    return num;
+}
+
+/**
+ * @brief 查找日期目录
+ * @param dirname 保存目录
+ * @param after 只找晚于这一天的目录（YYYYMMDD，0表示不限）
+ * @param newest true找最新的一天，false找after之后最旧的一天
+ * @return uint32_t 日期（YYYYMMDD），没有返回0
+ * @details 功能说明：
+ *          1. 列出年目录，按顺序（或倒序）逐个进入
+ *          2. 早于after的年、月直接跳过，不列出下一级
+ *          3. 找到的第一天就是结果
+ * @note 只读年、月、日三级目录项，不打开日期目录里的文件
+ */
+uint32_t findDateDir(const char *dirname, uint32_t after, bool newest){
+    int years[64];
+    int months[32];
+    int days[32];
+    char path[64];
+    int yearCount = listDateDirNames(dirname, 4, years, 64);
+    for(int yi = 0; yi < yearCount; yi++){
+        uint32_t year = years[newest ? yearCount - 1 - yi : yi];
+        if(year < after / 10000){
+            continue;
+        }
+        snprintf(path, sizeof(path), "%s/%04lu", dirname, (unsigned long)year);
+        int monthCount = listDateDirNames(path, 2, months, 32);
+        for(int mi = 0; mi < monthCount; mi++){
+            uint32_t yearMonth = year * 100 + months[newest ? monthCount - 1 - mi : mi];
+            if(yearMonth < after / 100){
+                continue;
+            }
+            snprintf(path, sizeof(path), "%s/%04lu/%02lu", dirname, (unsigned long)year, (unsigned long)(yearMonth % 100));
+            int dayCount = listDateDirNames(path, 2, days, 32);
+            for(int di = 0; di < dayCount; di++){
+                uint32_t date = yearMonth * 100 + days[newest ? dayCount - 1 - di : di];
+                if(date > after){
+                    return date;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief 生成日期目录路径
+ * @param dirname 保存目录
+ * @param date 日期（YYYYMMDD）
+ * @param path 输出缓冲区
+ * @param pathSize 缓冲区大小
+ */
+void dateDirPath(const char *dirname, uint32_t date, char *path, size_t pathSize){
+    snprintf(path, pathSize, "%s/%04lu/%02lu/%02lu", dirname,
+             (unsigned long)(date / 10000), (unsigned long)(date / 100 % 100), (unsigned long)(date % 100));
+}
+
+/**
+ * @brief 确保日期目录存在
+ * @param dateDir 日期目录路径（prefix/YYYY/MM/DD）
+ * @param prefixLen 保存目录路径长度
+ * @details 功能说明：
+ *          1. 与最近确认过的目录相同时直接返回
+ *          2. 否则逐级检查并创建年、月、日目录
+ * @note 一天只在第一次生成文件名时访问SD卡
+ */
+static void ensureDateDir(const char *dateDir, size_t prefixLen){
+    char dir[48];
+    size_t len = strlen(dateDir);
+    if(len >= sizeof(dir)){
+        return;
+    }
+    int slot = strncmp(dateDir, VIDEO_DIR, strlen(VIDEO_DIR)) == 0 ? 1 : 0;
+    portENTER_CRITICAL(&knownDateDirsMux);
+    bool known = strcmp(knownDateDirs[slot], dateDir) == 0;
+    portEXIT_CRITICAL(&knownDateDirsMux);
+    if(known){
+        return;
+    }
+    
+    // 逐级创建年、月、日目录
+    for(size_t i = prefixLen + 1; i <= len; i++){
+        if(dateDir[i] != '/' && dateDir[i] != '\0'){
+            continue;
+        }
+        memcpy(dir, dateDir, i);
+        dir[i] = '\0';
+        if(!SD_MMC.exists(dir) && !SD_MMC.mkdir(dir)){
+            Serial.printf("Failed to create directory: %s\n", dir);
+            return;
+        }
+    }
+    
+    portENTER_CRITICAL(&knownDateDirsMux);
+    memcpy(knownDateDirs[slot], dateDir, len + 1);
+    portEXIT_CRITICAL(&knownDateDirsMux);
+}
+
+/**
+ * @brief 忘记已确认的日期目录（删除日期目录后调用）
+ */
+static void forgetDateDirs(void){
+    portENTER_CRITICAL(&knownDateDirsMux);
+    knownDateDirs[0][0] = '\0';
+    knownDateDirs[1][0] = '\0';
+    portEXIT_CRITICAL(&knownDateDirsMux);
+}
+
 /**
  * @brief 生成时间戳文件名
- * @param prefix 文件名前缀（如"photo"或"video"）
+ * @param prefix 保存目录（如PHOTO_DIR或VIDEO_DIR）
  * @param extension 文件扩展名（如".jpg"或".avi"）
  * @param path 输出缓冲区
  * @param pathSize 缓冲区大小
@@ -542,16 +772,37 @@ void initPhotoDir(void){
  *          2. 格式化为YYYYMMDDHHMM格式
  *          3. 生成完整文件名
  * @note 文件名格式：YYYYMMDDHHMM（年月日时分）
+ *       路径格式：prefix/YYYY/MM/DD/YYYYMMDDHHMM.ext，日期目录不存在时自动创建
  */
 void generateTimestampFilename(const char *prefix, const char *extension, char *path, size_t pathSize) {
-    // 获取当前系统时间
-    time_t now = time(nullptr);
+    generateTimestampFilenameAt(time(nullptr), prefix, extension, path, pathSize);
+}
+
+/**
+ * @brief 按指定时间生成时间戳文件名
+ * @param when 文件时间（Unix时间戳）
+ * @param prefix 保存目录
+ * @param extension 文件扩展名
+ * @param path 输出缓冲区
+ * @param pathSize 缓冲区大小
+ * @note 用于延迟写入的文件（如连拍），文件名和日期目录仍按拍摄时间生成
+ */
+void generateTimestampFilenameAt(time_t when, const char *prefix, const char *extension, char *path, size_t pathSize) {
     struct tm timeinfo;
-    localtime_r(&now, &timeinfo);
+    localtime_r(&when, &timeinfo);
+    
+    // 日期目录：prefix/YYYY/MM/DD
+    char dateDir[48];
+    snprintf(dateDir, sizeof(dateDir), "%s/%04d/%02d/%02d",
+             prefix,
+             timeinfo.tm_year + 1900,
+             timeinfo.tm_mon + 1,
+             timeinfo.tm_mday);
+    ensureDateDir(dateDir, strlen(prefix));
     
     // 生成文件名：YYYYMMDDHHMM
     snprintf(path, pathSize, "%s/%04d%02d%02d%02d%02d%s", 
-             prefix,
+             dateDir,
              timeinfo.tm_year + 1900,
              timeinfo.tm_mon + 1,
              timeinfo.tm_mday,
@@ -560,6 +811,39 @@ void generateTimestampFilename(const char *prefix, const char *extension, char *
              extension);
 }
 
+/**
+ * @brief 从时间戳文件名解析时间
+ * @param path 文件路径或文件名
+ * @return time_t Unix时间戳，格式不符返回0
+ * @details 功能说明：
+ *          1. 取最后一个'/'之后的文件名
+ *          2. 解析前12位数字YYYYMMDDHHMM
+ *          3. 按本地时区转换为时间戳
+ * @note generateTimestampFilename()的逆操作
+ */
+time_t parseTimestampFromPath(const char *path) {
+    const char *name = strrchr(path, '/');
+    name = name ? name + 1 : path;
+    
+    // 检查前12位是否都是数字
+    for(int i = 0; i < 12; i++){
+        if(name[i] < '0' || name[i] > '9'){
+            return 0;
+        }
+    }
+    
+    struct tm timeinfo;
+    memset(&timeinfo, 0, sizeof(timeinfo));
+    timeinfo.tm_year = (name[0]-'0')*1000 + (name[1]-'0')*100 + (name[2]-'0')*10 + (name[3]-'0') - 1900;
+    timeinfo.tm_mon = (name[4]-'0')*10 + (name[5]-'0') - 1;
+    timeinfo.tm_mday = (name[6]-'0')*10 + (name[7]-'0');
+    timeinfo.tm_hour = (name[8]-'0')*10 + (name[9]-'0');
+    timeinfo.tm_min = (name[10]-'0')*10 + (name[11]-'0');
+    timeinfo.tm_isdst = -1;
+    time_t t = mktime(&timeinfo);
+    return t > 0 ? t : 0;
+}
+
 /**
  * @brief 保存摄像头照片到SD卡
  * @param buf JPEG图像数据指针
@@ -574,12 +858,50 @@ void generateTimestampFilename(const char *prefix, const char *extension, char *
  *       视频保存在/camera/videos目录下
  */
 bool savePhotoToSD(const uint8_t *buf, size_t size){
+    return savePhotoToSDAt(buf, size, time(nullptr));
+}
+
+/**
+ * @brief 按拍摄时间保存照片到SD卡
+ * @param buf JPEG图像数据指针
+ * @param size JPEG图像数据长度（字节数）
+ * @param when 拍摄时间（Unix时间戳）
+ * @param savedPath 输出实际保存的路径（可为NULL）
+ * @param savedPathSize savedPath缓冲区大小
+ * @return bool 保存成功返回true，失败返回false
+ * @details 功能说明：
+ *          1. 按拍摄时间生成YYYYMMDDHHMM文件名
+ *          2. 同一分钟内已有同名照片时追加_1、_2...序号，不覆盖
+ *          3. 将JPEG数据写入文件
+ */
+bool savePhotoToSDAt(const uint8_t *buf, size_t size, time_t when, char *savedPath, size_t savedPathSize){
     // 生成时间戳格式的照片文件名
     char path[64];
-    generateTimestampFilename(PHOTO_DIR, ".jpg", path, sizeof(path));
+    generateTimestampFilenameAt(when, PHOTO_DIR, ".jpg", path, sizeof(path));
+    
+    // 同名文件已存在时追加序号
+    if(SD_MMC.exists(path)){
+        char base[64];
+        generateTimestampFilenameAt(when, PHOTO_DIR, "", base, sizeof(base));
+        for(int seq = 1; seq < 1000; seq++){
+            snprintf(path, sizeof(path), "%s_%d.jpg", base, seq);
+            if(!SD_MMC.exists(path)){
+                break;
+            }
+        }
+    }
     
-    // 写入JPEG数据到文件
-    writejpg(SD_MMC, path, buf, size);
+    // 写入JPEG数据到文件，失败时删除残缺文件
+    if(!writejpg(SD_MMC, path, buf, size)){
+        SD_MMC.remove(path);
+        return false;
+    }
+    sd_space_file_added(size);
+    storage_stats_add(RETENTION_PHOTO, size);
+    catalog_add(path, CATALOG_TYPE_PHOTO, (uint32_t)when, (uint32_t)time(nullptr), size, 0);
+    if(savedPath){
+        snprintf(savedPath, savedPathSize, "%s", path);
+    }
     
     // 输出照片信息
     Serial.printf("Photo saved: %s, Size: %u bytes\n", path, size);
@@ -591,14 +913,15 @@ bool savePhotoToSD(const uint8_t *buf, size_t size){
  * @brief 获取SD卡已用空间（MB）
  * @return uint64_t 返回已用空间（MB），失败返回0
  * @details 功能说明：
- *          1. 调用SD_MMC.usedBytes()获取已用字节数
+ *          1. 读取缓存的已用字节数
  *          2. 转换为MB单位
  *          3. 返回结果
  * @note 用于监控SD卡使用情况，当空间不足时可以清理旧文件
+ *       不访问SD卡，计数由sd_space模块维护
  */
 uint64_t getSDUsedSpaceMB(void){
     // 获取已用字节数
-    uint64_t usedBytes = SD_MMC.usedBytes();
+    uint64_t usedBytes = sd_space_used_bytes();
     
     // 转换为GB单位（保留2位小数）
     return (usedBytes / (1024.0 * 1024.0 * 1024.0)) * 100;
@@ -608,14 +931,14 @@ uint64_t getSDUsedSpaceMB(void){
  * @brief 获取SD卡总空间（MB）
  * @return uint64_t 返回总空间（MB），失败返回0
  * @details 功能说明：
- *          1. 调用SD_MMC.totalBytes()获取总字节数
+ *          1. 读取缓存的总字节数
  *          2. 转换为MB单位
  *          3. 返回结果
  * @note 用于显示SD卡容量信息
  */
 uint64_t getSDTotalSpaceMB(void){
     // 获取总字节数
-    uint64_t totalBytes = SD_MMC.totalBytes();
+    uint64_t totalBytes = sd_space_total_bytes();
     
     // 转换为GB单位（保留2位小数）
     return (totalBytes / (1024.0 * 1024.0 * 1024.0)) * 100;
@@ -631,12 +954,11 @@ uint64_t getSDTotalSpaceMB(void){
  * @note 用于显示SD卡剩余空间信息
  */
 uint64_t getSDFreeSpaceMB(void){
-    // 获取总空间和已用空间
-    uint64_t totalBytes = SD_MMC.totalBytes();
-    uint64_t usedBytes = SD_MMC.usedBytes();
+    // 获取缓存的剩余空间
+    uint64_t freeBytes = sd_space_free_bytes();
     
     // 计算并返回剩余空间（GB，保留2位小数）
-    return ((totalBytes - usedBytes) / (1024.0 * 1024.0 * 1024.0)) * 100;
+    return (freeBytes / (1024.0 * 1024.0 * 1024.0)) * 100;
 }
 
 /**
@@ -738,7 +1060,7 @@ int getFileList(const char * dirname, char *files[], int maxFiles){
  * @details 功能说明：
  *          1. 打开指定目录
  *          2. 遍历目录中的所有文件
- *          3. 删除所有文件
+ *          3. 删除所有文件，子目录（日期目录）递归删除后再删除目录本身
  *          4. 返回删除的文件数量
  * @note 用于清理目录中的旧文件，释放SD卡空间
  */
@@ -762,42 +1084,49 @@ int deleteAllFiles(const char * dirname){
     // 遍历目录中的所有文件
     int num = 0;
     while(file){
-        // 只处理文件，不处理子目录
-        if(!file.isDirectory()){
-            // 构建完整文件路径
-            char path[128];
-            snprintf(path, sizeof(path), "%s/%s", dirname, file.name());
-            
-            // 删除文件
-            if(SD_MMC.remove(path)){
-                num++;
-                Serial.printf("Deleted file: %s\n", path);
-            } else {
-                Serial.printf("Failed to delete file: %s\n", path);
+        // 构建完整文件路径
+        char path[128];
+        snprintf(path, sizeof(path), "%s/%s", dirname, file.name());
+        bool isDir = file.isDirectory();
+        size_t fileSize = isDir ? 0 : file.size();
+        
+        // 先关闭再删除，递归时不多占打开文件数
+        file.close();
+        if(isDir){
+            // 子目录递归删除
+            int deleted = deleteAllFiles(path);
+            if(deleted > 0){
+                num += deleted;
             }
+            SD_MMC.rmdir(path);
+        } else if(SD_MMC.remove(path)){
+            // 删除文件
+            sd_space_file_removed(fileSize);
+            catalog_remove(path);
+            num++;
+            Serial.printf("Deleted file: %s\n", path);
+        } else {
+            Serial.printf("Failed to delete file: %s\n", path);
         }
         // 打开下一个文件
         file = root.openNextFile();
     }
+    forgetDateDirs();
     
     // 返回删除的文件数量
     return num;
 }
 
 /**
- * @brief 清理无效视频文件函数
- * @details 功能说明：
- *          1. 遍历videos目录中的所有文件
- *          2. 检查每个文件的大小是否为0KB
- *          3. 删除所有大小为0KB的视频文件
- *          4. 返回删除的文件数量
- * @note 用于清理启动时可能产生的无效视频文件
+ * @brief 删除目录中大小为0KB的视频文件
+ * @param dirname 目录路径
+ * @return int 返回删除的文件数量，目录打开失败返回-1
  */
-int cleanInvalidVideoFiles(void){
-    // 打开videos目录
-    File root = SD_MMC.open(VIDEO_DIR);
+static int cleanInvalidVideoFilesIn(const char *dirname){
+    // 打开目录
+    File root = SD_MMC.open(dirname);
     if(!root){
-        Serial.println("Failed to open videos directory");
+        Serial.printf("Failed to open directory: %s\n", dirname);
         return -1;
     }
     
@@ -819,10 +1148,11 @@ int cleanInvalidVideoFiles(void){
             if(file.size() == 0){
                 // 构建完整文件路径
                 char path[128];
-                snprintf(path, sizeof(path), "%s/%s", VIDEO_DIR, file.name());
+                snprintf(path, sizeof(path), "%s/%s", dirname, file.name());
                 
                 // 删除无效视频文件
                 if(SD_MMC.remove(path)){
+                    catalog_remove(path);
                     num++;
                     Serial.printf("Deleted invalid video file (0KB): %s\n", path);
                 } else {
@@ -838,6 +1168,35 @@ int cleanInvalidVideoFiles(void){
     return num;
 }
 
+/**
+ * @brief 清理无效视频文件函数
+ * @details 功能说明：
+ *          1. 检查videos根目录（旧版平铺存放的文件）
+ *          2. 检查最新的日期目录
+ *          3. 删除所有大小为0KB的视频文件
+ *          4. 返回删除的文件数量
+ * @note 用于清理启动时可能产生的无效视频文件
+ *       断电中断的分段只会在最新的日期目录中，不遍历更早的日期
+ */
+int cleanInvalidVideoFiles(void){
+    int num = cleanInvalidVideoFilesIn(VIDEO_DIR);
+    if(num < 0){
+        return -1;
+    }
+    
+    // 最新的日期目录
+    uint32_t newest = findDateDir(VIDEO_DIR, 0, true);
+    if(newest){
+        char dateDir[48];
+        dateDirPath(VIDEO_DIR, newest, dateDir, sizeof(dateDir));
+        int deleted = cleanInvalidVideoFilesIn(dateDir);
+        if(deleted > 0){
+            num += deleted;
+        }
+    }
+    return num;
+}
+
 /**
  * @brief 检查SD卡空间是否需要清理
  * @return bool 需要清理返回true，否则返回false
@@ -850,16 +1209,13 @@ int cleanInvalidVideoFiles(void){
  *       适应不同容量规格的SD卡（如32GB、64GB、128GB等）
  */
 bool checkSDSpaceNeedsCleanup(void){
-    // 获取总空间和已用空间
-    uint64_t totalBytes = SD_MMC.totalBytes();
-    uint64_t usedBytes = SD_MMC.usedBytes();
-    
-    // 计算剩余空间（GB单位）
-    uint64_t freeSpaceGB = (totalBytes - usedBytes) / (1024.0 * 1024.0 * 1024.0);
+    // 计算剩余空间（GB单位），读取缓存值，不访问SD卡
+    uint64_t freeSpaceGB = sd_space_free_bytes() / (1024.0 * 1024.0 * 1024.0);
     
-    // 检查剩余空间是否小于保留空间阈值
-    if(freeSpaceGB < SD_SPACE_RESERVE_GB){
-        Serial.printf("SD卡空间不足，需要清理: 剩余空间 %lluGB < 保留空间 %dGB\n", freeSpaceGB, SD_SPACE_RESERVE_GB);
+    // 检查剩余空间是否小于保留空间阈值（运行时保留策略）
+    uint64_t reserveGB = retention_low_watermark_bytes() / (1024ULL * 1024ULL * 1024ULL);
+    if(freeSpaceGB < reserveGB){
+        Serial.printf("SD卡空间不足，需要清理: 剩余空间 %lluGB < 保留空间 %lluGB\n", freeSpaceGB, reserveGB);
         return true;
     }
     
@@ -878,8 +1234,39 @@ bool checkSDSpaceNeedsCleanup(void){
  *          3. 获取每个文件的路径、名称、大小和修改时间
  *          4. 存储到文件信息数组中
  * @note 用于获取目录中的文件信息，方便按时间排序和删除
+ *       索引覆盖的目录直接读索引（最旧的在前），索引不可用时才遍历目录
+ *       遍历时先读根目录，再按日期从旧到新读日期目录
  */
 int getFileInfoList(const char * dirname, FileInfo *files, int maxFiles){
+    int cataloged = catalog_query(dirname, 0, UINT32_MAX, 0, files, maxFiles);
+    if(cataloged >= 0){
+        return cataloged;
+    }
+    int num = scanFileInfoList(dirname, files, maxFiles);
+    
+    // 再依次遍历日期目录（最旧的在前）
+    uint32_t date = 0;
+    while(num >= 0 && num < maxFiles && (date = findDateDir(dirname, date, false)) != 0){
+        char dateDir[48];
+        dateDirPath(dirname, date, dateDir, sizeof(dateDir));
+        int found = scanFileInfoList(dateDir, files + num, maxFiles - num);
+        if(found > 0){
+            num += found;
+        }
+    }
+    return num;
+}
+
+/**
+ * @brief 遍历目录获取文件信息列表
+ * @param dirname 目录路径
+ * @param files 文件信息数组指针
+ * @param maxFiles 最大文件数量
+ * @return int 返回文件数量，失败返回-1
+ * @note 每次调用都遍历一遍FAT目录，文件多时很慢，只在索引不可用或需要看到未索引文件时使用
+ *       只读这一级目录，不进入日期子目录
+ */
+int scanFileInfoList(const char * dirname, FileInfo *files, int maxFiles){
     // 打开目录
     File root = SD_MMC.open(dirname);
     if(!root){
@@ -916,88 +1303,476 @@ int getFileInfoList(const char * dirname, FileInfo *files, int maxFiles){
     return num;
 }
 
+/**
+ * @brief 最大堆下沉（堆顶是堆中最新的文件）
+ * @param heap 堆数组
+ * @param count 堆中元素数
+ * @param i 下沉的位置
+ */
+static void siftDownNewest(FileInfo *heap, int count, int i){
+    while(true){
+        int newest = i;
+        int left = 2 * i + 1;
+        int right = left + 1;
+        if(left < count && heap[left].mtime > heap[newest].mtime){
+            newest = left;
+        }
+        if(right < count && heap[right].mtime > heap[newest].mtime){
+            newest = right;
+        }
+        if(newest == i){
+            return;
+        }
+        FileInfo temp = heap[i];
+        heap[i] = heap[newest];
+        heap[newest] = temp;
+        i = newest;
+    }
+}
+
+/**
+ * @brief 最大堆上浮
+ * @param heap 堆数组
+ * @param i 上浮的位置
+ */
+static void siftUpNewest(FileInfo *heap, int i){
+    while(i > 0){
+        int parent = (i - 1) / 2;
+        if(heap[parent].mtime >= heap[i].mtime){
+            return;
+        }
+        FileInfo temp = heap[i];
+        heap[i] = heap[parent];
+        heap[parent] = temp;
+        i = parent;
+    }
+}
+
+/**
+ * @brief 遍历目录选出最旧的K个文件
+ * @param dirname 目录路径
+ * @param files 文件信息数组指针（容量至少为k）
+ * @param k 最多选出的文件数
+ * @return int 返回选出的文件数量（最旧的在前），失败返回-1
+ * @details 功能说明：
+ *          1. files作为大小为k的最大堆，堆顶是已选文件中最新的
+ *          2. 堆满后只有比堆顶更旧的文件才替换堆顶
+ *          3. 遍历结束后原地堆排序，得到从旧到新的顺序
+ * @note 内存O(k)，时间O(n log k)，只读这一级目录，不进入子目录
+ */
+static int scanOldestFiles(const char * dirname, FileInfo *files, int k){
+    // 打开目录
+    File root = SD_MMC.open(dirname);
+    if(!root){
+        Serial.printf("Failed to open directory: %s\n", dirname);
+        return -1;
+    }
+    if(!root.isDirectory()){
+        Serial.printf("Not a directory: %s\n", dirname);
+        return -1;
+    }
+
+    // 遍历目录中的所有文件，只保留最旧的k个
+    int count = 0;
+    File file = root.openNextFile();
+    while(file){
+        if(!file.isDirectory()){
+            time_t mtime = file.getLastWrite();
+            int slot = -1;
+            if(count < k){
+                slot = count++;
+            } else if(mtime < files[0].mtime){
+                slot = 0;
+            }
+            if(slot >= 0){
+                snprintf(files[slot].path, sizeof(files[slot].path), "%s/%s", dirname, file.name());
+                snprintf(files[slot].name, sizeof(files[slot].name), "%s", file.name());
+                files[slot].size = file.size();
+                files[slot].mtime = mtime;
+                if(slot == 0){
+                    siftDownNewest(files, count, 0);
+                } else {
+                    siftUpNewest(files, slot);
+                }
+            }
+        }
+        file = root.openNextFile();
+    }
+
+    // 原地堆排序：每次把堆顶（最新）换到末尾
+    for(int end = count - 1; end > 0; end--){
+        FileInfo temp = files[0];
+        files[0] = files[end];
+        files[end] = temp;
+        siftDownNewest(files, end, 0);
+    }
+    return count;
+}
+
+/**
+ * @brief 选出目录中最旧的K个文件
+ * @param dirname 目录路径
+ * @param files 文件信息数组指针（容量至少为k）
+ * @param k 最多选出的文件数
+ * @return int 返回选出的文件数量（最旧的在前），失败返回-1
+ * @details 功能说明：
+ *          1. 索引可用时直接读索引，索引本身按时间排列
+ *          2. 否则用大小为k的最大堆遍历目录
+ * @note 内存O(k)，时间O(n log k)，不会像固定数组那样只看到前100个目录项
+ */
+int selectOldestFiles(const char * dirname, FileInfo *files, int k){
+    if(k <= 0){
+        return 0;
+    }
+    int cataloged = catalog_query(dirname, 0, UINT32_MAX, 0, files, k);
+    if(cataloged >= 0){
+        return cataloged;
+    }
+    return scanOldestFiles(dirname, files, k);
+}
+
+/**
+ * @brief 按修改时间比较两个文件（qsort用）
+ */
+static int compareFileTime(const void *a, const void *b){
+    time_t ta = ((const FileInfo*)a)->mtime;
+    time_t tb = ((const FileInfo*)b)->mtime;
+    return (ta > tb) - (ta < tb);
+}
+
 /**
  * @brief 按时间排序文件信息列表
  * @param files 文件信息数组指针
  * @param fileCount 文件数量
  * @param ascending 排序顺序，true=升序（旧→新），false=降序（新→旧）
  * @details 功能说明：
- *          1. 使用冒泡排序算法按文件修改时间排序
+ *          1. 使用qsort按文件修改时间排序
  *          2. 升序时最旧的文件在前面
  *          3. 降序时最新的文件在前面
  * @note 按文件修改时间排序，升序时最旧的文件在前面
  */
 void sortFilesByTime(FileInfo *files, int fileCount, bool ascending){
-    // 使用冒泡排序按时间排序
-    for(int i = 0; i < fileCount - 1; i++){
-        for(int j = 0; j < fileCount - i - 1; j++){
-            bool needSwap = ascending ? (files[j].mtime > files[j+1].mtime) : (files[j].mtime < files[j+1].mtime);
-            if(needSwap){
-                // 交换文件信息
-                FileInfo temp = files[j];
-                files[j] = files[j+1];
-                files[j+1] = temp;
+    if(fileCount < 2){
+        return;
+    }
+    qsort(files, fileCount, sizeof(FileInfo), compareFileTime);
+    if(!ascending){
+        // 降序时反转
+        for(int i = 0, j = fileCount - 1; i < j; i++, j--){
+            FileInfo temp = files[i];
+            files[i] = files[j];
+            files[j] = temp;
+        }
+    }
+}
+
+// 清理进度 / Cleanup progress
+typedef struct {
+    uint64_t targetBytes;       // 清理目标空间（字节）/ Target bytes to free
+    uint64_t freedBytes;        // 已释放空间（字节）/ Bytes freed so far
+    int maxFiles;               // 最多删除文件数 / Maximum files to delete
+    int deletedCount;           // 已删除文件数 / Files deleted so far
+    int protectedCount;         // 跳过的受保护分段数 / Protected segments skipped
+    bool checkBookmarks;        // 是否检查书签保护 / Whether bookmark protection applies
+    uint32_t pacingMs;          // 每删除一个文件后的让步延时 / Yield delay after each deleted file
+} CleanupProgress;
+
+/**
+ * @brief 清理是否已完成
+ */
+static bool cleanupDone(const CleanupProgress *progress){
+    return progress->deletedCount >= progress->maxFiles || progress->freedBytes >= progress->targetBytes;
+}
+
+/**
+ * @brief 删除一个文件
+ * @param file 文件信息
+ * @param progress 清理进度
+ * @return bool 已删除返回true，跳过或删除失败返回false（文件仍在目录中）
+ * @note 跳过书签保护的分段和正在录制的分段
+ */
+static bool deleteCleanupFile(const FileInfo *file, CleanupProgress *progress){
+    // 跳过书签保护的分段
+    if(progress->checkBookmarks && bookmark_is_segment_protected(file->name)){
+        progress->protectedCount++;
+        return false;
+    }
+    
+    // 跳过正在录制的分段和正在写入的照片包
+    if(isRecording && strcmp(file->path, currentVideoFilename) == 0){
+        return false;
+    }
+    if(photo_pack_is_open(file->path)){
+        return false;
+    }
+    
+    // 删除文件（大文件要遍历FAT链，排在录像写入之后）
+    sd_io_begin(SD_IO_STORE);
+    bool removed = SD_MMC.remove(file->path);
+    sd_io_end(SD_IO_STORE, 0);
+    if(removed){
+        sd_space_file_removed(file->size);
+        catalog_remove(file->path);
+        progress->freedBytes += file->size;
+        progress->deletedCount++;
+        Serial.printf("Deleted file: %s, Size: %llu bytes, Total freed: %llu bytes\n", 
+                     file->name, file->size, progress->freedBytes);
+        
+        // 后台清理时让出SD卡
+        if(progress->pacingMs){
+            vTaskDelay(pdMS_TO_TICKS(progress->pacingMs));
+        }
+        return true;
+    }
+    Serial.printf("Failed to delete file: %s\n", file->path);
+    // 文件已不存在（如在电脑上删除）时同步索引
+    sd_io_begin(SD_IO_STORE);
+    bool exists = SD_MMC.exists(file->path);
+    sd_io_end(SD_IO_STORE, 0);
+    if(!exists){
+        catalog_remove(file->path);
+    }
+    return false;
+}
+
+/**
+ * @brief 从旧到新删除一个目录中的文件，直到目录中没有可删的文件或清理完成
+ * @param dirname 目录路径（只读这一级）
+ * @param useCatalog true按selectOldestFiles()选择（读索引），false直接遍历目录
+ * @param list 文件信息数组（堆上，容量不够时扩大）
+ * @param listCap 数组容量
+ * @param selectCount 每次多选出的新文件数
+ * @param progress 清理进度
+ * @details 功能说明：
+ *          1. 选出最旧的一批文件逐个删除，记下跳过的文件名（书签保护、正在写入、删除失败）
+ *          2. 跳过的文件仍是目录中最旧的，下次多选出同样数量，按文件名跳过已看过的
+ *          3. 选出的文件不满一批或没有新文件时说明这一级目录已处理完
+ * @note 受保护的文件不会让清理跳到更新的一天，保证从旧到新删除
+ */
+static void deleteOldestInDir(const char *dirname, bool useCatalog, FileInfo **list, int *listCap,
+                              int selectCount, CleanupProgress *progress){
+    char (*kept)[sizeof(((FileInfo*)0)->name)] = NULL;
+    int keptCount = 0;
+    int keptCap = 0;
+    bool more = true;
+    while(more && !cleanupDone(progress)){
+        // 已跳过的文件排在最前，多选出同样数量
+        int want = selectCount + keptCount;
+        if(want > *listCap){
+            FileInfo *grown = (FileInfo*)(psramFound() ? ps_realloc(*list, want * sizeof(FileInfo)) : realloc(*list, want * sizeof(FileInfo)));
+            if(!grown){
+                Serial.printf("Too many protected files in %s, moving on\n", dirname);
+                break;
+            }
+            *list = grown;
+            *listCap = want;
+        }
+        FileInfo *files = *list;
+        int fileCount = useCatalog ? selectOldestFiles(dirname, files, want) : scanOldestFiles(dirname, files, want);
+        more = fileCount == want;
+        
+        bool sawNew = false;
+        for(int i = 0; i < fileCount && !cleanupDone(progress); i++){
+            bool seen = false;
+            for(int j = 0; j < keptCount && !seen; j++){
+                seen = strcmp(kept[j], files[i].name) == 0;
+            }
+            if(seen){
+                continue;
+            }
+            sawNew = true;
+            if(deleteCleanupFile(&files[i], progress)){
+                continue;
+            }
+            // 记下跳过的文件名
+            if(keptCount == keptCap){
+                int cap = keptCap + SD_CLEAN_PROTECTED_SLACK;
+                void *grown = psramFound() ? ps_realloc(kept, cap * sizeof(*kept)) : realloc(kept, cap * sizeof(*kept));
+                if(!grown){
+                    more = false;
+                    break;
+                }
+                kept = (char (*)[sizeof(((FileInfo*)0)->name)])grown;
+                keptCap = cap;
             }
+            snprintf(kept[keptCount++], sizeof(*kept), "%s", files[i].name);
+        }
+        if(!sawNew){
+            break;
         }
     }
+    free(kept);
+}
+
+/**
+ * @brief 删除已清空的日期目录
+ * @param dirname 保存目录
+ * @param date 日期（YYYYMMDD）
+ * @note 日、月、年目录不为空时rmdir失败，保留目录
+ *       当天的目录不删除，录像和照片随时可能写入
+ */
+static void removeEmptyDateDir(const char *dirname, uint32_t date){
+    time_t now = time(nullptr);
+    struct tm timeinfo;
+    localtime_r(&now, &timeinfo);
+    uint32_t today = (timeinfo.tm_year + 1900) * 10000 + (timeinfo.tm_mon + 1) * 100 + timeinfo.tm_mday;
+    if(date >= today){
+        return;
+    }
+    
+    char path[48];
+    dateDirPath(dirname, date, path, sizeof(path));
+    if(!SD_MMC.rmdir(path)){
+        return;
+    }
+    Serial.printf("Removed date directory: %s\n", path);
+    forgetDateDirs();
+    
+    // 月、年目录随之变空时一并删除
+    char *slash = strrchr(path, '/');
+    *slash = '\0';
+    if(SD_MMC.rmdir(path)){
+        slash = strrchr(path, '/');
+        *slash = '\0';
+        SD_MMC.rmdir(path);
+    }
 }
 
 /**
  * @brief 删除指定目录中最旧的N个文件
  * @param dirname 目录路径
  * @param maxFilesToDelete 最大删除文件数量
+ * @param pacingMs 每删除一个文件后的让步延时（毫秒）
  * @return int 返回删除的文件数量，失败返回-1
  * @details 功能说明：
- *          1. 获取目录中的所有文件信息
- *          2. 按修改时间升序排序（最旧的在前面）
- *          3. 逐个删除最旧的文件
+ *          1. 先删除根目录下旧版平铺存放的文件（最旧的在前面）
+ *          2. 再按日期从旧到新逐个处理日期目录，每次只读一天的文件
+ *          3. 删除一天中的文件，跳过书签保护的视频分段后继续选同一天更新的文件，删空后删除日期目录
  *          4. 累计删除的文件大小
  *          5. 当释放空间达到2GB或删除了maxFilesToDelete个文件时停止
- * @note 按文件修改时间排序，删除最旧的文件
+ * @note 按日期目录整天删除，耗时只与一天的文件数有关
  *       清理出约2GB空间后停止
+ *       受保护的分段不计入maxFilesToDelete
  */
-int deleteOldestFiles(const char * dirname, int maxFilesToDelete){
-    // 定义文件信息数组（最多100个文件）
-    FileInfo files[100];
-    
-    // 获取文件信息列表
-    int fileCount = getFileInfoList(dirname, files, 100);
-    if(fileCount <= 0){
-        Serial.printf("No files found in directory: %s\n", dirname);
-        return 0;
+int deleteOldestFiles(const char * dirname, int maxFilesToDelete, uint32_t pacingMs){
+    // 多选几个文件，弥补书签保护跳过的分段
+    int selectCount = maxFilesToDelete + SD_CLEAN_PROTECTED_SLACK;
+    
+    // 文件信息数组放在堆上（每项约200字节，不能放在任务栈上）
+    int filesCap = selectCount;
+    FileInfo *files = (FileInfo*)(psramFound() ? ps_malloc(filesCap * sizeof(FileInfo)) : malloc(filesCap * sizeof(FileInfo)));
+    if(!files){
+        Serial.printf("Failed to allocate file list for: %s\n", dirname);
+        return -1;
     }
     
-    // 按时间升序排序（最旧的在前面）
-    sortFilesByTime(files, fileCount, true);
+    // 计算清理目标空间（字节），只有视频分段受书签保护
+    CleanupProgress progress;
+    memset(&progress, 0, sizeof(progress));
+    progress.targetBytes = retention_high_watermark_bytes() - retention_low_watermark_bytes();
+    progress.maxFiles = maxFilesToDelete;
+    progress.checkBookmarks = (strcmp(dirname, VIDEO_DIR) == 0);
+    progress.pacingMs = pacingMs;
+    
+    // 根目录下旧版平铺存放的文件最旧，先删除
+    deleteOldestInDir(dirname, false, &files, &filesCap, selectCount, &progress);
+    
+    // 按日期从旧到新整天删除，一天删完（或只剩受保护的文件）才进入下一天
+    uint32_t date = 0;
+    while(!cleanupDone(&progress) && (date = findDateDir(dirname, date, false)) != 0){
+        char dateDir[48];
+        dateDirPath(dirname, date, dateDir, sizeof(dateDir));
+        deleteOldestInDir(dateDir, true, &files, &filesCap, selectCount, &progress);
+        removeEmptyDateDir(dirname, date);
+    }
+    free(files);
     
-    // 计算清理目标空间（字节）
-    uint64_t targetSpaceBytes = SD_CLEAN_TARGET_GB * 1024ULL * 1024ULL * 1024ULL;
-    uint64_t freedSpace = 0;
-    int deletedCount = 0;
+    if(progress.freedBytes >= progress.targetBytes){
+        Serial.printf("已释放 %lluGB 空间，停止清理\n", progress.freedBytes / (1024ULL * 1024ULL * 1024ULL));
+    }
+    Serial.printf("从 %s 目录删除了 %d 个文件，释放了 %lluGB 空间\n", 
+                 dirname, progress.deletedCount, progress.freedBytes / (1024ULL * 1024ULL * 1024ULL));
+    if(progress.protectedCount > 0){
+        Serial.printf("跳过了 %d 个书签保护的分段\n", progress.protectedCount);
+    }
     
-    // 逐个删除最旧的文件
-    for(int i = 0; i < fileCount && i < maxFilesToDelete; i++){
-        // 检查是否已经释放了足够的空间
-        if(freedSpace >= targetSpaceBytes){
-            Serial.printf("已释放 %lluGB 空间，停止清理\n", freedSpace / (1024ULL * 1024ULL * 1024ULL));
-            break;
-        }
-        
-        // 删除文件
-        if(SD_MMC.remove(files[i].path)){
-            freedSpace += files[i].size;
-            deletedCount++;
-            Serial.printf("Deleted file: %s, Size: %llu bytes, Total freed: %llu bytes\n", 
-                         files[i].name, files[i].size, freedSpace);
+    return progress.deletedCount;
+}
+
+/**
+ * @brief 从文件路径解析日期目录
+ * @param path 文件路径（dirname/YYYY/MM/DD/文件名）
+ * @param dirname 输出保存目录
+ * @param dirnameSize 保存目录缓冲区大小
+ * @return uint32_t 日期（YYYYMMDD），不在日期目录中返回0
+ */
+static uint32_t dateDirOfPath(const char *path, char *dirname, size_t dirnameSize){
+    const char *name = strrchr(path, '/');
+    if(!name || name - path < 12){
+        return 0;
+    }
+    // 文件名之前应为 /YYYY/MM/DD
+    const char *p = name - 11;
+    static const char pattern[] = "/dddd/dd/dd";
+    uint32_t date = 0;
+    for(int i = 0; i < 11; i++){
+        if(pattern[i] == '/'){
+            if(p[i] != '/'){
+                return 0;
+            }
+        } else if(p[i] < '0' || p[i] > '9'){
+            return 0;
         } else {
-            Serial.printf("Failed to delete file: %s\n", files[i].path);
+            date = date * 10 + (p[i] - '0');
         }
     }
+    size_t len = p - path;
+    if(len + 1 > dirnameSize){
+        return 0;
+    }
+    memcpy(dirname, path, len);
+    dirname[len] = '\0';
+    return date;
+}
+
+/**
+ * @brief 删除给定的文件列表
+ * @param files 文件信息数组
+ * @param fileCount 文件数量
+ * @param pacingMs 每删除一个文件后的让步延时（毫秒）
+ * @return int 返回删除的文件数量
+ * @details 功能说明：
+ *          1. 按顺序删除文件，跳过正在录制的分段
+ *          2. 同步空间统计和目录索引
+ *          3. 删空的日期目录随之删除
+ * @note 文件列表由清理计划给出，书签保护已在计划中检查
+ */
+int deleteFileList(const FileInfo *files, int fileCount, uint32_t pacingMs){
+    CleanupProgress progress;
+    memset(&progress, 0, sizeof(progress));
+    progress.targetBytes = UINT64_MAX;
+    progress.maxFiles = fileCount;
+    progress.pacingMs = pacingMs;
+    for(int i = 0; i < fileCount && !cleanupDone(&progress); i++){
+        deleteCleanupFile(&files[i], &progress);
+    }
     
-    Serial.printf("从 %s 目录删除了 %d 个文件，释放了 %lluGB 空间\n", 
-                 dirname, deletedCount, freedSpace / (1024ULL * 1024ULL * 1024ULL));
-    
-    return deletedCount;
+    // 同一天的文件相邻，每个日期目录只尝试一次
+    char lastDir[48] = "";
+    for(int i = 0; i < fileCount; i++){
+        char dirname[48];
+        uint32_t date = dateDirOfPath(files[i].path, dirname, sizeof(dirname));
+        if(date == 0){
+            continue;
+        }
+        char dateDir[48];
+        dateDirPath(dirname, date, dateDir, sizeof(dateDir));
+        if(strcmp(dateDir, lastDir) != 0){
+            removeEmptyDateDir(dirname, date);
+            strcpy(lastDir, dateDir);
+        }
+    }
+    return progress.deletedCount;
 }
 
 /**
@@ -1012,10 +1787,11 @@ int deleteOldestFiles(const char * dirname, int maxFilesToDelete){
  *          6. 返回删除的文件数量
  * @note 当SD卡剩余空间小于保留空间（默认5GB）时，自动删除最旧的文件
  *       清理出约2GB空间后停止
- *       清理优先级由SD_CLEANUP_PRIORITY配置：
+ *       清理优先级由保留策略配置（默认SD_CLEANUP_PRIORITY）：
  *       0 = 只删除视频文件
  *       1 = 优先删除视频，再删除照片
  *       2 = 只删除照片文件
+ *       书签覆盖的视频分段不会被删除
  */
 int autoCleanOldFiles(void){
     // 检查SD卡空间是否需要清理
@@ -1025,16 +1801,17 @@ int autoCleanOldFiles(void){
     }
     
     int totalDeleted = 0;
+    int priority = retention_priority();
     
     // 根据清理优先级配置选择删除策略
-    if(SD_CLEANUP_PRIORITY == 0){
+    if(priority == 0){
         // 只删除视频文件
         Serial.println("清理策略：只删除videos目录中的文件");
         int deletedVideos = deleteOldestFiles(VIDEO_DIR, 100);
         if(deletedVideos > 0){
             totalDeleted += deletedVideos;
         }
-    } else if(SD_CLEANUP_PRIORITY == 1){
+    } else if(priority == 1){
         // 优先删除视频，再删除照片
         Serial.println("清理策略：优先删除videos目录中的文件，再删除photos目录中的文件");
         
@@ -1052,7 +1829,7 @@ int autoCleanOldFiles(void){
                 totalDeleted += deletedPhotos;
             }
         }
-    } else if(SD_CLEANUP_PRIORITY == 2){
+    } else if(priority == 2){
         // 只删除照片文件
         Serial.println("清理策略：只删除photos目录中的文件");
         int deletedPhotos = deleteOldestFiles(PHOTO_DIR, 100);
@@ -1066,42 +1843,29 @@ int autoCleanOldFiles(void){
 }
 
 /**
- * @brief 开始视频录制
- * @param fps 帧率（每秒帧数）
- * @param width 视频宽度
- * @param height 视频高度
+ * @brief 开始一个新的录像分段（录像参数已设置）
+ * @param startMs 分段第一帧的millis()，掉卡恢复时为最早暂存帧的时间
  * @return bool 成功返回true，失败返回false
  * @details 功能说明：
- *          1. 检查是否正在录制，如果是则返回false
- *          2. 检查SD卡空间，如果达到阈值则自动清理
- *          3. 生成时间戳格式的视频文件名
- *          4. 创建AVI文件并写入文件头
- *          5. 初始化录制参数
- * @note 创建AVI文件并写入文件头
- *       文件名格式：YYYYMMDDHHMM（年月日时分）
- *       自动分段：2分钟一段
+ *          1. 按第一帧时间生成视频文件名
+ *          2. 创建AVI文件并写入文件头
+ *          3. 初始化录制参数
  */
-bool startVideoRecording(int fps, int width, int height){
-    // 检查是否正在录制
-    if(isRecording){
-        Serial.println("视频录制中，无法开始新的录制");
-        return false;
-    }
-    
-    // 检查SD卡空间，如果需要清理则自动清理
-    if(checkSDSpaceNeedsCleanup()){
-        Serial.println("SD卡空间不足，开始自动清理...");
-        autoCleanOldFiles();
+static bool startVideoSegment(uint32_t startMs){
+    // 按第一帧的时间生成文件名，同一分钟内已有分段时追加_1、_2...序号（掉卡后很快恢复时会出现）
+    time_t startEpoch = time(nullptr) - (millis() - startMs) / 1000;
+    generateTimestampFilenameAt(startEpoch, VIDEO_DIR, ".avi", currentVideoFilename, sizeof(currentVideoFilename));
+    if(SD_MMC.exists(currentVideoFilename)){
+        char base[64];
+        generateTimestampFilenameAt(startEpoch, VIDEO_DIR, "", base, sizeof(base));
+        for(int seq = 1; seq < 100; seq++){
+            snprintf(currentVideoFilename, sizeof(currentVideoFilename), "%s_%d.avi", base, seq);
+            if(!SD_MMC.exists(currentVideoFilename)){
+                break;
+            }
+        }
     }
     
-    // 保存视频参数
-    videoFPS = fps;
-    videoWidth = width;
-    videoHeight = height;
-    
-    // 生成时间戳格式的视频文件名
-    generateTimestampFilename(VIDEO_DIR, ".avi", currentVideoFilename, sizeof(currentVideoFilename));
-    
     // 打开视频文件
     videoFile = SD_MMC.open(currentVideoFilename, FILE_WRITE);
     if(!videoFile){
@@ -1109,73 +1873,35 @@ bool startVideoRecording(int fps, int width, int height){
         return false;
     }
     
+    // 按校准结果设置写缓冲，帧数据攒够一块再写SD卡
+    if(videoWriteBlockSize){
+        videoFile.setBufferSize(videoWriteBlockSize);
+    }
+    
     // 初始化录制参数
     videoFrameCount = 0;
-    videoStartTime = millis();
-    videoSegmentStartTime = millis();
+    videoStartTime = startMs;
+    videoSegmentStartTime = startMs;
     videoTotalSize = 0;
     videoMaxFrameSize = 0;
+    videoAccountedBytes = 0;
     moviOffset = 0;
     idx1Offset = 0;
+    videoIndexComplete = true;
+    videoSegmentStartEpoch = startEpoch;
+    
+    // 分配帧大小数组（按2倍分段帧数预留，不够时再扩展）
+    if(!videoFrameSizes){
+        videoFrameSizesCap = VIDEO_SEGMENT_DURATION * videoFPS * 2;
+        videoFrameSizes = (uint32_t*)ps_malloc(videoFrameSizesCap * sizeof(uint32_t));
+        if(!videoFrameSizes){
+            videoFrameSizesCap = 0;
+            Serial.println("帧索引内存分配失败，视频将不含idx1索引");
+        }
+    }
     
-    // 初始化AVI主头
-    memset(&aviMainHeader, 0, sizeof(AVI_MAIN_HEADER));
-    memcpy(aviMainHeader.riff, AVI_FOURCC, 4);
-    memcpy(aviMainHeader.avi, AVI_AVI, 4);
-    memcpy(aviMainHeader.list, AVI_LIST, 4);
-    memcpy(aviMainHeader.hdrl, AVI_HDRL, 4);
-    memcpy(aviMainHeader.avih, "avih", 4);
-    aviMainHeader.avihSize = 56;
-    aviMainHeader.microSecPerFrame = 1000000 / videoFPS;
-    aviMainHeader.maxBytesPerSec = 0;
-    aviMainHeader.paddingGranularity = 0;
-    aviMainHeader.flags = 0x10;
-    aviMainHeader.totalFrames = 0;
-    aviMainHeader.initialFrames = 0;
-    aviMainHeader.streams = 1;
-    aviMainHeader.suggestedBufferSize = 0;
-    aviMainHeader.width = videoWidth;
-    aviMainHeader.height = videoHeight;
-    
-    // 初始化AVI流头
-    memset(&aviStreamHeader, 0, sizeof(AVI_STREAM_HEADER));
-    memcpy(aviStreamHeader.list, AVI_LIST, 4);
-    memcpy(aviStreamHeader.strl, AVI_STRL, 4);
-    memcpy(aviStreamHeader.strh, "strh", 4);
-    aviStreamHeader.strhSize = 56;
-    memcpy(aviStreamHeader.fccType, AVI_VIDS, 4);
-    memcpy(aviStreamHeader.fccHandler, AVI_MJPG, 4);
-    aviStreamHeader.flags = 0;
-    aviStreamHeader.priority = 0;
-    aviStreamHeader.language = 0;
-    aviStreamHeader.initialFrames = 0;
-    aviStreamHeader.scale = 1;
-    aviStreamHeader.rate = videoFPS;
-    aviStreamHeader.start = 0;
-    aviStreamHeader.length = 0;
-    aviStreamHeader.suggestedBufferSize = 0;
-    aviStreamHeader.quality = 0;
-    aviStreamHeader.sampleSize = 0;
-    aviStreamHeader.left = 0;
-    aviStreamHeader.top = 0;
-    aviStreamHeader.right = videoWidth;
-    aviStreamHeader.bottom = videoHeight;
-    
-    // 初始化AVI位图信息
-    memset(&aviBitmapInfo, 0, sizeof(AVI_BITMAP_INFO));
-    memcpy(aviBitmapInfo.strf, AVI_STRF, 4);
-    aviBitmapInfo.strfSize = 40;
-    aviBitmapInfo.size = 40;
-    aviBitmapInfo.width = videoWidth;
-    aviBitmapInfo.height = videoHeight;
-    aviBitmapInfo.planes = 1;
-    aviBitmapInfo.bitCount = 24;
-    aviBitmapInfo.compression = 0x47504A4D; // 'MJPG'
-    aviBitmapInfo.sizeImage = videoWidth * videoHeight * 3;
-    aviBitmapInfo.xPelsPerMeter = 0;
-    aviBitmapInfo.yPelsPerMeter = 0;
-    aviBitmapInfo.clrUsed = 0;
-    aviBitmapInfo.clrImportant = 0;
+    // 初始化AVI文件头
+    aviInitHeaders(&aviMainHeader, &aviStreamHeader, &aviBitmapInfo, videoFPS, videoWidth, videoHeight);
     
     // 写入AVI文件头（临时，后面会更新）
     videoFile.write((uint8_t*)&aviMainHeader, sizeof(AVI_MAIN_HEADER));
@@ -1184,10 +1910,10 @@ bool startVideoRecording(int fps, int width, int height){
     
     // 写入JUNK块（填充）
     char junk[5] = "JUNK";
-    uint32_t junkSize = 2048;
+    uint32_t junkSize = AVI_JUNK_SIZE;
     videoFile.write((uint8_t*)junk, 4);
     videoFile.write((uint8_t*)&junkSize, 4);
-    for(int i = 0; i < 2048; i++){
+    for(int i = 0; i < AVI_JUNK_SIZE; i++){
         videoFile.write(0);
     }
     
@@ -1200,6 +1926,9 @@ bool startVideoRecording(int fps, int width, int height){
     videoFile.write((uint8_t*)&moviListSize, 4);
     videoFile.write((uint8_t*)movi, 4);
     
+    // 记入索引（未完成），断电后清理仍能找到这个文件
+    catalog_add(currentVideoFilename, CATALOG_TYPE_VIDEO, (uint32_t)videoSegmentStartEpoch, (uint32_t)videoSegmentStartEpoch, 0, CATALOG_FLAG_OPEN);
+    
     // 标记正在录制
     isRecording = true;
     
@@ -1208,21 +1937,208 @@ bool startVideoRecording(int fps, int width, int height){
     return true;
 }
 
+/**
+ * @brief 开始视频录制
+ * @param fps 帧率（每秒帧数）
+ * @param width 视频宽度
+ * @param height 视频高度
+ * @return bool 成功返回true，失败返回false
+ * @details 功能说明：
+ *          1. 检查是否正在录制，如果是则返回false
+ *          2. 生成时间戳格式的视频文件名
+ *          3. 创建AVI文件并写入文件头
+ *          4. 初始化录制参数
+ * @note 创建AVI文件并写入文件头
+ *       不在这里清理SD卡空间，由后台清理任务（storage_janitor）负责
+ *       文件名格式：YYYYMMDDHHMM（年月日时分）
+ *       自动分段：2分钟一段
+ */
+bool startVideoRecording(int fps, int width, int height){
+    // 检查是否正在录制
+    if(isRecording){
+        Serial.println("视频录制中，无法开始新的录制");
+        return false;
+    }
+    
+    // 保存视频参数
+    videoFPS = fps;
+    videoWidth = width;
+    videoHeight = height;
+    
+    return startVideoSegment(millis());
+}
+
+/**
+ * @brief 把录像文件的当前大小计入空间统计
+ * @param fileBytes 文件当前大小
+ * @note 只计入与上次的差值，簇内增长不改变计数
+ */
+static void accountVideoFile(uint32_t fileBytes){
+    sd_space_file_resized(videoAccountedBytes, fileBytes);
+    videoAccountedBytes = fileBytes;
+}
+
+/**
+ * @brief 记录一帧的大小（用于写idx1）并更新帧计数和总大小
+ * @param frameSize 帧数据大小（不含8字节块头）
+ */
+static void recordVideoFrameSize(uint32_t frameSize){
+    if(videoFrameCount >= videoFrameSizesCap && videoFrameSizes){
+        uint32_t newCap = videoFrameSizesCap + VIDEO_SEGMENT_DURATION * videoFPS;
+        uint32_t *grown = (uint32_t*)ps_realloc(videoFrameSizes, newCap * sizeof(uint32_t));
+        if(grown){
+            videoFrameSizes = grown;
+            videoFrameSizesCap = newCap;
+        }
+    }
+    if(videoFrameCount < videoFrameSizesCap){
+        videoFrameSizes[videoFrameCount] = frameSize;
+    } else {
+        videoIndexComplete = false;
+    }
+    videoFrameCount++;
+    videoTotalSize += frameSize + 8; // 加上帧头和大小
+    accountVideoFile(AVI_MOVI_DATA_OFFSET + videoTotalSize);
+    storage_stats_add(RETENTION_VIDEO, frameSize + 8);
+}
+
+/**
+ * @brief 写入覆盖间隙的空帧
+ * @param gapMs 间隙时长（毫秒）
+ * @return bool 全部写入返回true，写入失败返回false
+ * @details 功能说明：
+ *          1. 按本分段已录部分的实际帧间隔计算空帧数量
+ *          2. 写入大小为0的00dc块，idx1中不带关键帧标志
+ *          3. 写入失败时与writeVideoChunk()相同回到上一帧末尾，计入连续写入失败次数并停止补帧
+ * @note 播放器把空块当作丢帧，画面停在间隙前一帧，时间轴不被压缩
+ */
+static bool writeVideoGapFrames(uint32_t gapMs){
+    uint32_t elapsedMs = millis() - videoStartTime;
+    uint32_t periodMs = 1000 / videoFPS;
+    if(videoFrameCount > 0 && elapsedMs > gapMs){
+        periodMs = (elapsedMs - gapMs) / videoFrameCount;
+    }
+    if(periodMs == 0){
+        periodMs = 1;
+    }
+    uint32_t gapFrames = (gapMs + periodMs / 2) / periodMs;
+    char gapChunk[8] = {'0', '0', 'd', 'c', 0, 0, 0, 0};
+    for(uint32_t i = 0; i < gapFrames; i++){
+        if(videoFile.write((uint8_t*)gapChunk, 8) != 8){
+            videoFile.seek(AVI_MOVI_DATA_OFFSET + videoTotalSize);
+            videoWriteFailures++;
+            Serial.printf("补入空帧失败，已补入 %lu/%lu 个\n", (unsigned long)i, (unsigned long)gapFrames);
+            return false;
+        }
+        recordVideoFrameSize(0);
+    }
+    Serial.printf("录像间隙 %lu 毫秒，补入 %lu 个空帧\n", (unsigned long)gapMs, (unsigned long)gapFrames);
+    return true;
+}
+
+/**
+ * @brief 标记录像间隙
+ * @param gapMs 间隙时长（毫秒）
+ * @note 由其他任务调用，空帧在录像任务下一次写帧时补入
+ */
+void markVideoGap(uint32_t gapMs){
+    if(!isRecording){
+        return;
+    }
+    portENTER_CRITICAL(&videoGapMux);
+    videoPendingGapMs += gapMs;
+    portEXIT_CRITICAL(&videoGapMux);
+}
+
+/**
+ * @brief 写入一个帧块
+ * @param buf JPEG图像数据指针
+ * @param size JPEG图像数据长度
+ * @return bool 成功返回true
+ * @note 写入失败时回到上一帧末尾，残缺的帧块由下一帧覆盖
+ */
+static bool writeVideoChunk(const uint8_t *buf, size_t size){
+    char frameId[5] = "00dc";
+    uint32_t frameSize = size;
+    if(videoFile.write((uint8_t*)frameId, 4) != 4 || videoFile.write((uint8_t*)&frameSize, 4) != 4 ||
+       videoFile.write(buf, size) != size){
+        videoFile.seek(AVI_MOVI_DATA_OFFSET + videoTotalSize);
+        return false;
+    }
+    
+    // 记录帧大小，更新统计信息
+    recordVideoFrameSize(frameSize);
+    if(size > videoMaxFrameSize){
+        videoMaxFrameSize = size;
+    }
+    return true;
+}
+
+/**
+ * @brief 掉卡恢复后在新分段中继续录像
+ * @return bool 成功返回true
+ * @details 功能说明：
+ *          1. 补记掉卡前分段的索引（收尾时卡已失效，索引可能未更新）
+ *          2. 以最早暂存帧的时间开始新分段，时长和帧率按实际拍摄时间计算
+ */
+static bool resumeVideoRecording(void){
+    if(lostVideoFilename[0]){
+        File file = SD_MMC.open(lostVideoFilename, FILE_READ);
+        if(file){
+            uint32_t fileSize = file.size();
+            file.close();
+            catalog_update(lostVideoFilename, lostVideoEndTime, fileSize, 0);
+        } else {
+            catalog_remove(lostVideoFilename);
+        }
+        lostVideoFilename[0] = '\0';
+    }
+    
+    const uint8_t *held;
+    size_t heldSize;
+    uint32_t startMs = millis();
+    sd_recovery_peek_frame(&held, &heldSize, &startMs);
+    if(!startVideoSegment(startMs)){
+        return false;
+    }
+    videoWriteFailures = 0;
+    Serial.printf("录像已恢复: %s\n", currentVideoFilename);
+    return true;
+}
+
+/**
+ * @brief 收尾掉卡时的录像分段
+ * @details 功能说明：
+ *          1. 尝试写入idx1和文件头（卡已失效时写入失败）
+ *          2. 关闭文件，记下文件名供重新挂载后补记索引
+ * @note 由掉卡恢复任务调用，此时录像任务只写暂存区，不访问录像文件
+ *       保持录制状态，重新挂载后录像任务开新分段
+ */
+void closeLostVideoSegment(void){
+    if(!isRecording || !videoFile){
+        return;
+    }
+    snprintf(lostVideoFilename, sizeof(lostVideoFilename), "%s", currentVideoFilename);
+    lostVideoEndTime = (uint32_t)time(nullptr);
+    sd_io_begin(SD_IO_RECORD);
+    stopVideoRecording(true);
+    sd_io_end(SD_IO_RECORD, 0);
+}
+
 /**
  * @brief 写入视频帧
  * @param buf JPEG图像数据指针
  * @param size JPEG图像数据长度（字节数）
- * @return bool 成功返回true，失败返回false
+ * @return bool 成功（含暂存到PSRAM）返回true，失败返回false
  * @details 功能说明：
  *          1. 检查是否正在录制
- *          2. 检查是否需要分段（2分钟）
- *          3. 如果需要分段，停止当前分段并开始新的分段
- *          4. 写入帧头（00dc）
- *          5. 写入帧大小
- *          6. 写入JPEG数据
- *          7. 更新帧计数和总大小
+ *          2. 掉卡期间帧只暂存到PSRAM；重新挂载后开新分段
+ *          3. 检查是否需要分段（2分钟），如果需要，停止当前分段并开始新的分段
+ *          4. 先补写暂存的帧，再写入本帧（帧头00dc、帧大小、JPEG数据）
+ *          5. 写入失败的帧暂存，连续失败达到阈值时报告掉卡
  * @note 将JPEG帧写入AVI文件
  *       自动分段：2分钟一段
+ *       整个写入以录像类别占用SD卡总线，其他读写让出
  */
 bool writeVideoFrame(const uint8_t *buf, size_t size){
     // 检查是否正在录制
@@ -1231,6 +2147,25 @@ bool writeVideoFrame(const uint8_t *buf, size_t size){
         return false;
     }
     
+    // 掉卡期间只暂存，不访问录像文件（由恢复任务收尾）
+    int cardState = sd_recovery_state();
+    if(cardState == SD_CARD_LOST){
+        return sd_recovery_hold_frame(buf, size, millis());
+    }
+    
+    // 录像类别严格优先占用SD卡总线，分段切换也在其中完成
+    sd_io_begin(SD_IO_RECORD);
+    
+    // 重新挂载后在新分段中继续
+    if(cardState == SD_CARD_RESTORED){
+        if(!resumeVideoRecording()){
+            sd_io_end(SD_IO_RECORD, 0);
+            sd_recovery_card_lost();
+            return sd_recovery_hold_frame(buf, size, millis());
+        }
+        sd_recovery_resumed();
+    }
+    
     // 检查是否需要分段（2分钟）
     uint32_t currentTime = millis();
     uint32_t segmentDuration = (currentTime - videoSegmentStartTime) / 1000;
@@ -1240,17 +2175,18 @@ bool writeVideoFrame(const uint8_t *buf, size_t size){
         // 停止当前分段（保持录制状态）
         stopVideoRecording(true);
         
-        // 短暂延迟
-        vTaskDelay(pdMS_TO_TICKS(100));
+        // 不在此延迟：持有录像总线时等待只会让其他读写和取帧一起停顿
         
         // 临时设置isRecording为false，以便开始新的分段
         isRecording = false;
         
-        // 开始新的分段
+        // 开始新的分段，失败按掉卡处理（保持录制状态，重新挂载后继续）
         if(!startVideoRecording(videoFPS, videoWidth, videoHeight)){
             Serial.println("开始新的视频分段失败");
-            isRecording = false;
-            return false;
+            isRecording = true;
+            sd_io_end(SD_IO_RECORD, 0);
+            sd_recovery_card_lost();
+            return sd_recovery_hold_frame(buf, size, millis());
         }
         
         // 更新分段计数
@@ -1261,25 +2197,49 @@ bool writeVideoFrame(const uint8_t *buf, size_t size){
         videoSegmentStartTime = millis();
     }
     
-    // 写入帧头（00dc）
-    char frameId[5] = "00dc";
-    videoFile.write((uint8_t*)frameId, 4);
-    
-    // 写入帧大小
-    uint32_t frameSize = size;
-    videoFile.write((uint8_t*)&frameSize, 4);
-    
-    // 写入JPEG数据
-    videoFile.write(buf, size);
+    // 补入间隙空帧（抓拍等暂停录像的时间）
+    portENTER_CRITICAL(&videoGapMux);
+    uint32_t gapMs = videoPendingGapMs;
+    videoPendingGapMs = 0;
+    portEXIT_CRITICAL(&videoGapMux);
+    if(gapMs > 0){
+        writeVideoGapFrames(gapMs);
+    }
     
-    // 更新统计信息
-    videoFrameCount++;
-    videoTotalSize += size + 8; // 加上帧头和大小
+    // 先补写暂存的帧（每帧限量，避免长时间阻塞取帧），暂存区未清空时本帧也排进暂存区保持顺序
+    bool ok = true;
+    size_t written = 0;
+    const uint8_t *held;
+    size_t heldSize;
+    uint32_t heldMs;
+    for(int i = 0; ok && i < SD_RECOVERY_DRAIN_PER_FRAME && sd_recovery_peek_frame(&held, &heldSize, &heldMs); i++){
+        ok = writeVideoChunk(held, heldSize);
+        if(ok){
+            written += heldSize + 8;
+            sd_recovery_pop_frame();
+        }
+    }
+    if(ok && sd_recovery_peek_frame(&held, &heldSize, &heldMs)){
+        sd_recovery_hold_frame(buf, size, millis());
+    } else if(ok){
+        ok = writeVideoChunk(buf, size);
+        written += ok ? size + 8 : 0;
+    }
     
-    // 更新最大帧大小
-    if(size > videoMaxFrameSize){
-        videoMaxFrameSize = size;
+    // 写入失败：本帧暂存，连续失败达到阈值时报告掉卡
+    if(!ok){
+        sd_recovery_hold_frame(buf, size, millis());
+        videoWriteFailures++;
+        Serial.printf("写入视频帧失败（连续%lu次）\n", (unsigned long)videoWriteFailures);
+        sd_io_end(SD_IO_RECORD, written);
+        if(videoWriteFailures >= SD_RECOVERY_FAIL_THRESHOLD){
+            sd_recovery_card_lost();
+            return true;
+        }
+        return false;
     }
+    videoWriteFailures = 0;
+    sd_io_end(SD_IO_RECORD, written);
     
     return true;
 }
@@ -1304,47 +2264,52 @@ bool stopVideoRecording(bool keepRecordingState){
         return false;
     }
     
-    // 写入idx1索引
+    // 写入idx1索引（帧大小不完整时不写，播放器会顺序扫描movi）
+    bool writeIndex = videoIndexComplete && videoFrameSizes && videoFrameCount > 0;
+    uint32_t indexFrames = writeIndex ? videoFrameCount : 0;
     char idx1[5] = "idx1";
-    uint32_t idx1Size = videoFrameCount * 16;
+    uint32_t idx1Size = indexFrames * sizeof(AVI_INDEX_ENTRY);
     idx1Offset = videoFile.position();
     videoFile.write((uint8_t*)idx1, 4);
     videoFile.write((uint8_t*)&idx1Size, 4);
     
-    // 写入索引条目
-    uint32_t currentOffset = 4; // movi列表偏移
-    for(uint32_t i = 0; i < videoFrameCount; i++){
-        AVI_INDEX_ENTRY entry;
-        memcpy(entry.id, "00dc", 4);
-        entry.flags = 0x10;
-        entry.offset = currentOffset;
-        entry.size = 0; // 这里简化处理，实际应该记录每帧的大小
-        
-        videoFile.write((uint8_t*)&entry, sizeof(AVI_INDEX_ENTRY));
+    // 写入索引条目（每次攒64条再写，减少SD卡写入次数）
+    AVI_INDEX_ENTRY entries[64];
+    uint32_t entryCount = 0;
+    uint32_t currentOffset = 4; // 偏移相对于movi标识，第一帧在"movi"之后
+    for(uint32_t i = 0; i < indexFrames; i++){
+        AVI_INDEX_ENTRY *entry = &entries[entryCount++];
+        memcpy(entry->id, "00dc", 4);
+        entry->flags = videoFrameSizes[i] ? 0x10 : 0; // AVIIF_KEYFRAME，间隙空帧不是关键帧
+        entry->offset = currentOffset;
+        entry->size = videoFrameSizes[i];
+        currentOffset += videoFrameSizes[i] + 8; // 帧头、大小和数据
         
-        currentOffset += 8; // 帧头和大小
+        if(entryCount == 64 || i == indexFrames - 1){
+            videoFile.write((uint8_t*)entries, entryCount * sizeof(AVI_INDEX_ENTRY));
+            entryCount = 0;
+        }
     }
     
     // 计算movi列表大小
     uint32_t moviListSize = videoTotalSize + 4; // +4 for "movi"
     
-    // 更新avih信息
-    aviMainHeader.totalFrames = videoFrameCount;
-    aviMainHeader.maxBytesPerSec = videoTotalSize / (videoFrameCount / videoFPS);
-    aviMainHeader.suggestedBufferSize = videoMaxFrameSize;
-    
-    // 更新strh信息
-    aviStreamHeader.length = videoFrameCount;
-    aviStreamHeader.suggestedBufferSize = videoMaxFrameSize;
-    
-    // 计算list大小
-    uint32_t listSize = sizeof(AVI_MAIN_HEADER) - 12 + sizeof(AVI_STREAM_HEADER) - 8 + sizeof(AVI_BITMAP_INFO) - 8 + 12 + 2048 + 8 + moviListSize;
-    aviMainHeader.listSize = listSize;
-    aviStreamHeader.listSize = sizeof(AVI_STREAM_HEADER) - 8 + sizeof(AVI_BITMAP_INFO) - 8;
-    
-    // 计算文件大小
-    uint32_t fileSize = 4 + 4 + listSize + 8 + moviListSize + 8 + idx1Size + 8;
-    aviMainHeader.fileSize = fileSize;
+    // 按实际时长写入帧率（rate/scale = 帧数/秒），并记录分段开始时间，供剪辑按时间定位帧
+    uint32_t durationMs = millis() - videoStartTime;
+    if(videoFrameCount > 0 && durationMs > 0){
+        aviStreamHeader.scale = durationMs;
+        aviStreamHeader.rate = videoFrameCount * 1000;
+        aviMainHeader.microSecPerFrame = (uint32_t)((uint64_t)durationMs * 1000 / videoFrameCount);
+    }
+    aviMainHeader.reserved[AVI_RSV_START_TIME] = (uint32_t)videoSegmentStartEpoch;
+    aviMainHeader.reserved[AVI_RSV_DURATION_MS] = durationMs;
+    
+    // 更新avih和strh中的帧数与大小
+    aviUpdateHeaders(&aviMainHeader, &aviStreamHeader, videoFrameCount, videoTotalSize, videoMaxFrameSize);
+    if(!writeIndex){
+        // 没有写idx1条目，修正RIFF大小
+        aviMainHeader.fileSize -= videoFrameCount * sizeof(AVI_INDEX_ENTRY);
+    }
     
     // 更新文件头
     videoFile.seek(0);
@@ -1357,7 +2322,12 @@ bool stopVideoRecording(bool keepRecordingState){
     videoFile.write((uint8_t*)&moviListSize, 4);
     
     // 关闭视频文件
+    uint32_t fileSize = aviMainHeader.fileSize + 8;
     videoFile.close();
+    accountVideoFile(fileSize);
+    
+    // 更新索引：完成时间和文件大小
+    catalog_update(currentVideoFilename, (uint32_t)videoSegmentStartEpoch + durationMs / 1000, fileSize, 0);
     
     // 计算录制时长
     uint32_t duration = (millis() - videoStartTime) / 1000;
@@ -1373,6 +2343,177 @@ bool stopVideoRecording(bool keepRecordingState){
     return true;
 }
 
+/**
+ * @brief 初始化AVI文件头结构体
+ * @param mainHeader AVI主头
+ * @param streamHeader AVI流头
+ * @param bitmapInfo AVI位图信息
+ * @param fps 帧率
+ * @param width 视频宽度
+ * @param height 视频高度
+ * @details 功能说明：
+ *          1. 填写RIFF/LIST/avih/strh/strf的固定字段
+ *          2. 帧数、大小等字段置0，完成文件时再更新
+ * @note 录制器和后台重编码任务共用，保证AVI格式一致
+ */
+void aviInitHeaders(AVI_MAIN_HEADER *mainHeader, AVI_STREAM_HEADER *streamHeader, AVI_BITMAP_INFO *bitmapInfo,
+                    uint32_t fps, uint32_t width, uint32_t height){
+    // 初始化AVI主头
+    memset(mainHeader, 0, sizeof(AVI_MAIN_HEADER));
+    memcpy(mainHeader->riff, AVI_FOURCC, 4);
+    memcpy(mainHeader->avi, AVI_AVI, 4);
+    memcpy(mainHeader->list, AVI_LIST, 4);
+    memcpy(mainHeader->hdrl, AVI_HDRL, 4);
+    memcpy(mainHeader->avih, "avih", 4);
+    mainHeader->avihSize = 56;
+    mainHeader->microSecPerFrame = 1000000 / fps;
+    mainHeader->maxBytesPerSec = 0;
+    mainHeader->paddingGranularity = 0;
+    mainHeader->flags = 0x10;
+    mainHeader->totalFrames = 0;
+    mainHeader->initialFrames = 0;
+    mainHeader->streams = 1;
+    mainHeader->suggestedBufferSize = 0;
+    mainHeader->width = width;
+    mainHeader->height = height;
+    
+    // 初始化AVI流头
+    memset(streamHeader, 0, sizeof(AVI_STREAM_HEADER));
+    memcpy(streamHeader->list, AVI_LIST, 4);
+    memcpy(streamHeader->strl, AVI_STRL, 4);
+    memcpy(streamHeader->strh, "strh", 4);
+    streamHeader->strhSize = 56;
+    memcpy(streamHeader->fccType, AVI_VIDS, 4);
+    memcpy(streamHeader->fccHandler, AVI_MJPG, 4);
+    streamHeader->flags = 0;
+    streamHeader->priority = 0;
+    streamHeader->language = 0;
+    streamHeader->initialFrames = 0;
+    streamHeader->scale = 1;
+    streamHeader->rate = fps;
+    streamHeader->start = 0;
+    streamHeader->length = 0;
+    streamHeader->suggestedBufferSize = 0;
+    streamHeader->quality = 0;
+    streamHeader->sampleSize = 0;
+    streamHeader->left = 0;
+    streamHeader->top = 0;
+    streamHeader->right = width;
+    streamHeader->bottom = height;
+    
+    // 初始化AVI位图信息
+    memset(bitmapInfo, 0, sizeof(AVI_BITMAP_INFO));
+    memcpy(bitmapInfo->strf, AVI_STRF, 4);
+    bitmapInfo->strfSize = 40;
+    bitmapInfo->size = 40;
+    bitmapInfo->width = width;
+    bitmapInfo->height = height;
+    bitmapInfo->planes = 1;
+    bitmapInfo->bitCount = 24;
+    bitmapInfo->compression = 0x47504A4D; // 'MJPG'
+    bitmapInfo->sizeImage = width * height * 3;
+    bitmapInfo->xPelsPerMeter = 0;
+    bitmapInfo->yPelsPerMeter = 0;
+    bitmapInfo->clrUsed = 0;
+    bitmapInfo->clrImportant = 0;
+}
+
+/**
+ * @brief 更新AVI文件头中的帧数和大小字段
+ * @param mainHeader AVI主头
+ * @param streamHeader AVI流头
+ * @param frameCount 总帧数
+ * @param moviDataSize movi数据大小（所有帧块，含8字节块头）
+ * @param maxFrameSize 最大帧大小
+ * @details 功能说明：
+ *          1. 更新avih的总帧数、码率、建议缓冲区大小
+ *          2. 更新strh的长度和建议缓冲区大小
+ *          3. 计算hdrl、strl列表和RIFF大小
+ * @note 时长按strh的rate/scale计算；不足1秒的文件按1秒计算码率，避免除零
+ */
+void aviUpdateHeaders(AVI_MAIN_HEADER *mainHeader, AVI_STREAM_HEADER *streamHeader,
+                      uint32_t frameCount, uint32_t moviDataSize, uint32_t maxFrameSize){
+    uint32_t moviListSize = moviDataSize + 4; // +4 for "movi"
+    uint32_t idx1Size = frameCount * sizeof(AVI_INDEX_ENTRY);
+    uint32_t rate = streamHeader->rate ? streamHeader->rate : 1;
+    uint32_t seconds = (uint32_t)((uint64_t)frameCount * streamHeader->scale / rate);
+    
+    // 更新avih信息
+    mainHeader->totalFrames = frameCount;
+    mainHeader->maxBytesPerSec = moviDataSize / (seconds ? seconds : 1);
+    mainHeader->suggestedBufferSize = maxFrameSize;
+    
+    // 更新strh信息
+    streamHeader->length = frameCount;
+    streamHeader->suggestedBufferSize = maxFrameSize;
+    
+    // 计算list大小：hdrl包含"hdrl"、avih块和strl列表；strl包含strh块和strf块
+    uint32_t listSize = sizeof(AVI_MAIN_HEADER) - 20 + sizeof(AVI_STREAM_HEADER) + sizeof(AVI_BITMAP_INFO);
+    mainHeader->listSize = listSize;
+    streamHeader->listSize = sizeof(AVI_STREAM_HEADER) - 8 + sizeof(AVI_BITMAP_INFO);
+    
+    // 计算文件大小："AVI " + hdrl列表 + JUNK块 + movi列表 + idx1块
+    mainHeader->fileSize = 4 + (8 + listSize) + (8 + AVI_JUNK_SIZE) + (8 + moviListSize) + (8 + idx1Size);
+}
+
+/**
+ * @brief 读取录制器生成的AVI文件头
+ * @param file 已打开的文件
+ * @param mainHeader AVI主头输出
+ * @param streamHeader AVI流头输出
+ * @param bitmapInfo AVI位图信息输出
+ * @return bool 格式正确返回true，否则返回false
+ * @details 功能说明：
+ *          1. 读取avih、strl、strf三个结构体
+ *          2. 检查RIFF/AVI/MJPG标识
+ *          3. 检查LIST movi在录制器写入的固定位置
+ * @note 后台重编码和剪辑共用
+ */
+bool aviReadHeaders(File &file, AVI_MAIN_HEADER *mainHeader, AVI_STREAM_HEADER *streamHeader, AVI_BITMAP_INFO *bitmapInfo){
+    if(file.size() < AVI_MOVI_DATA_OFFSET){
+        return false;
+    }
+    file.seek(0);
+    if(file.read((uint8_t*)mainHeader, sizeof(AVI_MAIN_HEADER)) != sizeof(AVI_MAIN_HEADER) ||
+       file.read((uint8_t*)streamHeader, sizeof(AVI_STREAM_HEADER)) != sizeof(AVI_STREAM_HEADER) ||
+       file.read((uint8_t*)bitmapInfo, sizeof(AVI_BITMAP_INFO)) != sizeof(AVI_BITMAP_INFO)){
+        return false;
+    }
+    if(memcmp(mainHeader->riff, AVI_FOURCC, 4) != 0 || memcmp(mainHeader->avi, AVI_AVI, 4) != 0 ||
+       memcmp(streamHeader->fccHandler, AVI_MJPG, 4) != 0){
+        return false;
+    }
+    
+    // 检查LIST movi的位置
+    char fourcc[4];
+    file.seek(AVI_MOVI_SIZE_OFFSET - 4);
+    if(file.read((uint8_t*)fourcc, 4) != 4 || memcmp(fourcc, AVI_LIST, 4) != 0){
+        return false;
+    }
+    file.seek(AVI_MOVI_FOURCC_OFFSET);
+    if(file.read((uint8_t*)fourcc, 4) != 4 || memcmp(fourcc, AVI_MOVI, 4) != 0){
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief 设置录像文件写缓冲大小
+ * @param blockSize 缓冲大小（字节），0为默认
+ * @note 从下一个分段开始生效
+ */
+void setVideoWriteBlockSize(uint32_t blockSize){
+    videoWriteBlockSize = blockSize;
+}
+
+/**
+ * @brief 获取录像文件写缓冲大小
+ * @return uint32_t 缓冲大小（字节），0为默认
+ */
+uint32_t getVideoWriteBlockSize(void){
+    return videoWriteBlockSize;
+}
+
 /**
  * @brief 检查是否正在录制视频
  * @return bool 正在录制返回true，否则返回false
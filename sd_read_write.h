@@ -44,6 +44,10 @@
 // 视频保存目录 / Video save directory
 #define VIDEO_DIR "/camera/videos"
 
+// 照片和视频按日期分目录存放：<目录>/YYYY/MM/DD/YYYYMMDDHHMM.ext / Photos and videos are stored in date directories: <dir>/YYYY/MM/DD/YYYYMMDDHHMM.ext
+// 目录层数（年/月/日）/ Directory levels (year/month/day)
+#define DATE_DIR_DEPTH 3
+
 // AVI文件相关定义 / AVI file related definitions
 #define AVI_FOURCC "RIFF"
 #define AVI_AVI "AVI "
@@ -132,10 +136,36 @@ typedef struct {
     uint32_t size;          // 大小 / Size
 } AVI_INDEX_ENTRY;
 
+// AVI JUNK填充块大小（字节）/ AVI JUNK padding chunk size (bytes)
+#define AVI_JUNK_SIZE 2048
+
+// AVI文件头总大小（avih + strl + strf）/ Total AVI header size (avih + strl + strf)
+#define AVI_HEADERS_SIZE (sizeof(AVI_MAIN_HEADER) + sizeof(AVI_STREAM_HEADER) + sizeof(AVI_BITMAP_INFO))
+
+// movi列表大小字段的偏移 / Offset of the movi list size field
+#define AVI_MOVI_SIZE_OFFSET (AVI_HEADERS_SIZE + 8 + AVI_JUNK_SIZE + 4)
+
+// "movi"标识的偏移（idx1偏移以此为基准）/ Offset of the "movi" fourcc (idx1 offsets are relative to it)
+#define AVI_MOVI_FOURCC_OFFSET (AVI_MOVI_SIZE_OFFSET + 4)
+
+// movi数据起始偏移 / Offset where movi data starts
+#define AVI_MOVI_DATA_OFFSET (AVI_MOVI_SIZE_OFFSET + 8)
+
+// 重量化标记（写入avih.reserved[AVI_RSV_REQUANT_TAG]）/ Requantization tag (stored in avih.reserved[AVI_RSV_REQUANT_TAG])
+#define AVI_REQUANT_TAG 0x31305152  // 'RQ01'
+
+// avih.reserved[]字段用途 / Usage of avih.reserved[] slots
+#define AVI_RSV_REQUANT_TAG   0     // 重量化标记 / Requantization tag
+#define AVI_RSV_REQUANT_SCALE 1     // 重量化放大百分比 / Requantization scale percent
+#define AVI_RSV_START_TIME    2     // 分段开始时间（Unix时间戳）/ Segment start time (Unix timestamp)
+#define AVI_RSV_DURATION_MS   3     // 分段实际时长（毫秒）/ Actual segment duration (ms)
+
 // SD卡空间管理配置 / SD card space management configuration
+// 以下清理参数只是默认值，运行时由保留策略（retention.h）调整 / The cleanup parameters below are only defaults, the retention policy (retention.h) adjusts them at runtime
 #define SD_SPACE_RESERVE_GB 5           // 保留空间阈值（GB），当剩余空间小于此值时触发清理 / Reserved space threshold (GB), triggers cleanup when free space is less than this value
 #define SD_CLEAN_TARGET_GB 2            // 清理目标空间（GB），每次清理释放约2GB空间 / Cleanup target space (GB), releases approximately 2GB space per cleanup
 #define SD_SPACE_CHECK_INTERVAL_MS 5000 // 空间检测间隔（毫秒），默认5秒检测一次 / Space check interval (ms), default 5 seconds
+#define SD_CLEAN_PROTECTED_SLACK 16     // 每次清理额外多选的文件数，用于跳过书签保护的分段 / Extra files selected per cleanup to make up for bookmark-protected segments
 
 // 清理优先级配置 / Cleanup priority configuration
 // 0 = 只删除视频文件 / Only delete video files
@@ -160,9 +190,24 @@ typedef struct {
  */
 bool sdmmcInit(void); 
 
+/**
+ * @brief 以指定总线频率重新挂载SD卡 / Remount the SD card at the given bus frequency
+ * @param freqKhz 总线频率（kHz），如SDMMC_FREQ_DEFAULT、SDMMC_FREQ_HIGHSPEED / Bus frequency (kHz), e.g. SDMMC_FREQ_DEFAULT, SDMMC_FREQ_HIGHSPEED
+ * @return bool 挂载成功返回true / Returns true if mounted
+ * @note 只能在没有打开文件时调用；失败时不格式化，SD卡处于未挂载状态，调用方应以原频率重新挂载
+ *       Only call it with no files open; a failure never formats the card and leaves it unmounted, callers should remount at the previous frequency
+ */
+bool sdmmcRemount(int freqKhz);
+
+/**
+ * @brief 获取当前SD卡总线频率 / Get the current SD card bus frequency
+ * @return int 总线频率（kHz）/ Bus frequency (kHz)
+ */
+int sdmmcGetFreqKhz(void);
+
 /**
  * @brief 生成时间戳文件名
- * @param prefix 文件名前缀（如"photo"或"video"）
+ * @param prefix 保存目录（如PHOTO_DIR或VIDEO_DIR）/ Save directory (such as PHOTO_DIR or VIDEO_DIR)
  * @param extension 文件扩展名（如".jpg"或".avi"）
  * @param path 输出缓冲区
  * @param pathSize 缓冲区大小
@@ -171,9 +216,48 @@ bool sdmmcInit(void);
  *          2. 格式化为ESP32-xxxx.xx.xx.xx格式 / 2. Format as ESP32-xxxx.xx.xx.xx
  *          3. 生成完整文件名 / 3. Generate complete filename
  * @note 文件名格式：ESP32-xxxx.xx.xx.xx（xxxx为启动后的秒数，xx.xx.xx为时分秒）/ Filename format: ESP32-xxxx.xx.xx.xx (xxxx is seconds after boot, xx.xx.xx is hours:minutes:seconds)
+ *       路径为prefix/YYYY/MM/DD/YYYYMMDDHHMM.ext，日期目录不存在时自动创建 / The path is prefix/YYYY/MM/DD/YYYYMMDDHHMM.ext, the date directories are created when missing
  */
 void generateTimestampFilename(const char *prefix, const char *extension, char *path, size_t pathSize);
 
+/**
+ * @brief 按指定时间生成时间戳文件名 / Generate a timestamp filename for a given time
+ * @param when 文件时间（Unix时间戳）/ File time (Unix timestamp)
+ * @param prefix 文件名前缀（目录）/ Filename prefix (directory)
+ * @param extension 文件扩展名 / File extension
+ * @param path 输出缓冲区 / Output buffer
+ * @param pathSize 缓冲区大小 / Buffer size
+ * @note 与generateTimestampFilename()相同，按日期目录存放 / Same as generateTimestampFilename(), stored under the date directories
+ */
+void generateTimestampFilenameAt(time_t when, const char *prefix, const char *extension, char *path, size_t pathSize);
+
+/**
+ * @brief 查找日期目录 / Find a date directory
+ * @param dirname 保存目录 / Save directory
+ * @param after 只找晚于这一天的目录（YYYYMMDD，0表示不限）/ Only dates after this one (YYYYMMDD, 0 for no limit)
+ * @param newest true找最新的一天，false找after之后最旧的一天 / true finds the newest date, false the oldest date after `after`
+ * @return uint32_t 日期（YYYYMMDD），没有返回0 / Date (YYYYMMDD), 0 if there is none
+ * @note 只读年、月、日三级目录项，不打开日期目录里的文件 / Only reads the year, month and day directory entries, never the files inside a date directory
+ */
+uint32_t findDateDir(const char *dirname, uint32_t after, bool newest);
+
+/**
+ * @brief 生成日期目录路径 / Build a date directory path
+ * @param dirname 保存目录 / Save directory
+ * @param date 日期（YYYYMMDD）/ Date (YYYYMMDD)
+ * @param path 输出缓冲区 / Output buffer
+ * @param pathSize 缓冲区大小 / Buffer size
+ */
+void dateDirPath(const char *dirname, uint32_t date, char *path, size_t pathSize);
+
+/**
+ * @brief 从时间戳文件名解析时间 / Parse the time from a timestamp filename
+ * @param path 文件路径或文件名（YYYYMMDDHHMM.ext）/ File path or name (YYYYMMDDHHMM.ext)
+ * @return time_t Unix时间戳（按本地时区），格式不符返回0 / Unix timestamp (local time zone), 0 if the name does not match
+ * @note generateTimestampFilename()的逆操作，精确到分钟 / Inverse of generateTimestampFilename(), minute resolution
+ */
+time_t parseTimestampFromPath(const char *path);
+
 /**
  * @brief 列出目录内容函数 / List directory contents function
  * @param fs 文件系统对象引用
@@ -256,9 +340,10 @@ void testFileIO(fs::FS &fs, const char * path);
  * @param path 要写入的文件路径
  * @param buf JPEG图像数据指针 / JPEG image data pointer
  * @param size JPEG图像数据长度（字节数）/ JPEG image data length (bytes)
+ * @return bool 全部写入返回true / Returns true if everything was written
  * @note 这是保存摄像头照片的核心函数 / This is the core function for saving camera photos
  */
-void writejpg(fs::FS &fs, const char * path, const uint8_t *buf, size_t size);
+bool writejpg(fs::FS &fs, const char * path, const uint8_t *buf, size_t size);
 
 /**
  * @brief 统计目录文件数量函数 / Count directory files function
@@ -285,10 +370,23 @@ void initPhotoDir(void);
  */
 bool savePhotoToSD(const uint8_t *buf, size_t size);
 
+/**
+ * @brief 按拍摄时间保存照片到SD卡 / Save a photo to the SD card under its capture time
+ * @param buf JPEG图像数据指针 / JPEG image data pointer
+ * @param size JPEG图像数据长度（字节数）/ JPEG image data length (bytes)
+ * @param when 拍摄时间（Unix时间戳）/ Capture time (Unix timestamp)
+ * @param savedPath 输出实际保存的路径（可为NULL）/ Receives the path actually used (may be NULL)
+ * @param savedPathSize savedPath缓冲区大小 / Size of the savedPath buffer
+ * @return bool 保存成功返回true，失败返回false
+ * @note 同一分钟内的照片追加_1、_2...序号，不会互相覆盖 / Photos within the same minute get a _1, _2... suffix and never overwrite each other
+ */
+bool savePhotoToSDAt(const uint8_t *buf, size_t size, time_t when, char *savedPath = NULL, size_t savedPathSize = 0);
+
 /**
  * @brief 获取SD卡已用空间（MB）/ Get SD card used space (MB)
  * @return uint64_t 返回已用空间（MB），失败返回0 / Returns used space (MB), 0 on failure
  * @note 用于监控SD卡使用情况，当空间不足时可以清理旧文件 / Used to monitor SD card usage, can clean up old files when space is low
+ *       读取sd_space模块缓存的计数，不访问SD卡 / Reads the counters cached by the sd_space module and never touches the card
  */
 uint64_t getSDUsedSpaceMB(void);
 
@@ -330,6 +428,7 @@ int getFileList(const char * dirname, char *files[], int maxFiles);
  * @param dirname 目录路径
  * @return int 返回删除的文件数量，失败返回-1 / Returns number of files deleted, -1 on failure / Returns number of files deleted, -1 on failure
  * @note 用于清理目录中的旧文件，释放SD卡空间 / Used to clean up old files in directory, free up SD card space
+ *       日期子目录中的文件一并删除，空目录随后删除 / Files in the date subdirectories are deleted too, followed by the empty directories
  */
 int deleteAllFiles(const char * dirname);
 
@@ -338,6 +437,7 @@ int deleteAllFiles(const char * dirname);
  * @return bool 需要清理返回true，否则返回false / Returns true if cleanup is needed, false otherwise
  * @note 动态计算阈值：当剩余空间小于保留空间（默认5GB）时返回true / Dynamically calculates threshold: returns true when free space is less than reserved space (default 5GB)
  *       适应不同容量规格的SD卡 / Adapts to SD cards of different capacities
+ *       读取缓存的剩余空间，可在录像任务中频繁调用 / Reads the cached free space, cheap enough to call often from the recorder
  */
 bool checkSDSpaceNeedsCleanup(void);
 
@@ -348,9 +448,33 @@ bool checkSDSpaceNeedsCleanup(void);
  * @param maxFiles 最大文件数量 / Maximum number of files
  * @return int 返回文件数量，失败返回-1 / Returns number of files, -1 on failure
  * @note 获取文件路径、名称、大小和修改时间 / Gets file path, name, size, and modification time
+ *       索引覆盖的目录从索引读取（最旧的在前），不遍历目录 / Directories covered by the catalog are read from it (oldest first) without a directory walk
  */
 int getFileInfoList(const char * dirname, FileInfo *files, int maxFiles);
 
+/**
+ * @brief 遍历目录获取文件信息列表 / Get file information list by walking the directory
+ * @param dirname 目录路径 / Directory path
+ * @param files 文件信息数组指针 / File information array pointer
+ * @param maxFiles 最大文件数量 / Maximum number of files
+ * @return int 返回文件数量，失败返回-1 / Returns number of files, -1 on failure
+ * @note 不读索引，能看到未索引的文件（如临时文件）/ Bypasses the catalog, so files it does not track (such as temp files) are visible
+ *       只读这一级目录，不进入日期子目录；每次调用都遍历FAT目录，只在索引不可用或需要看到未索引文件时使用
+ *       Reads this directory level only and does not descend into the date subdirectories; every call walks the FAT directory, so only use it when the catalog is unavailable or untracked files must be seen
+ */
+int scanFileInfoList(const char * dirname, FileInfo *files, int maxFiles);
+
+/**
+ * @brief 选出目录中最旧的K个文件 / Select the K oldest files in a directory
+ * @param dirname 目录路径 / Directory path
+ * @param files 文件信息数组指针（容量至少为k）/ File information array pointer (capacity at least k)
+ * @param k 最多选出的文件数 / Maximum number of files to select
+ * @return int 返回选出的文件数量（最旧的在前），失败返回-1 / Returns number of files selected (oldest first), -1 on failure
+ * @note 索引可用时直接读索引；否则遍历整个目录，用大小为k的最大堆只保留最旧的k个 / Reads the catalog when usable; otherwise walks the whole directory keeping only the k oldest in a max-heap of size k
+ *       内存O(k)，时间O(n log k)，与目录中文件数无关 / O(k) memory and O(n log k) time, whatever the number of files in the directory
+ */
+int selectOldestFiles(const char * dirname, FileInfo *files, int k);
+
 /**
  * @brief 按时间排序文件信息列表 / Sort file information list by time
  * @param files 文件信息数组指针 / File information array pointer
@@ -364,11 +488,25 @@ void sortFilesByTime(FileInfo *files, int fileCount, bool ascending);
  * @brief 删除指定目录中最旧的N个文件 / Delete N oldest files in specified directory
  * @param dirname 目录路径 / Directory path
  * @param maxFilesToDelete 最大删除文件数量 / Maximum number of files to delete
+ * @param pacingMs 每删除一个文件后的让步延时（毫秒），后台清理用 / Yield delay after each deleted file (ms), used by background cleanup
  * @return int 返回删除的文件数量，失败返回-1 / Returns number of files deleted, -1 on failure
- * @note 按文件修改时间排序，删除最旧的文件 / Sorts by file modification time, deletes oldest files
+ * @note 先删根目录下旧版平铺存放的文件，再按日期目录从旧到新整天删除，删空的日期目录随之删除 / Deletes legacy flat files in the root first, then whole date directories oldest first, removing each emptied date directory
+ *       每次只遍历一天的目录，耗时与卡上总文件数无关 / Only one day's directory is walked at a time, so the cost does not depend on how many files the card holds
  *       清理出约2GB空间后停止 / Stops after freeing approximately 2GB space
+ *       书签保护的视频分段会被跳过，同一天更新的文件接着删除，删完一天才进入下一天 / Video segments protected by a bookmark are skipped and newer files of the same day are deleted next; the following day is only touched once a day is exhausted
+ */
+int deleteOldestFiles(const char * dirname, int maxFilesToDelete, uint32_t pacingMs = 0);
+
+/**
+ * @brief 删除给定的文件列表 / Delete a given list of files
+ * @param files 文件信息数组（通常来自retention_plan_cleanup()）/ File information array (usually from retention_plan_cleanup())
+ * @param fileCount 文件数量 / Number of files
+ * @param pacingMs 每删除一个文件后的让步延时（毫秒）/ Yield delay after each deleted file (ms)
+ * @return int 返回删除的文件数量 / Returns number of files deleted
+ * @note 正在录制的分段会被跳过，删空的日期目录随之删除 / The segment being recorded is skipped, emptied date directories are removed
+ *       不再检查书签，调用方的清理计划已排除受保护的分段 / Bookmarks are not checked again, the caller's cleanup plan already excludes protected segments
  */
-int deleteOldestFiles(const char * dirname, int maxFilesToDelete);
+int deleteFileList(const FileInfo *files, int fileCount, uint32_t pacingMs = 0);
 
 /**
  * @brief 自动清理旧文件以释放空间 / Automatically clean up old files to free space
@@ -376,7 +514,8 @@ int deleteOldestFiles(const char * dirname, int maxFilesToDelete);
  * @note 当SD卡剩余空间小于保留空间（默认5GB）时，自动删除最旧的文件 / When SD card free space is less than reserved space (default 5GB), automatically deletes oldest files
  *       清理出约2GB空间后停止 / Stops after freeing approximately 2GB space
  *       优先删除videos目录中的文件，然后删除photos目录中的文件 / Prioritizes deleting files in videos directory, then photos directory
- *       清理优先级由SD_CLEANUP_PRIORITY配置 / Cleanup priority is configured by SD_CLEANUP_PRIORITY
+ *       清理优先级由保留策略配置（默认SD_CLEANUP_PRIORITY）/ Cleanup priority comes from the retention policy (SD_CLEANUP_PRIORITY by default)
+ *       书签覆盖的视频分段不会被删除 / Video segments covered by a bookmark are never deleted
  */
 int autoCleanOldFiles(void);
 
@@ -387,6 +526,7 @@ int autoCleanOldFiles(void);
  * @param height 视频高度 / Video height
  * @return bool 成功返回true，失败返回false
  * @note 创建AVI文件并写入文件头 / Creates AVI file and writes file header
+ *       不清理SD卡空间，由后台清理任务负责 / Does no SD cleanup, the background janitor task handles it
  */
 bool startVideoRecording(int fps, int width, int height);
 
@@ -394,11 +534,26 @@ bool startVideoRecording(int fps, int width, int height);
  * @brief 写入视频帧 / Write video frame
  * @param buf JPEG图像数据指针 / JPEG image data pointer
  * @param size JPEG图像数据长度（字节数）/ JPEG image data length (bytes)
- * @return bool 成功返回true，失败返回false
+ * @return bool 成功（含暂存到PSRAM）返回true，失败返回false / Returns true on success (including when held in PSRAM), false on failure
  * @note 将JPEG帧写入AVI文件 / Writes JPEG frame to AVI file
+ *       连续写入失败时报告掉卡，之后帧暂存到PSRAM，重新挂载后在新分段中继续 / Repeated write failures report a lost card, frames are then held in PSRAM and recording resumes in a new segment after remounting
  */
 bool writeVideoFrame(const uint8_t *buf, size_t size);
 
+/**
+ * @brief 收尾掉卡时的录像分段 / Close out the recording segment on card loss
+ * @note 由掉卡恢复任务在卸载前调用，保持录制状态 / Called by the recovery task before unmounting, the recording state is kept
+ */
+void closeLostVideoSegment(void);
+
+/**
+ * @brief 标记录像间隙 / Mark a gap in the recording
+ * @param gapMs 间隙时长（毫秒）/ Gap length (ms)
+ * @note 下一帧写入前补入对应数量的空00dc块（播放器按丢帧处理），时间轴保持正确
+ *       Empty 00dc chunks covering the gap are inserted before the next frame (players treat them as dropped frames), keeping the timeline correct
+ */
+void markVideoGap(uint32_t gapMs);
+
 /**
  * @brief 停止视频录制 / Stop video recording
  * @param keepRecordingState 是否保持录制状态（true=保持，false=停止）/ Whether to keep recording state (true=keep, false=stop)
@@ -408,6 +563,54 @@ bool writeVideoFrame(const uint8_t *buf, size_t size);
  */
 bool stopVideoRecording(bool keepRecordingState = false);
 
+/**
+ * @brief 初始化AVI文件头结构体 / Initialize AVI header structures
+ * @param mainHeader AVI主头 / AVI main header
+ * @param streamHeader AVI流头 / AVI stream header
+ * @param bitmapInfo AVI位图信息 / AVI bitmap info
+ * @param fps 帧率 / Frame rate
+ * @param width 视频宽度 / Video width
+ * @param height 视频高度 / Video height
+ * @note 帧数和大小字段为0，完成文件时由aviUpdateHeaders()填写 / Frame count and size fields are zero, filled in by aviUpdateHeaders() when the file is completed
+ */
+void aviInitHeaders(AVI_MAIN_HEADER *mainHeader, AVI_STREAM_HEADER *streamHeader, AVI_BITMAP_INFO *bitmapInfo,
+                    uint32_t fps, uint32_t width, uint32_t height);
+
+/**
+ * @brief 更新AVI文件头中的帧数和大小字段 / Update frame count and size fields in AVI headers
+ * @param mainHeader AVI主头 / AVI main header
+ * @param streamHeader AVI流头 / AVI stream header
+ * @param frameCount 总帧数 / Total frame count
+ * @param moviDataSize movi数据大小（所有帧块，含8字节块头）/ movi data size (all frame chunks including 8-byte chunk headers)
+ * @param maxFrameSize 最大帧大小 / Maximum frame size
+ * @note 录制器和后台重编码任务共用，保证文件头格式一致 / Shared by the recorder and background re-encoding jobs so the header layout stays identical
+ */
+void aviUpdateHeaders(AVI_MAIN_HEADER *mainHeader, AVI_STREAM_HEADER *streamHeader,
+                      uint32_t frameCount, uint32_t moviDataSize, uint32_t maxFrameSize);
+
+/**
+ * @brief 读取录制器生成的AVI文件头 / Read the headers of an AVI written by the recorder
+ * @param file 已打开的文件 / Opened file
+ * @param mainHeader AVI主头输出 / AVI main header output
+ * @param streamHeader AVI流头输出 / AVI stream header output
+ * @param bitmapInfo AVI位图信息输出 / AVI bitmap info output
+ * @return bool 格式正确且LIST movi在预期位置返回true / Returns true if the format is valid and LIST movi sits at the expected offset
+ */
+bool aviReadHeaders(File &file, AVI_MAIN_HEADER *mainHeader, AVI_STREAM_HEADER *streamHeader, AVI_BITMAP_INFO *bitmapInfo);
+
+/**
+ * @brief 设置录像文件写缓冲大小 / Set the recording file write buffer size
+ * @param blockSize 缓冲大小（字节），0为默认 / Buffer size (bytes), 0 keeps the default
+ * @note 帧数据攒够一块才写SD卡，从下一个分段开始生效 / Frame data is written to the card one full block at a time, takes effect from the next segment
+ */
+void setVideoWriteBlockSize(uint32_t blockSize);
+
+/**
+ * @brief 获取录像文件写缓冲大小 / Get the recording file write buffer size
+ * @return uint32_t 缓冲大小（字节），0为默认 / Buffer size (bytes), 0 for the default
+ */
+uint32_t getVideoWriteBlockSize(void);
+
 /**
  * @brief 检查是否正在录制视频 / Check if video is being recorded
  * @return bool 正在录制返回true，否则返回false / Returns true if recording, false otherwise
@@ -428,6 +631,7 @@ const char* getCurrentVideoFilename(void);
  *          3. 删除所有大小为0KB的视频文件 / 3. Delete all video files with 0KB size
  *          4. 返回删除的文件数量 / 4. Return the number of deleted files
  * @note 用于清理启动时可能产生的无效视频文件 / Used to clean up invalid video files that may be generated during startup
+ *       只检查根目录和最新的日期目录（断电中断的分段只会在这里）/ Only the root and the newest date directory are checked (a segment cut short by power loss can only be there)
  * @return int 返回删除的文件数量，失败返回-1 / Returns number of deleted files, -1 on failure
  */
 int cleanInvalidVideoFiles(void);
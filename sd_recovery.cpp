@@ -0,0 +1,263 @@
+/**********************************************************************
+  文件名称 / Filename : sd_recovery.cpp
+  文件用途 / File Purpose : SD卡掉卡恢复实现文件 / SD Card Loss Recovery Implementation File
+               本文件实现了掉卡后的卸载、退避重新挂载，以及掉卡期间的PSRAM帧暂存区
+               This file implements unmounting after a card loss, remounting with backoff, and the PSRAM frame hold buffer used while the card is gone
+               主要功能包括 / Main Features:
+               1. 掉卡状态切换 / Card loss state transitions
+               2. 恢复任务：收尾分段、卸载、退避重新挂载、重新加载卡上状态 / Recovery task: close out the segment, unmount, remount with backoff, reload on-card state
+               3. PSRAM环形暂存区（满时丢弃最早的帧）/ PSRAM ring hold buffer (oldest frames dropped when full)
+  作者 / Author : ESP32-S3监控项目 / ESP32-S3 Monitoring Project
+  修改日期 / Modification Date : 2026-02-05
+  硬件平台 / Hardware Platform : ESP32S3-EYE开发板 / ESP32S3-EYE Development Board
+  依赖库 / Dependencies : SD_MMC.h - 卸载 / Unmounting
+  使用说明 / Usage Instructions : 1. 调用sd_recovery_init()启动恢复任务 / Call sd_recovery_init() to start the recovery task
+  注意事项 / Important Notes : 暂存区记录：8字节头{长度, millis} + 按4字节对齐的JPEG数据；放不下时写回绕标记回到开头
+                  Hold buffer record: 8-byte header {length, millis} + JPEG data padded to 4 bytes; a wrap marker sends the writer back to the start when a record does not fit
+               重新挂载不格式化，避免把接触不良的卡清空 / Remounting never formats, so a card with a bad contact is not wiped
+**********************************************************************/
+
+#include "sd_recovery.h"
+#include "sd_read_write.h"
+#include "sd_space.h"
+#include "sd_io.h"
+#include "catalog.h"
+#include "retention.h"
+#include "photo_pack.h"
+#include "led_control.h"
+
+// 暂存帧记录头 / Held frame record header
+typedef struct {
+    uint32_t len;               // JPEG长度，HOLD_WRAP表示回绕 / JPEG length, HOLD_WRAP marks a wrap
+    uint32_t ms;                // 拍摄时的millis() / millis() at capture
+} HeldFrameHeader;
+
+#define HOLD_WRAP 0xFFFFFFFF
+
+// 暂存区（只由录像任务访问）/ Hold buffer (only accessed by the recording task)
+static uint8_t *holdBuf = NULL;
+static uint32_t holdHead = 0;
+static uint32_t holdTail = 0;
+
+// 状态和统计 / State and statistics
+static volatile int cardState = SD_CARD_OK;
+static SdRecoveryStats recoveryStats;
+static portMUX_TYPE recoveryMux = portMUX_INITIALIZER_UNLOCKED;
+
+// 恢复任务 / Recovery task
+static TaskHandle_t recoveryTask = NULL;
+
+/**
+ * @brief 记录占用的字节数 / Bytes a record occupies
+ */
+static uint32_t record_size(uint32_t len) {
+    return sizeof(HeldFrameHeader) + ((len + 3) & ~3u);
+}
+
+/**
+ * @brief 读取位置遇到回绕标记或放不下记录头时回到开头 / Go back to the start at a wrap marker or where no header fits
+ */
+static uint32_t normalize_pos(uint32_t pos) {
+    if(pos + sizeof(HeldFrameHeader) > SD_RECOVERY_HOLD_BYTES) {
+        return 0;
+    }
+    return ((HeldFrameHeader*)(holdBuf + pos))->len == HOLD_WRAP ? 0 : pos;
+}
+
+/**
+ * @brief 丢弃最早的帧 / Drop the oldest frame
+ */
+static void drop_oldest(void) {
+    HeldFrameHeader *header = (HeldFrameHeader*)(holdBuf + holdHead);
+    uint32_t len = header->len;
+    portENTER_CRITICAL(&recoveryMux);
+    recoveryStats.heldFrames--;
+    recoveryStats.heldBytes -= len;
+    uint32_t frames = recoveryStats.heldFrames;
+    portEXIT_CRITICAL(&recoveryMux);
+    if(frames == 0) {
+        holdHead = 0;
+        holdTail = 0;
+    } else {
+        holdHead = normalize_pos(holdHead + record_size(len));
+    }
+}
+
+/**
+ * @brief 恢复任务 / Recovery task
+ * @param pvParameters 未使用 / Unused
+ */
+static void sd_recovery_task(void *pvParameters) {
+    while(true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        led_set_status(LED_SD_ERROR);
+
+        // 收尾丢卡前的分段，卡已失效时写入失败，只关闭文件 / Close out the segment from before the loss, if the card is dead the writes fail and the file is just closed
+        closeLostVideoSegment();
+        photo_pack_detach();
+        sd_io_begin(SD_IO_RECORD);
+        SD_MMC.end();
+        sd_io_end(SD_IO_RECORD, 0);
+        Serial.println("SD card unmounted after write failures, waiting to remount / 写入连续失败，已卸载SD卡，等待重新挂载");
+
+        // 退避重试挂载 / Retry mounting with backoff
+        uint32_t backoffMs = SD_RECOVERY_BACKOFF_MIN_MS;
+        while(true) {
+            vTaskDelay(pdMS_TO_TICKS(backoffMs));
+            portENTER_CRITICAL(&recoveryMux);
+            recoveryStats.remountAttempts++;
+            portEXIT_CRITICAL(&recoveryMux);
+            sd_io_begin(SD_IO_RECORD);
+            bool mounted = sdmmcRemount(sdmmcGetFreqKhz()) && sd_space_init();
+            sd_io_end(SD_IO_RECORD, 0);
+            if(mounted) {
+                break;
+            }
+            backoffMs = backoffMs * 2 < SD_RECOVERY_BACKOFF_MAX_MS ? backoffMs * 2 : SD_RECOVERY_BACKOFF_MAX_MS;
+        }
+
+        // 重新加载卡上的状态（可能换了一张卡）/ Reload on-card state (it may be a different card)
+        initPhotoDir();
+        catalog_init();
+        retention_init();
+        photo_pack_init();
+
+        portENTER_CRITICAL(&recoveryMux);
+        recoveryStats.remounts++;
+        portEXIT_CRITICAL(&recoveryMux);
+        cardState = SD_CARD_RESTORED;
+        led_set_status(LED_CAMERA_READY);
+        Serial.println("SD card remounted, recording resumes in a new segment / SD卡已重新挂载，录像在新分段中继续");
+    }
+}
+
+/**
+ * @brief 初始化掉卡恢复 / Initialise card loss recovery
+ * @return bool 成功返回true / Returns true on success
+ */
+bool sd_recovery_init(void) {
+    if(recoveryTask) {
+        return true;
+    }
+    if(!holdBuf) {
+        holdBuf = (uint8_t*)ps_malloc(SD_RECOVERY_HOLD_BYTES);
+        if(!holdBuf) {
+            Serial.println("SD recovery hold buffer allocation failed / 掉卡暂存区分配失败");
+        }
+    }
+    return xTaskCreatePinnedToCore(sd_recovery_task, "sd_recovery", SD_RECOVERY_TASK_STACK, NULL,
+                                   SD_RECOVERY_TASK_PRIORITY, &recoveryTask, SD_RECOVERY_TASK_CORE) == pdPASS;
+}
+
+/**
+ * @brief 获取SD卡状态 / Get the SD card state
+ */
+int sd_recovery_state(void) {
+    return cardState;
+}
+
+/**
+ * @brief 报告掉卡 / Report a lost card
+ */
+void sd_recovery_card_lost(void) {
+    if(!recoveryTask || cardState == SD_CARD_LOST) {
+        return;
+    }
+    portENTER_CRITICAL(&recoveryMux);
+    recoveryStats.cardLosses++;
+    portEXIT_CRITICAL(&recoveryMux);
+    cardState = SD_CARD_LOST;
+    xTaskNotifyGive(recoveryTask);
+}
+
+/**
+ * @brief 录像已恢复 / Recording has resumed
+ */
+void sd_recovery_resumed(void) {
+    if(cardState == SD_CARD_RESTORED) {
+        cardState = SD_CARD_OK;
+    }
+}
+
+/**
+ * @brief 暂存一帧 / Hold a frame
+ * @return bool 已暂存返回true / Returns true if held
+ */
+bool sd_recovery_hold_frame(const uint8_t *buf, size_t len, uint32_t ms) {
+    uint32_t rec = record_size(len);
+    if(!holdBuf || rec > SD_RECOVERY_HOLD_BYTES) {
+        return false;
+    }
+
+    // 腾出连续空间，不够时丢弃最早的帧 / Make contiguous room, dropping the oldest frames when short
+    while(true) {
+        if(recoveryStats.heldFrames == 0) {
+            holdHead = 0;
+            holdTail = 0;
+            break;
+        }
+        if(holdTail > holdHead) {
+            if(SD_RECOVERY_HOLD_BYTES - holdTail >= rec) {
+                break;
+            }
+            if(holdHead >= rec) {
+                if(SD_RECOVERY_HOLD_BYTES - holdTail >= sizeof(HeldFrameHeader)) {
+                    ((HeldFrameHeader*)(holdBuf + holdTail))->len = HOLD_WRAP;
+                }
+                holdTail = 0;
+                break;
+            }
+        } else if(holdTail < holdHead && holdHead - holdTail >= rec) {
+            break;
+        }
+        drop_oldest();
+        portENTER_CRITICAL(&recoveryMux);
+        recoveryStats.droppedFrames++;
+        portEXIT_CRITICAL(&recoveryMux);
+    }
+
+    HeldFrameHeader *header = (HeldFrameHeader*)(holdBuf + holdTail);
+    header->len = len;
+    header->ms = ms;
+    memcpy(holdBuf + holdTail + sizeof(HeldFrameHeader), buf, len);
+    holdTail += rec;
+    portENTER_CRITICAL(&recoveryMux);
+    recoveryStats.heldFrames++;
+    recoveryStats.heldBytes += len;
+    portEXIT_CRITICAL(&recoveryMux);
+    return true;
+}
+
+/**
+ * @brief 查看最早的暂存帧 / Peek at the oldest held frame
+ * @return bool 有暂存帧返回true / Returns true if a frame is held
+ */
+bool sd_recovery_peek_frame(const uint8_t **buf, size_t *len, uint32_t *ms) {
+    if(recoveryStats.heldFrames == 0) {
+        return false;
+    }
+    HeldFrameHeader *header = (HeldFrameHeader*)(holdBuf + holdHead);
+    *buf = holdBuf + holdHead + sizeof(HeldFrameHeader);
+    *len = header->len;
+    *ms = header->ms;
+    return true;
+}
+
+/**
+ * @brief 丢弃最早的暂存帧 / Discard the oldest held frame
+ */
+void sd_recovery_pop_frame(void) {
+    if(recoveryStats.heldFrames > 0) {
+        drop_oldest();
+    }
+}
+
+/**
+ * @brief 获取恢复统计 / Get recovery statistics
+ */
+void sd_recovery_get_stats(SdRecoveryStats *stats) {
+    portENTER_CRITICAL(&recoveryMux);
+    *stats = recoveryStats;
+    portEXIT_CRITICAL(&recoveryMux);
+    stats->state = cardState;
+}
@@ -0,0 +1,118 @@
+/**********************************************************************
+  文件名称 / Filename : sd_recovery.h
+  文件用途 / File Purpose : SD卡掉卡恢复头文件 / SD Card Loss Recovery Header File
+               声明了录像写入连续失败后卸载、退避重新挂载并恢复录像，以及掉卡期间PSRAM暂存帧相关的函数原型和宏定义
+               Declares function prototypes and macro definitions for unmounting after repeated recording write failures, remounting with backoff and resuming recording, and holding frames in PSRAM while the card is gone
+  作者 / Author : ESP32-S3监控项目 / ESP32-S3 Monitoring Project
+  修改日期 / Modification Date : 2026-02-05
+  硬件平台 / Hardware Platform : ESP32S3-EYE开发板 / ESP32S3-EYE Development Board
+  依赖库 / Dependencies : sd_read_write.h - 挂载和录像分段 / Mounting and recording segments
+               sd_io.h - 卸载和挂载期间独占总线 / Holds the bus while unmounting and mounting
+  使用说明 / Usage Instructions : 1. 包含本头文件 #include "sd_recovery.h" / Include this header file
+               2. 启动录像前调用sd_recovery_init()分配暂存区并启动恢复任务 / Call sd_recovery_init() before recording starts to allocate the hold buffer and start the recovery task
+               3. 录像任务由writeVideoFrame()自动调用其余接口 / The recording task uses the rest through writeVideoFrame()
+  参数调整 / Parameter Adjustment : SD_RECOVERY_FAIL_THRESHOLD - 判定掉卡的连续写入失败次数（默认3）/ Consecutive write failures that count as a lost card (default 3)
+                  SD_RECOVERY_HOLD_BYTES - PSRAM暂存区大小（默认2MB）/ PSRAM hold buffer size (default 2MB)
+                  SD_RECOVERY_BACKOFF_MIN_MS/MAX_MS - 重新挂载的退避间隔（默认0.5秒到30秒）/ Remount backoff (default 0.5 s to 30 s)
+  注意事项 / Important Notes : 状态只按固定方向切换：录像任务 正常→掉卡，恢复任务 掉卡→已恢复，录像任务 已恢复→正常
+                  State only moves one way at a time: recorder normal→lost, recovery task lost→restored, recorder restored→normal
+               掉卡期间录像任务只写暂存区，不碰录像文件，由恢复任务收尾 / While the card is lost the recorder only fills the hold buffer and never touches the recording file, the recovery task closes it out
+               暂存区满时丢弃最早的帧，保留的帧始终连续 / When the hold buffer is full the oldest frames are dropped, so the frames kept are always contiguous
+               暂存区只由录像任务读写 / Only the recording task reads and writes the hold buffer
+**********************************************************************/
+
+#ifndef __SD_RECOVERY_H
+#define __SD_RECOVERY_H
+
+#include "Arduino.h"
+
+// 判定掉卡的连续写入失败次数 / Consecutive write failures that count as a lost card
+#define SD_RECOVERY_FAIL_THRESHOLD 3
+
+// PSRAM暂存区大小（字节）/ PSRAM hold buffer size (bytes)
+#define SD_RECOVERY_HOLD_BYTES (2 * 1024 * 1024)
+
+// 恢复后每写一帧最多补写的暂存帧数 / Held frames written back per live frame after recovery
+#define SD_RECOVERY_DRAIN_PER_FRAME 4
+
+// 重新挂载的退避间隔（毫秒，每次失败加倍）/ Remount backoff (ms, doubled after every failure)
+#define SD_RECOVERY_BACKOFF_MIN_MS 500
+#define SD_RECOVERY_BACKOFF_MAX_MS 30000
+
+// 恢复任务配置 / Recovery task configuration
+#define SD_RECOVERY_TASK_STACK 4096
+#define SD_RECOVERY_TASK_PRIORITY 1
+#define SD_RECOVERY_TASK_CORE 0
+
+// SD卡状态 / SD card state
+#define SD_CARD_OK 0                // 正常 / Normal
+#define SD_CARD_LOST 1              // 已卸载，等待重新挂载 / Unmounted, waiting to remount
+#define SD_CARD_RESTORED 2          // 已重新挂载，等待录像任务开新分段 / Remounted, waiting for the recorder to start a new segment
+
+// 恢复统计 / Recovery statistics
+typedef struct {
+    int state;                      // SD卡状态 / SD card state
+    uint32_t cardLosses;            // 掉卡次数 / Times the card was lost
+    uint32_t remounts;              // 重新挂载成功次数 / Successful remounts
+    uint32_t remountAttempts;       // 重新挂载尝试次数 / Remount attempts
+    uint32_t heldFrames;            // 当前暂存帧数 / Frames currently held
+    uint32_t heldBytes;             // 当前暂存字节数 / Bytes currently held
+    uint32_t droppedFrames;         // 暂存区满丢弃的帧数 / Frames dropped because the hold buffer was full
+} SdRecoveryStats;
+
+/**
+ * @brief 初始化掉卡恢复 / Initialise card loss recovery
+ * @return bool 成功返回true / Returns true on success
+ * @details 功能说明 / Function Description:
+ *          1. 在PSRAM中分配暂存区 / Allocate the hold buffer in PSRAM
+ *          2. 启动恢复任务（平时阻塞等待）/ Start the recovery task (blocked until needed)
+ */
+bool sd_recovery_init(void);
+
+/**
+ * @brief 获取SD卡状态 / Get the SD card state
+ * @return int SD_CARD_OK / SD_CARD_LOST / SD_CARD_RESTORED
+ */
+int sd_recovery_state(void);
+
+/**
+ * @brief 报告掉卡（录像任务调用）/ Report a lost card (called by the recorder)
+ * @note 之后录像任务不再访问录像文件，直到状态变为SD_CARD_RESTORED / The recorder must not touch the recording file again until the state is SD_CARD_RESTORED
+ */
+void sd_recovery_card_lost(void);
+
+/**
+ * @brief 录像已恢复（录像任务调用）/ Recording has resumed (called by the recorder)
+ */
+void sd_recovery_resumed(void);
+
+/**
+ * @brief 暂存一帧 / Hold a frame
+ * @param buf JPEG数据 / JPEG data
+ * @param len JPEG长度 / JPEG length
+ * @param ms 拍摄时的millis() / millis() at capture
+ * @return bool 已暂存返回true，未初始化或帧大于暂存区返回false / Returns true if held, false if not initialised or larger than the buffer
+ */
+bool sd_recovery_hold_frame(const uint8_t *buf, size_t len, uint32_t ms);
+
+/**
+ * @brief 查看最早的暂存帧 / Peek at the oldest held frame
+ * @param buf 输出帧数据指针（指向暂存区内部）/ Output pointer to the frame data (inside the hold buffer)
+ * @param len 输出帧长度 / Output frame length
+ * @param ms 输出拍摄时的millis() / Output millis() at capture
+ * @return bool 有暂存帧返回true / Returns true if a frame is held
+ */
+bool sd_recovery_peek_frame(const uint8_t **buf, size_t *len, uint32_t *ms);
+
+/**
+ * @brief 丢弃最早的暂存帧（写入后调用）/ Discard the oldest held frame (call once written)
+ */
+void sd_recovery_pop_frame(void);
+
+/**
+ * @brief 获取恢复统计 / Get recovery statistics
+ * @param stats 输出统计 / Output statistics
+ */
+void sd_recovery_get_stats(SdRecoveryStats *stats);
+
+#endif // __SD_RECOVERY_H
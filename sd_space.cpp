@@ -0,0 +1,134 @@
+/**********************************************************************
+  文件名称 / Filename : sd_space.cpp
+  文件用途 / File Purpose : SD卡空间统计实现文件 / SD Card Space Accounting Implementation File
+               本文件实现了挂载时读取一次、之后按文件操作增量维护的SD卡空间计数
+               This file implements SD card space counters read once at mount and then maintained incrementally from file operations
+               主要功能包括 / Main Features:
+               1. 挂载时读取准确的簇信息 / Authoritative cluster reading at mount
+               2. 写入和删除时按簇调整计数 / Cluster-rounded adjustments on writes and deletes
+               3. 后台定期校准 / Periodic background re-sync
+  作者 / Author : ESP32-S3监控项目 / ESP32-S3 Monitoring Project
+  修改日期 / Modification Date : 2026-02-05
+  硬件平台 / Hardware Platform : ESP32S3-EYE开发板 / ESP32S3-EYE Development Board
+  依赖库 / Dependencies : ff.h - FATFS
+  使用说明 / Usage Instructions : 1. 调用sd_space_init()读取准确值 / Call sd_space_init() for an authoritative reading
+  注意事项 / Important Notes : SD_MMC.usedBytes()每次都调用f_getfree()，FSInfo无效时（exFAT总是）要遍历整个FAT
+                  SD_MMC.usedBytes() calls f_getfree() every time, which walks the whole FAT when FSInfo is invalid (always on exFAT)
+**********************************************************************/
+
+#include "sd_space.h"
+#include "ff.h"
+
+// 空间计数 / Space counters
+static uint64_t spaceTotalBytes = 0;
+static uint64_t spaceUsedBytes = 0;
+static uint32_t spaceClusterBytes = 0;
+static uint32_t spaceSyncMs = 0;
+static portMUX_TYPE spaceMux = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief 读取准确的空间信息 / Take an authoritative space reading
+ * @return bool 成功返回true / Returns true on success
+ */
+bool sd_space_init(void) {
+    FATFS *fs;
+    DWORD freeClusters;
+    if(f_getfree(SD_SPACE_FATFS_DRIVE, &freeClusters, &fs) != FR_OK) {
+        return false;
+    }
+#if FF_MAX_SS != FF_MIN_SS
+    uint32_t sectorBytes = fs->ssize;
+#else
+    uint32_t sectorBytes = FF_MAX_SS;
+#endif
+    uint32_t clusterBytes = fs->csize * sectorBytes;
+    uint64_t totalClusters = fs->n_fatent - 2;
+    portENTER_CRITICAL(&spaceMux);
+    spaceClusterBytes = clusterBytes;
+    spaceTotalBytes = totalClusters * clusterBytes;
+    spaceUsedBytes = (totalClusters - freeClusters) * clusterBytes;
+    spaceSyncMs = millis();
+    portEXIT_CRITICAL(&spaceMux);
+    return true;
+}
+
+/**
+ * @brief 到期时重新校准 / Re-sync when due
+ */
+void sd_space_resync_if_due(void) {
+    if(millis() - spaceSyncMs >= SD_SPACE_RESYNC_INTERVAL_MS) {
+        sd_space_init();
+    }
+}
+
+/**
+ * @brief 按簇向上取整 / Round up to whole clusters
+ */
+static uint64_t cluster_round(uint64_t bytes, uint32_t clusterBytes) {
+    return (bytes + clusterBytes - 1) / clusterBytes * clusterBytes;
+}
+
+/**
+ * @brief 文件大小变化 / A file changed size
+ */
+void sd_space_file_resized(uint64_t oldBytes, uint64_t newBytes) {
+    portENTER_CRITICAL(&spaceMux);
+    if(spaceClusterBytes) {
+        uint64_t oldUsed = cluster_round(oldBytes, spaceClusterBytes);
+        uint64_t newUsed = cluster_round(newBytes, spaceClusterBytes);
+        if(newUsed >= oldUsed) {
+            spaceUsedBytes += newUsed - oldUsed;
+            if(spaceUsedBytes > spaceTotalBytes) {
+                spaceUsedBytes = spaceTotalBytes;
+            }
+        } else {
+            uint64_t freed = oldUsed - newUsed;
+            spaceUsedBytes = spaceUsedBytes > freed ? spaceUsedBytes - freed : 0;
+        }
+    }
+    portEXIT_CRITICAL(&spaceMux);
+}
+
+/**
+ * @brief 新增文件 / A file was added
+ */
+void sd_space_file_added(uint64_t bytes) {
+    sd_space_file_resized(0, bytes);
+}
+
+/**
+ * @brief 删除文件 / A file was deleted
+ */
+void sd_space_file_removed(uint64_t bytes) {
+    sd_space_file_resized(bytes, 0);
+}
+
+/**
+ * @brief 获取总空间 / Get total space
+ */
+uint64_t sd_space_total_bytes(void) {
+    portENTER_CRITICAL(&spaceMux);
+    uint64_t total = spaceTotalBytes;
+    portEXIT_CRITICAL(&spaceMux);
+    return total;
+}
+
+/**
+ * @brief 获取已用空间 / Get used space
+ */
+uint64_t sd_space_used_bytes(void) {
+    portENTER_CRITICAL(&spaceMux);
+    uint64_t used = spaceUsedBytes;
+    portEXIT_CRITICAL(&spaceMux);
+    return used;
+}
+
+/**
+ * @brief 获取剩余空间 / Get free space
+ */
+uint64_t sd_space_free_bytes(void) {
+    portENTER_CRITICAL(&spaceMux);
+    uint64_t freeBytes = spaceTotalBytes - spaceUsedBytes;
+    portEXIT_CRITICAL(&spaceMux);
+    return freeBytes;
+}
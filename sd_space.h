@@ -0,0 +1,84 @@
+/**********************************************************************
+  文件名称 / Filename : sd_space.h
+  文件用途 / File Purpose : SD卡空间统计头文件 / SD Card Space Accounting Header File
+               声明了缓存的SD卡已用/剩余空间计数相关的函数原型和宏定义
+               Declares function prototypes and macro definitions for the cached SD card used/free space counters
+  作者 / Author : ESP32-S3监控项目 / ESP32-S3 Monitoring Project
+  修改日期 / Modification Date : 2026-02-05
+  硬件平台 / Hardware Platform : ESP32S3-EYE开发板 / ESP32S3-EYE Development Board
+  依赖库 / Dependencies : ff.h - FATFS（读取簇大小和空闲簇数）/ FATFS (cluster size and free cluster count)
+  使用说明 / Usage Instructions : 1. 包含本头文件 #include "sd_space.h" / Include this header file
+               2. SD卡挂载后调用sd_space_init()读取一次准确值 / Call sd_space_init() after mounting for one authoritative reading
+               3. 写入、关闭、删除文件时调用sd_space_file_*()调整计数 / Call sd_space_file_*() on file writes, closes and deletes to adjust the counters
+               4. 后台任务定期调用sd_space_resync_if_due()重新校准 / A background task calls sd_space_resync_if_due() periodically to re-sync
+  参数调整 / Parameter Adjustment : SD_SPACE_RESYNC_INTERVAL_MS - 后台校准间隔（默认10分钟）/ Background re-sync interval (default 10 minutes)
+  注意事项 / Important Notes : 查询只读内存中的计数，O(1)且不访问SD卡 / Queries only read the in-memory counters, O(1) and never touch the card
+               计数按簇向上取整，与FAT实际占用一致；固件以外的改动由后台校准修正 / Counters round up to whole clusters like FAT does; changes made outside the firmware are corrected by the background re-sync
+**********************************************************************/
+
+#ifndef __SD_SPACE_H
+#define __SD_SPACE_H
+
+#include "Arduino.h"
+
+// 后台校准间隔（毫秒）/ Background re-sync interval (ms)
+#define SD_SPACE_RESYNC_INTERVAL_MS (10 * 60 * 1000)
+
+// FATFS驱动器号（SD_MMC挂载为第一个FATFS卷）/ FATFS drive (SD_MMC mounts the first FATFS volume)
+#define SD_SPACE_FATFS_DRIVE "0:"
+
+/**
+ * @brief 读取准确的空间信息 / Take an authoritative space reading
+ * @return bool 成功返回true / Returns true on success
+ * @details 功能说明 / Function Description:
+ *          1. 通过f_getfree()读取簇大小、总簇数和空闲簇数 / Read cluster size, total and free clusters through f_getfree()
+ *          2. 覆盖内存中的计数 / Overwrite the in-memory counters
+ * @note 可能遍历FAT，只在挂载时和后台任务中调用 / May walk the FAT, only call it at mount and from background tasks
+ */
+bool sd_space_init(void);
+
+/**
+ * @brief 到期时重新校准 / Re-sync when due
+ * @note 距上次读取超过SD_SPACE_RESYNC_INTERVAL_MS时调用sd_space_init() / Calls sd_space_init() once SD_SPACE_RESYNC_INTERVAL_MS has passed since the last reading
+ */
+void sd_space_resync_if_due(void);
+
+/**
+ * @brief 文件大小变化 / A file changed size
+ * @param oldBytes 原大小（新文件为0）/ Old size (0 for a new file)
+ * @param newBytes 新大小 / New size
+ * @note 按簇取整后计入差值，同一簇内的增长不改变计数 / The difference is counted in whole clusters, growth within a cluster changes nothing
+ */
+void sd_space_file_resized(uint64_t oldBytes, uint64_t newBytes);
+
+/**
+ * @brief 新增文件 / A file was added
+ * @param bytes 文件大小 / File size
+ */
+void sd_space_file_added(uint64_t bytes);
+
+/**
+ * @brief 删除文件 / A file was deleted
+ * @param bytes 文件大小 / File size
+ */
+void sd_space_file_removed(uint64_t bytes);
+
+/**
+ * @brief 获取总空间 / Get total space
+ * @return uint64_t 总字节数，未挂载返回0 / Total bytes, 0 if not mounted
+ */
+uint64_t sd_space_total_bytes(void);
+
+/**
+ * @brief 获取已用空间 / Get used space
+ * @return uint64_t 已用字节数 / Used bytes
+ */
+uint64_t sd_space_used_bytes(void);
+
+/**
+ * @brief 获取剩余空间 / Get free space
+ * @return uint64_t 剩余字节数 / Free bytes
+ */
+uint64_t sd_space_free_bytes(void);
+
+#endif // __SD_SPACE_H
@@ -0,0 +1,180 @@
+/**********************************************************************
+  文件名称 / Filename : storage_janitor.cpp
+  文件用途 / File Purpose : SD卡空间清理任务实现文件 / SD Card Storage Janitor Implementation File
+               本文件实现了后台按水位线清理SD卡空间的低优先级任务
+               This file implements the low-priority background task that keeps SD card free space between two watermarks
+               主要功能包括 / Main Features:
+               1. 定期检查剩余空间 / Periodic free space checks
+               2. 低水位线开始、高水位线停止的滞回清理 / Hysteresis cleanup starting at the low watermark and stopping at the high one
+               3. 分批删除并在每个文件后让步 / Batched deletes with a yield after every file
+               4. 每轮执行保留策略的配额和保留天数 / Retention quotas and ages enforced every round
+               5. 按写入速率提前清理 / Cleanup ahead of demand from the write rate
+  作者 / Author : ESP32-S3监控项目 / ESP32-S3 Monitoring Project
+  修改日期 / Modification Date : 2026-02-05
+  硬件平台 / Hardware Platform : ESP32S3-EYE开发板 / ESP32S3-EYE Development Board
+  依赖库 / Dependencies : sd_space.h - 缓存的空间统计 / Cached space accounting
+               retention.h - 保留策略和清理计划 / Retention policy and cleanup planning
+  使用说明 / Usage Instructions : 1. 调用storage_janitor_init()启动任务 / Call storage_janitor_init() to start the task
+  注意事项 / Important Notes : 任务运行在录像以外的核心，优先级低于录像和Web服务 / The task runs on the core not used for recording, below the recorder and the web server in priority
+               空间统计的后台校准和写入统计的保存也在本任务中进行 / The background re-sync of the space accounting and saving the write statistics also run in this task
+               索引不可用时退回按目录删除最旧的文件，只处理剩余空间，不执行配额和天数 / Without the catalog it falls back to deleting the oldest files per directory, for free space only, without quotas and ages
+**********************************************************************/
+
+#include "storage_janitor.h"
+#include "sd_space.h"
+#include "retention.h"
+#include "storage_stats.h"
+
+// 清理统计 / Cleanup statistics
+static StorageJanitorStats janitorStats = {0};
+static portMUX_TYPE janitorStatsMux = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief 获取剩余空间 / Get free space
+ * @return uint64_t 剩余字节数，SD卡未挂载返回0 / Free bytes, 0 if the SD card is not mounted
+ */
+static uint64_t janitor_free_bytes(void) {
+    uint64_t freeBytes = sd_space_free_bytes();
+    portENTER_CRITICAL(&janitorStatsMux);
+    janitorStats.freeBytes = freeBytes;
+    portEXIT_CRITICAL(&janitorStatsMux);
+    return freeBytes;
+}
+
+// 清理计划缓冲区（PSRAM）/ Cleanup plan buffer (PSRAM)
+static FileInfo *janitorPlan = NULL;
+
+/**
+ * @brief 按清理优先级删除一批最旧的文件（索引不可用时）/ Delete one batch of the oldest files following the cleanup priority (without the catalog)
+ * @return int 删除的文件数 / Files deleted
+ * @note 优先级1时视频删完才删照片 / With priority 1 photos are only deleted once no video can be
+ */
+static int janitor_delete_oldest(void) {
+    int priority = retention_priority();
+    int deleted = 0;
+    if(priority != 2) {
+        deleted = deleteOldestFiles(VIDEO_DIR, STORAGE_JANITOR_BATCH_FILES, STORAGE_JANITOR_DELETE_PACING_MS);
+    }
+    if(deleted <= 0 && priority != 0) {
+        deleted = deleteOldestFiles(PHOTO_DIR, STORAGE_JANITOR_BATCH_FILES, STORAGE_JANITOR_DELETE_PACING_MS);
+    }
+    return deleted;
+}
+
+/**
+ * @brief 按保留策略删除一批文件 / Delete one batch of files following the retention policy
+ * @param needBytes 为剩余空间还需释放的字节数，0表示只按配额和保留天数 / Bytes still to free for free space, 0 for quotas and ages only
+ * @return int 删除的文件数 / Files deleted
+ */
+static int janitor_delete_batch(uint64_t needBytes) {
+    int planned = janitorPlan ? retention_plan_cleanup(needBytes, janitorPlan, STORAGE_JANITOR_BATCH_FILES) : -1;
+    if(planned < 0) {
+        return needBytes > 0 ? janitor_delete_oldest() : 0;
+    }
+    return planned > 0 ? deleteFileList(janitorPlan, planned, STORAGE_JANITOR_DELETE_PACING_MS) : 0;
+}
+
+/**
+ * @brief 计算水位线的提前量 / Work out how far to move the watermarks up
+ * @param gapBytes 两条水位线之差，提前量的上限 / Gap between the watermarks, the upper limit
+ * @return uint64_t 按当前写入速率在STORAGE_JANITOR_LOOKAHEAD_S内写入的字节数 / Bytes the current write rate adds within STORAGE_JANITOR_LOOKAHEAD_S
+ */
+static uint64_t janitor_ahead_bytes(uint64_t gapBytes) {
+    StorageForecast forecast;
+    storage_stats_forecast(&forecast);
+    uint64_t aheadBytes = (uint64_t)forecast.totalRateBps * STORAGE_JANITOR_LOOKAHEAD_S;
+    if(aheadBytes > gapBytes) {
+        aheadBytes = gapBytes;
+    }
+    portENTER_CRITICAL(&janitorStatsMux);
+    janitorStats.aheadBytes = aheadBytes;
+    portEXIT_CRITICAL(&janitorStatsMux);
+    return aheadBytes;
+}
+
+/**
+ * @brief 设置清理状态 / Set the cleanup state
+ */
+static void set_cleaning(bool cleaning) {
+    portENTER_CRITICAL(&janitorStatsMux);
+    janitorStats.cleaning = cleaning;
+    if(cleaning) {
+        janitorStats.passes++;
+    }
+    portEXIT_CRITICAL(&janitorStatsMux);
+}
+
+/**
+ * @brief SD卡空间清理任务 / Storage janitor task
+ * @param pvParameters 未使用 / Unused
+ */
+static void storage_janitor_task(void *pvParameters) {
+    Serial.printf("Storage janitor started on core %d / SD卡空间清理任务已启动\n", xPortGetCoreID());
+    while(true) {
+        // 到期时重新读取准确的空间信息 / Take a fresh authoritative reading when due
+        sd_space_resync_if_due();
+        storage_stats_save_if_due();
+        uint64_t freeBytes = janitor_free_bytes();
+        uint64_t lowBytes = retention_low_watermark_bytes();
+        uint64_t highBytes = retention_high_watermark_bytes();
+
+        // 按写入速率提前清理 / Clean ahead of demand from the write rate
+        uint64_t aheadBytes = janitor_ahead_bytes(highBytes > lowBytes ? highBytes - lowBytes : 0);
+        lowBytes += aheadBytes;
+        highBytes += aheadBytes;
+        bool lowSpace = sd_space_total_bytes() > 0 && freeBytes < lowBytes;
+        if(lowSpace) {
+            // 低于低水位线，一直清理到高水位线 / Below the low watermark, keep cleaning up to the high watermark
+            set_cleaning(true);
+            Serial.printf("Storage janitor: %llu MB free, cleaning up to %llu MB / 剩余空间不足，开始清理\n",
+                          freeBytes / (1024ULL * 1024ULL), highBytes / (1024ULL * 1024ULL));
+        }
+
+        // 配额和保留天数每轮都执行，空间不足时再按优先级补足 / Quotas and ages apply every round, free space is topped up by priority when low
+        if(sd_space_total_bytes() > 0) {
+            while(true) {
+                uint64_t needBytes = lowSpace && freeBytes < highBytes ? highBytes - freeBytes : 0;
+                int deleted = janitor_delete_batch(needBytes);
+                if(deleted <= 0) {
+                    if(needBytes > 0) {
+                        Serial.println("Storage janitor: nothing left to delete / 没有可删除的文件");
+                    }
+                    break;
+                }
+                portENTER_CRITICAL(&janitorStatsMux);
+                janitorStats.filesDeleted += deleted;
+                portEXIT_CRITICAL(&janitorStatsMux);
+                freeBytes = janitor_free_bytes();
+            }
+        }
+
+        if(lowSpace) {
+            set_cleaning(false);
+            Serial.printf("Storage janitor: done, %llu MB free / 清理完成\n", freeBytes / (1024ULL * 1024ULL));
+        }
+        vTaskDelay(pdMS_TO_TICKS(SD_SPACE_CHECK_INTERVAL_MS));
+    }
+}
+
+/**
+ * @brief 启动SD卡空间清理任务 / Start the storage janitor task
+ * @return bool 成功返回true / Returns true on success
+ */
+bool storage_janitor_init(void) {
+    if(!janitorPlan) {
+        janitorPlan = (FileInfo*)(psramFound() ? ps_malloc(STORAGE_JANITOR_BATCH_FILES * sizeof(FileInfo))
+                                               : malloc(STORAGE_JANITOR_BATCH_FILES * sizeof(FileInfo)));
+    }
+    return xTaskCreatePinnedToCore(storage_janitor_task, "storage_janitor", STORAGE_JANITOR_TASK_STACK, NULL,
+                                   STORAGE_JANITOR_TASK_PRIORITY, NULL, STORAGE_JANITOR_TASK_CORE) == pdPASS;
+}
+
+/**
+ * @brief 获取清理统计 / Get cleanup statistics
+ * @param stats 统计输出 / Statistics output
+ */
+void storage_janitor_get_stats(StorageJanitorStats *stats) {
+    portENTER_CRITICAL(&janitorStatsMux);
+    *stats = janitorStats;
+    portEXIT_CRITICAL(&janitorStatsMux);
+}
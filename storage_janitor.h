@@ -0,0 +1,66 @@
+/**********************************************************************
+  文件名称 / Filename : storage_janitor.h
+  文件用途 / File Purpose : SD卡空间清理任务头文件 / SD Card Storage Janitor Header File
+               声明了后台按水位线清理SD卡空间相关的函数原型和宏定义
+               Declares function prototypes and macro definitions for background SD card cleanup between watermarks
+  作者 / Author : ESP32-S3监控项目 / ESP32-S3 Monitoring Project
+  修改日期 / Modification Date : 2026-02-05
+  硬件平台 / Hardware Platform : ESP32S3-EYE开发板 / ESP32S3-EYE Development Board
+  依赖库 / Dependencies : sd_read_write.h - SD卡空间查询和删除最旧文件 / SD card space queries and oldest-file deletion
+  使用说明 / Usage Instructions : 1. 包含本头文件 #include "storage_janitor.h" / Include this header file
+               2. SD卡初始化后调用storage_janitor_init()启动任务 / Call storage_janitor_init() after SD card init to start the task
+  参数调整 / Parameter Adjustment : 水位线、配额和保留天数由保留策略（retention.h）在运行时配置 / Watermarks, quotas and ages are configured at runtime by the retention policy (retention.h)
+               STORAGE_JANITOR_DELETE_PACING_MS - 每删除一个文件后的让步延时 / Yield delay after each deleted file
+  注意事项 / Important Notes : 录像任务不再等待删除，分段切换时不做任何清理 / The recorder never waits on deletes, segment rollover does no cleanup at all
+               两条水位线之间不开始也不停止清理，避免在阈值附近反复启停 / Between the two watermarks cleanup neither starts nor stops, so it does not flap around a single threshold
+               水位线按写入速率提前，最多提前一次清理的量（两条水位线之差）/ The watermarks move ahead with the write rate, by at most one cleanup's worth (the gap between them)
+**********************************************************************/
+
+#ifndef __STORAGE_JANITOR_H
+#define __STORAGE_JANITOR_H
+
+#include "Arduino.h"
+#include "sd_read_write.h"
+
+// 每批最多删除的文件数，每批之后重新检查剩余空间 / Maximum files per batch, free space is checked again after each batch
+#define STORAGE_JANITOR_BATCH_FILES 8
+
+// 每删除一个文件后的让步延时（毫秒），给录像写入让出SD卡 / Yield delay after each deleted file (ms), leaves the SD card to recording writes
+#define STORAGE_JANITOR_DELETE_PACING_MS 50
+
+// 提前清理的预测时长（秒）：按当前写入速率把两条水位线上移这段时间的写入量，0表示不提前 / Cleanup lookahead (s): both watermarks move up by what the current write rate adds in this time, 0 to disable
+#define STORAGE_JANITOR_LOOKAHEAD_S 600
+
+// 任务参数 / Task parameters
+#define STORAGE_JANITOR_TASK_CORE 0
+#define STORAGE_JANITOR_TASK_PRIORITY 1
+#define STORAGE_JANITOR_TASK_STACK 6144
+
+// 清理统计 / Cleanup statistics
+typedef struct {
+    bool cleaning;              // 是否正在清理（低于高水位线）/ Whether cleanup is in progress (below the high watermark)
+    uint32_t passes;            // 清理轮数 / Cleanup passes
+    uint32_t filesDeleted;      // 已删除文件数 / Files deleted
+    uint64_t freeBytes;         // 最近一次检查的剩余空间 / Free space at the last check
+    uint64_t aheadBytes;        // 最近一次检查时水位线的提前量 / How far the watermarks were moved up at the last check
+} StorageJanitorStats;
+
+/**
+ * @brief 启动SD卡空间清理任务 / Start the storage janitor task
+ * @return bool 成功返回true / Returns true on success
+ * @details 功能说明 / Function Description:
+ *          1. 每隔SD_SPACE_CHECK_INTERVAL_MS检查一次剩余空间 / Check free space every SD_SPACE_CHECK_INTERVAL_MS
+ *          2. 每轮删除超出配额或超过最长保留天数的文件 / Every round, delete files over quota or past their maximum age
+ *          3. 低于低水位线时按清理优先级分批删除最旧的文件，达到高水位线或没有可删除的文件时停止 / Below the low watermark, delete the oldest files in batches by priority until the high watermark or nothing is left to delete
+ *          4. 两条水位线按STORAGE_JANITOR_LOOKAHEAD_S内的预计写入量上移，在需要之前清理 / Both watermarks move up by the writes expected within STORAGE_JANITOR_LOOKAHEAD_S, so cleanup runs ahead of demand
+ * @note 清理集合由retention_plan_cleanup()一次遍历索引得出 / Each batch comes from one walk of the catalog by retention_plan_cleanup()
+ */
+bool storage_janitor_init(void);
+
+/**
+ * @brief 获取清理统计 / Get cleanup statistics
+ * @param stats 统计输出 / Statistics output
+ */
+void storage_janitor_get_stats(StorageJanitorStats *stats);
+
+#endif // __STORAGE_JANITOR_H
@@ -0,0 +1,218 @@
+/**********************************************************************
+  文件名称 / Filename : storage_stats.cpp
+  文件用途 / File Purpose : SD卡写入统计与空间预测实现文件 / SD Card Write Statistics and Space Forecast Implementation File
+               本文件实现了由写入路径增量维护的写入计数，以及基于写入速率的清理时间预测
+               This file implements the write counters maintained incrementally by the write paths, and the cleanup time forecast based on the write rate
+               主要功能包括 / Main Features:
+               1. 按天、按分类的写入量 / Per-day, per-category bytes written
+               2. 按分钟分桶的写入速率 / Write rate from per-minute buckets
+               3. 开始清理和写满的时间预测 / Forecast of when cleanup starts and when the card fills up
+               4. 按天统计保存到SD卡 / Per-day counters saved to the SD card
+  作者 / Author : ESP32-S3监控项目 / ESP32-S3 Monitoring Project
+  修改日期 / Modification Date : 2026-02-05
+  硬件平台 / Hardware Platform : ESP32S3-EYE开发板 / ESP32S3-EYE Development Board
+  依赖库 / Dependencies : SD_MMC.h - SD卡文件系统 / SD card file system
+  使用说明 / Usage Instructions : 1. 调用storage_stats_init()加载按天统计 / Call storage_stats_init() to load the per-day counters
+  注意事项 / Important Notes : 计数由portMUX保护，不在临界区内访问SD卡或取本地时间 / Counters are guarded by a portMUX, neither the SD card nor local time is touched inside the critical section
+**********************************************************************/
+
+#include "storage_stats.h"
+#include "sd_space.h"
+#include "SD_MMC.h"
+#include "sd_io.h"
+#include <time.h>
+
+// 统计文件内容 / Statistics file contents
+typedef struct {
+    uint32_t magic;                                     // 文件标识 / File magic
+    uint32_t head;                                      // 最新一天的位置 / Slot of the newest day
+    StorageDayStats days[STORAGE_STATS_DAYS];           // 按天统计（环形）/ Per-day counters (ring)
+} StorageStatsFile;
+
+// 按天统计 / Per-day counters
+static StorageStatsFile statsFile = {STORAGE_STATS_MAGIC, 0, {}};
+static bool statsDirty = false;
+static uint32_t statsLastSaveMs = 0;
+
+// 按分钟分桶（多一个桶存放当前分钟）/ Per-minute buckets (one extra for the current minute)
+#define RATE_BUCKETS (STORAGE_STATS_RATE_WINDOW_MIN + 1)
+static uint32_t minuteKey[RATE_BUCKETS];
+static uint32_t minuteBytes[RATE_BUCKETS][RETENTION_NUM_CATEGORIES];
+
+// 启动以来的写入量 / Bytes written since boot
+static uint64_t bootBytes[RETENTION_NUM_CATEGORIES];
+
+static portMUX_TYPE statsMux = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief 当前日期 / Today's date
+ * @return uint32_t YYYYMMDD，系统时间未同步返回0 / YYYYMMDD, 0 while the clock is not synced
+ */
+static uint32_t today(void) {
+    time_t now = time(nullptr);
+    if(now < RETENTION_MIN_VALID_TIME) {
+        return 0;
+    }
+    struct tm timeinfo;
+    localtime_r(&now, &timeinfo);
+    return (timeinfo.tm_year + 1900) * 10000 + (timeinfo.tm_mon + 1) * 100 + timeinfo.tm_mday;
+}
+
+/**
+ * @brief 加载按天统计 / Load the per-day counters
+ * @return bool 从SD卡加载返回true / Returns true if loaded from the SD card
+ */
+bool storage_stats_init(void) {
+    statsLastSaveMs = millis();
+    sd_io_begin(SD_IO_STORE);
+    File file = SD_MMC.exists(STORAGE_STATS_FILE) ? SD_MMC.open(STORAGE_STATS_FILE, FILE_READ) : File();
+    if(!file) {
+        sd_io_end(SD_IO_STORE, 0);
+        return false;
+    }
+    StorageStatsFile *contents = (StorageStatsFile*)malloc(sizeof(StorageStatsFile));
+    bool ok = contents && sd_io_read(file, (uint8_t*)contents, sizeof(StorageStatsFile), SD_IO_STORE) == sizeof(StorageStatsFile) &&
+              contents->magic == STORAGE_STATS_MAGIC && contents->head < STORAGE_STATS_DAYS;
+    file.close();
+    sd_io_end(SD_IO_STORE, 0);
+    if(ok) {
+        portENTER_CRITICAL(&statsMux);
+        statsFile = *contents;
+        portEXIT_CRITICAL(&statsMux);
+    } else {
+        Serial.println("Storage statistics file is corrupt, starting from zero / 写入统计文件损坏，从零开始");
+    }
+    free(contents);
+    return ok;
+}
+
+/**
+ * @brief 记录写入 / Count a write
+ */
+void storage_stats_add(int category, uint32_t bytes) {
+    if(category < 0 || category >= RETENTION_NUM_CATEGORIES || bytes == 0) {
+        return;
+    }
+    uint32_t date = today();
+    uint32_t minute = millis() / 60000;
+    uint32_t bucket = minute % RATE_BUCKETS;
+
+    portENTER_CRITICAL(&statsMux);
+    bootBytes[category] += bytes;
+    if(minuteKey[bucket] != minute) {
+        minuteKey[bucket] = minute;
+        memset(minuteBytes[bucket], 0, sizeof(minuteBytes[bucket]));
+    }
+    minuteBytes[bucket][category] += bytes;
+    if(date) {
+        StorageDayStats *day = &statsFile.days[statsFile.head];
+        if(day->date != date) {
+            // 换天：占用下一个位置，覆盖最旧的一天 / New day: take the next slot, overwriting the oldest day
+            if(day->date != 0) {
+                statsFile.head = (statsFile.head + 1) % STORAGE_STATS_DAYS;
+                day = &statsFile.days[statsFile.head];
+            }
+            memset(day, 0, sizeof(StorageDayStats));
+            day->date = date;
+        }
+        day->bytes[category] += bytes;
+        statsDirty = true;
+    }
+    portEXIT_CRITICAL(&statsMux);
+}
+
+/**
+ * @brief 获取写入速率和空间预测 / Get the write rate and space forecast
+ */
+void storage_stats_forecast(StorageForecast *forecast) {
+    memset(forecast, 0, sizeof(StorageForecast));
+    uint32_t nowMs = millis();
+    uint32_t minute = nowMs / 60000;
+
+    // 窗口为最近的完整分钟加当前分钟已过的部分，不超过运行时间 / The window is the last whole minutes plus the part of the current one, at most the uptime
+    uint64_t windowBytes[RETENTION_NUM_CATEGORIES] = {0};
+    portENTER_CRITICAL(&statsMux);
+    for(int b = 0; b < RATE_BUCKETS; b++) {
+        if(minute - minuteKey[b] <= STORAGE_STATS_RATE_WINDOW_MIN) {
+            for(int c = 0; c < RETENTION_NUM_CATEGORIES; c++) {
+                windowBytes[c] += minuteBytes[b][c];
+            }
+        }
+    }
+    memcpy(forecast->bootBytes, bootBytes, sizeof(bootBytes));
+    portEXIT_CRITICAL(&statsMux);
+    uint32_t windowSec = STORAGE_STATS_RATE_WINDOW_MIN * 60 + (nowMs % 60000) / 1000;
+    if(windowSec > nowMs / 1000) {
+        windowSec = nowMs / 1000;
+    }
+    if(windowSec == 0) {
+        windowSec = 1;
+    }
+    for(int c = 0; c < RETENTION_NUM_CATEGORIES; c++) {
+        forecast->rateBps[c] = (uint32_t)(windowBytes[c] / windowSec);
+        forecast->totalRateBps += forecast->rateBps[c];
+    }
+
+    forecast->freeBytes = sd_space_free_bytes();
+    forecast->lowWatermarkBytes = retention_low_watermark_bytes();
+    if(forecast->totalRateBps == 0) {
+        forecast->secondsToCleanup = -1;
+        forecast->secondsToFull = -1;
+        return;
+    }
+    uint64_t aboveLow = forecast->freeBytes > forecast->lowWatermarkBytes ? forecast->freeBytes - forecast->lowWatermarkBytes : 0;
+    uint64_t toCleanup = aboveLow / forecast->totalRateBps;
+    uint64_t toFull = forecast->freeBytes / forecast->totalRateBps;
+    forecast->secondsToCleanup = toCleanup > INT32_MAX ? INT32_MAX : (int32_t)toCleanup;
+    forecast->secondsToFull = toFull > INT32_MAX ? INT32_MAX : (int32_t)toFull;
+}
+
+/**
+ * @brief 获取按天统计 / Get the per-day counters
+ * @return int 天数 / Number of days
+ */
+int storage_stats_get_days(StorageDayStats *days, int maxDays) {
+    int count = 0;
+    portENTER_CRITICAL(&statsMux);
+    for(int i = 0; i < STORAGE_STATS_DAYS && count < maxDays; i++) {
+        const StorageDayStats *day = &statsFile.days[(statsFile.head + STORAGE_STATS_DAYS - i) % STORAGE_STATS_DAYS];
+        if(day->date == 0) {
+            break;
+        }
+        days[count++] = *day;
+    }
+    portEXIT_CRITICAL(&statsMux);
+    return count;
+}
+
+/**
+ * @brief 到期时保存按天统计 / Save the per-day counters when due
+ */
+void storage_stats_save_if_due(void) {
+    if(!statsDirty || millis() - statsLastSaveMs < STORAGE_STATS_SAVE_INTERVAL_MS) {
+        return;
+    }
+    StorageStatsFile *contents = (StorageStatsFile*)malloc(sizeof(StorageStatsFile));
+    if(!contents) {
+        return;
+    }
+    portENTER_CRITICAL(&statsMux);
+    *contents = statsFile;
+    statsDirty = false;
+    portEXIT_CRITICAL(&statsMux);
+    statsLastSaveMs = millis();
+
+    sd_io_begin(SD_IO_STORE);
+    File file = SD_MMC.open(STORAGE_STATS_FILE, FILE_WRITE);
+    bool ok = file && sd_io_write(file, (uint8_t*)contents, sizeof(StorageStatsFile), SD_IO_STORE) == sizeof(StorageStatsFile);
+    if(file) {
+        file.close();
+    }
+    sd_io_end(SD_IO_STORE, 0);
+    if(!ok) {
+        // 下次到期时重试 / Retry when next due
+        statsDirty = true;
+        Serial.println("Failed to write storage statistics file / 无法写入写入统计文件");
+    }
+    free(contents);
+}
@@ -0,0 +1,98 @@
+/**********************************************************************
+  文件名称 / Filename : storage_stats.h
+  文件用途 / File Purpose : SD卡写入统计与空间预测头文件 / SD Card Write Statistics and Space Forecast Header File
+               声明了按天、按分类统计写入量，计算当前写入速率并预测何时开始清理相关的函数原型和宏定义
+               Declares function prototypes and macro definitions for per-day, per-category write counters, the current write rate and the forecast of when cleanup starts
+  作者 / Author : ESP32-S3监控项目 / ESP32-S3 Monitoring Project
+  修改日期 / Modification Date : 2026-02-05
+  硬件平台 / Hardware Platform : ESP32S3-EYE开发板 / ESP32S3-EYE Development Board
+  依赖库 / Dependencies : retention.h - 分类和清理水位线 / Categories and cleanup watermarks
+               sd_space.h - 剩余空间 / Free space
+  使用说明 / Usage Instructions : 1. 包含本头文件 #include "storage_stats.h" / Include this header file
+               2. SD卡挂载后调用storage_stats_init()加载按天统计 / Call storage_stats_init() after mounting to load the per-day counters
+               3. 写入文件时调用storage_stats_add()计数 / Call storage_stats_add() when writing files
+               4. 清理任务定期调用storage_stats_save_if_due()保存 / The janitor calls storage_stats_save_if_due() periodically to save them
+  参数调整 / Parameter Adjustment : STORAGE_STATS_DAYS - 保留的按天统计天数（默认14天）/ Days of per-day counters kept (default 14)
+                  STORAGE_STATS_RATE_WINDOW_MIN - 写入速率的统计窗口（默认10分钟）/ Write rate window (default 10 minutes)
+  注意事项 / Important Notes : 计数只在内存中累加，不扫描SD卡；按天统计在系统时间同步后才开始 / Counters only accumulate in memory and never scan the card; per-day counters start once the clock is synced
+               统计的是新增数据，旧录像压缩等原地重写不计入 / Only new data is counted, in-place rewrites such as old recording compression are not
+               文件格式：magic + 当前位置 + 定长按天统计数组 / File format: magic + head position + fixed per-day array
+**********************************************************************/
+
+#ifndef __STORAGE_STATS_H
+#define __STORAGE_STATS_H
+
+#include "Arduino.h"
+#include "retention.h"
+
+// 统计文件路径 / Statistics file path
+#define STORAGE_STATS_FILE "/camera/storage_stats.dat"
+
+// 统计文件标识 / Statistics file magic
+#define STORAGE_STATS_MAGIC 0x31535453  // 'STS1'
+
+// 保留的按天统计天数 / Days of per-day counters kept
+#define STORAGE_STATS_DAYS 14
+
+// 写入速率的统计窗口（分钟）/ Write rate window (minutes)
+#define STORAGE_STATS_RATE_WINDOW_MIN 10
+
+// 按天统计的保存间隔（毫秒）/ Save interval for the per-day counters (ms)
+#define STORAGE_STATS_SAVE_INTERVAL_MS (10 * 60 * 1000)
+
+// 一天的写入量 / One day's writes
+typedef struct {
+    uint32_t date;                                      // 日期YYYYMMDD，0表示未使用 / Date YYYYMMDD, 0 if unused
+    uint32_t reserved;                                  // 保留（对齐）/ Reserved (alignment)
+    uint64_t bytes[RETENTION_NUM_CATEGORIES];           // 各分类写入字节数 / Bytes written per category
+} StorageDayStats;
+
+// 写入速率和空间预测 / Write rate and space forecast
+typedef struct {
+    uint32_t rateBps[RETENTION_NUM_CATEGORIES];         // 各分类写入速率（字节/秒）/ Per-category write rate (bytes/s)
+    uint32_t totalRateBps;                              // 总写入速率（字节/秒）/ Total write rate (bytes/s)
+    uint64_t bootBytes[RETENTION_NUM_CATEGORIES];       // 启动以来各分类写入字节数 / Bytes written per category since boot
+    uint64_t freeBytes;                                 // 剩余空间 / Free space
+    uint64_t lowWatermarkBytes;                         // 开始清理的剩余空间 / Free space at which cleanup starts
+    int32_t secondsToCleanup;                           // 预计多少秒后开始清理，0表示已在清理，-1表示没有写入 / Seconds until cleanup starts, 0 if already due, -1 with no writes
+    int32_t secondsToFull;                              // 不清理时预计多少秒后写满，-1表示没有写入 / Seconds until the card is full without cleanup, -1 with no writes
+} StorageForecast;
+
+/**
+ * @brief 加载按天统计 / Load the per-day counters
+ * @return bool 从SD卡加载返回true，从零开始返回false / Returns true if loaded from the SD card, false if starting from zero
+ */
+bool storage_stats_init(void);
+
+/**
+ * @brief 记录写入 / Count a write
+ * @param category 分类（RETENTION_VIDEO/PHOTO/DERIVED）/ Category (RETENTION_VIDEO/PHOTO/DERIVED)
+ * @param bytes 写入字节数 / Bytes written
+ * @note 只更新内存计数，可在录像任务中调用 / Only updates in-memory counters, safe to call from the recording task
+ */
+void storage_stats_add(int category, uint32_t bytes);
+
+/**
+ * @brief 获取写入速率和空间预测 / Get the write rate and space forecast
+ * @param forecast 输出预测 / Output forecast
+ * @details 功能说明 / Function Description:
+ *          1. 按最近STORAGE_STATS_RATE_WINDOW_MIN分钟的写入量计算速率 / Compute the rate from the writes in the last STORAGE_STATS_RATE_WINDOW_MIN minutes
+ *          2. 按剩余空间与低水位线之差除以速率预测开始清理的时间 / Divide the free space above the low watermark by the rate to forecast when cleanup starts
+ */
+void storage_stats_forecast(StorageForecast *forecast);
+
+/**
+ * @brief 获取按天统计 / Get the per-day counters
+ * @param days 输出数组（最新的在前）/ Output array (newest first)
+ * @param maxDays 数组容量 / Array capacity
+ * @return int 天数 / Number of days
+ */
+int storage_stats_get_days(StorageDayStats *days, int maxDays);
+
+/**
+ * @brief 到期时保存按天统计 / Save the per-day counters when due
+ * @note 有新写入且距上次保存超过STORAGE_STATS_SAVE_INTERVAL_MS时整体重写文件 / Rewrites the whole file when there are new writes and STORAGE_STATS_SAVE_INTERVAL_MS has passed since the last save
+ */
+void storage_stats_save_if_due(void);
+
+#endif // __STORAGE_STATS_H
@@ -0,0 +1,427 @@
+/**********************************************************************
+  文件名称 / Filename : stream_clients.cpp
+  文件用途 / File Purpose : 多客户端视频流实现文件 / Multi-Client Video Stream Implementation File
+               本文件实现了每个视频流客户端一个发送任务的MJPEG推送
+               This file implements MJPEG pushing with one sender task per stream client
+               主要功能包括 / Main Features:
+               1. 客户端位置分配 / Client slot allocation
+               2. 异步请求和发送任务 / Asynchronous requests and sender tasks
+               3. 每个客户端的帧率、码率限速 / Per-client frame rate and bit rate limits
+               4. 每个客户端的帧率、丢帧数和发送字节数统计 / Per-client frame rate, dropped frames and bytes sent
+               5. 不分块的multipart响应，每帧一次writev()发出 / Multipart response without chunking, one writev() per frame
+               6. 复制帧后立即释放，发送不占用帧缓冲 / Frames are copied and released at once, sending never holds a frame buffer
+  作者 / Author : ESP32-S3监控项目 / ESP32-S3 Monitoring Project
+  修改日期 / Modification Date : 2026-02-05
+  硬件平台 / Hardware Platform : ESP32S3-EYE开发板 / ESP32S3-EYE Development Board
+  依赖库 / Dependencies : esp_http_server.h - 异步请求 / Asynchronous requests
+               lwip/sockets.h - writev()
+               img_converters.h - 非JPEG格式转换 / Conversion of non-JPEG formats
+  使用说明 / Usage Instructions : 1. 调用stream_clients_init()初始化 / Call stream_clients_init() to initialise
+  注意事项 / Important Notes : 发送任务结束时调用httpd_req_async_handler_complete()把连接交还服务器 / The sender task hands the connection back with httpd_req_async_handler_complete() when it ends
+               发送前帧已复制到客户端缓冲并释放，慢客户端不占用帧缓冲 / Frames are copied to the client buffer and released before sending, a slow client holds no frame buffer
+**********************************************************************/
+
+#include "stream_clients.h"
+#include "frame_broker.h"
+#include "img_converters.h"
+#include "esp_timer.h"
+#include <lwip/sockets.h>
+
+#define PART_BOUNDARY "123456789000000000000987654321"
+#define STREAM_CONTENT_TYPE "multipart/x-mixed-replace;boundary=" PART_BOUNDARY
+#if STREAM_SINGLE_WRITE
+// 自己写出响应头，没有Transfer-Encoding，结束时关闭连接 / The response head is written here, no Transfer-Encoding, the connection closes at the end
+static const char *STREAM_HEAD = "HTTP/1.1 200 OK\r\nContent-Type: " STREAM_CONTENT_TYPE "\r\n"
+                                 "Access-Control-Allow-Origin: *\r\nX-Framerate: %lu\r\nConnection: close\r\n\r\n";
+// 分隔符和分段头合在一起 / Boundary and part header in one piece
+static const char *STREAM_PART = "\r\n--" PART_BOUNDARY "\r\n"
+                                 "Content-Type: image/jpeg\r\nContent-Length: %u\r\nX-Timestamp: %d.%06d\r\n\r\n";
+#else
+static const char *STREAM_BOUNDARY = "\r\n--" PART_BOUNDARY "\r\n";
+static const char *STREAM_PART = "Content-Type: image/jpeg\r\nContent-Length: %u\r\nX-Timestamp: %d.%06d\r\n\r\n";
+#endif
+
+#ifdef CONFIG_LED_ILLUMINATOR_ENABLED
+// 补光灯由app_httpd.cpp控制 / The illuminator is driven by app_httpd.cpp
+extern bool isStreaming;
+void enable_led(bool en);
+#endif
+
+// 客户端位置 / Client slot
+typedef struct {
+    bool used;                          // 是否占用 / Whether taken
+    httpd_req_t *req;                   // 异步请求 / Asynchronous request
+    StreamClientStats stats;            // 统计 / Statistics
+    uint32_t fpsFrames;                 // 本秒开始时的帧数 / Frames at the start of this second
+    uint32_t fpsStartMs;                // 本秒开始时间 / Start of this second
+} StreamClient;
+
+static StreamClient streamClients[STREAM_MAX_CLIENTS];
+static uint32_t nextClientId = 1;
+static portMUX_TYPE clientsMux = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief 释放客户端位置 / Free a client slot
+ * @return int 剩余的客户端数 / Clients left
+ */
+static int release_slot(StreamClient *client) {
+    int active = 0;
+    portENTER_CRITICAL(&clientsMux);
+    client->used = false;
+    for(int i = 0; i < STREAM_MAX_CLIENTS; i++) {
+        if(streamClients[i].used) {
+            active++;
+        }
+    }
+    portEXIT_CRITICAL(&clientsMux);
+    return active;
+}
+
+/**
+ * @brief 记录一帧 / Count one frame
+ * @param gap 取这一帧时跳过的帧数 / Frames skipped when taking this frame
+ * @param backlog 其中在上一帧发送期间到达的帧数 / Of those, frames that arrived while the previous one was being sent
+ */
+static void count_frame(StreamClient *client, size_t bytes, uint32_t gap, uint32_t backlog, uint32_t sendUs, uint32_t writes,
+                        uint32_t latencyUs) {
+    uint32_t now = millis();
+    // 不限速时跳过的帧都是发送慢造成的 / Without limits every skipped frame is down to slow sending
+    bool limited = client->stats.limits.maxFps || client->stats.limits.maxKbps;
+    uint32_t dropped = limited && backlog < gap ? backlog : gap;
+    portENTER_CRITICAL(&clientsMux);
+    StreamClientStats *stats = &client->stats;
+    stats->frames++;
+    stats->bytes += bytes;
+    stats->skipped += gap;
+    stats->dropped += dropped;
+    stats->capped += gap - dropped;
+    stats->sendUs += sendUs;
+    stats->writes += writes;
+    stats->latencyUs += latencyUs;
+    if(now - client->fpsStartMs >= 1000) {
+        stats->fps = (stats->frames - client->fpsFrames) * 1000.0f / (now - client->fpsStartMs);
+        client->fpsFrames = stats->frames;
+        client->fpsStartMs = now;
+    }
+    portEXIT_CRITICAL(&clientsMux);
+}
+
+/**
+ * @brief 记录一个因缓冲不足丢弃的帧 / Count a frame dropped for lack of buffer
+ */
+static void count_dropped(StreamClient *client) {
+    portENTER_CRITICAL(&clientsMux);
+    client->stats.skipped++;
+    client->stats.dropped++;
+    portEXIT_CRITICAL(&clientsMux);
+}
+
+#if STREAM_SINGLE_WRITE
+/**
+ * @brief 发送响应头 / Send the response head
+ * @return esp_err_t 成功返回ESP_OK / ESP_OK on success
+ */
+static esp_err_t send_head(httpd_req_t *req, uint32_t framerate) {
+    char head[256];
+    struct iovec iov;
+    uint32_t writes = 0;
+    iov.iov_base = head;
+    iov.iov_len = snprintf(head, sizeof(head), STREAM_HEAD, (unsigned long)framerate);
+    return stream_send_iov(httpd_req_to_sockfd(req), &iov, 1, &writes);
+}
+
+/**
+ * @brief 发送一帧 / Send one frame
+ * @param writes 累加socket写入次数 / Adds up the socket writes
+ * @return esp_err_t 成功返回ESP_OK / ESP_OK on success
+ * @note 分段头和帧数据一次writev()写出 / Part header and frame go out in one writev()
+ */
+static esp_err_t send_frame(httpd_req_t *req, const uint8_t *jpg, size_t len, const struct timeval *timestamp, uint32_t *writes) {
+    char part[160];
+    struct iovec iov[2];
+    iov[0].iov_base = part;
+    iov[0].iov_len = snprintf(part, sizeof(part), STREAM_PART, len, timestamp->tv_sec, timestamp->tv_usec);
+    iov[1].iov_base = (void*)jpg;
+    iov[1].iov_len = len;
+    return stream_send_iov(httpd_req_to_sockfd(req), iov, 2, writes);
+}
+#else
+/**
+ * @brief 发送一帧 / Send one frame
+ * @param writes 累加socket写入次数 / Adds up the socket writes
+ * @return esp_err_t 成功返回ESP_OK / ESP_OK on success
+ * @note 每个分块写3次：长度行、数据、结尾换行 / Each chunk is 3 writes: size line, data, trailing CRLF
+ */
+static esp_err_t send_frame(httpd_req_t *req, const uint8_t *jpg, size_t len, const struct timeval *timestamp, uint32_t *writes) {
+    char part[128];
+    esp_err_t res = httpd_resp_send_chunk(req, STREAM_BOUNDARY, strlen(STREAM_BOUNDARY));
+    if(res == ESP_OK) {
+        size_t hlen = snprintf(part, sizeof(part), STREAM_PART, len, timestamp->tv_sec, timestamp->tv_usec);
+        res = httpd_resp_send_chunk(req, part, hlen);
+    }
+    if(res == ESP_OK) {
+        res = httpd_resp_send_chunk(req, (const char*)jpg, len);
+    }
+    *writes += 9;
+    return res;
+}
+#endif
+
+/**
+ * @brief 下一帧最早的发送时间 / Earliest time to send the next frame
+ * @param sendStartMs 本帧开始发送的时间 / When this frame started sending
+ * @param len 本帧长度 / Length of this frame
+ */
+static uint32_t next_send_ms(const StreamClientLimits *limits, uint32_t sendStartMs, size_t len) {
+    uint32_t interval = 0;
+    if(limits->maxFps) {
+        interval = 1000 / limits->maxFps;
+    }
+    if(limits->maxKbps) {
+        // 字节数 × 8 / kbit/s = 毫秒 / Bytes × 8 / kbit/s = milliseconds
+        uint32_t byRate = (uint32_t)((uint64_t)len * 8 / limits->maxKbps);
+        if(byRate > interval) {
+            interval = byRate;
+        }
+    }
+    return sendStartMs + interval;
+}
+
+/**
+ * @brief 已发布的最新帧序号 / Sequence number of the newest published frame
+ */
+static uint32_t latest_seq(void) {
+    FrameBrokerStats broker;
+    frame_broker_get_stats(&broker);
+    return broker.published;
+}
+
+/**
+ * @brief 发送任务 / Sender task
+ * @param pvParameters 客户端位置 / Client slot
+ */
+static void stream_client_task(void *pvParameters) {
+    StreamClient *client = (StreamClient*)pvParameters;
+    httpd_req_t *req = client->req;
+    const StreamClientLimits limits = client->stats.limits;
+    FrameSubscriber sub;
+    frame_broker_subscribe(&sub);
+    StreamFrameBuf frameBuf = {NULL, 0};
+
+    uint32_t framerate = limits.maxFps ? limits.maxFps : STREAM_MAX_FPS;
+#if STREAM_SINGLE_WRITE
+    esp_err_t res = send_head(req, framerate);
+#else
+    // 响应头在第一次发送时才写出，字符串要保留到那时 / Headers go out with the first send, the string has to live until then
+    char framerateHdr[8];
+    snprintf(framerateHdr, sizeof(framerateHdr), "%lu", (unsigned long)framerate);
+    httpd_resp_set_type(req, STREAM_CONTENT_TYPE);
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    httpd_resp_set_hdr(req, "X-Framerate", framerateHdr);
+    esp_err_t res = ESP_OK;
+#endif
+
+    uint32_t nextSendMs = millis();
+    uint32_t backlog = 0;
+    while(res == ESP_OK) {
+        // 限速：等到允许发送下一帧时再取帧，等待期间的帧直接跳过 / Limits: take the next frame only once it may be sent, frames during the wait are skipped outright
+        int32_t wait = (int32_t)(nextSendMs - millis());
+        if(wait > 0) {
+            vTaskDelay(pdMS_TO_TICKS(wait));
+        }
+
+        // 取最新帧，发送慢时中间的帧被跳过 / Take the newest frame, frames in between are skipped when sending is slow
+        uint32_t skippedBefore = sub.skipped;
+        camera_fb_t *fb = frame_broker_acquire(&sub, STREAM_FRAME_TIMEOUT_MS);
+        if(!fb) {
+            Serial.printf("Stream client %lu: no frame / 视频流客户端取不到帧\n", (unsigned long)client->stats.id);
+            break;
+        }
+        // 复制后立即释放帧，发送阻塞时不占用帧缓冲 / Copy and release the frame at once so a blocked send holds no frame buffer
+        struct timeval timestamp;
+        size_t len = stream_copy_frame(fb, &frameBuf, &timestamp);
+        if(len == 0) {
+            count_dropped(client);
+            continue;
+        }
+        uint32_t sendStartMs = millis();
+        int64_t sendStartUs = esp_timer_get_time();
+        uint32_t writes = 0;
+        res = send_frame(req, frameBuf.data, len, &timestamp, &writes);
+        int64_t sendEndUs = esp_timer_get_time();
+        uint32_t sendUs = (uint32_t)(sendEndUs - sendStartUs);
+        // 帧时间戳取自esp_timer，与发送完成时间相减即端到端延迟 / Frame timestamps come from esp_timer, so the difference to send completion is the end-to-end latency
+        int64_t latencyUs = sendEndUs - ((int64_t)timestamp.tv_sec * 1000000LL + timestamp.tv_usec);
+        if(res == ESP_OK) {
+            count_frame(client, len, sub.skipped - skippedBefore, backlog, sendUs, writes,
+                        latencyUs > 0 ? (uint32_t)latencyUs : 0);
+            // 发送期间到达的帧下次取帧时会被跳过，记为丢帧 / Frames that arrived during the send are skipped next time, they count as dropped
+            backlog = latest_seq() - sub.lastSeq;
+            nextSendMs = next_send_ms(&limits, sendStartMs, len);
+        }
+    }
+
+    // 交还连接并关闭：多路复用响应没有结尾，连接不能再用 / Hand the connection back and close it: the multipart response has no end, the connection cannot be reused
+    httpd_handle_t server = req->handle;
+    int fd = httpd_req_to_sockfd(req);
+    Serial.printf("Stream client %lu ended: %lu frames, %lu dropped, %lu capped, %llu KB / 视频流客户端断开\n",
+                  (unsigned long)client->stats.id, (unsigned long)client->stats.frames, (unsigned long)client->stats.dropped,
+                  (unsigned long)client->stats.capped, (unsigned long long)(client->stats.bytes / 1024));
+    free(frameBuf.data);
+    httpd_req_async_handler_complete(req);
+    httpd_sess_trigger_close(server, fd);
+    if(release_slot(client) == 0) {
+#ifdef CONFIG_LED_ILLUMINATOR_ENABLED
+        isStreaming = false;
+        enable_led(false);
+#endif
+    }
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief 把帧复制到发送缓冲并释放帧 / Copy a frame into a send buffer and release the frame
+ * @return size_t JPEG长度，失败返回0 / JPEG length, 0 on failure
+ */
+size_t stream_copy_frame(camera_fb_t *fb, StreamFrameBuf *out, struct timeval *timestamp) {
+    *timestamp = fb->timestamp;
+    uint8_t *jpg = fb->buf;
+    size_t len = fb->len;
+    bool converted = false;
+    if(fb->format != PIXFORMAT_JPEG) {
+        converted = frame2jpg(fb, 80, &jpg, &len);
+        frame_broker_release(fb);
+        fb = NULL;
+        if(!converted) {
+            return 0;
+        }
+    }
+    if(len > out->size) {
+        // 按步长增长，减少重新分配；失败时保留原缓冲 / Grow in steps to reallocate less often; the old buffer stays on failure
+        size_t size = (len + STREAM_FRAME_BUF_STEP - 1) / STREAM_FRAME_BUF_STEP * STREAM_FRAME_BUF_STEP;
+        uint8_t *grown = (uint8_t*)(psramFound() ? ps_realloc(out->data, size) : realloc(out->data, size));
+        if(grown) {
+            out->data = grown;
+            out->size = size;
+        }
+    }
+    bool fits = len <= out->size;
+    if(fits) {
+        memcpy(out->data, jpg, len);
+    }
+    if(fb) {
+        frame_broker_release(fb);
+    }
+    if(converted) {
+        free(jpg);
+    }
+    return fits ? len : 0;
+}
+
+/**
+ * @brief 写出全部数据 / Write out all the data
+ * @return esp_err_t 成功返回ESP_OK / ESP_OK on success
+ */
+esp_err_t stream_send_iov(int fd, struct iovec *iov, int count, uint32_t *writes) {
+    while(count > 0) {
+        ssize_t sent = writev(fd, iov, count);
+        (*writes)++;
+        if(sent <= 0) {
+            return ESP_FAIL;
+        }
+        // 只写出一部分时从断点继续 / Carry on from where a partial write stopped
+        while(count > 0 && (size_t)sent >= iov->iov_len) {
+            sent -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if(count > 0) {
+            iov->iov_base = (uint8_t*)iov->iov_base + sent;
+            iov->iov_len -= sent;
+        }
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief 初始化视频流客户端管理 / Initialise stream client management
+ * @return bool 成功返回true / Returns true on success
+ */
+bool stream_clients_init(void) {
+    memset(streamClients, 0, sizeof(streamClients));
+    return true;
+}
+
+/**
+ * @brief 为请求启动发送任务 / Start a sender task for a request
+ * @return esp_err_t 成功返回ESP_OK / ESP_OK on success
+ */
+esp_err_t stream_clients_start(httpd_req_t *req, const StreamClientLimits *limits) {
+    // 占用客户端位置 / Take a client slot
+    StreamClient *client = NULL;
+    portENTER_CRITICAL(&clientsMux);
+    for(int i = 0; i < STREAM_MAX_CLIENTS; i++) {
+        if(!streamClients[i].used) {
+            client = &streamClients[i];
+            client->used = true;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&clientsMux);
+    if(!client) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    memset(&client->stats, 0, sizeof(client->stats));
+    client->stats.id = nextClientId++;
+    client->stats.startMs = millis();
+    client->stats.limits = *limits;
+    if(client->stats.limits.maxFps > STREAM_MAX_FPS) {
+        client->stats.limits.maxFps = STREAM_MAX_FPS;
+    }
+    client->fpsFrames = 0;
+    client->fpsStartMs = client->stats.startMs;
+    if(httpd_req_async_handler_begin(req, &client->req) != ESP_OK) {
+        release_slot(client);
+        return ESP_FAIL;
+    }
+
+#ifdef CONFIG_LED_ILLUMINATOR_ENABLED
+    isStreaming = true;
+    enable_led(true);
+#endif
+
+    char name[16];
+    snprintf(name, sizeof(name), "stream_%lu", (unsigned long)client->stats.id);
+    if(xTaskCreatePinnedToCore(stream_client_task, name, STREAM_TASK_STACK, client,
+                               STREAM_TASK_PRIORITY, NULL, STREAM_TASK_CORE) != pdPASS) {
+        httpd_req_async_handler_complete(client->req);
+        release_slot(client);
+        return ESP_ERR_NO_MEM;
+    }
+    Serial.printf("Stream client %lu started, fps %lu, %lu kbps / 视频流客户端已连接\n", (unsigned long)client->stats.id,
+                  (unsigned long)client->stats.limits.maxFps, (unsigned long)client->stats.limits.maxKbps);
+    return ESP_OK;
+}
+
+/**
+ * @brief 获取正在观看的客户端统计 / Get statistics of the active clients
+ * @return int 客户端数 / Number of clients
+ */
+int stream_clients_get_stats(StreamClientStats *stats, int maxClients) {
+    int count = 0;
+    uint32_t now = millis();
+    portENTER_CRITICAL(&clientsMux);
+    for(int i = 0; i < STREAM_MAX_CLIENTS && count < maxClients; i++) {
+        if(streamClients[i].used) {
+            stats[count] = streamClients[i].stats;
+            // 超过两秒没发出帧时帧率归零 / The rate reads zero once no frame has gone out for two seconds
+            if(now - streamClients[i].fpsStartMs > 2000) {
+                stats[count].fps = 0;
+            }
+            count++;
+        }
+    }
+    portEXIT_CRITICAL(&clientsMux);
+    return count;
+}
@@ -0,0 +1,130 @@
+/**********************************************************************
+  文件名称 / Filename : stream_clients.h
+  文件用途 / File Purpose : 多客户端视频流头文件 / Multi-Client Video Stream Header File
+               声明了每个视频流客户端由独立发送任务推送MJPEG、视频流服务器不被占用相关的函数原型和宏定义
+               Declares function prototypes and macro definitions for pushing MJPEG to each stream client from its own sender task, leaving the stream server free
+  作者 / Author : ESP32-S3监控项目 / ESP32-S3 Monitoring Project
+  修改日期 / Modification Date : 2026-02-05
+  硬件平台 / Hardware Platform : ESP32S3-EYE开发板 / ESP32S3-EYE Development Board
+  依赖库 / Dependencies : esp_http_server.h - 异步请求 / Asynchronous requests
+               frame_broker.h - 共用的最新帧 / Shared newest frame
+  使用说明 / Usage Instructions : 1. 包含本头文件 #include "stream_clients.h" / Include this header file
+               2. /stream处理函数验证通过后调用stream_clients_start()并立即返回 / The /stream handler calls stream_clients_start() once authenticated and returns at once
+  参数调整 / Parameter Adjustment : STREAM_MAX_CLIENTS - 同时观看的客户端上限（默认4）/ Maximum concurrent viewers (default 4)
+               STREAM_MAX_FPS - fps参数上限 / Upper bound of the fps parameter
+               STREAM_SINGLE_WRITE - 每帧一次写入（1）或旧的分块发送（0），用于对比 / One write per frame (1) or the old chunked sending (0), for comparison
+  注意事项 / Important Notes : 请求通过httpd_req_async_handler_begin()交给发送任务，服务器在发送结束前不处理该连接
+                  The request is handed to the sender task with httpd_req_async_handler_begin(), the server leaves that connection alone until sending ends
+               所有客户端从帧分发器取同一路帧，客户端数不影响取帧帧率 / All clients take frames from the frame broker, the number of clients does not change the capture rate
+               限速只决定何时取下一帧，取到的总是最新帧，网络慢时不会积压旧帧 / Limits only decide when the next frame is taken, it is always the newest one, so a slow network never builds up stale frames
+               帧先复制到每个客户端自己的缓冲（有PSRAM时放在PSRAM）并立即释放，发送最长阻塞SO_SNDTIMEO也不占用帧缓冲；缓冲分配失败时丢弃这一帧
+                  Frames are copied into each client's own buffer (in PSRAM when present) and released at once, so a send blocking for up to SO_SNDTIMEO never holds a frame buffer; a frame is dropped when the buffer cannot grow
+**********************************************************************/
+
+#ifndef __STREAM_CLIENTS_H
+#define __STREAM_CLIENTS_H
+
+#include "Arduino.h"
+#include "esp_http_server.h"
+#include "esp_camera.h"
+#include <lwip/sockets.h>
+
+// 同时观看的客户端上限 / Maximum concurrent viewers
+#define STREAM_MAX_CLIENTS 4
+
+// fps参数上限 / Upper bound of the fps parameter
+#define STREAM_MAX_FPS 60
+
+// 每帧一次写入：不分块的multipart响应，分段头和帧数据一次writev()发出
+// One write per frame: multipart response without chunking, part header and frame go out in one writev()
+// 设为0恢复每帧3个httpd_resp_send_chunk()（9次socket写入），用于对比/streams中的send_us和writes_per_frame
+// Set to 0 for the old 3 httpd_resp_send_chunk() per frame (9 socket writes), to compare send_us and writes_per_frame on /streams
+#define STREAM_SINGLE_WRITE 1
+
+// 等待新帧的超时（毫秒），超时后结束该客户端 / Timeout waiting for a new frame (ms), the client ends after it
+#define STREAM_FRAME_TIMEOUT_MS 5000
+
+// 发送任务配置 / Sender task configuration
+#define STREAM_TASK_STACK 4096
+#define STREAM_TASK_PRIORITY 4
+#define STREAM_TASK_CORE 0
+
+// 发送缓冲按此粒度增长（字节）/ Send buffers grow in steps of this size (bytes)
+#define STREAM_FRAME_BUF_STEP (16 * 1024)
+
+// 客户端发送缓冲 / Client send buffer
+typedef struct {
+    uint8_t *data;                      // 缓冲 / Buffer
+    size_t size;                        // 缓冲大小 / Buffer size
+} StreamFrameBuf;
+
+// 客户端限速，0表示不限 / Client limits, 0 for none
+typedef struct {
+    uint32_t maxFps;                    // 帧率上限 / Frame rate cap
+    uint32_t maxKbps;                   // 码率上限（kbit/s）/ Bit rate cap (kbit/s)
+} StreamClientLimits;
+
+// 客户端统计 / Client statistics
+typedef struct {
+    uint32_t id;                        // 客户端编号 / Client ID
+    uint32_t startMs;                   // 开始时间（millis）/ Start time (millis)
+    uint32_t frames;                    // 已发送帧数 / Frames sent
+    uint32_t skipped;                   // 跳过的帧数（dropped + capped）/ Frames skipped (dropped + capped)
+    uint32_t dropped;                   // 发送未完成时到达而丢弃的帧数 / Frames dropped because they arrived while the previous one was still being sent
+    uint32_t capped;                    // 因限速跳过的帧数 / Frames skipped to honour the limits
+    uint64_t bytes;                     // 已发送字节数 / Bytes sent
+    uint64_t sendUs;                    // 发送耗时合计（微秒）/ Total time spent sending (µs)
+    uint32_t writes;                    // socket写入次数 / Socket writes
+    uint64_t latencyUs;                 // 取帧到发送完成的时间合计（微秒）/ Total time from capture to send complete (µs)
+    float fps;                          // 最近一秒的发送帧率 / Send rate over the last second
+    StreamClientLimits limits;          // 限速 / Limits
+} StreamClientStats;
+
+/**
+ * @brief 初始化视频流客户端管理 / Initialise stream client management
+ * @return bool 成功返回true / Returns true on success
+ */
+bool stream_clients_init(void);
+
+/**
+ * @brief 为请求启动发送任务 / Start a sender task for a request
+ * @param req /stream请求（已验证）/ The /stream request (already authenticated)
+ * @param limits 限速 / Limits
+ * @return esp_err_t 成功返回ESP_OK，客户端已满返回ESP_ERR_NO_MEM / ESP_OK on success, ESP_ERR_NO_MEM when all client slots are taken
+ * @details 功能说明 / Function Description:
+ *          1. 占用一个客户端位置 / Take a client slot
+ *          2. 用httpd_req_async_handler_begin()复制请求 / Copy the request with httpd_req_async_handler_begin()
+ *          3. 启动发送任务，处理函数随即返回 / Start the sender task, the handler returns straight away
+ */
+esp_err_t stream_clients_start(httpd_req_t *req, const StreamClientLimits *limits);
+
+/**
+ * @brief 获取正在观看的客户端统计 / Get statistics of the active clients
+ * @param stats 输出数组 / Output array
+ * @param maxClients 数组容量 / Array capacity
+ * @return int 客户端数 / Number of clients
+ */
+int stream_clients_get_stats(StreamClientStats *stats, int maxClients);
+
+/**
+ * @brief 把帧复制到发送缓冲并释放帧 / Copy a frame into a send buffer and release the frame
+ * @param fb frame_broker_acquire()取得的帧，返回时已释放 / Frame from frame_broker_acquire(), released on return
+ * @param out 发送缓冲，按需增长，用完调用free(out->data) / Send buffer, grown as needed, free(out->data) when done
+ * @param timestamp 输出帧时间戳 / Output frame timestamp
+ * @return size_t JPEG长度，缓冲无法增长或格式转换失败时返回0（丢弃这一帧）/ JPEG length, 0 when the buffer cannot grow or the conversion fails (the frame is dropped)
+ * @note 非JPEG格式先转换再复制 / Non-JPEG formats are converted before copying
+ */
+size_t stream_copy_frame(camera_fb_t *fb, StreamFrameBuf *out, struct timeval *timestamp);
+
+/**
+ * @brief 写出全部数据 / Write out all the data
+ * @param fd 套接字 / Socket
+ * @param iov 数据段，部分写出时会被修改 / Data pieces, modified on a partial write
+ * @param count 数据段数 / Number of pieces
+ * @param writes 累加socket写入次数 / Adds up the socket writes
+ * @return esp_err_t 成功返回ESP_OK，出错或发送超时（SO_SNDTIMEO）返回ESP_FAIL / ESP_OK on success, ESP_FAIL on error or send timeout (SO_SNDTIMEO)
+ * @note 一次writev()写出多段数据，只写出一部分时从断点继续 / Writes several pieces with one writev(), carrying on from where a partial write stopped
+ */
+esp_err_t stream_send_iov(int fd, struct iovec *iov, int count, uint32_t *writes);
+
+#endif // __STREAM_CLIENTS_H
@@ -0,0 +1,167 @@
+/**********************************************************************
+  文件名称 / Filename : bench_select_oldest.cpp
+  文件用途 / File Purpose : 清理选文件性能测试工具（在电脑上运行）/ Cleanup File Selection Benchmark (runs on the host)
+               比较selectOldestFiles()的有界最大堆选择和原来的整表排序
+               Compares the bounded max-heap selection of selectOldestFiles() with the old full sort
+  作者 / Author : ESP32-S3监控项目 / ESP32-S3 Monitoring Project
+  修改日期 / Modification Date : 2026-02-05
+  使用说明 / Usage Instructions : g++ -O2 -o bench_select_oldest tools/bench_select_oldest.cpp && ./bench_select_oldest
+  注意事项 / Important Notes : 堆操作与sd_read_write.cpp中的scanOldestFiles()相同，目录遍历换成内存数组
+                  The heap code matches scanOldestFiles() in sd_read_write.cpp with the directory walk replaced by an in-memory array
+               比较次数与平台无关，耗时是电脑上的数值，只用于相对比较
+                  Comparison counts do not depend on the platform; times are host figures and only meaningful relative to each other
+**********************************************************************/
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <vector>
+
+// 与sd_read_write.h相同的文件信息 / Same file information as sd_read_write.h
+typedef struct {
+    char path[128];
+    char name[64];
+    uint64_t size;
+    time_t mtime;
+} FileInfo;
+
+// 合成目录的文件数、每次选出的文件数（100 + SD_CLEAN_PROTECTED_SLACK）、重复次数
+// Files in the synthetic directory, files selected per run (100 + SD_CLEAN_PROTECTED_SLACK), repetitions
+#define BENCH_FILES 10000
+#define BENCH_SELECT 116
+#define BENCH_RUNS 50
+
+static uint64_t comparisons = 0;
+
+static void siftDownNewest(FileInfo *heap, int count, int i) {
+    while(true) {
+        int newest = i;
+        int left = 2 * i + 1;
+        int right = left + 1;
+        if(left < count && (comparisons++, heap[left].mtime > heap[newest].mtime)) {
+            newest = left;
+        }
+        if(right < count && (comparisons++, heap[right].mtime > heap[newest].mtime)) {
+            newest = right;
+        }
+        if(newest == i) {
+            return;
+        }
+        FileInfo temp = heap[i];
+        heap[i] = heap[newest];
+        heap[newest] = temp;
+        i = newest;
+    }
+}
+
+static void siftUpNewest(FileInfo *heap, int i) {
+    while(i > 0) {
+        int parent = (i - 1) / 2;
+        comparisons++;
+        if(heap[parent].mtime >= heap[i].mtime) {
+            return;
+        }
+        FileInfo temp = heap[i];
+        heap[i] = heap[parent];
+        heap[parent] = temp;
+        i = parent;
+    }
+}
+
+/**
+ * @brief 有界选择：与scanOldestFiles()相同 / Bounded selection: same as scanOldestFiles()
+ */
+static int select_bounded(const FileInfo *dir, int n, FileInfo *files, int k) {
+    int count = 0;
+    for(int d = 0; d < n; d++) {
+        int slot = -1;
+        if(count < k) {
+            slot = count++;
+        } else if(comparisons++, dir[d].mtime < files[0].mtime) {
+            slot = 0;
+        }
+        if(slot >= 0) {
+            files[slot] = dir[d];
+            if(slot == 0) {
+                siftDownNewest(files, count, 0);
+            } else {
+                siftUpNewest(files, slot);
+            }
+        }
+    }
+    for(int end = count - 1; end > 0; end--) {
+        FileInfo temp = files[0];
+        files[0] = files[end];
+        files[end] = temp;
+        siftDownNewest(files, end, 0);
+    }
+    return count;
+}
+
+static int compare_time(const void *a, const void *b) {
+    comparisons++;
+    time_t ta = ((const FileInfo*)a)->mtime;
+    time_t tb = ((const FileInfo*)b)->mtime;
+    return (ta > tb) - (ta < tb);
+}
+
+/**
+ * @brief 原来的做法：读入全部文件，qsort后取前k个 / The old way: read every file, qsort, take the first k
+ */
+static int select_full_sort(const FileInfo *dir, int n, FileInfo *all, FileInfo *files, int k) {
+    memcpy(all, dir, n * sizeof(FileInfo));
+    qsort(all, n, sizeof(FileInfo), compare_time);
+    int count = n < k ? n : k;
+    memcpy(files, all, count * sizeof(FileInfo));
+    return count;
+}
+
+int main() {
+    std::vector<FileInfo> dir(BENCH_FILES), all(BENCH_FILES), bounded(BENCH_SELECT), sorted(BENCH_SELECT);
+    const char *orders[] = {"random", "oldest-first", "newest-first"};
+    srand(1);
+    printf("%d files, %d selected, %d runs, sizeof(FileInfo) = %zu\n", BENCH_FILES, BENCH_SELECT, BENCH_RUNS, sizeof(FileInfo));
+    for(int o = 0; o < 3; o++) {
+        // 目录顺序：随机、从旧到新、从新到旧 / Directory order: random, oldest first, newest first
+        for(int i = 0; i < BENCH_FILES; i++) {
+            time_t t = 1700000000 + (o == 0 ? rand() % (BENCH_FILES * 60) : (o == 1 ? i : BENCH_FILES - i) * 60);
+            dir[i].mtime = t;
+            dir[i].size = 1 << 20;
+            snprintf(dir[i].name, sizeof(dir[i].name), "%ld.avi", (long)t);
+            snprintf(dir[i].path, sizeof(dir[i].path), "/video/%s", dir[i].name);
+        }
+        double boundedUs = 0, sortedUs = 0;
+        uint64_t boundedCmp = 0, sortedCmp = 0;
+        for(int r = 0; r < BENCH_RUNS; r++) {
+            comparisons = 0;
+            auto t0 = std::chrono::steady_clock::now();
+            int nb = select_bounded(dir.data(), BENCH_FILES, bounded.data(), BENCH_SELECT);
+            auto t1 = std::chrono::steady_clock::now();
+            boundedCmp += comparisons;
+            comparisons = 0;
+            int ns = select_full_sort(dir.data(), BENCH_FILES, all.data(), sorted.data(), BENCH_SELECT);
+            auto t2 = std::chrono::steady_clock::now();
+            sortedCmp += comparisons;
+            boundedUs += std::chrono::duration<double, std::micro>(t1 - t0).count();
+            sortedUs += std::chrono::duration<double, std::micro>(t2 - t1).count();
+            // 两种做法必须选出同样的文件 / Both must pick the same files
+            if(nb != ns) {
+                printf("count mismatch: %d vs %d\n", nb, ns);
+                return 1;
+            }
+            for(int i = 0; i < nb; i++) {
+                if(bounded[i].mtime != sorted[i].mtime) {
+                    printf("order mismatch at %d\n", i);
+                    return 1;
+                }
+            }
+        }
+        printf("%-12s bounded: %8.1f us %7llu cmps %7zu B | full sort: %8.1f us %7llu cmps %8zu B\n", orders[o],
+               boundedUs / BENCH_RUNS, (unsigned long long)(boundedCmp / BENCH_RUNS), BENCH_SELECT * sizeof(FileInfo),
+               sortedUs / BENCH_RUNS, (unsigned long long)(sortedCmp / BENCH_RUNS), BENCH_FILES * sizeof(FileInfo));
+    }
+    return 0;
+}
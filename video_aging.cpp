@@ -0,0 +1,489 @@
+/**********************************************************************
+  文件名称 / Filename : video_aging.cpp
+  文件用途 / File Purpose : 旧录像压缩实现文件 / Old Recording Compression Implementation File
+               本文件实现了后台对旧AVI录像逐帧进行DCT域重量化的任务
+               This file implements the background task that requantizes old AVI recordings frame by frame in the DCT domain
+               主要功能包括 / Main Features:
+               1. 定期扫描视频目录，找出足够旧且未压缩的分段 / Periodically scan the video directory for old, uncompressed segments
+               2. 遍历movi中的00dc帧块并重量化 / Walk the 00dc chunks in movi and requantize them
+               3. 写入正确的idx1索引并更新文件头 / Write a correct idx1 index and update the file headers
+               4. 替换原文件并保留修改时间 / Replace the original file and keep its modification time
+               5. 统计节省字节数和转码帧率 / Track bytes saved and transcode frame rate
+  作者 / Author : ESP32-S3监控项目 / ESP32-S3 Monitoring Project
+  修改日期 / Modification Date : 2026-02-05
+  硬件平台 / Hardware Platform : ESP32S3-EYE开发板 / ESP32S3-EYE Development Board
+  依赖库 / Dependencies : SD_MMC.h - SD卡文件系统 / SD card file system
+               jpeg_requant.h - JPEG DCT域重量化 / JPEG DCT-domain requantization
+  使用说明 / Usage Instructions : 1. 调用video_aging_init()启动任务 / Call video_aging_init() to start the task
+  注意事项 / Important Notes : 所有SD卡访问按SD_IO_BULK排队，录像写入优先 / All SD card access queues as SD_IO_BULK so recording writes come first
+               先写入临时文件VIDEO_AGING_TEMP_FILE，完整写完后才替换原文件，中途断电不会损坏原录像 / Writes the temp file VIDEO_AGING_TEMP_FILE first and only replaces the original once complete, a power loss midway never damages the original recording
+               修改时间保留不变，SD卡清理仍按录制时间删除 / The modification time is preserved so SD cleanup still deletes by recording time
+**********************************************************************/
+
+#include "video_aging.h"
+#include "sd_read_write.h"
+#include "jpeg_requant.h"
+#include "bookmark.h"
+#include "catalog.h"
+#include "sd_space.h"
+#include "sd_io.h"
+#include "SD_MMC.h"
+#include <time.h>
+#include <utime.h>
+
+// 时间有效阈值（2023-11-14），NTP未同步时不处理 / Valid time threshold (2023-11-14), nothing is processed before NTP sync
+#define VIDEO_AGING_MIN_VALID_TIME 1700000000
+
+// 每次扫描的最大文件数 / Maximum files per scan
+#define VIDEO_AGING_MAX_FILES 100
+
+// 帧索引增长步长 / Frame index growth step
+#define VIDEO_AGING_INDEX_STEP 1024
+
+// 帧缓冲区（PSRAM）/ Frame buffers (PSRAM)
+static uint8_t *agingInBuf = NULL;
+static uint8_t *agingOutBuf = NULL;
+
+// 压缩统计 / Compression statistics
+static VideoAgingStats agingStats = {0};
+static portMUX_TYPE agingStatsMux = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief 更新统计 / Update statistics
+ */
+static void add_stats(uint32_t frames, uint32_t kept, uint32_t before, uint32_t after, uint32_t ms) {
+    portENTER_CRITICAL(&agingStatsMux);
+    agingStats.framesProcessed += frames;
+    agingStats.framesKept += kept;
+    agingStats.bytesBefore += before;
+    agingStats.bytesAfter += after;
+    agingStats.busyMs += ms;
+    portEXIT_CRITICAL(&agingStatsMux);
+}
+
+/**
+ * @brief 用临时文件替换原文件，任何一步断电都可恢复（调用方持有总线）/ Replace the original with the temp file so a power loss at any step can be recovered (caller holds the bus)
+ * @return bool 成功返回true，失败时原文件保持不变 / Returns true on success, the original is left in place on failure
+ */
+static bool replace_original(const char *path, const char *tmpPath) {
+    // 先记下目标路径，启动时据此恢复 / Record the target path first, boot recovery works from it
+    File journal = SD_MMC.open(VIDEO_AGING_JOURNAL_FILE, FILE_WRITE);
+    size_t len = strlen(path);
+    bool ok = journal && journal.write((const uint8_t*)path, len) == len;
+    if(journal) {
+        journal.close();
+    }
+    if(!ok || !SD_MMC.rename(path, VIDEO_AGING_BACKUP_FILE)) {
+        SD_MMC.remove(VIDEO_AGING_JOURNAL_FILE);
+        SD_MMC.remove(tmpPath);
+        return false;
+    }
+    if(!SD_MMC.rename(tmpPath, path)) {
+        SD_MMC.rename(VIDEO_AGING_BACKUP_FILE, path);
+        SD_MMC.remove(VIDEO_AGING_JOURNAL_FILE);
+        SD_MMC.remove(tmpPath);
+        return false;
+    }
+    SD_MMC.remove(VIDEO_AGING_BACKUP_FILE);
+    SD_MMC.remove(VIDEO_AGING_JOURNAL_FILE);
+    return true;
+}
+
+/**
+ * @brief 重量化一个AVI文件 / Requantize one AVI file
+ * @param path 文件路径 / File path
+ * @param mtime 原文件修改时间 / Original modification time
+ * @return bool 成功替换返回true / Returns true if the file was replaced
+ * @details 功能说明 / Function Description:
+ *          1. 复制文件头和JUNK块到临时文件 / Copy headers and the JUNK chunk into a temp file
+ *          2. 逐帧重量化，失败或未变小时写原帧 / Requantize every frame, write the original when it fails or does not shrink
+ *          3. 写idx1，回写文件头和movi大小 / Write idx1, patch headers and movi size
+ *          4. 按日志替换原文件，恢复修改时间 / Replace the original through the journal, restore mtime
+ */
+static bool requantize_file(const char *path, time_t mtime) {
+    // 打开、读文件头等少量操作一起排队 / Opening, header reads and similar small steps queue together
+    sd_io_begin(SD_IO_BULK);
+    File src = SD_MMC.open(path, FILE_READ);
+    if(!src) {
+        sd_io_end(SD_IO_BULK, 0);
+        return false;
+    }
+
+    AVI_MAIN_HEADER mainHeader;
+    AVI_STREAM_HEADER streamHeader;
+    AVI_BITMAP_INFO bitmapInfo;
+    if(!aviReadHeaders(src, &mainHeader, &streamHeader, &bitmapInfo)) {
+        src.close();
+        sd_io_end(SD_IO_BULK, 0);
+        return false;
+    }
+    if(mainHeader.reserved[AVI_RSV_REQUANT_TAG] == AVI_REQUANT_TAG) {
+        // 已压缩（如索引重建后标志丢失），补上标志下次不再打开 / Already compressed (e.g. the flag was lost in a catalog rebuild), set the flag so it is not reopened
+        catalog_update(path, 0, src.size(), CATALOG_FLAG_REQUANT);
+        src.close();
+        sd_io_end(SD_IO_BULK, 0);
+        return false;
+    }
+
+    const char *tmpPath = VIDEO_AGING_TEMP_FILE;
+    File dst = SD_MMC.open(tmpPath, FILE_WRITE);
+    if(!dst) {
+        src.close();
+        sd_io_end(SD_IO_BULK, 0);
+        Serial.printf("Video aging: failed to create %s / 创建临时文件失败\n", tmpPath);
+        return false;
+    }
+
+    // 复制文件头、JUNK和LIST movi头（大小后面回写）/ Copy headers, JUNK and the LIST movi header (sizes are patched later)
+    src.seek(0);
+    size_t headLen = src.read(agingInBuf, AVI_MOVI_DATA_OFFSET);
+    if(headLen != AVI_MOVI_DATA_OFFSET || dst.write(agingInBuf, headLen) != headLen) {
+        src.close();
+        dst.close();
+        SD_MMC.remove(tmpPath);
+        sd_io_end(SD_IO_BULK, 0);
+        return false;
+    }
+    sd_io_end(SD_IO_BULK, AVI_MOVI_DATA_OFFSET * 2);
+
+    // 每帧大小，用于写idx1 / Per-frame size, used to write idx1
+    uint32_t indexCap = mainHeader.totalFrames ? mainHeader.totalFrames : VIDEO_AGING_INDEX_STEP;
+    uint32_t *frameSizes = (uint32_t*)ps_malloc(indexCap * sizeof(uint32_t));
+    if(!frameSizes) {
+        sd_io_begin(SD_IO_BULK);
+        src.close();
+        dst.close();
+        SD_MMC.remove(tmpPath);
+        sd_io_end(SD_IO_BULK, 0);
+        return false;
+    }
+
+    uint32_t frameCount = 0;
+    uint32_t keptCount = 0;
+    uint32_t moviDataSize = 0;
+    uint32_t maxFrameSize = 0;
+    uint32_t bytesBefore = 0;
+    uint32_t bytesAfter = 0;
+    uint32_t busyMs = 0;
+    uint32_t fileStart = millis();
+    size_t fileSize = src.size();
+    size_t pos = AVI_MOVI_DATA_OFFSET;
+    bool ok = true;
+
+    src.seek(pos);
+    while(pos + 8 <= fileSize) {
+        // 读取帧块头，遇到idx1或其他块即结束 / Read the chunk header, stop at idx1 or any other chunk
+        char chunkId[4];
+        uint32_t chunkSize;
+        sd_io_begin(SD_IO_BULK);
+        bool headerRead = src.read((uint8_t*)chunkId, 4) == 4 && src.read((uint8_t*)&chunkSize, 4) == 4;
+        sd_io_end(SD_IO_BULK, 8);
+        if(!headerRead) {
+            break;
+        }
+        if(memcmp(chunkId, AVI_00DC, 4) != 0 && memcmp(chunkId, AVI_00DB, 4) != 0) {
+            break;
+        }
+        if(pos + 8 + chunkSize > fileSize) {
+            // 录制中断电留下的半帧，丢弃 / Half-written frame left by a power loss, dropped
+            break;
+        }
+        pos += 8 + chunkSize;
+
+        // 扩展帧索引 / Grow the frame index
+        if(frameCount == indexCap) {
+            uint32_t *grown = (uint32_t*)ps_realloc(frameSizes, (indexCap + VIDEO_AGING_INDEX_STEP) * sizeof(uint32_t));
+            if(!grown) {
+                ok = false;
+                break;
+            }
+            frameSizes = grown;
+            indexCap += VIDEO_AGING_INDEX_STEP;
+        }
+
+        const uint8_t *outData = NULL;
+        size_t outLen = 0;
+        if(chunkSize <= VIDEO_AGING_MAX_FRAME_SIZE) {
+            if(sd_io_read(src, agingInBuf, chunkSize, SD_IO_BULK) != chunkSize) {
+                ok = false;
+                break;
+            }
+            uint32_t t0 = millis();
+            bool requantized = jpeg_requantize(agingInBuf, chunkSize, agingOutBuf, VIDEO_AGING_MAX_FRAME_SIZE, &outLen, VIDEO_AGING_SCALE_PERCENT);
+            busyMs += millis() - t0;
+            if(requantized && outLen < chunkSize) {
+                outData = agingOutBuf;
+            } else {
+                outData = agingInBuf;
+                outLen = chunkSize;
+                keptCount++;
+            }
+        } else {
+            // 超大帧分块原样复制 / Oversized frames are copied as is in blocks
+            keptCount++;
+        }
+
+        uint32_t newSize = outData ? outLen : chunkSize;
+        uint8_t chunkHeader[8];
+        memcpy(chunkHeader, AVI_00DC, 4);
+        memcpy(chunkHeader + 4, &newSize, 4);
+        bool written = sd_io_write(dst, chunkHeader, 8, SD_IO_BULK) == 8;
+        if(outData) {
+            written = written && sd_io_write(dst, outData, outLen, SD_IO_BULK) == outLen;
+        } else {
+            uint32_t left = chunkSize;
+            while(written && left > 0) {
+                size_t n = left > VIDEO_AGING_MAX_FRAME_SIZE ? VIDEO_AGING_MAX_FRAME_SIZE : left;
+                written = sd_io_read(src, agingInBuf, n, SD_IO_BULK) == n && sd_io_write(dst, agingInBuf, n, SD_IO_BULK) == n;
+                left -= n;
+            }
+        }
+        if(!written) {
+            ok = false;
+            break;
+        }
+
+        frameSizes[frameCount++] = newSize;
+        moviDataSize += newSize + 8;
+        if(newSize > maxFrameSize) {
+            maxFrameSize = newSize;
+        }
+        bytesBefore += chunkSize;
+        bytesAfter += newSize;
+
+        // 让出SD卡和CPU / Yield the SD card and the CPU
+        vTaskDelay(pdMS_TO_TICKS(VIDEO_AGING_FRAME_YIELD_MS));
+    }
+    sd_io_begin(SD_IO_BULK);
+    src.close();
+    sd_io_end(SD_IO_BULK, 0);
+
+    if(ok && frameCount > 0) {
+        // 写入idx1索引，偏移相对于movi标识；在输出缓冲中攒成整块再写 / Write the idx1 index, offsets are relative to the movi fourcc; entries are gathered in the output buffer and written in blocks
+        uint32_t idx1Size = frameCount * sizeof(AVI_INDEX_ENTRY);
+        memcpy(agingOutBuf, AVI_IDX1, 4);
+        memcpy(agingOutBuf + 4, &idx1Size, 4);
+        size_t used = 8;
+        uint32_t offset = 4;
+        for(uint32_t i = 0; ok && i < frameCount; i++) {
+            AVI_INDEX_ENTRY entry;
+            memcpy(entry.id, AVI_00DC, 4);
+            entry.flags = frameSizes[i] ? 0x10 : 0; // AVIIF_KEYFRAME, gap frames are empty
+            entry.offset = offset;
+            entry.size = frameSizes[i];
+            memcpy(agingOutBuf + used, &entry, sizeof(entry));
+            used += sizeof(entry);
+            offset += frameSizes[i] + 8;
+            if(used + sizeof(entry) > VIDEO_AGING_MAX_FRAME_SIZE || i == frameCount - 1) {
+                ok = sd_io_write(dst, agingOutBuf, used, SD_IO_BULK) == used;
+                used = 0;
+            }
+        }
+    }
+    free(frameSizes);
+
+    if(ok && frameCount > 0) {
+        // 回写文件头，标记已压缩 / Patch the headers and tag the file as compressed
+        aviUpdateHeaders(&mainHeader, &streamHeader, frameCount, moviDataSize, maxFrameSize);
+        mainHeader.reserved[AVI_RSV_REQUANT_TAG] = AVI_REQUANT_TAG;
+        mainHeader.reserved[AVI_RSV_REQUANT_SCALE] = VIDEO_AGING_SCALE_PERCENT;
+        uint32_t moviListSize = moviDataSize + 4;
+        sd_io_begin(SD_IO_BULK);
+        dst.seek(0);
+        ok = dst.write((uint8_t*)&mainHeader, sizeof(AVI_MAIN_HEADER)) == sizeof(AVI_MAIN_HEADER) &&
+             dst.write((uint8_t*)&streamHeader, sizeof(AVI_STREAM_HEADER)) == sizeof(AVI_STREAM_HEADER);
+        dst.seek(AVI_MOVI_SIZE_OFFSET);
+        ok = ok && dst.write((uint8_t*)&moviListSize, 4) == 4;
+        sd_io_end(SD_IO_BULK, sizeof(AVI_MAIN_HEADER) + sizeof(AVI_STREAM_HEADER) + 4);
+    }
+
+    // 关闭、替换、更新索引和修改时间一起排队 / Closing, the swap, the catalog update and the mtime restore queue together
+    sd_io_begin(SD_IO_BULK);
+    dst.close();
+
+    // 原文件已被SD清理删除时放弃 / Give up if SD cleanup deleted the original meanwhile
+    if(!ok || frameCount == 0 || !SD_MMC.exists(path)) {
+        SD_MMC.remove(tmpPath);
+        sd_io_end(SD_IO_BULK, 0);
+        return false;
+    }
+
+    // 替换原文件 / Replace the original file
+    if(!replace_original(path, tmpPath)) {
+        sd_io_end(SD_IO_BULK, 0);
+        Serial.printf("Video aging: failed to replace %s / 替换文件失败\n", path);
+        return false;
+    }
+
+    // 更新空间统计和索引中的大小和标志 / Update the space accounting and the size and flags in the catalog
+    uint32_t newSize = AVI_MOVI_DATA_OFFSET + moviDataSize + 8 + frameCount * sizeof(AVI_INDEX_ENTRY);
+    sd_space_file_resized(fileSize, newSize);
+    catalog_update(path, 0, newSize, CATALOG_FLAG_REQUANT);
+
+    // 恢复修改时间，保持清理顺序 / Restore the modification time to keep cleanup order
+    char vfsPath[160];
+    snprintf(vfsPath, sizeof(vfsPath), "%s%s", SD_MOUNT_POINT, path);
+    struct utimbuf times;
+    times.actime = mtime;
+    times.modtime = mtime;
+    utime(vfsPath, &times);
+    sd_io_end(SD_IO_BULK, 0);
+
+    add_stats(frameCount, keptCount, bytesBefore, bytesAfter, busyMs);
+    portENTER_CRITICAL(&agingStatsMux);
+    agingStats.filesProcessed++;
+    portEXIT_CRITICAL(&agingStatsMux);
+
+    uint32_t wallMs = millis() - fileStart;
+    Serial.printf("Video aging: %s, %lu frames, %lu -> %lu bytes (%lu%%), %.1f fps transcode, %.1f fps overall\n",
+                  path, (unsigned long)frameCount, (unsigned long)bytesBefore, (unsigned long)bytesAfter,
+                  (unsigned long)(bytesBefore ? (uint64_t)bytesAfter * 100 / bytesBefore : 100),
+                  busyMs ? frameCount * 1000.0f / busyMs : 0.0f, wallMs ? frameCount * 1000.0f / wallMs : 0.0f);
+    return true;
+}
+
+/**
+ * @brief 扫描视频目录并压缩足够旧的分段 / Scan the video directory and compress old enough segments
+ * @return int 本次压缩的文件数 / Number of files compressed in this pass
+ */
+static int aging_scan(void) {
+    time_t now = time(NULL);
+    if(now < VIDEO_AGING_MIN_VALID_TIME) {
+        return 0;
+    }
+
+    FileInfo *files = (FileInfo*)ps_malloc(VIDEO_AGING_MAX_FILES * sizeof(FileInfo));
+    if(!files) {
+        return 0;
+    }
+    // 索引可用时只取够旧且未压缩的文件，避免反复打开已压缩的文件 / With the catalog only old enough, uncompressed files are fetched, so compressed ones are not reopened every pass
+    int fileCount = catalog_query(VIDEO_DIR, 0, (uint32_t)(now - (time_t)VIDEO_AGING_MIN_AGE_HOURS * 3600),
+                                  CATALOG_FLAG_REQUANT | CATALOG_FLAG_OPEN, files, VIDEO_AGING_MAX_FILES);
+    if(fileCount < 0) {
+        fileCount = getFileInfoList(VIDEO_DIR, files, VIDEO_AGING_MAX_FILES);
+    }
+    if(fileCount > 0) {
+        sortFilesByTime(files, fileCount, true);
+    }
+
+    int processed = 0;
+    for(int i = 0; i < fileCount; i++) {
+        size_t nameLen = strlen(files[i].name);
+        if(nameLen < 4 || strcmp(files[i].name + nameLen - 4, ".avi") != 0) {
+            continue;
+        }
+        if(now - files[i].mtime < (time_t)VIDEO_AGING_MIN_AGE_HOURS * 3600) {
+            break; // 已按时间升序排序，后面的更新 / Sorted oldest first, the rest are newer
+        }
+        // 跳过正在录制的文件 / Skip the file being recorded
+        if(isRecordingVideo() && strcmp(files[i].path, getCurrentVideoFilename()) == 0) {
+            continue;
+        }
+        // 书签保护的分段保留原画质 / Bookmarked segments keep their original quality
+        if(bookmark_is_segment_protected(files[i].name)) {
+            continue;
+        }
+
+        portENTER_CRITICAL(&agingStatsMux);
+        agingStats.running = true;
+        portEXIT_CRITICAL(&agingStatsMux);
+        if(requantize_file(files[i].path, files[i].mtime)) {
+            processed++;
+        }
+        portENTER_CRITICAL(&agingStatsMux);
+        agingStats.running = false;
+        portEXIT_CRITICAL(&agingStatsMux);
+    }
+
+    free(files);
+    return processed;
+}
+
+/**
+ * @brief 按日志恢复上次断电时未完成的替换 / Recover a swap that a power loss interrupted, using the journal
+ * @details 有备份而原路径不存在时把备份改回原文件；其余情况原路径上已是完整文件，只删除残留
+ *          With a backup and nothing at the original path the backup is renamed back; otherwise the original path already holds a complete file and only leftovers are removed
+ */
+static void recover_interrupted_swap(void) {
+    sd_io_begin(SD_IO_BULK);
+    if(SD_MMC.exists(VIDEO_AGING_JOURNAL_FILE)) {
+        char path[128] = {0};
+        File journal = SD_MMC.open(VIDEO_AGING_JOURNAL_FILE, FILE_READ);
+        if(journal) {
+            journal.read((uint8_t*)path, sizeof(path) - 1);
+            journal.close();
+        }
+        if(path[0] && SD_MMC.exists(VIDEO_AGING_BACKUP_FILE)) {
+            if(SD_MMC.exists(path)) {
+                SD_MMC.remove(VIDEO_AGING_BACKUP_FILE);
+            } else if(SD_MMC.rename(VIDEO_AGING_BACKUP_FILE, path)) {
+                Serial.printf("Video aging: restored %s after power loss / 断电后已恢复原文件\n", path);
+            }
+        }
+        if(!SD_MMC.exists(VIDEO_AGING_BACKUP_FILE)) {
+            SD_MMC.remove(VIDEO_AGING_JOURNAL_FILE);
+        }
+    }
+    // 替换开始前断电：原文件未动，临时文件作废 / Power lost before the swap: the original is untouched, the temp file is void
+    if(SD_MMC.exists(VIDEO_AGING_TEMP_FILE)) {
+        SD_MMC.remove(VIDEO_AGING_TEMP_FILE);
+    }
+    sd_io_end(SD_IO_BULK, 0);
+}
+
+/**
+ * @brief 旧录像压缩任务 / Old recording compression task
+ */
+static void video_aging_task(void *pvParameters) {
+    Serial.printf("Video aging task started on core %d / 旧录像压缩任务已启动\n", xPortGetCoreID());
+    recover_interrupted_swap();
+    while(true) {
+        int processed = aging_scan();
+        if(processed > 0) {
+            VideoAgingStats stats;
+            video_aging_get_stats(&stats);
+            Serial.printf("Video aging: %d file(s) this pass, %llu KB saved in total / 本轮压缩 %d 个文件\n",
+                          processed, (stats.bytesBefore - stats.bytesAfter) / 1024, processed);
+        }
+        vTaskDelay(pdMS_TO_TICKS(VIDEO_AGING_SCAN_INTERVAL_MS));
+    }
+}
+
+/**
+ * @brief 启动旧录像压缩任务 / Start the old recording compression task
+ * @return bool 成功返回true / Returns true on success
+ */
+bool video_aging_init(void) {
+    agingInBuf = (uint8_t*)ps_malloc(VIDEO_AGING_MAX_FRAME_SIZE);
+    agingOutBuf = (uint8_t*)ps_malloc(VIDEO_AGING_MAX_FRAME_SIZE);
+    if(!agingInBuf || !agingOutBuf) {
+        Serial.println("Video aging: PSRAM allocation failed / PSRAM分配失败");
+        free(agingInBuf);
+        free(agingOutBuf);
+        agingInBuf = NULL;
+        agingOutBuf = NULL;
+        return false;
+    }
+    return xTaskCreatePinnedToCore(video_aging_task, "video_aging", VIDEO_AGING_TASK_STACK, NULL,
+                                   VIDEO_AGING_TASK_PRIORITY, NULL, VIDEO_AGING_TASK_CORE) == pdPASS;
+}
+
+/**
+ * @brief 获取压缩统计 / Get compression statistics
+ * @param stats 统计输出 / Statistics output
+ */
+void video_aging_get_stats(VideoAgingStats *stats) {
+    portENTER_CRITICAL(&agingStatsMux);
+    *stats = agingStats;
+    portEXIT_CRITICAL(&agingStatsMux);
+}
+
+/**
+ * @brief 获取转码吞吐量（帧/秒）/ Get transcode throughput (frames per second)
+ * @return float 累计转码帧数 / 累计转码耗时 / Accumulated frames / accumulated transcode time
+ */
+float video_aging_get_fps(void) {
+    VideoAgingStats stats;
+    video_aging_get_stats(&stats);
+    return stats.busyMs ? stats.framesProcessed * 1000.0f / stats.busyMs : 0.0f;
+}
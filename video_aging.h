@@ -0,0 +1,89 @@
+/**********************************************************************
+  文件名称 / Filename : video_aging.h
+  文件用途 / File Purpose : 旧录像压缩头文件 / Old Recording Compression Header File
+               声明了后台旧录像DCT域重量化任务相关的函数原型和宏定义
+               Declares function prototypes and macro definitions for the background DCT-domain requantization of old recordings
+  作者 / Author : ESP32-S3监控项目 / ESP32-S3 Monitoring Project
+  修改日期 / Modification Date : 2026-02-05
+  硬件平台 / Hardware Platform : ESP32S3-EYE开发板 / ESP32S3-EYE Development Board
+  依赖库 / Dependencies : Arduino.h - Arduino核心库 / Arduino Core Library
+               sd_read_write.h - AVI格式与SD卡操作 / AVI format and SD card operations
+               jpeg_requant.h - JPEG DCT域重量化 / JPEG DCT-domain requantization
+  使用说明 / Usage Instructions : 1. 包含本头文件 #include "video_aging.h" / Include this header file
+               2. SD卡初始化后调用video_aging_init()启动后台任务 / Call video_aging_init() after SD card init to start the background task
+               3. 调用video_aging_get_stats()获取统计 / Call video_aging_get_stats() to read statistics
+  参数调整 / Parameter Adjustment : VIDEO_AGING_MIN_AGE_HOURS - 视频多旧才压缩（默认24小时）/ How old a video must be before compression (default 24 hours)
+               VIDEO_AGING_SCALE_PERCENT - 量化步长放大百分比（默认200）/ Quantization step scale in percent (default 200)
+               VIDEO_AGING_TASK_CORE - 任务运行的核心（默认0，录制在核心1）/ Core the task runs on (default 0, recording runs on core 1)
+  注意事项 / Important Notes : 已压缩的文件在avih.reserved[0]中写入AVI_REQUANT_TAG，不会重复处理 / Compressed files carry AVI_REQUANT_TAG in avih.reserved[0] and are never processed twice
+               单帧转码失败时保留原始帧 / A frame that fails to transcode is kept as is
+               替换顺序：写日志 → 原文件改名为备份 → 临时文件改名为原文件 → 删除备份和日志；启动时按日志恢复，断电不会丢失录像
+                  Swap order: write the journal, rename the original to the backup, rename the temp file over the original, remove backup and journal; boot recovers from the journal, so a power loss never loses the recording
+**********************************************************************/
+
+#ifndef __VIDEO_AGING_H
+#define __VIDEO_AGING_H
+
+#include "Arduino.h"
+
+// 视频多旧才压缩（小时）/ Minimum video age before compression (hours)
+#define VIDEO_AGING_MIN_AGE_HOURS 24
+
+// 量化步长放大百分比 / Quantization step scale in percent
+#define VIDEO_AGING_SCALE_PERCENT 200
+
+// 扫描间隔（毫秒）/ Scan interval (ms)
+#define VIDEO_AGING_SCAN_INTERVAL_MS (10 * 60 * 1000)
+
+// 每处理一帧后的让步延时（毫秒），给录制和Web服务让出SD卡 / Yield delay after each frame (ms), leaves the SD card to recording and web serving
+#define VIDEO_AGING_FRAME_YIELD_MS 2
+
+// 单帧最大大小（字节），超过则原样复制 / Maximum frame size (bytes), larger frames are copied as is
+#define VIDEO_AGING_MAX_FRAME_SIZE (512 * 1024)
+
+// 临时文件（放在CAMERA_DIR，清理录像时不会碰到）/ Temp file (kept in CAMERA_DIR so video cleanup never touches it)
+#define VIDEO_AGING_TEMP_FILE CAMERA_DIR "/aging.tmp"
+
+// 替换期间的原文件备份和记录目标路径的日志 / Backup of the original during the swap, and the journal holding the target path
+#define VIDEO_AGING_BACKUP_FILE CAMERA_DIR "/aging.bak"
+#define VIDEO_AGING_JOURNAL_FILE CAMERA_DIR "/aging.jnl"
+
+// 任务参数 / Task parameters
+#define VIDEO_AGING_TASK_CORE 0
+#define VIDEO_AGING_TASK_PRIORITY 1
+#define VIDEO_AGING_TASK_STACK 6144
+
+// 压缩统计 / Compression statistics
+typedef struct {
+    uint32_t filesProcessed;     // 已压缩文件数 / Files compressed
+    uint32_t framesProcessed;    // 已转码帧数 / Frames transcoded
+    uint32_t framesKept;         // 转码失败保留原样的帧数 / Frames kept as is after a transcode failure
+    uint64_t bytesBefore;        // 压缩前帧数据字节数 / Frame bytes before compression
+    uint64_t bytesAfter;         // 压缩后帧数据字节数 / Frame bytes after compression
+    uint32_t busyMs;             // 转码累计耗时（毫秒）/ Accumulated transcode time (ms)
+    bool running;                // 是否正在处理文件 / Whether a file is being processed
+} VideoAgingStats;
+
+/**
+ * @brief 启动旧录像压缩任务 / Start the old recording compression task
+ * @return bool 成功返回true / Returns true on success
+ * @details 功能说明 / Function Description:
+ *          1. 在PSRAM中分配输入输出帧缓冲区 / Allocate input and output frame buffers in PSRAM
+ *          2. 在VIDEO_AGING_TASK_CORE上创建低优先级任务 / Create a low-priority task on VIDEO_AGING_TASK_CORE
+ * @note 需要NTP时间有效才能判断文件年龄，时间无效时任务只等待 / File age needs valid NTP time, the task only waits while time is invalid
+ */
+bool video_aging_init(void);
+
+/**
+ * @brief 获取压缩统计 / Get compression statistics
+ * @param stats 统计输出 / Statistics output
+ */
+void video_aging_get_stats(VideoAgingStats *stats);
+
+/**
+ * @brief 获取转码吞吐量（帧/秒）/ Get transcode throughput (frames per second)
+ * @return float 累计转码帧数 / 累计转码耗时 / Accumulated frames / accumulated transcode time
+ */
+float video_aging_get_fps(void);
+
+#endif // __VIDEO_AGING_H
@@ -0,0 +1,499 @@
+/**********************************************************************
+  文件名称 / Filename : video_clip.cpp
+  文件用途 / File Purpose : 录像剪辑实现文件 / Recording Clip Implementation File
+               本文件实现了按时间段从多个录像分段中提取帧并生成新AVI
+               This file implements extracting frames for a time range from several recorded segments into a new AVI
+               主要功能包括 / Main Features:
+               1. 按分段idx1索引直接定位时间段内的帧 / Locate frames in range directly through each segment's idx1 index
+               2. 连续00dc块整块复制，不解码JPEG / Copy contiguous 00dc chunks as whole blocks without decoding JPEG
+               3. 生成带正确idx1的AVI，输出到回调或SD卡 / Produce an AVI with a correct idx1, to a callback or the SD card
+  作者 / Author : ESP32-S3监控项目 / ESP32-S3 Monitoring Project
+  修改日期 / Modification Date : 2026-02-05
+  硬件平台 / Hardware Platform : ESP32S3-EYE开发板 / ESP32S3-EYE Development Board
+  依赖库 / Dependencies : SD_MMC.h - SD卡文件系统 / SD card file system
+  使用说明 / Usage Instructions : 1. clip_prepare() → clip_write()/clip_save() → clip_free()
+  注意事项 / Important Notes : 帧时间 = 分段开始时间 + 帧序号 × 实际帧间隔（录制器写在avih.reserved中）/ Frame time = segment start + frame number × actual frame interval (written by the recorder in avih.reserved)
+               旧版本录制的文件没有这些字段，按文件名时间和标称帧率估算 / Files from older firmware lack these fields and are estimated from the filename time and nominal frame rate
+**********************************************************************/
+
+#include "video_clip.h"
+#include "sd_read_write.h"
+#include "catalog.h"
+#include "sd_space.h"
+#include "sd_io.h"
+#include "storage_stats.h"
+#include "SD_MMC.h"
+#include <time.h>
+
+// 分段文件名时间之后可能包含的最长时长（秒）：2分钟分段 + 分钟取整余量 / Longest span after a segment's filename time (seconds): 2-minute segment + minute rounding slack
+#define CLIP_SEGMENT_SPAN_S 180
+
+// 帧数组增长步长 / Frame array growth step
+#define CLIP_FRAME_STEP 1024
+
+// 一次读取的idx1条目数 / idx1 entries read per batch
+#define CLIP_INDEX_BATCH 64
+
+/**
+ * @brief 追加一帧到剪辑计划 / Append one frame to the clip plan
+ */
+static bool plan_add_frame(ClipPlan *plan, uint32_t offset, uint32_t size) {
+    if(plan->frameCount == plan->frameCap) {
+        uint32_t newCap = plan->frameCap + CLIP_FRAME_STEP;
+        ClipFrame *grown = (ClipFrame*)ps_realloc(plan->frames, newCap * sizeof(ClipFrame));
+        if(!grown) {
+            return false;
+        }
+        plan->frames = grown;
+        plan->frameCap = newCap;
+    }
+    plan->frames[plan->frameCount].offset = offset;
+    plan->frames[plan->frameCount].size = size;
+    plan->frameCount++;
+    plan->moviDataSize += size + 8;
+    if(size > plan->maxFrameSize) {
+        plan->maxFrameSize = size;
+    }
+    return true;
+}
+
+/**
+ * @brief 从一个分段中选出时间段内的帧 / Select the frames in range from one segment
+ * @param plan 剪辑计划 / Clip plan
+ * @param path 分段路径 / Segment path
+ * @param nameTime 文件名时间 / Filename time
+ * @return int 选中的帧数，失败返回-1 / Number of frames selected, -1 on failure
+ */
+static int plan_add_segment(ClipPlan *plan, const char *path, time_t nameTime) {
+    // 文件头和idx1头一起读 / The file headers and the idx1 header are read in one go
+    sd_io_begin(SD_IO_STORE);
+    File file = SD_MMC.open(path, FILE_READ);
+    if(!file) {
+        sd_io_end(SD_IO_STORE, 0);
+        return -1;
+    }
+    AVI_MAIN_HEADER mainHeader;
+    AVI_STREAM_HEADER streamHeader;
+    AVI_BITMAP_INFO bitmapInfo;
+    if(!aviReadHeaders(file, &mainHeader, &streamHeader, &bitmapInfo)) {
+        file.close();
+        sd_io_end(SD_IO_STORE, 0);
+        return -1;
+    }
+
+    // 分段时间轴 / Segment timeline
+    uint32_t totalFrames = mainHeader.totalFrames;
+    uint64_t segStartMs = (uint64_t)(mainHeader.reserved[AVI_RSV_START_TIME] ? mainHeader.reserved[AVI_RSV_START_TIME] : nameTime) * 1000;
+    uint32_t durationMs = mainHeader.reserved[AVI_RSV_DURATION_MS];
+    if(durationMs == 0 || totalFrames == 0) {
+        uint32_t rate = streamHeader.rate ? streamHeader.rate : 1;
+        durationMs = (uint32_t)((uint64_t)totalFrames * streamHeader.scale * 1000 / rate);
+    }
+
+    // 读取idx1头，检查索引是否有效（旧版本录制的idx1大小为0）/ Read the idx1 header, check the index is usable (older recordings wrote size 0)
+    uint32_t moviListSize = 0;
+    file.seek(AVI_MOVI_SIZE_OFFSET);
+    file.read((uint8_t*)&moviListSize, 4);
+    uint32_t idx1Pos = AVI_MOVI_FOURCC_OFFSET + moviListSize;
+    char idx1Id[4] = {0};
+    uint32_t idx1Size = 0;
+    AVI_INDEX_ENTRY firstEntry;
+    bool useIndex = false;
+    if(totalFrames > 0 && idx1Pos + 8 + sizeof(AVI_INDEX_ENTRY) <= file.size()) {
+        file.seek(idx1Pos);
+        file.read((uint8_t*)idx1Id, 4);
+        file.read((uint8_t*)&idx1Size, 4);
+        file.read((uint8_t*)&firstEntry, sizeof(firstEntry));
+        useIndex = memcmp(idx1Id, AVI_IDX1, 4) == 0 && idx1Size / sizeof(AVI_INDEX_ENTRY) == totalFrames &&
+                   firstEntry.offset == 4 && idx1Pos + 8 + idx1Size <= file.size();
+    }
+    sd_io_end(SD_IO_STORE, 0);
+
+    // 时间段对应的帧序号区间 / Frame number range for the time range
+    uint64_t rangeStartMs = (uint64_t)plan->start * 1000;
+    uint64_t rangeEndMs = (uint64_t)plan->end * 1000;
+    uint32_t first = 0;
+    uint32_t last = totalFrames;    // 不含 / exclusive
+    if(totalFrames > 0 && durationMs > 0) {
+        if(rangeStartMs > segStartMs) {
+            uint64_t f = ((rangeStartMs - segStartMs) * totalFrames + durationMs - 1) / durationMs;
+            first = f < totalFrames ? (uint32_t)f : totalFrames;
+        }
+        if(rangeEndMs < segStartMs) {
+            last = 0;
+        } else {
+            uint64_t l = (rangeEndMs - segStartMs) * totalFrames / durationMs + 1;
+            last = l < totalFrames ? (uint32_t)l : totalFrames;
+        }
+    }
+
+    uint32_t before = plan->frameCount;
+    bool ok = true;
+    if(useIndex) {
+        // 按索引直接跳到第一帧，只读需要的条目 / Jump straight to the first frame through the index, reading only the entries needed
+        AVI_INDEX_ENTRY entries[CLIP_INDEX_BATCH];
+        for(uint32_t i = first; ok && i < last; i += CLIP_INDEX_BATCH) {
+            uint32_t n = last - i < CLIP_INDEX_BATCH ? last - i : CLIP_INDEX_BATCH;
+            sd_io_begin(SD_IO_STORE);
+            file.seek(idx1Pos + 8 + i * sizeof(AVI_INDEX_ENTRY));
+            size_t got = file.read((uint8_t*)entries, n * sizeof(AVI_INDEX_ENTRY));
+            sd_io_end(SD_IO_STORE, got);
+            if(got != n * sizeof(AVI_INDEX_ENTRY)) {
+                ok = false;
+                break;
+            }
+            for(uint32_t k = 0; k < n && ok; k++) {
+                ok = plan_add_frame(plan, AVI_MOVI_FOURCC_OFFSET + entries[k].offset + 8, entries[k].size);
+            }
+        }
+    } else if(totalFrames > 0) {
+        // 没有有效索引：顺序扫描块头 / No usable index: walk the chunk headers in order
+        uint32_t pos = AVI_MOVI_DATA_OFFSET;
+        uint32_t moviEnd = AVI_MOVI_FOURCC_OFFSET + moviListSize;
+        for(uint32_t i = 0; ok && i < last && pos + 8 <= moviEnd; i++) {
+            char chunkId[4];
+            uint32_t chunkSize;
+            sd_io_begin(SD_IO_STORE);
+            file.seek(pos);
+            bool headerRead = file.read((uint8_t*)chunkId, 4) == 4 && file.read((uint8_t*)&chunkSize, 4) == 4;
+            sd_io_end(SD_IO_STORE, 8);
+            if(!headerRead || (memcmp(chunkId, AVI_00DC, 4) != 0 && memcmp(chunkId, AVI_00DB, 4) != 0)) {
+                break;
+            }
+            if(i >= first) {
+                ok = plan_add_frame(plan, pos + 8, chunkSize);
+            }
+            pos += 8 + chunkSize;
+        }
+    }
+    sd_io_begin(SD_IO_STORE);
+    file.close();
+    sd_io_end(SD_IO_STORE, 0);
+    if(!ok) {
+        return -1;
+    }
+
+    uint32_t selected = plan->frameCount - before;
+    if(selected > 0) {
+        if(before == 0) {
+            plan->firstFrameTime = (uint32_t)((segStartMs + (uint64_t)first * durationMs / totalFrames) / 1000);
+            plan->width = mainHeader.width;
+            plan->height = mainHeader.height;
+        }
+        plan->durationMs += (uint32_t)((uint64_t)selected * durationMs / totalFrames);
+    }
+    return selected;
+}
+
+/**
+ * @brief 时间段可能包含的分段加入剪辑计划 / Add a segment to the clip plan if it may overlap the range
+ * @param path 分段路径 / Segment path
+ * @param name 文件名 / Filename
+ */
+static void plan_consider_segment(ClipPlan *plan, const char *path, const char *name) {
+    size_t nameLen = strlen(name);
+    if(nameLen < 4 || strcmp(name + nameLen - 4, ".avi") != 0) {
+        return;
+    }
+    // 正在录制的分段文件头尚未完成 / The segment being recorded has no final headers yet
+    if(isRecordingVideo() && strcmp(path, getCurrentVideoFilename()) == 0) {
+        return;
+    }
+    time_t nameTime = parseTimestampFromPath(name);
+    if(nameTime <= 0 || nameTime > (time_t)plan->end || nameTime + CLIP_SEGMENT_SPAN_S < (time_t)plan->start) {
+        return;
+    }
+    if(plan->segmentCount >= CLIP_MAX_SEGMENTS) {
+        return;
+    }
+    ClipSegment *seg = &plan->segments[plan->segmentCount++];
+    snprintf(seg->path, sizeof(seg->path), "%s", path);
+}
+
+/**
+ * @brief 遍历一级目录找分段（索引不可用时）/ Walk one directory level for segments (when the catalog is unavailable)
+ * @note 每个目录项单独排队，不长时间占用总线 / Every directory entry queues on its own so the bus is never held for long
+ */
+static void plan_scan_dir(ClipPlan *plan, const char *dirname) {
+    sd_io_begin(SD_IO_STORE);
+    File root = SD_MMC.open(dirname);
+    File file = root && root.isDirectory() ? root.openNextFile() : File();
+    sd_io_end(SD_IO_STORE, 0);
+    while(file) {
+        if(!file.isDirectory()) {
+            char path[64];
+            snprintf(path, sizeof(path), "%s/%s", dirname, file.name());
+            plan_consider_segment(plan, path, file.name());
+        }
+        sd_io_begin(SD_IO_STORE);
+        file = root.openNextFile();
+        sd_io_end(SD_IO_STORE, 0);
+    }
+}
+
+/**
+ * @brief 本地日期（YYYYMMDD）/ Local date (YYYYMMDD)
+ */
+static uint32_t local_date(time_t t) {
+    struct tm timeinfo;
+    localtime_r(&t, &timeinfo);
+    return (timeinfo.tm_year + 1900) * 10000 + (timeinfo.tm_mon + 1) * 100 + timeinfo.tm_mday;
+}
+
+/**
+ * @brief 按时间段收集剪辑帧 / Collect clip frames for a time range
+ * @return ClipPlan* 剪辑计划，没有帧返回NULL / Clip plan, NULL if there are no frames
+ */
+ClipPlan* clip_prepare(uint32_t start, uint32_t end) {
+    if(end <= start || end - start > CLIP_MAX_DURATION_S) {
+        return NULL;
+    }
+
+    FileInfo *files = (FileInfo*)ps_malloc(100 * sizeof(FileInfo));
+    ClipPlan *plan = (ClipPlan*)ps_calloc(1, sizeof(ClipPlan));
+    if(!files || !plan) {
+        free(files);
+        free(plan);
+        return NULL;
+    }
+    plan->start = start;
+    plan->end = end;
+
+    // 找出与时间段重叠的分段 / Find the segments overlapping the range
+    int fileCount = catalog_query(VIDEO_DIR, start, end, CATALOG_FLAG_OPEN, files, 100);
+    for(int i = 0; i < fileCount; i++) {
+        plan_consider_segment(plan, files[i].path, files[i].name);
+    }
+    if(fileCount < 0) {
+        // 索引不可用：遍历根目录（旧版平铺文件）和时间段所在的日期目录 / Catalog unavailable: walk the root (legacy flat files) and the date directories the range falls in
+        plan_scan_dir(plan, VIDEO_DIR);
+        uint32_t firstDate = local_date((time_t)start - CLIP_SEGMENT_SPAN_S);
+        uint32_t lastDate = local_date((time_t)end);
+        uint32_t date = 0;
+        while((date = findDateDir(VIDEO_DIR, date, false)) != 0 && date <= lastDate) {
+            if(date >= firstDate) {
+                char dateDir[48];
+                dateDirPath(VIDEO_DIR, date, dateDir, sizeof(dateDir));
+                plan_scan_dir(plan, dateDir);
+            }
+        }
+    }
+
+    // 按文件名时间排序（插入排序，分段数很少）/ Sort by filename time (insertion sort, few segments)
+    for(int i = 1; i < plan->segmentCount; i++) {
+        ClipSegment key = plan->segments[i];
+        time_t keyTime = parseTimestampFromPath(key.path);
+        int j = i - 1;
+        while(j >= 0 && parseTimestampFromPath(plan->segments[j].path) > keyTime) {
+            plan->segments[j + 1] = plan->segments[j];
+            j--;
+        }
+        plan->segments[j + 1] = key;
+    }
+    free(files);
+
+    // 逐个分段收集帧，丢弃没有选中帧的分段 / Collect frames segment by segment, dropping segments with no frames selected
+    int kept = 0;
+    for(int i = 0; i < plan->segmentCount; i++) {
+        ClipSegment seg = plan->segments[i];
+        seg.firstFrame = plan->frameCount;
+        int n = plan_add_segment(plan, seg.path, parseTimestampFromPath(seg.path));
+        if(n > 0) {
+            seg.frameCount = n;
+            plan->segments[kept++] = seg;
+        }
+    }
+    plan->segmentCount = kept;
+
+    if(plan->frameCount == 0) {
+        clip_free(plan);
+        return NULL;
+    }
+    return plan;
+}
+
+/**
+ * @brief 生成剪辑的AVI文件头 / Build the AVI headers for a clip
+ */
+static void clip_build_headers(const ClipPlan *plan, AVI_MAIN_HEADER *mainHeader, AVI_STREAM_HEADER *streamHeader, AVI_BITMAP_INFO *bitmapInfo) {
+    uint32_t durationMs = plan->durationMs ? plan->durationMs : plan->frameCount * 50;
+    aviInitHeaders(mainHeader, streamHeader, bitmapInfo, 1, plan->width, plan->height);
+    streamHeader->scale = durationMs;
+    streamHeader->rate = plan->frameCount * 1000;
+    mainHeader->microSecPerFrame = (uint32_t)((uint64_t)durationMs * 1000 / plan->frameCount);
+    mainHeader->reserved[AVI_RSV_START_TIME] = plan->firstFrameTime;
+    mainHeader->reserved[AVI_RSV_DURATION_MS] = durationMs;
+    aviUpdateHeaders(mainHeader, streamHeader, plan->frameCount, plan->moviDataSize, plan->maxFrameSize);
+}
+
+/**
+ * @brief 获取剪辑AVI文件总大小 / Get the total size of the clip AVI file
+ */
+uint32_t clip_file_size(const ClipPlan *plan) {
+    AVI_MAIN_HEADER mainHeader;
+    AVI_STREAM_HEADER streamHeader;
+    AVI_BITMAP_INFO bitmapInfo;
+    clip_build_headers(plan, &mainHeader, &streamHeader, &bitmapInfo);
+    return mainHeader.fileSize + 8;
+}
+
+/**
+ * @brief 输出剪辑AVI / Output the clip AVI
+ * @return bool 成功返回true / Returns true on success
+ */
+bool clip_write(const ClipPlan *plan, clip_write_cb write, void *arg) {
+    uint8_t *buf = (uint8_t*)ps_malloc(CLIP_COPY_BUF_SIZE);
+    if(!buf) {
+        return false;
+    }
+
+    // 文件头、JUNK和LIST movi头一次写出 / Headers, JUNK and the LIST movi header in one write
+    AVI_MAIN_HEADER mainHeader;
+    AVI_STREAM_HEADER streamHeader;
+    AVI_BITMAP_INFO bitmapInfo;
+    clip_build_headers(plan, &mainHeader, &streamHeader, &bitmapInfo);
+    uint32_t junkSize = AVI_JUNK_SIZE;
+    uint32_t moviListSize = plan->moviDataSize + 4;
+    memset(buf, 0, AVI_MOVI_DATA_OFFSET);
+    uint8_t *p = buf;
+    memcpy(p, &mainHeader, sizeof(mainHeader));     p += sizeof(mainHeader);
+    memcpy(p, &streamHeader, sizeof(streamHeader)); p += sizeof(streamHeader);
+    memcpy(p, &bitmapInfo, sizeof(bitmapInfo));     p += sizeof(bitmapInfo);
+    memcpy(p, "JUNK", 4);                            p += 4;
+    memcpy(p, &junkSize, 4);                         p += 4 + AVI_JUNK_SIZE;
+    memcpy(p, AVI_LIST, 4);                          p += 4;
+    memcpy(p, &moviListSize, 4);                     p += 4;
+    memcpy(p, AVI_MOVI, 4);
+    bool ok = write(buf, AVI_MOVI_DATA_OFFSET, arg);
+
+    // 按分段复制帧：源文件中相邻的帧块合并为一段连续区间整块复制 / Copy frames per segment: adjacent chunks in the source are merged into one contiguous run
+    for(int s = 0; ok && s < plan->segmentCount; s++) {
+        const ClipSegment *seg = &plan->segments[s];
+        sd_io_begin(SD_IO_BULK);
+        File file = SD_MMC.open(seg->path, FILE_READ);
+        sd_io_end(SD_IO_BULK, 0);
+        if(!file) {
+            ok = false;
+            break;
+        }
+        uint32_t i = seg->firstFrame;
+        uint32_t segEnd = seg->firstFrame + seg->frameCount;
+        while(ok && i < segEnd) {
+            uint32_t j = i;
+            while(j + 1 < segEnd && plan->frames[j + 1].offset == plan->frames[j].offset + plan->frames[j].size + 8) {
+                j++;
+            }
+            uint32_t runStart = plan->frames[i].offset - 8;
+            uint32_t runLen = plan->frames[j].offset + plan->frames[j].size - runStart;
+            sd_io_begin(SD_IO_BULK);
+            file.seek(runStart);
+            sd_io_end(SD_IO_BULK, 0);
+            while(ok && runLen > 0) {
+                size_t n = runLen > CLIP_COPY_BUF_SIZE ? CLIP_COPY_BUF_SIZE : runLen;
+                ok = sd_io_read(file, buf, n, SD_IO_BULK) == n && write(buf, n, arg);
+                runLen -= n;
+            }
+            i = j + 1;
+        }
+        sd_io_begin(SD_IO_BULK);
+        file.close();
+        sd_io_end(SD_IO_BULK, 0);
+    }
+
+    // idx1索引 / idx1 index
+    if(ok) {
+        uint32_t idx1Size = plan->frameCount * sizeof(AVI_INDEX_ENTRY);
+        memcpy(buf, AVI_IDX1, 4);
+        memcpy(buf + 4, &idx1Size, 4);
+        size_t used = 8;
+        uint32_t offset = 4;
+        for(uint32_t i = 0; ok && i < plan->frameCount; i++) {
+            AVI_INDEX_ENTRY entry;
+            memcpy(entry.id, AVI_00DC, 4);
+            entry.flags = plan->frames[i].size ? 0x10 : 0; // AVIIF_KEYFRAME, gap frames are empty
+            entry.offset = offset;
+            entry.size = plan->frames[i].size;
+            offset += entry.size + 8;
+            memcpy(buf + used, &entry, sizeof(entry));
+            used += sizeof(entry);
+            if(used + sizeof(entry) > CLIP_COPY_BUF_SIZE || i == plan->frameCount - 1) {
+                ok = write(buf, used, arg);
+                used = 0;
+            }
+        }
+    }
+
+    free(buf);
+    return ok;
+}
+
+/**
+ * @brief 文件输出回调 / File output callback
+ */
+static bool clip_file_write(const uint8_t *data, size_t len, void *arg) {
+    return sd_io_write(*(File*)arg, data, len, SD_IO_BULK) == len;
+}
+
+/**
+ * @brief 保存剪辑到SD卡 / Save a clip to the SD card
+ * @return bool 成功返回true / Returns true on success
+ * @note 同一秒开始的剪辑已存在时加_N后缀，不覆盖 / When a clip starting in the same second exists, a _N suffix is added instead of overwriting it
+ */
+bool clip_save(const ClipPlan *plan, char *path, size_t pathSize) {
+    // 选名和创建文件是元数据操作，按STORE排队；帧数据按BULK写入 / Picking the name and creating the file are metadata work queued as STORE; frame data is written as BULK
+    sd_io_begin(SD_IO_STORE);
+    if(!SD_MMC.exists(CLIP_DIR)) {
+        SD_MMC.mkdir(CLIP_DIR);
+    }
+    time_t t = plan->firstFrameTime;
+    struct tm timeinfo;
+    localtime_r(&t, &timeinfo);
+    char base[48];
+    snprintf(base, sizeof(base), "%s/%04d%02d%02d%02d%02d%02d", CLIP_DIR,
+             timeinfo.tm_year + 1900, timeinfo.tm_mon + 1, timeinfo.tm_mday,
+             timeinfo.tm_hour, timeinfo.tm_min, timeinfo.tm_sec);
+    snprintf(path, pathSize, "%s.avi", base);
+    for(int n = 1; SD_MMC.exists(path); n++) {
+        if(n > CLIP_NAME_MAX_SUFFIX) {
+            sd_io_end(SD_IO_STORE, 0);
+            Serial.printf("Too many clips named %s / 同名剪辑过多\n", base);
+            return false;
+        }
+        snprintf(path, pathSize, "%s_%d.avi", base, n);
+    }
+
+    File file = SD_MMC.open(path, FILE_WRITE);
+    sd_io_end(SD_IO_STORE, 0);
+    if(!file) {
+        Serial.printf("Failed to open clip file: %s / 无法创建剪辑文件\n", path);
+        return false;
+    }
+    bool ok = clip_write(plan, clip_file_write, &file);
+    sd_io_begin(SD_IO_BULK);
+    size_t clipSize = file.size();
+    file.close();
+    if(!ok) {
+        SD_MMC.remove(path);
+    }
+    sd_io_end(SD_IO_BULK, 0);
+    if(!ok) {
+        return false;
+    }
+    sd_space_file_added(clipSize);
+    storage_stats_add(RETENTION_DERIVED, clipSize);
+    catalog_add(path, CATALOG_TYPE_CLIP, plan->firstFrameTime, plan->firstFrameTime + plan->durationMs / 1000, clipSize, 0);
+    Serial.printf("Clip saved: %s, %lu frames from %d segment(s) / 剪辑已保存\n",
+                  path, (unsigned long)plan->frameCount, plan->segmentCount);
+    return true;
+}
+
+/**
+ * @brief 释放剪辑计划 / Free a clip plan
+ */
+void clip_free(ClipPlan *plan) {
+    if(!plan) {
+        return;
+    }
+    free(plan->frames);
+    free(plan);
+}
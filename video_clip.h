@@ -0,0 +1,124 @@
+/**********************************************************************
+  文件名称 / Filename : video_clip.h
+  文件用途 / File Purpose : 录像剪辑头文件 / Recording Clip Header File
+               声明了按时间段从录像分段中提取AVI剪辑的函数原型和宏定义
+               Declares function prototypes and macro definitions for extracting an AVI clip from recorded segments by time range
+  作者 / Author : ESP32-S3监控项目 / ESP32-S3 Monitoring Project
+  修改日期 / Modification Date : 2026-02-05
+  硬件平台 / Hardware Platform : ESP32S3-EYE开发板 / ESP32S3-EYE Development Board
+  依赖库 / Dependencies : Arduino.h - Arduino核心库 / Arduino Core Library
+               sd_read_write.h - AVI格式与SD卡操作 / AVI format and SD card operations
+  使用说明 / Usage Instructions : 1. 包含本头文件 #include "video_clip.h" / Include this header file
+               2. 调用clip_prepare()按时间段收集帧 / Call clip_prepare() to collect frames for a time range
+               3. 调用clip_write()通过回调输出AVI / Call clip_write() to output the AVI through a callback
+               4. 调用clip_free()释放 / Call clip_free() to release
+  参数调整 / Parameter Adjustment : CLIP_MAX_DURATION_S - 单个剪辑最大时长（默认30分钟）/ Maximum clip duration (default 30 minutes)
+               CLIP_COPY_BUF_SIZE - 复制缓冲区大小（默认64KB）/ Copy buffer size (default 64KB)
+  注意事项 / Important Notes : 不解码JPEG，00dc块按连续区间整块复制 / No JPEG decode, 00dc chunks are copied as whole contiguous runs
+               正在录制的分段尚未写完，不包含在剪辑中 / The segment being recorded is not finished yet and is not included
+**********************************************************************/
+
+#ifndef __VIDEO_CLIP_H
+#define __VIDEO_CLIP_H
+
+#include "Arduino.h"
+
+// 剪辑保存目录（不参与自动清理）/ Clip save directory (not touched by auto cleanup)
+#define CLIP_DIR "/camera/clips"
+
+// 单个剪辑最大时长（秒）/ Maximum clip duration (seconds)
+#define CLIP_MAX_DURATION_S 1800
+
+// 单个剪辑最多跨越的分段数 / Maximum number of segments one clip can span
+#define CLIP_MAX_SEGMENTS 20
+
+// 同一秒开始的剪辑最多的_N后缀 / Highest _N suffix for clips starting in the same second
+#define CLIP_NAME_MAX_SUFFIX 99
+
+// 复制缓冲区大小（字节，PSRAM）/ Copy buffer size (bytes, PSRAM)
+#define CLIP_COPY_BUF_SIZE (64 * 1024)
+
+// 剪辑中的一个分段 / One segment in a clip
+typedef struct {
+    char path[64];              // 分段路径 / Segment path
+    uint32_t firstFrame;        // 在帧数组中的起始下标 / First index in the frame array
+    uint32_t frameCount;        // 选中的帧数 / Number of selected frames
+} ClipSegment;
+
+// 剪辑中的一帧（源文件中的位置）/ One frame in a clip (location in the source file)
+typedef struct {
+    uint32_t offset;            // JPEG数据在源文件中的偏移 / Offset of the JPEG data in the source file
+    uint32_t size;              // JPEG数据大小 / JPEG data size
+} ClipFrame;
+
+// 剪辑计划 / Clip plan
+typedef struct {
+    uint32_t start;             // 请求开始时间 / Requested start time
+    uint32_t end;               // 请求结束时间 / Requested end time
+    uint32_t firstFrameTime;    // 第一帧时间（Unix时间戳）/ Time of the first frame (Unix timestamp)
+    uint32_t durationMs;        // 选中帧的总时长（毫秒）/ Total duration of the selected frames (ms)
+    uint32_t width;             // 宽度 / Width
+    uint32_t height;            // 高度 / Height
+    ClipSegment segments[CLIP_MAX_SEGMENTS];
+    int segmentCount;
+    ClipFrame *frames;          // 帧数组（PSRAM）/ Frame array (PSRAM)
+    uint32_t frameCount;
+    uint32_t frameCap;
+    uint32_t moviDataSize;      // movi数据大小（含8字节块头）/ movi data size (including 8-byte chunk headers)
+    uint32_t maxFrameSize;      // 最大帧大小 / Maximum frame size
+} ClipPlan;
+
+// 输出回调：成功返回true / Output callback: returns true on success
+typedef bool (*clip_write_cb)(const uint8_t *data, size_t len, void *arg);
+
+/**
+ * @brief 按时间段收集剪辑帧 / Collect clip frames for a time range
+ * @param start 开始时间（Unix时间戳）/ Start time (Unix timestamp)
+ * @param end 结束时间（Unix时间戳）/ End time (Unix timestamp)
+ * @return ClipPlan* 剪辑计划，没有帧或参数无效返回NULL / Clip plan, NULL if there are no frames or the arguments are invalid
+ * @details 功能说明 / Function Description:
+ *          1. 按文件名时间找出与时间段重叠的分段 / Find segments overlapping the range by filename time
+ *          2. 读取分段的idx1索引（无有效索引时扫描movi块头）/ Read each segment's idx1 index (walk movi chunk headers if there is no valid index)
+ *          3. 按分段开始时间和实际帧间隔选出范围内的帧 / Select frames in range using the segment start time and actual frame interval
+ * @note 只读取文件头和索引，不读取帧数据 / Only headers and indexes are read, never frame data
+ */
+ClipPlan* clip_prepare(uint32_t start, uint32_t end);
+
+/**
+ * @brief 获取剪辑AVI文件总大小 / Get the total size of the clip AVI file
+ * @param plan 剪辑计划 / Clip plan
+ * @return uint32_t 文件大小（字节）/ File size (bytes)
+ */
+uint32_t clip_file_size(const ClipPlan *plan);
+
+/**
+ * @brief 输出剪辑AVI / Output the clip AVI
+ * @param plan 剪辑计划 / Clip plan
+ * @param write 输出回调 / Output callback
+ * @param arg 回调参数 / Callback argument
+ * @return bool 成功返回true / Returns true on success
+ * @details 功能说明 / Function Description:
+ *          1. 输出带最终大小的文件头 / Output headers carrying the final sizes
+ *          2. 按连续区间大块复制00dc块 / Copy 00dc chunks in large contiguous runs
+ *          3. 输出idx1索引 / Output the idx1 index
+ */
+bool clip_write(const ClipPlan *plan, clip_write_cb write, void *arg);
+
+/**
+ * @brief 保存剪辑到SD卡 / Save a clip to the SD card
+ * @param plan 剪辑计划 / Clip plan
+ * @param path 输出路径缓冲区 / Output path buffer
+ * @param pathSize 缓冲区大小 / Buffer size
+ * @return bool 成功返回true / Returns true on success
+ * @note 文件名为第一帧时间YYYYMMDDHHMMSS.avi，保存在CLIP_DIR；同名文件已存在时为YYYYMMDDHHMMSS_N.avi
+ *       Named after the first frame time YYYYMMDDHHMMSS.avi, saved in CLIP_DIR; YYYYMMDDHHMMSS_N.avi when that name is taken
+ */
+bool clip_save(const ClipPlan *plan, char *path, size_t pathSize);
+
+/**
+ * @brief 释放剪辑计划 / Free a clip plan
+ * @param plan 剪辑计划 / Clip plan
+ */
+void clip_free(ClipPlan *plan);
+
+#endif // __VIDEO_CLIP_H
@@ -0,0 +1,422 @@
+/**********************************************************************
+  文件名称 / Filename : video_playback.cpp
+  文件用途 / File Purpose : 录像回放实现文件 / Recording Playback Implementation File
+               本文件实现了每个回放一个发送任务，从录像AVI中读取00dc帧并按时间推送MJPEG
+               This file implements one sender task per playback that reads 00dc frames out of a recorded AVI and pushes them as timed MJPEG
+               主要功能包括 / Main Features:
+               1. 按idx1索引定位帧，高倍速时跳帧 / Locate frames through the idx1 index, skipping frames at high speed
+               2. 按原始帧时间 × 倍速控制发送节奏 / Pace sending by the original frame times × speed
+               3. 分段结束后接着播放下一个分段 / Carry on with the next segment when one ends
+  作者 / Author : ESP32-S3监控项目 / ESP32-S3 Monitoring Project
+  修改日期 / Modification Date : 2026-02-05
+  硬件平台 / Hardware Platform : ESP32S3-EYE开发板 / ESP32S3-EYE Development Board
+  依赖库 / Dependencies : SD_MMC.h - SD卡文件系统 / SD card file system
+               sd_io.h - 批量读取 / Bulk reads
+               esp_timer.h - 节奏控制 / Pacing
+  使用说明 / Usage Instructions : 1. 调用video_playback_init()初始化 / Call video_playback_init() to initialise
+  注意事项 / Important Notes : 帧数据按SD_IO_BULK读取，录像写入优先 / Frame data is read as SD_IO_BULK so recording writes come first
+               多路复用响应没有结尾，结束时关闭连接 / The multipart response has no end, the connection is closed when playback ends
+**********************************************************************/
+
+#include "video_playback.h"
+#include "sd_read_write.h"
+#include "catalog.h"
+#include "sd_io.h"
+#include "stream_clients.h"
+#include "SD_MMC.h"
+#include "esp_timer.h"
+
+#define PART_BOUNDARY "123456789000000000000987654321"
+// 自己写出响应头，没有Transfer-Encoding，结束时关闭连接 / The response head is written here, no Transfer-Encoding, the connection closes at the end
+static const char *PLAYBACK_HEAD = "HTTP/1.1 200 OK\r\nContent-Type: multipart/x-mixed-replace;boundary=" PART_BOUNDARY "\r\n"
+                                   "Access-Control-Allow-Origin: *\r\nX-Playback-Speed: %lu.%02lu\r\nConnection: close\r\n\r\n";
+// 分隔符和分段头合在一起，X-Timestamp为帧的录制时间 / Boundary and part header in one piece, X-Timestamp is when the frame was recorded
+static const char *PLAYBACK_PART = "\r\n--" PART_BOUNDARY "\r\n"
+                                   "Content-Type: image/jpeg\r\nContent-Length: %lu\r\nX-Timestamp: %lu.%03lu\r\n\r\n";
+
+// 一次读取的idx1条目数 / idx1 entries read per batch
+#define PLAYBACK_INDEX_BATCH 64
+
+// 正在播放的分段 / Segment being played
+typedef struct {
+    File file;                          // 分段文件 / Segment file
+    char path[128];                     // 分段路径 / Segment path
+    uint32_t totalFrames;               // 总帧数 / Total frames
+    uint32_t durationMs;                // 实际时长（毫秒）/ Actual duration (ms)
+    uint64_t startMs;                   // 开始时间（Unix毫秒）/ Start time (Unix ms)
+    uint32_t maxFrameSize;              // 最大帧大小 / Largest frame
+    bool useIndex;                      // idx1是否有效 / Whether idx1 is usable
+    uint32_t idx1Pos;                   // idx1块位置 / Position of the idx1 chunk
+    uint32_t moviEnd;                   // movi数据结束位置 / End of the movi data
+    AVI_INDEX_ENTRY entries[PLAYBACK_INDEX_BATCH]; // 已读入的索引条目 / Index entries read in
+    uint32_t batchFirst;                // entries[0]的帧序号 / Frame number of entries[0]
+    uint32_t batchCount;                // 已读入的条目数 / Entries read in
+    uint32_t walkPos;                   // 无索引时下一个块头的位置 / Next chunk header without an index
+    uint32_t walkFrame;                 // walkPos处的帧序号 / Frame number at walkPos
+} PlaybackSegment;
+
+// 回放位置 / Playback slot
+typedef struct {
+    bool used;                          // 是否占用 / Whether taken
+    httpd_req_t *req;                   // 异步请求 / Asynchronous request
+    uint32_t id;                        // 回放编号 / Playback number
+    uint32_t speedPct;                  // 倍速百分比 / Speed in percent
+    uint32_t firstFrame;                // 第一个分段的开始帧 / Start frame in the first segment
+    PlaybackSegment seg;                // 当前分段 / Current segment
+    uint8_t *buf;                       // 帧缓冲 / Frame buffer
+    size_t bufSize;                     // 帧缓冲大小 / Frame buffer size
+    uint32_t frames;                    // 发出的帧数 / Frames sent
+    uint32_t skipped;                   // 跳过的帧数 / Frames skipped
+} PlaybackClient;
+
+static PlaybackClient playbackClients[VIDEO_PLAYBACK_MAX_CLIENTS];
+static uint32_t nextPlaybackId = 1;
+static portMUX_TYPE playbackMux = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief 释放回放位置 / Free a playback slot
+ */
+static void release_slot(PlaybackClient *client) {
+    if(client->seg.file) {
+        client->seg.file.close();
+    }
+    free(client->buf);
+    client->buf = NULL;
+    client->bufSize = 0;
+    portENTER_CRITICAL(&playbackMux);
+    client->used = false;
+    portEXIT_CRITICAL(&playbackMux);
+}
+
+/**
+ * @brief 打开分段并读取时间轴和索引位置 / Open a segment and read its timeline and index position
+ * @return bool 成功返回true，正在录制或文件头无效返回false / Returns true on success, false while it is being recorded or if its headers are invalid
+ */
+static bool open_segment(PlaybackSegment *seg, const char *path) {
+    if(seg->file) {
+        seg->file.close();
+    }
+    // 正在录制的分段文件头尚未完成 / The segment being recorded has no final headers yet
+    if(isRecordingVideo() && strcmp(path, getCurrentVideoFilename()) == 0) {
+        return false;
+    }
+    seg->file = SD_MMC.open(path, FILE_READ);
+    if(!seg->file) {
+        return false;
+    }
+    AVI_MAIN_HEADER mainHeader;
+    AVI_STREAM_HEADER streamHeader;
+    AVI_BITMAP_INFO bitmapInfo;
+    if(!aviReadHeaders(seg->file, &mainHeader, &streamHeader, &bitmapInfo) || mainHeader.totalFrames == 0) {
+        seg->file.close();
+        return false;
+    }
+    snprintf(seg->path, sizeof(seg->path), "%s", path);
+    seg->totalFrames = mainHeader.totalFrames;
+    time_t nameTime = parseTimestampFromPath(path);
+    seg->startMs = (uint64_t)(mainHeader.reserved[AVI_RSV_START_TIME] ? mainHeader.reserved[AVI_RSV_START_TIME] : nameTime) * 1000;
+    seg->durationMs = mainHeader.reserved[AVI_RSV_DURATION_MS];
+    if(seg->durationMs == 0) {
+        uint32_t rate = streamHeader.rate ? streamHeader.rate : 1;
+        seg->durationMs = (uint32_t)((uint64_t)seg->totalFrames * streamHeader.scale * 1000 / rate);
+    }
+    if(seg->durationMs == 0) {
+        seg->durationMs = seg->totalFrames * 50;
+    }
+    seg->maxFrameSize = mainHeader.suggestedBufferSize;
+
+    // 检查idx1是否有效（旧版本录制的idx1大小为0）/ Check the idx1 is usable (older recordings wrote size 0)
+    uint32_t moviListSize = 0;
+    seg->file.seek(AVI_MOVI_SIZE_OFFSET);
+    seg->file.read((uint8_t*)&moviListSize, 4);
+    seg->moviEnd = AVI_MOVI_FOURCC_OFFSET + moviListSize;
+    seg->idx1Pos = seg->moviEnd;
+    seg->useIndex = false;
+    if(seg->idx1Pos + 8 + sizeof(AVI_INDEX_ENTRY) <= seg->file.size()) {
+        char idx1Id[4] = {0};
+        uint32_t idx1Size = 0;
+        AVI_INDEX_ENTRY firstEntry;
+        seg->file.seek(seg->idx1Pos);
+        seg->file.read((uint8_t*)idx1Id, 4);
+        seg->file.read((uint8_t*)&idx1Size, 4);
+        seg->file.read((uint8_t*)&firstEntry, sizeof(firstEntry));
+        seg->useIndex = memcmp(idx1Id, AVI_IDX1, 4) == 0 && idx1Size / sizeof(AVI_INDEX_ENTRY) == seg->totalFrames &&
+                        firstEntry.offset == 4 && seg->idx1Pos + 8 + idx1Size <= seg->file.size();
+    }
+    seg->batchFirst = 0;
+    seg->batchCount = 0;
+    seg->walkPos = AVI_MOVI_DATA_OFFSET;
+    seg->walkFrame = 0;
+    return true;
+}
+
+/**
+ * @brief 帧在分段内的时间（毫秒）/ Time of a frame within the segment (ms)
+ */
+static uint64_t frame_time_ms(const PlaybackSegment *seg, uint32_t frame) {
+    return (uint64_t)frame * seg->durationMs / seg->totalFrames;
+}
+
+/**
+ * @brief 找到一帧在文件中的位置 / Find where a frame is in the file
+ * @param offset 输出JPEG数据偏移 / Output offset of the JPEG data
+ * @param size 输出JPEG数据大小 / Output JPEG data size
+ * @return bool 成功返回true / Returns true on success
+ */
+static bool locate_frame(PlaybackSegment *seg, uint32_t frame, uint32_t *offset, uint32_t *size) {
+    if(seg->useIndex) {
+        // 按批读取索引，跳帧时直接跳到需要的条目 / Read the index in batches, skipping frames jumps straight to the entry needed
+        if(frame < seg->batchFirst || frame >= seg->batchFirst + seg->batchCount) {
+            uint32_t n = seg->totalFrames - frame < PLAYBACK_INDEX_BATCH ? seg->totalFrames - frame : PLAYBACK_INDEX_BATCH;
+            seg->file.seek(seg->idx1Pos + 8 + frame * sizeof(AVI_INDEX_ENTRY));
+            if(seg->file.read((uint8_t*)seg->entries, n * sizeof(AVI_INDEX_ENTRY)) != n * sizeof(AVI_INDEX_ENTRY)) {
+                seg->batchCount = 0;
+                return false;
+            }
+            seg->batchFirst = frame;
+            seg->batchCount = n;
+        }
+        const AVI_INDEX_ENTRY *e = &seg->entries[frame - seg->batchFirst];
+        *offset = AVI_MOVI_FOURCC_OFFSET + e->offset + 8;
+        *size = e->size;
+        return true;
+    }
+
+    // 没有有效索引：顺序扫描块头 / No usable index: walk the chunk headers in order
+    if(frame < seg->walkFrame) {
+        seg->walkPos = AVI_MOVI_DATA_OFFSET;
+        seg->walkFrame = 0;
+    }
+    while(seg->walkPos + 8 <= seg->moviEnd) {
+        char chunkId[4];
+        uint32_t chunkSize;
+        seg->file.seek(seg->walkPos);
+        if(seg->file.read((uint8_t*)chunkId, 4) != 4 || seg->file.read((uint8_t*)&chunkSize, 4) != 4 ||
+           (memcmp(chunkId, AVI_00DC, 4) != 0 && memcmp(chunkId, AVI_00DB, 4) != 0)) {
+            return false;
+        }
+        if(seg->walkFrame == frame) {
+            *offset = seg->walkPos + 8;
+            *size = chunkSize;
+            return true;
+        }
+        seg->walkPos += 8 + chunkSize;
+        seg->walkFrame++;
+    }
+    return false;
+}
+
+/**
+ * @brief 读取并发送一帧 / Read and send one frame
+ * @param sent 输出是否发出了画面，录像间隙的空帧不发送 / Output whether a picture went out, the empty frames of a recording gap are not sent
+ * @return esp_err_t 成功返回ESP_OK（包括空帧）/ ESP_OK on success (empty frames included)
+ */
+static esp_err_t send_frame(PlaybackClient *client, int fd, uint32_t frame, bool *sent) {
+    PlaybackSegment *seg = &client->seg;
+    uint32_t offset, size;
+    *sent = false;
+    if(!locate_frame(seg, frame, &offset, &size) || size > VIDEO_PLAYBACK_MAX_FRAME) {
+        Serial.printf("Playback %lu: bad frame %lu in %s / 回放帧无效\n", (unsigned long)client->id, (unsigned long)frame, seg->path);
+        return ESP_FAIL;
+    }
+    // 间隙空帧：浏览器继续显示上一帧 / Gap frame: the browser keeps showing the previous picture
+    if(size == 0) {
+        return ESP_OK;
+    }
+    if(size > client->bufSize) {
+        uint8_t *grown = (uint8_t*)(psramFound() ? ps_realloc(client->buf, size) : realloc(client->buf, size));
+        if(!grown) {
+            return ESP_ERR_NO_MEM;
+        }
+        client->buf = grown;
+        client->bufSize = size;
+    }
+    if(!seg->file.seek(offset) || sd_io_read(seg->file, client->buf, size, SD_IO_BULK) != size) {
+        return ESP_FAIL;
+    }
+
+    uint64_t recordedMs = seg->startMs + frame_time_ms(seg, frame);
+    char part[160];
+    struct iovec iov[2];
+    uint32_t writes = 0;
+    iov[0].iov_base = part;
+    iov[0].iov_len = snprintf(part, sizeof(part), PLAYBACK_PART, (unsigned long)size,
+                              (unsigned long)(recordedMs / 1000), (unsigned long)(recordedMs % 1000));
+    iov[1].iov_base = client->buf;
+    iov[1].iov_len = size;
+    esp_err_t res = stream_send_iov(fd, iov, 2, &writes);
+    *sent = res == ESP_OK;
+    return res;
+}
+
+/**
+ * @brief 播放当前分段 / Play the current segment
+ * @param frame 开始帧 / Start frame
+ * @return esp_err_t 播到分段结尾返回ESP_OK / ESP_OK once the end of the segment is reached
+ */
+static esp_err_t play_segment(PlaybackClient *client, int fd, uint32_t frame) {
+    PlaybackSegment *seg = &client->seg;
+    uint32_t speed = client->speedPct;
+    // 两次发送之间至少经过的录像时间，倍速越高跳过的帧越多 / Recorded time that passes at least between two sends, the higher the speed the more frames are skipped
+    uint64_t minStepMs = (uint64_t)1000 * speed / (100 * VIDEO_PLAYBACK_MAX_FPS);
+    int64_t baseUs = esp_timer_get_time();
+    uint64_t baseMs = frame_time_ms(seg, frame);
+    esp_err_t res = ESP_OK;
+    while(res == ESP_OK && frame < seg->totalFrames) {
+        // 等到这一帧按倍速应当显示的时间 / Wait until this frame is due at the chosen speed
+        int64_t dueUs = baseUs + (int64_t)((frame_time_ms(seg, frame) - baseMs) * 1000 * 100 / speed);
+        int64_t waitUs = dueUs - esp_timer_get_time();
+        if(waitUs >= 1000) {
+            vTaskDelay(pdMS_TO_TICKS(waitUs / 1000));
+        }
+        bool sent;
+        res = send_frame(client, fd, frame, &sent);
+        if(res != ESP_OK) {
+            break;
+        }
+        if(sent) {
+            client->frames++;
+        } else {
+            client->skipped++;
+        }
+
+        // 下一帧：不早于帧率上限，发送慢于播放速度时跳到当前应播放的帧 / Next frame: no sooner than the frame rate cap allows, and the frame due now when sending is slower than playback
+        uint64_t nextMs = frame_time_ms(seg, frame) + minStepMs;
+        uint64_t nowMs = baseMs + (uint64_t)(esp_timer_get_time() - baseUs) / 1000 * speed / 100;
+        if(nowMs > nextMs) {
+            nextMs = nowMs;
+        }
+        uint32_t next = (uint32_t)((nextMs * seg->totalFrames + seg->durationMs - 1) / seg->durationMs);
+        if(next <= frame) {
+            next = frame + 1;
+        }
+        if(next > seg->totalFrames) {
+            next = seg->totalFrames;
+        }
+        client->skipped += next - frame - 1;
+        frame = next;
+    }
+    return res;
+}
+
+/**
+ * @brief 发送任务 / Sender task
+ * @param pvParameters 回放位置 / Playback slot
+ */
+static void video_playback_task(void *pvParameters) {
+    PlaybackClient *client = (PlaybackClient*)pvParameters;
+    httpd_req_t *req = client->req;
+    int fd = httpd_req_to_sockfd(req);
+
+    char head[256];
+    struct iovec iov;
+    uint32_t writes = 0;
+    iov.iov_base = head;
+    iov.iov_len = snprintf(head, sizeof(head), PLAYBACK_HEAD, (unsigned long)(client->speedPct / 100),
+                           (unsigned long)(client->speedPct % 100));
+    esp_err_t res = stream_send_iov(fd, &iov, 1, &writes);
+
+    uint32_t frame = client->firstFrame;
+    while(res == ESP_OK) {
+        res = play_segment(client, fd, frame);
+        if(res != ESP_OK) {
+            break;
+        }
+        // 接着播放下一个分段 / Carry on with the next segment
+        FileInfo next;
+        uint32_t endTime = (uint32_t)((client->seg.startMs + client->seg.durationMs) / 1000);
+        if(catalog_list(VIDEO_DIR, client->seg.path, endTime, false, CATALOG_FLAG_OPEN, &next, 1) != 1 ||
+           !open_segment(&client->seg, next.path)) {
+            break;
+        }
+        frame = 0;
+    }
+
+    // 交还连接并关闭：多路复用响应没有结尾，连接不能再用 / Hand the connection back and close it: the multipart response has no end, the connection cannot be reused
+    Serial.printf("Playback %lu ended: %lu frames sent, %lu skipped / 回放结束\n", (unsigned long)client->id,
+                  (unsigned long)client->frames, (unsigned long)client->skipped);
+    httpd_handle_t server = req->handle;
+    httpd_req_async_handler_complete(req);
+    httpd_sess_trigger_close(server, fd);
+    release_slot(client);
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief 初始化录像回放 / Initialise recording playback
+ * @return bool 成功返回true / Returns true on success
+ */
+bool video_playback_init(void) {
+    for(int i = 0; i < VIDEO_PLAYBACK_MAX_CLIENTS; i++) {
+        playbackClients[i].used = false;
+        playbackClients[i].req = NULL;
+        playbackClients[i].buf = NULL;
+        playbackClients[i].bufSize = 0;
+    }
+    return true;
+}
+
+/**
+ * @brief 开始回放 / Start a playback
+ * @return esp_err_t 成功返回ESP_OK，回放数已满返回ESP_ERR_NO_MEM / ESP_OK on success, ESP_ERR_NO_MEM when all playback slots are taken
+ */
+esp_err_t video_playback_start(httpd_req_t *req, const char *path, double t, uint32_t speedPct) {
+    // 占用回放位置 / Take a playback slot
+    PlaybackClient *client = NULL;
+    portENTER_CRITICAL(&playbackMux);
+    for(int i = 0; i < VIDEO_PLAYBACK_MAX_CLIENTS; i++) {
+        if(!playbackClients[i].used) {
+            client = &playbackClients[i];
+            client->used = true;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&playbackMux);
+    if(!client) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    if(!open_segment(&client->seg, path)) {
+        release_slot(client);
+        return httpd_resp_send_404(req);
+    }
+
+    // 开始帧：分段内秒数或Unix时间戳 / Start frame: seconds into the segment or a Unix timestamp
+    PlaybackSegment *seg = &client->seg;
+    double offsetMs = t >= 1000000000.0 ? t * 1000.0 - (double)seg->startMs : t * 1000.0;
+    if(offsetMs < 0) {
+        offsetMs = 0;
+    }
+    if(offsetMs >= seg->durationMs) {
+        release_slot(client);
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "t is past the end of the recording");
+    }
+    client->firstFrame = (uint32_t)((uint64_t)offsetMs * seg->totalFrames / seg->durationMs);
+    client->speedPct = speedPct < VIDEO_PLAYBACK_MIN_SPEED ? VIDEO_PLAYBACK_MIN_SPEED :
+                       (speedPct > VIDEO_PLAYBACK_MAX_SPEED ? VIDEO_PLAYBACK_MAX_SPEED : speedPct);
+    client->frames = 0;
+    client->skipped = 0;
+    client->bufSize = seg->maxFrameSize && seg->maxFrameSize <= VIDEO_PLAYBACK_MAX_FRAME ? seg->maxFrameSize : 64 * 1024;
+    client->buf = (uint8_t*)(psramFound() ? ps_malloc(client->bufSize) : malloc(client->bufSize));
+    if(!client->buf) {
+        release_slot(client);
+        return httpd_resp_send_500(req);
+    }
+    client->id = nextPlaybackId++;
+
+    if(httpd_req_async_handler_begin(req, &client->req) != ESP_OK) {
+        release_slot(client);
+        return ESP_FAIL;
+    }
+    char name[16];
+    snprintf(name, sizeof(name), "playback_%lu", (unsigned long)client->id);
+    if(xTaskCreatePinnedToCore(video_playback_task, name, VIDEO_PLAYBACK_TASK_STACK, client,
+                               VIDEO_PLAYBACK_TASK_PRIORITY, NULL, VIDEO_PLAYBACK_TASK_CORE) != pdPASS) {
+        httpd_req_async_handler_complete(client->req);
+        release_slot(client);
+        return ESP_ERR_NO_MEM;
+    }
+    Serial.printf("Playback %lu started: %s from frame %lu at %lu%% / 回放开始\n", (unsigned long)client->id, path,
+                  (unsigned long)client->firstFrame, (unsigned long)client->speedPct);
+    return ESP_OK;
+}
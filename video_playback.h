@@ -0,0 +1,70 @@
+/**********************************************************************
+  文件名称 / Filename : video_playback.h
+  文件用途 / File Purpose : 录像回放头文件 / Recording Playback Header File
+               声明了把录像AVI中的00dc帧按原始时间和倍速以MJPEG推送给浏览器相关的函数原型和宏定义
+               Declares function prototypes and macro definitions for pushing the 00dc frames of a recorded AVI to the browser as MJPEG, paced by their original timing and a speed factor
+  作者 / Author : ESP32-S3监控项目 / ESP32-S3 Monitoring Project
+  修改日期 / Modification Date : 2026-02-05
+  硬件平台 / Hardware Platform : ESP32S3-EYE开发板 / ESP32S3-EYE Development Board
+  依赖库 / Dependencies : esp_http_server.h - 异步请求 / Asynchronous requests
+               sd_read_write.h - AVI格式 / AVI format
+               catalog.h - 查找下一个分段 / Finding the next segment
+               stream_clients.h - 一次写出 / Single-write sending
+  使用说明 / Usage Instructions : 1. 包含本头文件 #include "video_playback.h" / Include this header file
+               2. /playback处理函数验证认证和路径后调用video_playback_start()并立即返回 / The /playback handler checks authentication and the path, then calls video_playback_start() and returns at once
+  参数调整 / Parameter Adjustment : VIDEO_PLAYBACK_MAX_CLIENTS - 同时回放数上限（默认2）/ Maximum concurrent playbacks (default 2)
+               VIDEO_PLAYBACK_MAX_FPS - 发出帧率上限，倍速超过时按索引跳帧（默认20，与录像帧率相同）/ Output frame rate cap, frames are skipped through the index beyond it (default 20, the recording rate)
+  注意事项 / Important Notes : 不解码JPEG，只读取idx1索引和选中的帧；没有有效索引的旧文件顺序扫描块头
+                  No JPEG decode, only the idx1 index and the selected frames are read; older files without a usable index walk the chunk headers in order
+               帧时间 = 分段开始时间 + 帧序号 × 实际帧间隔（与video_clip相同）/ Frame time = segment start + frame number × actual frame interval (same as video_clip)
+               网络慢于播放速度时跳到当前应播放的帧，不积压 / When the network is slower than playback, it jumps to the frame due now instead of falling behind
+               录像间隙的空帧（大小为0的00dc块）不发送，计入跳帧，浏览器停在间隙前一帧 / Empty gap frames (zero-size 00dc chunks) are not sent but counted as skipped, the browser holds the last picture before the gap
+               一个分段播完后按索引接着播放下一个分段，正在录制的分段不播放
+                  After one segment ends, playback carries on with the next one from the catalog; the segment being recorded is not played
+**********************************************************************/
+
+#ifndef __VIDEO_PLAYBACK_H
+#define __VIDEO_PLAYBACK_H
+
+#include "Arduino.h"
+#include "esp_http_server.h"
+
+// 同时回放数上限 / Maximum concurrent playbacks
+#define VIDEO_PLAYBACK_MAX_CLIENTS 2
+
+// 发出帧率上限 / Output frame rate cap
+#define VIDEO_PLAYBACK_MAX_FPS 20
+
+// 倍速范围（百分比）/ Speed range (percent)
+#define VIDEO_PLAYBACK_MIN_SPEED 10
+#define VIDEO_PLAYBACK_MAX_SPEED 3200
+
+// 单帧最大字节数，超过视为文件损坏 / Largest frame in bytes, anything bigger is treated as a corrupt file
+#define VIDEO_PLAYBACK_MAX_FRAME (512 * 1024)
+
+// 发送任务配置 / Sender task configuration
+#define VIDEO_PLAYBACK_TASK_STACK 6144
+#define VIDEO_PLAYBACK_TASK_PRIORITY 3
+#define VIDEO_PLAYBACK_TASK_CORE 0
+
+/**
+ * @brief 初始化录像回放 / Initialise recording playback
+ * @return bool 成功返回true / Returns true on success
+ */
+bool video_playback_init(void);
+
+/**
+ * @brief 开始回放 / Start a playback
+ * @param req 请求 / Request
+ * @param path 录像路径（调用方已检查）/ Recording path (already checked by the caller)
+ * @param t 开始位置：小于1000000000为分段内秒数，否则为Unix时间戳 / Where to start: seconds into the segment below 1000000000, a Unix timestamp otherwise
+ * @param speedPct 倍速百分比（100为原速）/ Speed in percent (100 is real time)
+ * @return esp_err_t ESP_OK表示已开始发送或已回复404，ESP_ERR_NO_MEM表示回放数已满，由调用方回复503
+ *                   ESP_OK once sending has started or a 404 has been sent, ESP_ERR_NO_MEM when all playback slots are taken and the caller answers 503
+ * @details 功能说明 / Function Description:
+ *          1. 打开分段并检查文件头和索引 / Open the segment and check its headers and index
+ *          2. 把请求交给发送任务，视频流服务器随即可以处理其他请求 / Hand the request to a sender task, the stream server can handle other requests at once
+ */
+esp_err_t video_playback_start(httpd_req_t *req, const char *path, double t, uint32_t speedPct);
+
+#endif // __VIDEO_PLAYBACK_H
@@ -0,0 +1,423 @@
+/**********************************************************************
+  文件名称 / Filename : ws_stream.cpp
+  文件用途 / File Purpose : WebSocket视频流实现文件 / WebSocket Video Stream Implementation File
+               本文件实现了/ws/stream端点：每个客户端一个发送任务，按确认窗口推送最新帧
+               This file implements the /ws/stream endpoint: one sender task per client, pushing the newest frame within the acknowledgement window
+               主要功能包括 / Main Features:
+               1. 每帧一个二进制消息，WebSocket帧头、消息头和JPEG一次writev()写出 / One binary message per frame, WebSocket header, message header and JPEG written in one writev()
+               2. 按确认的流量控制 / Acknowledgement-based flow control
+               3. 同一连接上的舵机命令 / Servo commands on the same connection
+               4. 帧复制到客户端缓冲后立即释放，发送不占用帧缓冲 / Frames are copied to the client buffer and released at once, sending never holds a frame buffer
+  作者 / Author : ESP32-S3监控项目 / ESP32-S3 Monitoring Project
+  修改日期 / Modification Date : 2026-02-05
+  硬件平台 / Hardware Platform : ESP32S3-EYE开发板 / ESP32S3-EYE Development Board
+  依赖库 / Dependencies : esp_http_server.h - WebSocket支持 / WebSocket support
+               servo_control.h - 舵机命令 / Servo commands
+  使用说明 / Usage Instructions : 1. 调用ws_stream_init()初始化 / Call ws_stream_init() to initialise
+  注意事项 / Important Notes : 客户端位置在发送任务结束且会话关闭后才释放，服务器仍可能用sess_ctx回调到它
+                  A client slot is freed only once the sender task has ended and the session has closed, the server may still call back with it as sess_ctx until then
+**********************************************************************/
+
+#include "ws_stream.h"
+#include "frame_broker.h"
+#include "auth.h"
+#include "servo_control.h"
+#include "esp_timer.h"
+
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+
+// 客户端位置 / Client slot
+typedef struct {
+    bool used;                          // 是否占用 / Whether taken
+    bool taskRunning;                   // 发送任务在运行 / Sender task running
+    bool sessionOpen;                   // 会话未关闭 / Session not closed yet
+    bool closed;                        // 会话已关闭或收到关闭消息，停止发送 / Session closed or close received, stop sending
+    httpd_handle_t server;              // 视频流服务器 / Stream server
+    int fd;                             // 套接字 / Socket
+    uint32_t credit;                    // 确认窗口，0表示不做流量控制 / Acknowledgement window, 0 for no flow control
+    uint32_t acked;                     // 已确认的帧序号 / Sequence number acknowledged
+    SemaphoreHandle_t sendMutex;        // 套接字发送互斥锁 / Socket send mutex
+    SemaphoreHandle_t creditSem;        // 确认、窗口变化或关闭时释放 / Given on acknowledgements, window changes and close
+    StreamClientStats stats;            // 统计 / Statistics
+    uint32_t fpsFrames;                 // 本秒开始时的帧数 / Frames at the start of this second
+    uint32_t fpsStartMs;                // 本秒开始时间 / Start of this second
+} WsClient;
+
+static WsClient wsClients[WS_STREAM_MAX_CLIENTS];
+static uint32_t nextClientId = 1;
+static portMUX_TYPE wsMux = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief 写WebSocket二进制帧头 / Write a WebSocket binary frame header
+ * @return size_t 帧头长度 / Header length
+ * @note 服务器发出的帧不加掩码 / Frames from the server are not masked
+ */
+static size_t ws_frame_header(uint8_t *buf, size_t payloadLen) {
+    buf[0] = 0x80 | HTTPD_WS_TYPE_BINARY;
+    if(payloadLen < 126) {
+        buf[1] = payloadLen;
+        return 2;
+    }
+    if(payloadLen <= 0xFFFF) {
+        buf[1] = 126;
+        buf[2] = payloadLen >> 8;
+        buf[3] = payloadLen & 0xFF;
+        return 4;
+    }
+    buf[1] = 127;
+    for(int i = 0; i < 8; i++) {
+        buf[2 + i] = (uint64_t)payloadLen >> (56 - 8 * i);
+    }
+    return 10;
+}
+
+/**
+ * @brief 结束发送任务或会话的一方，两方都结束时释放位置 / End the task or the session side, freeing the slot once both have ended
+ */
+static void release_side(WsClient *client, bool task) {
+    portENTER_CRITICAL(&wsMux);
+    if(task) {
+        client->taskRunning = false;
+    } else {
+        client->sessionOpen = false;
+    }
+    if(!client->taskRunning && !client->sessionOpen) {
+        client->used = false;
+    }
+    portEXIT_CRITICAL(&wsMux);
+}
+
+/**
+ * @brief 会话关闭（httpd的free_ctx回调）/ Session closed (httpd free_ctx callback)
+ * @note 服务器已关闭套接字，持锁标记后发送任务不会再写这个套接字 / The server has already closed the socket, once marked under the lock the sender never writes to it again
+ */
+static void ws_session_closed(void *ctx) {
+    WsClient *client = (WsClient*)ctx;
+    xSemaphoreTake(client->sendMutex, portMAX_DELAY);
+    client->closed = true;
+    xSemaphoreGive(client->sendMutex);
+    xSemaphoreGive(client->creditSem);
+    release_side(client, false);
+}
+
+/**
+ * @brief 记录一帧 / Count one frame
+ */
+static void count_frame(WsClient *client, size_t bytes, uint32_t gap, uint32_t backlog, uint32_t sendUs, uint32_t writes,
+                        uint32_t latencyUs) {
+    uint32_t now = millis();
+    // 不做流量控制时跳过的帧都是发送慢造成的 / Without flow control every skipped frame is down to slow sending
+    uint32_t dropped = client->credit && backlog < gap ? backlog : gap;
+    portENTER_CRITICAL(&wsMux);
+    StreamClientStats *stats = &client->stats;
+    stats->frames++;
+    stats->bytes += bytes;
+    stats->skipped += gap;
+    stats->dropped += dropped;
+    stats->capped += gap - dropped;
+    stats->sendUs += sendUs;
+    stats->writes += writes;
+    stats->latencyUs += latencyUs;
+    if(now - client->fpsStartMs >= 1000) {
+        stats->fps = (stats->frames - client->fpsFrames) * 1000.0f / (now - client->fpsStartMs);
+        client->fpsFrames = stats->frames;
+        client->fpsStartMs = now;
+    }
+    portEXIT_CRITICAL(&wsMux);
+}
+
+/**
+ * @brief 等待确认窗口有空位 / Wait for room in the acknowledgement window
+ * @return bool 可以发送返回true，已关闭或等待超时返回false / Returns true when a frame may be sent, false when closed or timed out
+ */
+static bool wait_credit(WsClient *client, uint32_t seq) {
+    while(true) {
+        portENTER_CRITICAL(&wsMux);
+        bool closed = client->closed;
+        uint32_t credit = client->credit;
+        uint32_t acked = client->acked;
+        portEXIT_CRITICAL(&wsMux);
+        if(closed) {
+            return false;
+        }
+        if(credit == 0 || seq - acked < credit) {
+            return true;
+        }
+        if(xSemaphoreTake(client->creditSem, pdMS_TO_TICKS(WS_STREAM_ACK_TIMEOUT_MS)) != pdTRUE) {
+            Serial.printf("WebSocket client %lu: no acknowledgement / WebSocket客户端未确认\n", (unsigned long)client->stats.id);
+            return false;
+        }
+    }
+}
+
+/**
+ * @brief 发送任务 / Sender task
+ * @param pvParameters 客户端位置 / Client slot
+ */
+static void ws_stream_task(void *pvParameters) {
+    WsClient *client = (WsClient*)pvParameters;
+    FrameSubscriber sub;
+    frame_broker_subscribe(&sub);
+    StreamFrameBuf frameBuf = {NULL, 0};
+
+    uint32_t seq = 0;
+    uint32_t backlog = 0;
+    esp_err_t res = ESP_OK;
+    while(res == ESP_OK && wait_credit(client, seq)) {
+        // 窗口有空位后取最新帧，等待期间的帧直接跳过 / Take the newest frame once the window has room, frames during the wait are skipped outright
+        uint32_t skippedBefore = sub.skipped;
+        camera_fb_t *fb = frame_broker_acquire(&sub, STREAM_FRAME_TIMEOUT_MS);
+        if(!fb) {
+            break;
+        }
+        // 复制后立即释放帧，等待发送锁和发送阻塞时不占用帧缓冲 / Copy and release the frame at once so waiting for the send lock or a blocked send holds no frame buffer
+        struct timeval timestamp;
+        size_t len = stream_copy_frame(fb, &frameBuf, &timestamp);
+        if(len == 0) {
+            portENTER_CRITICAL(&wsMux);
+            client->stats.skipped++;
+            client->stats.dropped++;
+            portEXIT_CRITICAL(&wsMux);
+            continue;
+        }
+
+        // WebSocket帧头和消息头合在一起，与JPEG一次写出 / WebSocket header and message header in one piece, written together with the JPEG
+        uint8_t head[10 + sizeof(WsFrameHeader)];
+        size_t headLen = ws_frame_header(head, sizeof(WsFrameHeader) + len);
+        WsFrameHeader frameHeader = {++seq, (uint32_t)timestamp.tv_sec, (uint32_t)timestamp.tv_usec};
+        memcpy(head + headLen, &frameHeader, sizeof(frameHeader));
+        struct iovec iov[2];
+        iov[0].iov_base = head;
+        iov[0].iov_len = headLen + sizeof(frameHeader);
+        iov[1].iov_base = frameBuf.data;
+        iov[1].iov_len = len;
+
+        int64_t sendStartUs = esp_timer_get_time();
+        uint32_t writes = 0;
+        xSemaphoreTake(client->sendMutex, portMAX_DELAY);
+        res = client->closed ? ESP_FAIL : stream_send_iov(client->fd, iov, 2, &writes);
+        xSemaphoreGive(client->sendMutex);
+        int64_t sendEndUs = esp_timer_get_time();
+        if(res == ESP_OK) {
+            int64_t latencyUs = sendEndUs - ((int64_t)timestamp.tv_sec * 1000000LL + timestamp.tv_usec);
+            count_frame(client, len, sub.skipped - skippedBefore, backlog, (uint32_t)(sendEndUs - sendStartUs), writes,
+                        latencyUs > 0 ? (uint32_t)latencyUs : 0);
+            FrameBrokerStats broker;
+            frame_broker_get_stats(&broker);
+            backlog = broker.published - sub.lastSeq;
+        }
+    }
+
+    Serial.printf("WebSocket client %lu ended: %lu frames, %lu dropped, %lu waiting for acks / WebSocket客户端断开\n",
+                  (unsigned long)client->stats.id, (unsigned long)client->stats.frames,
+                  (unsigned long)client->stats.dropped, (unsigned long)client->stats.capped);
+    // 会话未关闭时请服务器关闭 / Ask the server to close the session if it is still open
+    xSemaphoreTake(client->sendMutex, portMAX_DELAY);
+    if(!client->closed) {
+        client->closed = true;
+        httpd_sess_trigger_close(client->server, client->fd);
+    }
+    xSemaphoreGive(client->sendMutex);
+    free(frameBuf.data);
+    release_side(client, true);
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief 发送文本消息 / Send a text message
+ */
+static void send_text(httpd_req_t *req, WsClient *client, const char *text) {
+    httpd_ws_frame_t frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.type = HTTPD_WS_TYPE_TEXT;
+    frame.payload = (uint8_t*)text;
+    frame.len = strlen(text);
+    xSemaphoreTake(client->sendMutex, portMAX_DELAY);
+    if(!client->closed) {
+        httpd_ws_send_frame(req, &frame);
+    }
+    xSemaphoreGive(client->sendMutex);
+}
+
+/**
+ * @brief 处理文本命令 / Handle a text command
+ */
+static void handle_command(httpd_req_t *req, WsClient *client, const char *cmd) {
+    unsigned long value;
+    int a, b;
+    char reply[96];
+    if(sscanf(cmd, "ack %lu", &value) == 1) {
+        portENTER_CRITICAL(&wsMux);
+        if((int32_t)(value - client->acked) > 0) {
+            client->acked = value;
+        }
+        portEXIT_CRITICAL(&wsMux);
+        xSemaphoreGive(client->creditSem);
+    } else if(sscanf(cmd, "credit %lu", &value) == 1) {
+        portENTER_CRITICAL(&wsMux);
+        client->credit = value > WS_STREAM_MAX_CREDIT ? WS_STREAM_MAX_CREDIT : value;
+        portEXIT_CRITICAL(&wsMux);
+        xSemaphoreGive(client->creditSem);
+    } else if(sscanf(cmd, "jog %d %d", &a, &b) == 2 || sscanf(cmd, "servo %d %d", &a, &b) == 2) {
+        bool ok = cmd[0] == 'j' ? servo_moveRelative(a, b) : servo_setPosition(a, b);
+        snprintf(reply, sizeof(reply), "{\"status\":\"%s\",\"pan\":%d,\"tilt\":%d}", ok ? "ok" : "error",
+                 servo_getPanAngle(), servo_getTiltAngle());
+        send_text(req, client, reply);
+    } else {
+        send_text(req, client, "{\"status\":\"error\",\"message\":\"unknown command\"}");
+    }
+}
+
+/**
+ * @brief 初始化WebSocket视频流 / Initialise the WebSocket stream
+ * @return bool 成功返回true / Returns true on success
+ */
+bool ws_stream_init(void) {
+    for(int i = 0; i < WS_STREAM_MAX_CLIENTS; i++) {
+        if(!wsClients[i].sendMutex) {
+            wsClients[i].sendMutex = xSemaphoreCreateMutex();
+            wsClients[i].creditSem = xSemaphoreCreateBinary();
+        }
+        if(!wsClients[i].sendMutex || !wsClients[i].creditSem) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief 握手：占用客户端位置并启动发送任务 / Handshake: take a client slot and start the sender task
+ */
+static esp_err_t ws_stream_open(httpd_req_t *req) {
+    auth_result_t auth_result = auth_verify(req);
+    if(auth_result != AUTH_SUCCESS) {
+        Serial.printf("WebSocket stream: authentication failed (%d) / WebSocket视频流认证失败\n", auth_result);
+        return ESP_FAIL;
+    }
+
+    WsClient *client = NULL;
+    portENTER_CRITICAL(&wsMux);
+    for(int i = 0; i < WS_STREAM_MAX_CLIENTS; i++) {
+        if(!wsClients[i].used && wsClients[i].sendMutex) {
+            client = &wsClients[i];
+            client->used = true;
+            client->taskRunning = true;
+            client->sessionOpen = true;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&wsMux);
+    if(!client) {
+        Serial.println("WebSocket stream: no free client slot / WebSocket视频流客户端已满");
+        return ESP_FAIL;
+    }
+
+    client->closed = false;
+    client->server = req->handle;
+    client->fd = httpd_req_to_sockfd(req);
+    client->credit = 0;
+    client->acked = 0;
+    xSemaphoreTake(client->creditSem, 0);
+    memset(&client->stats, 0, sizeof(client->stats));
+    client->stats.id = nextClientId++;
+    client->stats.startMs = millis();
+    client->fpsFrames = 0;
+    client->fpsStartMs = client->stats.startMs;
+
+    char name[16];
+    snprintf(name, sizeof(name), "ws_stream_%lu", (unsigned long)client->stats.id);
+    if(xTaskCreatePinnedToCore(ws_stream_task, name, WS_STREAM_TASK_STACK, client,
+                               WS_STREAM_TASK_PRIORITY, NULL, WS_STREAM_TASK_CORE) != pdPASS) {
+        portENTER_CRITICAL(&wsMux);
+        client->used = false;
+        portEXIT_CRITICAL(&wsMux);
+        return ESP_FAIL;
+    }
+    // 会话关闭时服务器调用free_ctx / The server calls free_ctx when the session closes
+    req->sess_ctx = client;
+    req->free_ctx = ws_session_closed;
+    Serial.printf("WebSocket client %lu started / WebSocket客户端已连接\n", (unsigned long)client->stats.id);
+    return ESP_OK;
+}
+
+/**
+ * @brief /ws/stream处理函数 / /ws/stream handler
+ */
+esp_err_t ws_stream_handler(httpd_req_t *req) {
+    if(req->method == HTTP_GET) {
+        return ws_stream_open(req);
+    }
+    WsClient *client = (WsClient*)req->sess_ctx;
+    if(!client) {
+        return ESP_FAIL;
+    }
+
+    // 先取消息长度，命令很短，过长的消息丢弃 / Get the message length first, commands are short and longer messages are discarded
+    httpd_ws_frame_t frame;
+    memset(&frame, 0, sizeof(frame));
+    if(httpd_ws_recv_frame(req, &frame, 0) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    uint8_t payload[64];
+    if(frame.len >= sizeof(payload)) {
+        return ESP_FAIL;
+    }
+    if(frame.len > 0) {
+        frame.payload = payload;
+        if(httpd_ws_recv_frame(req, &frame, frame.len) != ESP_OK) {
+            return ESP_FAIL;
+        }
+    }
+    payload[frame.len] = 0;
+
+    switch(frame.type) {
+        case HTTPD_WS_TYPE_TEXT:
+            handle_command(req, client, (const char*)payload);
+            break;
+        case HTTPD_WS_TYPE_PING: {
+            // 控制帧由这里处理，回复与发送任务共用互斥锁 / Control frames are handled here, the reply shares the sender's mutex
+            httpd_ws_frame_t pong = frame;
+            pong.type = HTTPD_WS_TYPE_PONG;
+            xSemaphoreTake(client->sendMutex, portMAX_DELAY);
+            if(!client->closed) {
+                httpd_ws_send_frame(req, &pong);
+            }
+            xSemaphoreGive(client->sendMutex);
+            break;
+        }
+        case HTTPD_WS_TYPE_CLOSE:
+            // 发送任务结束后关闭会话 / The session is closed once the sender task ends
+            xSemaphoreTake(client->sendMutex, portMAX_DELAY);
+            client->closed = true;
+            xSemaphoreGive(client->sendMutex);
+            xSemaphoreGive(client->creditSem);
+            httpd_sess_trigger_close(req->handle, httpd_req_to_sockfd(req));
+            break;
+        default:
+            break;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief 获取已连接客户端统计 / Get statistics of the connected clients
+ * @return int 客户端数 / Number of clients
+ */
+int ws_stream_get_stats(StreamClientStats *stats, int maxClients) {
+    int count = 0;
+    uint32_t now = millis();
+    portENTER_CRITICAL(&wsMux);
+    for(int i = 0; i < WS_STREAM_MAX_CLIENTS && count < maxClients; i++) {
+        if(wsClients[i].used && wsClients[i].taskRunning) {
+            stats[count] = wsClients[i].stats;
+            if(now - wsClients[i].fpsStartMs > 2000) {
+                stats[count].fps = 0;
+            }
+            count++;
+        }
+    }
+    portEXIT_CRITICAL(&wsMux);
+    return count;
+}
+
+#endif // CONFIG_HTTPD_WS_SUPPORT
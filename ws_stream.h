@@ -0,0 +1,84 @@
+/**********************************************************************
+  文件名称 / Filename : ws_stream.h
+  文件用途 / File Purpose : WebSocket视频流头文件 / WebSocket Video Stream Header File
+               声明了/ws/stream端点按二进制消息推送JPEG、按确认做流量控制、同一连接传递舵机命令相关的函数原型和宏定义
+               Declares function prototypes and macro definitions for the /ws/stream endpoint that pushes JPEGs as binary messages, with acknowledgement-based flow control and servo commands on the same connection
+  作者 / Author : ESP32-S3监控项目 / ESP32-S3 Monitoring Project
+  修改日期 / Modification Date : 2026-02-05
+  硬件平台 / Hardware Platform : ESP32S3-EYE开发板 / ESP32S3-EYE Development Board
+  依赖库 / Dependencies : esp_http_server.h - WebSocket支持（CONFIG_HTTPD_WS_SUPPORT）/ WebSocket support (CONFIG_HTTPD_WS_SUPPORT)
+               frame_broker.h - 共用的最新帧 / Shared newest frame
+               stream_clients.h - 统计结构和一次写出 / Statistics structure and single-write sending
+  使用说明 / Usage Instructions : 1. 包含本头文件 #include "ws_stream.h" / Include this header file
+               2. 在视频流服务器上注册/ws/stream，is_websocket和handle_ws_control_frames设为true，处理函数为ws_stream_handler
+                  Register /ws/stream on the stream server with is_websocket and handle_ws_control_frames set, handler ws_stream_handler
+  参数调整 / Parameter Adjustment : WS_STREAM_MAX_CLIENTS - 同时连接的客户端上限（默认2）/ Maximum concurrent clients (default 2)
+               WS_STREAM_MAX_CREDIT - 确认窗口上限 / Maximum acknowledgement window
+  注意事项 / Important Notes : 服务器→客户端：每帧一个二进制消息，前12字节为WsFrameHeader（小端），其后为JPEG
+                  Server to client: one binary message per frame, the first 12 bytes are a WsFrameHeader (little-endian), then the JPEG
+               客户端→服务器（文本消息）/ Client to server (text messages):
+                  "credit N"        开启流量控制，最多N帧未确认 / Turn on flow control with at most N unacknowledged frames
+                  "ack SEQ"         确认SEQ及之前的帧 / Acknowledge frame SEQ and everything before it
+                  "jog DPAN DTILT"  舵机相对移动 / Move the servos relative
+                  "servo PAN TILT"  舵机移动到指定角度 / Move the servos to the given angles
+               未发送credit时按套接字背压发送；开启后未确认的帧达到窗口时不再发送，之后发送的总是最新帧
+                  Without credit, sending follows socket back-pressure; with it, sending pauses once the window is full and the next frame sent is always the newest
+               发送任务和服务器任务通过每个客户端的互斥锁共用套接字，会话关闭时由httpd的free_ctx回调通知
+                  The sender task and the server task share the socket through a per-client mutex, session close is signalled by the httpd free_ctx callback
+**********************************************************************/
+
+#ifndef __WS_STREAM_H
+#define __WS_STREAM_H
+
+#include "Arduino.h"
+#include "esp_http_server.h"
+#include "stream_clients.h"
+
+// 同时连接的客户端上限 / Maximum concurrent clients
+#define WS_STREAM_MAX_CLIENTS 2
+
+// 确认窗口上限 / Maximum acknowledgement window
+#define WS_STREAM_MAX_CREDIT 8
+
+// 窗口满后等待确认的超时（毫秒），超时后断开 / Timeout waiting for an acknowledgement with a full window (ms), the client is dropped after it
+#define WS_STREAM_ACK_TIMEOUT_MS 5000
+
+// 发送任务配置 / Sender task configuration
+#define WS_STREAM_TASK_STACK 4096
+#define WS_STREAM_TASK_PRIORITY 4
+#define WS_STREAM_TASK_CORE 0
+
+// 帧消息头（小端）/ Frame message header (little-endian)
+typedef struct __attribute__((packed)) {
+    uint32_t seq;                       // 帧序号，从1开始 / Frame sequence number, from 1
+    uint32_t sec;                       // 取帧时间戳（秒）/ Capture timestamp (s)
+    uint32_t usec;                      // 取帧时间戳（微秒部分）/ Capture timestamp (µs part)
+} WsFrameHeader;
+
+/**
+ * @brief 初始化WebSocket视频流 / Initialise the WebSocket stream
+ * @return bool 成功返回true / Returns true on success
+ */
+bool ws_stream_init(void);
+
+/**
+ * @brief /ws/stream处理函数 / /ws/stream handler
+ * @param req 请求 / Request
+ * @return esp_err_t 返回ESP_FAIL时服务器关闭连接 / The server closes the connection on ESP_FAIL
+ * @details 功能说明 / Function Description:
+ *          1. 握手（GET）：验证认证，占用客户端位置并启动发送任务 / Handshake (GET): authenticate, take a client slot and start the sender task
+ *          2. 文本消息：确认、窗口和舵机命令 / Text messages: acknowledgements, window and servo commands
+ *          3. 关闭消息：结束发送任务 / Close message: end the sender task
+ */
+esp_err_t ws_stream_handler(httpd_req_t *req);
+
+/**
+ * @brief 获取已连接客户端统计 / Get statistics of the connected clients
+ * @param stats 输出数组 / Output array
+ * @param maxClients 数组容量 / Array capacity
+ * @return int 客户端数 / Number of clients
+ * @note limits.maxFps为0，capped为等待确认跳过的帧数 / limits.maxFps is 0, capped counts frames skipped while waiting for acknowledgements
+ */
+int ws_stream_get_stats(StreamClientStats *stats, int maxClients);
+
+#endif // __WS_STREAM_H